@@ -203,7 +203,7 @@ QHullPartition(cpVect *verts, int count, cpVect a, cpVect b, cpFloat tol)
 	int pivot = 0;
 	
 	cpVect delta = cpvsub(b, a);
-	cpFloat valueTol = tol*cpvlength(delta);
+	cpFloat valueTol = cpfmax(tol, CP_HULL_TOLERANCE)*cpvlength(delta);
 	
 	int head = 0;
 	for(int tail = count-1; head <= tail;){
@@ -26,10 +26,32 @@
 #include "chipmunk/chipmunk_structs.h"
 
 #define CP_HASH_COEF (3344921057ul)
-#define CP_HASH_PAIR(A, B) ((cpHashValue)(A)*CP_HASH_COEF ^ (cpHashValue)(B)*CP_HASH_COEF)
+
+// Spread the bits of a pointer or id so that nearby values get unrelated hashes.
+static inline cpHashValue
+cpHashMix(cpHashValue x)
+{
+	x ^= x >> 16;
+	x *= CP_HASH_COEF;
+	return x ^ (x >> 13);
+}
+
+// Symmetric, so a pair hashes the same in either order.
+#define CP_HASH_PAIR(A, B) (cpHashMix((cpHashValue)(A)) + cpHashMix((cpHashValue)(B)))
 
 // TODO: Eww. Magic numbers.
-#define MAGIC_EPSILON 1e-5
+// Single precision can't resolve 1e-5 on coordinates in the hundreds, so the tolerances are widened for float builds.
+#if CP_USE_DOUBLES
+	#define MAGIC_EPSILON 1e-5
+	// Minimum tolerance used when reducing convex hulls.
+	#define CP_HULL_TOLERANCE 0.0
+	// Relative slack allowed when checking if GJK/EPA made progress.
+	#define CP_COLLISION_EPSILON 0.0
+#else
+	#define MAGIC_EPSILON 1e-3f
+	#define CP_HULL_TOLERANCE 1e-3f
+	#define CP_COLLISION_EPSILON (8.0f*CPFLOAT_EPSILON)
+#endif
 
 
 //MARK: cpArray
@@ -46,6 +68,19 @@ cpBool cpArrayContains(cpArray *arr, void *ptr);
 void cpArrayFreeEach(cpArray *arr, void (freeFunc)(void*));
 
 
+//MARK: cpArena
+
+cpArena *cpArenaInit(cpArena *arena, const cpSpaceAllocator *allocator, size_t chunkBytes);
+void cpArenaDestroy(cpArena *arena);
+
+void *cpArenaAlloc(cpArena *arena, size_t bytes);
+void cpArenaReset(cpArena *arena);
+
+// Allocate a pool buffer from the arena if there is one, otherwise from cpcalloc() and push it onto allocatedBuffers.
+void *cpBufferAlloc(cpArena *arena, cpArray *allocatedBuffers, size_t bytes);
+// Give back every buffer in allocatedBuffers. Arena buffers are kept in the arena for cpBufferAlloc() to reuse.
+void cpBufferFreeAll(cpArena *arena, cpArray *allocatedBuffers);
+
 //MARK: cpHashSet
 
 typedef cpBool (*cpHashSetEqlFunc)(const void *ptr, const void *elt);
@@ -53,6 +88,7 @@ typedef void *(*cpHashSetTransFunc)(const void *ptr, void *data);
 
 cpHashSet *cpHashSetNew(int size, cpHashSetEqlFunc eqlFunc);
 void cpHashSetSetDefaultValue(cpHashSet *set, void *default_value);
+void cpHashSetSetArena(cpHashSet *set, cpArena *arena);
 
 void cpHashSetFree(cpHashSet *set);
 
@@ -78,11 +114,46 @@ void cpBodyAccumulateMassFromShapes(cpBody *body);
 
 void cpBodyRemoveConstraint(cpBody *body, cpConstraint *constraint);
 
+// Continuous bodies are swept over the step while they are awake.
+static inline cpBool
+cpBodyIsSwept(const cpBody *body)
+{
+	return (body->continuous && body->sleeping.root == NULL);
+}
+
+// Transform of a continuous body at fraction t of the last step.
+// Earlier poses are found by moving the body back along its velocity from where it is now.
+static inline cpTransform
+cpBodySweepTransform(const cpBody *body, cpFloat t, cpFloat dt)
+{
+	cpFloat back = (body->impactTime - cpfmin(t, body->impactTime))*dt;
+	cpVect p = cpvsub(body->p, cpvmult(body->v, back));
+	cpVect rot = cpvforangle(body->a - body->w*back);
+	cpVect c = body->cog;
+	
+	return cpTransformNewTranspose(
+		rot.x, -rot.y, p.x - (c.x*rot.x - c.y*rot.y),
+		rot.y,  rot.x, p.y - (c.x*rot.y + c.y*rot.x)
+	);
+}
+
+// Move a continuous dynamic body back to fraction t of the last step.
+void cpBodySweepRewind(cpBody *body, cpFloat t, cpFloat dt);
+
 
 //MARK: Spatial Index Functions
 
 cpSpatialIndex *cpSpatialIndexInit(cpSpatialIndex *index, cpSpatialIndexClass *klass, cpSpatialIndexBBFunc bbfunc, cpSpatialIndex *staticIndex);
 
+// Size statistics used to pick and tune a spatial index.
+typedef struct cpBroadphasePopulation {
+	int count;
+	cpFloat totalExtent, maxExtent;
+} cpBroadphasePopulation;
+
+void cpBroadphasePopulationAdd(cpBroadphasePopulation *population, cpBB bb);
+void cpBroadphaseHashSize(const cpBroadphasePopulation *population, cpFloat *celldim, int *numcells);
+
 
 //MARK: Arbiters
 
@@ -97,10 +168,19 @@ cpArbiterThreadForBody(cpArbiter *arb, cpBody *body)
 void cpArbiterUnthread(cpArbiter *arb);
 
 void cpArbiterUpdate(cpArbiter *arb, struct cpCollisionInfo *info, cpSpace *space);
+// Look up the arbiter's collision handlers from its shapes' collision types.
+void cpArbiterUpdateHandlers(cpArbiter *arb, cpSpace *space);
 void cpArbiterPreStep(cpArbiter *arb, cpFloat dt, cpFloat bias, cpFloat slop);
 void cpArbiterApplyCachedImpulse(cpArbiter *arb, cpFloat dt_coef);
 void cpArbiterApplyImpulse(cpArbiter *arb);
 
+#if CP_USE_PACKED_SOLVER
+// Same as the functions above, for the packed copies made by the packed solver.
+void cpSolverArbiterPreStep(cpSolverArbiter *arb, cpFloat dt, cpFloat slop, cpFloat bias);
+void cpSolverArbiterApplyCachedImpulse(cpSolverArbiter *arb, cpFloat dt_coef);
+void cpSolverArbiterApplyImpulse(cpSolverArbiter *arb);
+#endif
+
 
 //MARK: Shapes/Collisions
 
@@ -116,6 +196,12 @@ cpShapeActive(cpShape *shape)
 
 // Note: This function returns contact points with r1/r2 in absolute coordinates, not body relative.
 struct cpCollisionInfo cpCollide(const cpShape *a, const cpShape *b, cpCollisionID id, struct cpContact *contacts);
+// Boolean overlap test used for trigger shapes.
+cpBool cpShapesOverlap(const cpShape *a, const cpShape *b);
+// Earliest fraction of the last step at which the shapes of continuous bodies touch, or INFINITY.
+cpFloat cpShapesTimeOfImpact(const cpShape *a, const cpShape *b, cpFloat dt, cpFloat tolerance);
+// Like cpCollide(), but with the shapes of continuous bodies where they were at fraction t of the last step.
+struct cpCollisionInfo cpCollideAt(const cpShape *a, const cpShape *b, cpFloat t, cpFloat dt, cpCollisionID id, struct cpContact *contacts);
 
 static inline void
 CircleSegmentQuery(cpShape *shape, cpVect center, cpFloat r1, cpVect a, cpVect b, cpFloat r2, cpSegmentQueryInfo *info)
@@ -182,8 +268,17 @@ normal_relative_velocity(cpBody *a, cpBody *b, cpVect r1, cpVect r2, cpVect n){
 	return cpvdot(relative_velocity(a, b, r1, r2), n);
 }
 
+// Static and kinematic bodies are shared between the islands solved by different threads.
+// Impulses don't change their velocities, so skip the writes to keep the threads from racing.
+#if CP_USE_THREADS
+	#define CP_SKIP_INFINITE_MASS(body) if(body->m_inv == 0.0f && body->i_inv == 0.0f) return
+#else
+	#define CP_SKIP_INFINITE_MASS(body)
+#endif
+
 static inline void
 apply_impulse(cpBody *body, cpVect j, cpVect r){
+	CP_SKIP_INFINITE_MASS(body);
 	body->v = cpvadd(body->v, cpvmult(j, body->m_inv));
 	body->w += body->i_inv*cpvcross(r, j);
 }
@@ -195,9 +290,17 @@ apply_impulses(cpBody *a , cpBody *b, cpVect r1, cpVect r2, cpVect j)
 	apply_impulse(b, j, r2);
 }
 
+static inline void
+apply_angular_impulse(cpBody *body, cpFloat dw)
+{
+	CP_SKIP_INFINITE_MASS(body);
+	body->w += dw;
+}
+
 static inline void
 apply_bias_impulse(cpBody *body, cpVect j, cpVect r)
 {
+	CP_SKIP_INFINITE_MASS(body);
 	body->v_bias = cpvadd(body->v_bias, cpvmult(j, body->m_inv));
 	body->w_bias += body->i_inv*cpvcross(r, j);
 }
@@ -276,25 +379,63 @@ bias_coef(cpFloat errorBias, cpFloat dt)
 		"Put these calls into a post-step callback." \
 	);
 
+// Value of cpSpace.prevStepTime when no step has been timed at the current step budget settings yet.
+// A step can take 0 ticks with a coarse or recorded clock, so 0 is a real time.
+#define CP_NO_STEP_TIME (~(uint64_t)0)
+
 void cpSpaceSetStaticBody(cpSpace *space, cpBody *body);
 
 extern cpCollisionHandler cpCollisionHandlerDoNothing;
 
 void cpSpaceProcessComponents(cpSpace *space, cpFloat dt);
 
+#if CP_USE_PACKED_SOLVER
+// List the space's arbiters grouped by contact graph component, and by body within each component.
+// 'order' must have room for all of them. Returns the number of arbiters written to it.
+int cpSpaceArbiterSolverOrder(cpSpace *space, cpArbiter **order);
+#endif
+
+#if CP_USE_THREADS
+// Find the contact graph component of each arbiter and constraint in the space, identified by the component's root body.
+// Arbiters and constraints between non-dynamic bodies get a NULL root.
+void cpSpaceComponentRoots(cpSpace *space, cpBody **arbiterRoots, cpBody **constraintRoots);
+
+void cpSolverPoolFree(cpSolverPool *pool);
+
+// Threaded versions of the arbiter prestep and the impulse solver, used by cpSpaceStep() when threads are enabled.
+void cpSpacePreStepIslands(cpSpace *space, cpFloat dt, cpFloat slop, cpFloat bias);
+void cpSpaceSolveIslands(cpSpace *space, cpFloat dt, cpFloat dt_coef);
+#endif
+
+void cpSpaceUpdateBroadphase(cpSpace *space);
+
 void cpSpacePushFreshContactBuffer(cpSpace *space);
 struct cpContact *cpContactBufferGetArray(cpSpace *space);
 void cpSpacePushContacts(cpSpace *space, int count);
+void cpSpaceResetContactBuffers(cpSpace *space);
 
 cpPostStepCallback *cpSpaceGetPostStepCallback(cpSpace *space, void *key);
 
+void *cpSpaceArbiterSetTrans(cpShape **shapes, cpSpace *space);
+void *cpSpaceTriggerPairSetTrans(cpShape **shapes, cpSpace *space);
 cpBool cpSpaceArbiterSetFilter(cpArbiter *arb, cpSpace *space);
+cpBool cpSpaceTriggerPairSetFilter(cpTriggerPair *pair, cpSpace *space);
 void cpSpaceFilterArbiters(cpSpace *space, cpBody *body, cpShape *filter);
 
 void cpSpaceActivateBody(cpSpace *space, cpBody *body);
+struct cpContact *cpSpaceAllocSleepingContacts(cpSpace *space);
+void cpSpaceFreeSleepingContacts(cpSpace *space, struct cpContact *contacts);
 void cpSpaceLock(cpSpace *space);
 void cpSpaceUnlock(cpSpace *space, cpBool runPostStep);
 
+static inline cpCollisionHandler *
+cpSpaceLookupHandler(cpSpace *space, cpCollisionType a, cpCollisionType b, cpCollisionHandler *defaultValue)
+{
+	cpCollisionType types[] = {a, b};
+	cpCollisionHandler *handler = (cpCollisionHandler *)cpHashSetFind(space->collisionHandlers, CP_HASH_PAIR(a, b), types);
+	return (handler ? handler : defaultValue);
+}
+
 static inline void
 cpSpaceUncacheArbiter(cpSpace *space, cpArbiter *arb)
 {
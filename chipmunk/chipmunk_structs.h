@@ -60,6 +60,10 @@ struct cpBody {
 	
 	cpTransform transform;
 	
+	// Continuous collision flag, and the fraction of the step the body has been moved back to after a time of impact.
+	cpBool continuous;
+	cpFloat impactTime;
+	
 	cpDataPointer userData;
 	
 	// "pseudo-velocities" used for eliminating overlap.
@@ -68,6 +72,8 @@ struct cpBody {
 	cpFloat w_bias;
 	
 	cpSpace *space;
+	// Unique within the space. Snapshots use it to match up bodies.
+	cpHashValue hashid;
 	
 	cpShape *shapeList;
 	cpArbiter *arbiterList;
@@ -144,6 +150,16 @@ struct cpArbiter {
 	enum cpArbiterState state;
 };
 
+// A pair of overlapping shapes where at least one is a trigger.
+// The shapes are in the order of the handler's collision types.
+typedef struct cpTriggerPair {
+	cpShape *a, *b;
+	cpCollisionHandler *handler;
+	
+	// Last step the shapes overlapped in, 0 until the enter callback has been called.
+	cpTimestamp stamp;
+} cpTriggerPair;
+
 struct cpShapeMassInfo {
 	cpFloat m;
 	cpFloat i;
@@ -183,6 +199,7 @@ struct cpShape {
 	cpBB bb;
 	
 	cpBool sensor;
+	cpBool trigger;
 	
 	cpFloat e;
 	cpFloat u;
@@ -228,6 +245,8 @@ struct cpPolyShape {
 	cpFloat r;
 	
 	int count;
+	// Rectangles take the SAT fast path in the narrowphase.
+	cpBool isBox;
 	// The untransformed planes are appended at the end of the transformed planes.
 	struct cpSplittingPlane *planes;
 	
@@ -393,8 +412,59 @@ struct cpSimpleMotor {
 typedef struct cpContactBufferHeader cpContactBufferHeader;
 typedef void (*cpSpaceArbiterApplyImpulseFunc)(cpArbiter *arb);
 
+#if CP_USE_PACKED_SOLVER
+// Packed copy of the arbiter fields used by the prestep and the impulse solver, pointing to a packed copy of its contacts.
+// Only valid between the prestep and the end of the impulse solver, the cpArbiter remains the authoritative copy.
+typedef struct cpSolverArbiter {
+	cpBody *body_a, *body_b;
+	cpVect n;
+	cpVect surface_vr;
+	cpFloat e, u;
+	cpBool firstContact;
+	
+	int count;
+	struct cpContact *contacts;
+	cpArbiter *arb;
+} cpSolverArbiter;
+#endif
+
+typedef struct cpArenaChunk cpArenaChunk;
+typedef struct cpArenaBuffer cpArenaBuffer;
+
+// Bump allocator that requests fixed size chunks from a cpSpaceAllocator.
+// Individual allocations are never freed, but the arena can be reset to reuse its chunks.
+typedef struct cpArena {
+	const cpSpaceAllocator *allocator;
+	size_t chunkBytes;
+	
+	cpArenaChunk *chunks, *current;
+	size_t used;
+	
+	// Pool buffers given back by spatial indexes freed before the space. See cpBufferFreeAll().
+	cpArenaBuffer *spareBuffers;
+} cpArena;
+
+#if CP_USE_THREADS
+// Worker threads and per-step island data for the threaded solver. See cpSpaceThreads.c.
+typedef struct cpSolverPool cpSolverPool;
+#endif
+
 struct cpSpace {
 	int iterations;
+	int substeps;
+	
+	cpBool useStepBudget;
+	cpStepBudget stepBudget;
+	uint64_t lastStepTime, prevStepTime;
+	
+#if CP_USE_STEP_PROFILE
+	cpStepClockFunc profileClock;
+	cpStepProfile *profiles;
+	int profileCapacity, profileCount, profileNext;
+	// Profile of the step in progress, and the clock reading its last phase ended at.
+	cpStepProfile profile;
+	uint64_t profileMark;
+#endif
 	
 	cpVect gravity;
 	cpFloat damping;
@@ -415,19 +485,44 @@ struct cpSpace {
 	cpArray *staticBodies;
 	cpArray *rousedBodies;
 	cpArray *sleepingComponents;
+	int awakeBodyCount;
+	int sleepingBodyCount;
+	cpHashValue bodyIDCounter;
 	
 	cpHashValue shapeIDCounter;
 	cpSpatialIndex *staticShapes;
 	cpSpatialIndex *dynamicShapes;
+	cpBroadphaseType dynamicShapesType;
+	
+	// The other kind of dynamic index, kept when auto-selection switches away from it.
+	cpSpatialIndex *spareDynamicShapes;
+	cpBool autoSelectBroadphase;
+	cpBroadphaseThresholds broadphaseThresholds;
+	int treeRebalanceBudget;
 	
 	cpArray *constraints;
 	
 	cpArray *arbiters;
+#if CP_USE_PACKED_SOLVER
+	cpSolverArbiter *solverArbiters;
+#endif
+#if CP_USE_THREADS
+	cpSolverPool *solverPool;
+#endif
 	cpContactBufferHeader *contactBuffersHead;
 	cpHashSet *cachedArbiters;
 	cpArray *pooledArbiters;
+	cpArray *pooledSleepingContacts;
+	
+	cpHashSet *triggerPairs;
+	cpArray *pooledTriggerPairs;
+	
+	// Pairs with a swept body found by this step's broadphase, collided after the swept bodies are moved back.
+	cpArray *sweptPairs;
 	
-	cpArray *allocatedBuffers;
+	cpSpaceAllocator allocator;
+	cpArena persistentArena;
+	cpArena scratchArena;
 	int locked;
 	
 	cpBool usesWildcards;
@@ -436,6 +531,7 @@ struct cpSpace {
 	
 	cpBool skipPostStep;
 	cpArray *postStepCallbacks;
+	cpArray *pooledPostStepCallbacks;
 	
 	cpBody *staticBody;
 	cpBody _staticBody;
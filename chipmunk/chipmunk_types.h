@@ -54,9 +54,16 @@
 
 #ifndef CP_USE_DOUBLES
 	// Use doubles by default for higher precision.
+	// Define CP_USE_DOUBLES=0 for a single precision build. The collision tolerances are widened to suit it.
 	#define CP_USE_DOUBLES 1
 #endif
 
+#ifndef CP_USE_DOUBLE_PREDICATES
+	// Evaluate the orientation predicates in cpRobust.c in double precision in a single precision build too.
+	// Makes them exact for float inputs, but puts double arithmetic back into GJK/EPA. No effect when CP_USE_DOUBLES=1.
+	#define CP_USE_DOUBLE_PREDICATES 0
+#endif
+
 /// @defgroup basicTypes Basic Types
 /// Most of these types can be configured at compile time.
 /// @{
@@ -76,6 +83,7 @@
 	#define cpffloor floor
 	#define cpfceil ceil
 	#define CPFLOAT_MIN DBL_MIN
+	#define CPFLOAT_EPSILON DBL_EPSILON
 #else
 	typedef float cpFloat;
 	#define cpfsqrt sqrtf
@@ -89,6 +97,50 @@
 	#define cpffloor floorf
 	#define cpfceil ceilf
 	#define CPFLOAT_MIN FLT_MIN
+	#define CPFLOAT_EPSILON FLT_EPSILON
+#endif
+
+#ifndef CP_USE_FIXED_KERNELS
+	// Route the transcendental functions through the integer kernels in cpFixed.c.
+	// Their results are bit-exact across the host and the N64.
+	#define CP_USE_FIXED_KERNELS 0
+#endif
+
+#ifndef CP_USE_PACKED_SOLVER
+	// Copy the arbiters and their contacts into a packed array each step, ordered by contact graph component and body,
+	// and run the prestep and impulse solver over that instead of the space's arbiter array. See cpSpaceStep.c.
+	#define CP_USE_PACKED_SOLVER 0
+#endif
+
+#ifndef CP_USE_SMALL_TREE_INDEX
+	// Address cpBBTree nodes with 16 bit indexes instead of 32 bit ones.
+	// Shrinks the nodes, but limits a tree to 32512 leaves. See cpBBTree.c.
+	#define CP_USE_SMALL_TREE_INDEX 0
+#endif
+
+#ifndef CP_USE_THREADS
+	// Build cpSpaceSetThreads() to solve independent islands on a pool of pthreads. See cpSpaceThreads.c.
+	// Only meant for host builds (tools, replays, regression runs). Link with -pthread.
+	#define CP_USE_THREADS 0
+#endif
+
+#ifndef CP_USE_STEP_PROFILE
+	// Build cpSpaceSetStepProfiler() to time the phases of every cpSpaceStep() into a ring buffer.
+	// Off by default, so release builds don't carry the clock checks. See cpSpaceStep.c.
+	#define CP_USE_STEP_PROFILE 0
+#endif
+
+#if CP_USE_FIXED_KERNELS
+	#include "cpFixed.h"
+
+	#undef cpfsqrt
+	#undef cpfsin
+	#undef cpfcos
+	#undef cpfatan2
+	#define cpfsqrt cpFixedKernelSqrt
+	#define cpfsin cpFixedKernelSin
+	#define cpfcos cpFixedKernelCos
+	#define cpfatan2 cpFixedKernelAtan2
 #endif
 
 #ifndef INFINITY
@@ -345,12 +345,21 @@ cpArbiterInit(cpArbiter *arb, cpShape *a, cpShape *b)
 	return arb;
 }
 
-static inline cpCollisionHandler *
-cpSpaceLookupHandler(cpSpace *space, cpCollisionType a, cpCollisionType b, cpCollisionHandler *defaultValue)
+void
+cpArbiterUpdateHandlers(cpArbiter *arb, cpSpace *space)
 {
-	cpCollisionType types[] = {a, b};
-	cpCollisionHandler *handler = (cpCollisionHandler *)cpHashSetFind(space->collisionHandlers, CP_HASH_PAIR(a, b), types);
-	return (handler ? handler : defaultValue);
+	cpCollisionType typeA = arb->a->type, typeB = arb->b->type;
+	cpCollisionHandler *defaultHandler = &space->defaultHandler;
+	cpCollisionHandler *handler = arb->handler = cpSpaceLookupHandler(space, typeA, typeB, defaultHandler);
+	
+	// Check if the types match, but don't swap for a default handler which use the wildcard for type A.
+	cpBool swapped = arb->swapped = (typeA != handler->typeA && handler->typeA != CP_WILDCARD_COLLISION_TYPE);
+	
+	if(handler != defaultHandler || space->usesWildcards){
+		// The order of the main handler swaps the wildcard handlers too. Uffda.
+		arb->handlerA = cpSpaceLookupHandler(space, (swapped ? typeB : typeA), CP_WILDCARD_COLLISION_TYPE, &cpCollisionHandlerDoNothing);
+		arb->handlerB = cpSpaceLookupHandler(space, (swapped ? typeA : typeB), CP_WILDCARD_COLLISION_TYPE, &cpCollisionHandlerDoNothing);
+	}
 }
 
 void
@@ -396,33 +405,21 @@ cpArbiterUpdate(cpArbiter *arb, struct cpCollisionInfo *info, cpSpace *space)
 	cpVect surface_vr = cpvsub(b->surfaceV, a->surfaceV);
 	arb->surface_vr = cpvsub(surface_vr, cpvmult(info->n, cpvdot(surface_vr, info->n)));
 	
-	cpCollisionType typeA = info->a->type, typeB = info->b->type;
-	cpCollisionHandler *defaultHandler = &space->defaultHandler;
-	cpCollisionHandler *handler = arb->handler = cpSpaceLookupHandler(space, typeA, typeB, defaultHandler);
-	
-	// Check if the types match, but don't swap for a default handler which use the wildcard for type A.
-	cpBool swapped = arb->swapped = (typeA != handler->typeA && handler->typeA != CP_WILDCARD_COLLISION_TYPE);
-	
-	if(handler != defaultHandler || space->usesWildcards){
-		// The order of the main handler swaps the wildcard handlers too. Uffda.
-		arb->handlerA = cpSpaceLookupHandler(space, (swapped ? typeB : typeA), CP_WILDCARD_COLLISION_TYPE, &cpCollisionHandlerDoNothing);
-		arb->handlerB = cpSpaceLookupHandler(space, (swapped ? typeA : typeB), CP_WILDCARD_COLLISION_TYPE, &cpCollisionHandlerDoNothing);
-	}
+	cpArbiterUpdateHandlers(arb, space);
 		
 	// mark it as new if it's been cached
 	if(arb->state == CP_ARBITER_STATE_CACHED) arb->state = CP_ARBITER_STATE_FIRST_COLLISION;
 }
 
-void
-cpArbiterPreStep(cpArbiter *arb, cpFloat dt, cpFloat slop, cpFloat bias)
+// The prestep and the impulse solver work on the contacts of an arbiter, and are shared with the packed solver.
+
+static inline void
+ContactsPreStep(cpBody *a, cpBody *b, cpVect n, cpFloat e, struct cpContact *contacts, int count, cpFloat dt, cpFloat slop, cpFloat bias)
 {
-	cpBody *a = arb->body_a;
-	cpBody *b = arb->body_b;
-	cpVect n = arb->n;
 	cpVect body_delta = cpvsub(b->p, a->p);
 	
-	for(int i=0; i<arb->count; i++){
-		struct cpContact *con = &arb->contacts[i];
+	for(int i=0; i<count; i++){
+		struct cpContact *con = &contacts[i];
 		
 		// Calculate the mass normal and mass tangent.
 		con->nMass = 1.0f/k_scalar(a, b, con->r1, con->r2, n);
@@ -434,21 +431,15 @@ cpArbiterPreStep(cpArbiter *arb, cpFloat dt, cpFloat slop, cpFloat bias)
 		con->jBias = 0.0f;
 		
 		// Calculate the target bounce velocity.
-		con->bounce = normal_relative_velocity(a, b, con->r1, con->r2, n)*arb->e;
+		con->bounce = normal_relative_velocity(a, b, con->r1, con->r2, n)*e;
 	}
 }
 
-void
-cpArbiterApplyCachedImpulse(cpArbiter *arb, cpFloat dt_coef)
+static inline void
+ContactsApplyCachedImpulse(cpBody *a, cpBody *b, cpVect n, struct cpContact *contacts, int count, cpFloat dt_coef)
 {
-	if(cpArbiterIsFirstContact(arb)) return;
-	
-	cpBody *a = arb->body_a;
-	cpBody *b = arb->body_b;
-	cpVect n = arb->n;
-	
-	for(int i=0; i<arb->count; i++){
-		struct cpContact *con = &arb->contacts[i];
+	for(int i=0; i<count; i++){
+		struct cpContact *con = &contacts[i];
 		cpVect j = cpvrotate(n, cpv(con->jnAcc, con->jtAcc));
 		apply_impulses(a, b, con->r1, con->r2, cpvmult(j, dt_coef));
 	}
@@ -456,17 +447,11 @@ cpArbiterApplyCachedImpulse(cpArbiter *arb, cpFloat dt_coef)
 
 // TODO: is it worth splitting velocity/position correction?
 
-void
-cpArbiterApplyImpulse(cpArbiter *arb)
+static inline void
+ContactsApplyImpulse(cpBody *a, cpBody *b, cpVect n, cpVect surface_vr, cpFloat friction, struct cpContact *contacts, int count)
 {
-	cpBody *a = arb->body_a;
-	cpBody *b = arb->body_b;
-	cpVect n = arb->n;
-	cpVect surface_vr = arb->surface_vr;
-	cpFloat friction = arb->u;
-
-	for(int i=0; i<arb->count; i++){
-		struct cpContact *con = &arb->contacts[i];
+	for(int i=0; i<count; i++){
+		struct cpContact *con = &contacts[i];
 		cpFloat nMass = con->nMass;
 		cpVect r1 = con->r1;
 		cpVect r2 = con->r2;
@@ -496,3 +481,45 @@ cpArbiterApplyImpulse(cpArbiter *arb)
 		apply_impulses(a, b, r1, r2, cpvrotate(n, cpv(con->jnAcc - jnOld, con->jtAcc - jtOld)));
 	}
 }
+
+void
+cpArbiterPreStep(cpArbiter *arb, cpFloat dt, cpFloat slop, cpFloat bias)
+{
+	ContactsPreStep(arb->body_a, arb->body_b, arb->n, arb->e, arb->contacts, arb->count, dt, slop, bias);
+}
+
+void
+cpArbiterApplyCachedImpulse(cpArbiter *arb, cpFloat dt_coef)
+{
+	if(cpArbiterIsFirstContact(arb)) return;
+	ContactsApplyCachedImpulse(arb->body_a, arb->body_b, arb->n, arb->contacts, arb->count, dt_coef);
+}
+
+void
+cpArbiterApplyImpulse(cpArbiter *arb)
+{
+	ContactsApplyImpulse(arb->body_a, arb->body_b, arb->n, arb->surface_vr, arb->u, arb->contacts, arb->count);
+}
+
+#if CP_USE_PACKED_SOLVER
+
+void
+cpSolverArbiterPreStep(cpSolverArbiter *arb, cpFloat dt, cpFloat slop, cpFloat bias)
+{
+	ContactsPreStep(arb->body_a, arb->body_b, arb->n, arb->e, arb->contacts, arb->count, dt, slop, bias);
+}
+
+void
+cpSolverArbiterApplyCachedImpulse(cpSolverArbiter *arb, cpFloat dt_coef)
+{
+	if(arb->firstContact) return;
+	ContactsApplyCachedImpulse(arb->body_a, arb->body_b, arb->n, arb->contacts, arb->count, dt_coef);
+}
+
+void
+cpSolverArbiterApplyImpulse(cpSolverArbiter *arb)
+{
+	ContactsApplyImpulse(arb->body_a, arb->body_b, arb->n, arb->surface_vr, arb->u, arb->contacts, arb->count);
+}
+
+#endif
@@ -0,0 +1,166 @@
+#include <string.h>
+
+#include "chipmunk/chipmunk_private.h"
+
+// Allocations are rounded up to this so any type can be placed in the arena.
+#define CP_ARENA_ALIGN 16
+#define CP_ARENA_ROUND(bytes) (((bytes) + (CP_ARENA_ALIGN - 1)) & ~(size_t)(CP_ARENA_ALIGN - 1))
+
+struct cpArenaChunk {
+	cpArenaChunk *next;
+	size_t bytes;
+};
+
+#define CP_ARENA_HEADER_BYTES CP_ARENA_ROUND(sizeof(cpArenaChunk))
+
+// A pool buffer given back to the arena by cpBufferFreeAll(). The buffer itself holds this until it's reused.
+struct cpArenaBuffer {
+	cpArenaBuffer *next;
+	size_t bytes;
+};
+
+static void *
+DefaultAlloc(size_t bytes, void *unused)
+{
+	return cpcalloc(1, bytes);
+}
+
+static void
+DefaultFree(void *ptr, void *unused)
+{
+	cpfree(ptr);
+}
+
+const cpSpaceAllocator cpSpaceAllocatorDefault = {
+	DefaultAlloc, DefaultFree, NULL,
+	CP_BUFFER_BYTES, CP_BUFFER_BYTES,
+};
+
+cpArena *
+cpArenaInit(cpArena *arena, const cpSpaceAllocator *allocator, size_t chunkBytes)
+{
+	arena->allocator = allocator;
+	arena->chunkBytes = chunkBytes;
+
+	arena->chunks = NULL;
+	arena->current = NULL;
+	arena->used = 0;
+	arena->spareBuffers = NULL;
+
+	return arena;
+}
+
+void
+cpArenaDestroy(cpArena *arena)
+{
+	cpArenaChunk *chunk = arena->chunks;
+	while(chunk){
+		cpArenaChunk *next = chunk->next;
+		arena->allocator->free(chunk, arena->allocator->userData);
+		chunk = next;
+	}
+
+	arena->chunks = NULL;
+	arena->current = NULL;
+	arena->used = 0;
+	arena->spareBuffers = NULL;
+}
+
+static cpArenaChunk *
+cpArenaPushChunk(cpArena *arena, size_t bytes)
+{
+	cpArenaChunk *chunk = (cpArenaChunk *)arena->allocator->alloc(CP_ARENA_HEADER_BYTES + bytes, arena->allocator->userData);
+	cpAssertHard(chunk, "Space allocator is out of memory.");
+	chunk->bytes = bytes;
+
+	// Insert after the current chunk so chunks kept from before a reset are reused in order.
+	if(arena->current){
+		chunk->next = arena->current->next;
+		arena->current->next = chunk;
+	} else {
+		chunk->next = arena->chunks;
+		arena->chunks = chunk;
+	}
+
+	return chunk;
+}
+
+void *
+cpArenaAlloc(cpArena *arena, size_t bytes)
+{
+	bytes = CP_ARENA_ROUND(bytes);
+
+	cpArenaChunk *chunk = arena->current;
+	if(chunk == NULL || arena->used + bytes > chunk->bytes){
+		// Move on to the next chunk kept from before a reset, or make a new one.
+		cpArenaChunk *next = (chunk ? chunk->next : arena->chunks);
+		if(next == NULL || bytes > next->bytes){
+			next = cpArenaPushChunk(arena, (bytes > arena->chunkBytes ? bytes : arena->chunkBytes));
+		}
+
+		arena->current = chunk = next;
+		arena->used = 0;
+	}
+
+	void *ptr = (char *)chunk + CP_ARENA_HEADER_BYTES + arena->used;
+	arena->used += bytes;
+
+	return memset(ptr, 0, bytes);
+}
+
+void
+cpArenaReset(cpArena *arena)
+{
+	arena->current = NULL;
+	arena->used = 0;
+}
+
+void *
+cpBufferAlloc(cpArena *arena, cpArray *allocatedBuffers, size_t bytes)
+{
+	if(arena){
+		cpAssertHard(bytes >= sizeof(cpArenaBuffer), "Internal Error: Buffer size too small.");
+		
+		// Reuse a buffer of the same size given back by an index that was freed before the space.
+		cpArenaBuffer **prev = &arena->spareBuffers, *spare = arena->spareBuffers;
+		while(spare && spare->bytes != bytes){
+			prev = &spare->next;
+			spare = spare->next;
+		}
+		
+		void *buffer;
+		if(spare){
+			(*prev) = spare->next;
+			buffer = memset(spare, 0, bytes);
+		} else {
+			buffer = cpArenaAlloc(arena, bytes);
+		}
+		
+		// Arena buffers are pushed with their size so cpBufferFreeAll() can give them back.
+		cpArrayPush(allocatedBuffers, buffer);
+		cpArrayPush(allocatedBuffers, (void *)bytes);
+		return buffer;
+	} else {
+		void *buffer = cpcalloc(1, bytes);
+		cpArrayPush(allocatedBuffers, buffer);
+		return buffer;
+	}
+}
+
+void
+cpBufferFreeAll(cpArena *arena, cpArray *allocatedBuffers)
+{
+	if(arena){
+		// Arena memory lives until the space is freed. Keep the buffers for the next index that needs them.
+		for(int i=0; i<allocatedBuffers->num; i+=2){
+			cpArenaBuffer *spare = (cpArenaBuffer *)allocatedBuffers->arr[i];
+			spare->bytes = (size_t)allocatedBuffers->arr[i + 1];
+			spare->next = arena->spareBuffers;
+			arena->spareBuffers = spare;
+		}
+	} else {
+		for(int i=0; i<allocatedBuffers->num; i++) cpfree(allocatedBuffers->arr[i]);
+	}
+	
+	allocatedBuffers->num = 0;
+}
@@ -27,48 +27,71 @@
 static inline cpSpatialIndexClass *Klass(void);
 
 typedef struct Node Node;
+typedef struct Leaf Leaf;
 typedef struct Pair Pair;
 
+// Nodes are addressed by index instead of by pointer.
+// Internal nodes and leaves are kept apart, and leaf indexes are tagged with LEAF_BIT
+// so a child link can refer to either kind.
+// The bounds of a node are stored in its parent next to the child link, or in the tree for the root.
+// Traversals test both children of a node without touching them, and every bounding box is stored only once.
+#if CP_USE_SMALL_TREE_INDEX
+	typedef uint16_t NodeIndex;
+#else
+	typedef uint32_t NodeIndex;
+#endif
+
+#define LEAF_BIT ((NodeIndex)1 << (8*sizeof(NodeIndex) - 1))
+#define NODE_NULL ((NodeIndex)~0)
+
+// Both kinds are allocated in blocks of this many, so growing the tree never moves them.
+// The leaf set and the pair threads hold on to leaves by pointer.
+#define BLOCK_SHIFT 8
+#define BLOCK_COUNT (1 << BLOCK_SHIFT)
+
 struct cpBBTree {
 	cpSpatialIndex spatialIndex;
 	cpBBTreeVelocityFunc velocityFunc;
 	
 	cpHashSet *leaves;
-	Node *root;
+	NodeIndex root;
+	cpBB rootBB;
+	
+	Node **nodeBlocks;
+	int nodeBlockCount;
+	NodeIndex pooledNodes;
+	
+	Leaf **leafBlocks;
+	int leafBlockCount;
+	NodeIndex pooledLeaves;
 	
-	Node *pooledNodes;
 	Pair *pooledPairs;
 	cpArray *allocatedBuffers;
 	
+	// LeafUpdate() examines up to rebalanceBudget nodes for rotations per reindex query.
+	int rebalanceBudget;
+	int rebalanceLeft;
+	
 	cpTimestamp stamp;
 };
 
 struct Node {
-	void *obj;
-	cpBB bb;
-	Node *parent;
-	
-	union {
-		// Internal nodes
-		struct { Node *a, *b; } children;
-		
-		// Leaves
-		struct {
-			cpTimestamp stamp;
-			Pair *pairs;
-		} leaf;
-	} node;
+	cpBB bb[2];
+	NodeIndex child[2];
+	NodeIndex parent;
 };
 
-// Can't use anonymous unions and still get good x-compiler compatability
-#define A node.children.a
-#define B node.children.b
-#define STAMP node.leaf.stamp
-#define PAIRS node.leaf.pairs
+struct Leaf {
+	void *obj;
+	Pair *pairs;
+	cpTimestamp stamp;
+	NodeIndex parent;
+	NodeIndex index;
+};
 
 typedef struct Thread {
 	Pair *prev;
-	Node *leaf;
+	Leaf *leaf;
 	Pair *next;
 } Thread;
 
@@ -103,9 +126,10 @@ GetTree(cpSpatialIndex *index)
 	return (index && index->klass == Klass() ? (cpBBTree *)index : NULL);
 }
 
-static inline Node *
-GetRootIfTree(cpSpatialIndex *index){
-	return (index && index->klass == Klass() ? ((cpBBTree *)index)->root : NULL);
+static inline cpBBTree *
+GetTreeIfRooted(cpSpatialIndex *index){
+	cpBBTree *tree = GetTree(index);
+	return (tree && tree->root != NODE_NULL ? tree : NULL);
 }
 
 static inline cpBBTree *
@@ -156,8 +180,7 @@ PairFromPool(cpBBTree *tree)
 		int count = CP_BUFFER_BYTES/sizeof(Pair);
 		cpAssertHard(count, "Internal Error: Buffer size is too small.");
 		
-		Pair *buffer = (Pair *)cpcalloc(1, CP_BUFFER_BYTES);
-		cpArrayPush(tree->allocatedBuffers, buffer);
+		Pair *buffer = (Pair *)cpBufferAlloc(tree->spatialIndex.arena, tree->allocatedBuffers, CP_BUFFER_BYTES);
 		
 		// push all but the first one, return the first instead
 		for(int i=1; i<count; i++) PairRecycle(tree, buffer + i);
@@ -178,15 +201,15 @@ ThreadUnlink(Thread thread)
 	if(prev){
 		if(prev->a.leaf == thread.leaf) prev->a.next = next; else prev->b.next = next;
 	} else {
-		thread.leaf->PAIRS = next;
+		thread.leaf->pairs = next;
 	}
 }
 
 static void
-PairsClear(Node *leaf, cpBBTree *tree)
+PairsClear(Leaf *leaf, cpBBTree *tree)
 {
-	Pair *pair = leaf->PAIRS;
-	leaf->PAIRS = NULL;
+	Pair *pair = leaf->pairs;
+	leaf->pairs = NULL;
 	
 	while(pair){
 		if(pair->a.leaf == leaf){
@@ -204,13 +227,13 @@ PairsClear(Node *leaf, cpBBTree *tree)
 }
 
 static void
-PairInsert(Node *a, Node *b, cpBBTree *tree)
+PairInsert(Leaf *a, Leaf *b, cpBBTree *tree)
 {
-	Pair *nextA = a->PAIRS, *nextB = b->PAIRS;
+	Pair *nextA = a->pairs, *nextB = b->pairs;
 	Pair *pair = PairFromPool(tree);
 	Pair temp = {{NULL, a, nextA},{NULL, b, nextB}, 0};
 	
-	a->PAIRS = b->PAIRS = pair;
+	a->pairs = b->pairs = pair;
 	*pair = temp;
 	
 	if(nextA){
@@ -225,92 +248,172 @@ PairInsert(Node *a, Node *b, cpBBTree *tree)
 
 //MARK: Node Functions
 
+static inline cpBool
+NodeIsLeaf(NodeIndex node)
+{
+	return (node & LEAF_BIT) != 0;
+}
+
+static inline Node *
+NodeAt(cpBBTree *tree, NodeIndex node)
+{
+	return tree->nodeBlocks[node >> BLOCK_SHIFT] + (node & (BLOCK_COUNT - 1));
+}
+
+static inline Leaf *
+LeafAt(cpBBTree *tree, NodeIndex leaf)
+{
+	leaf &= ~LEAF_BIT;
+	return tree->leafBlocks[leaf >> BLOCK_SHIFT] + (leaf & (BLOCK_COUNT - 1));
+}
+
+static inline NodeIndex
+NodeGetParent(cpBBTree *tree, NodeIndex node)
+{
+	return (NodeIsLeaf(node) ? LeafAt(tree, node)->parent : NodeAt(tree, node)->parent);
+}
+
+static inline void
+NodeSetParent(cpBBTree *tree, NodeIndex node, NodeIndex parent)
+{
+	if(NodeIsLeaf(node)){
+		LeafAt(tree, node)->parent = parent;
+	} else {
+		NodeAt(tree, node)->parent = parent;
+	}
+}
+
+// Index of the child in its parent's child[] and bb[] arrays.
+static inline int
+NodeSlot(Node *parent, NodeIndex child)
+{
+	return (parent->child[0] == child ? 0 : 1);
+}
+
+static inline cpBB
+ChildBB(cpBBTree *tree, NodeIndex parent, NodeIndex child)
+{
+	if(parent == NODE_NULL){
+		return tree->rootBB;
+	} else {
+		Node *p = NodeAt(tree, parent);
+		return p->bb[NodeSlot(p, child)];
+	}
+}
+
+static inline cpBB
+NodeBB(cpBBTree *tree, NodeIndex node)
+{
+	return ChildBB(tree, NodeGetParent(tree, node), node);
+}
+
+static inline cpBB
+LeafBB(cpBBTree *tree, Leaf *leaf)
+{
+	return ChildBB(tree, leaf->parent, leaf->index);
+}
+
 static void
-NodeRecycle(cpBBTree *tree, Node *node)
+NodeRecycle(cpBBTree *tree, NodeIndex node)
 {
-	node->parent = tree->pooledNodes;
+	NodeAt(tree, node)->parent = tree->pooledNodes;
 	tree->pooledNodes = node;
 }
 
-static Node *
+static NodeIndex
 NodeFromPool(cpBBTree *tree)
 {
-	Node *node = tree->pooledNodes;
+	NodeIndex node = tree->pooledNodes;
 	
-	if(node){
-		tree->pooledNodes = node->parent;
+	if(node != NODE_NULL){
+		tree->pooledNodes = NodeAt(tree, node)->parent;
 		return node;
 	} else {
-		// Pool is exhausted, make more
-		int count = CP_BUFFER_BYTES/sizeof(Node);
-		cpAssertHard(count, "Internal Error: Buffer size is too small.");
+		// Pool is exhausted, make another block
+		int first = tree->nodeBlockCount*BLOCK_COUNT;
+		cpAssertHard((size_t)(first + BLOCK_COUNT) <= LEAF_BIT, "Internal Error: Too many nodes for the tree's index type. Build with CP_USE_SMALL_TREE_INDEX=0.");
 		
-		Node *buffer = (Node *)cpcalloc(1, CP_BUFFER_BYTES);
-		cpArrayPush(tree->allocatedBuffers, buffer);
+		Node *buffer = (Node *)cpBufferAlloc(tree->spatialIndex.arena, tree->allocatedBuffers, BLOCK_COUNT*sizeof(Node));
+		tree->nodeBlocks = (Node **)cprealloc(tree->nodeBlocks, (tree->nodeBlockCount + 1)*sizeof(Node *));
+		tree->nodeBlocks[tree->nodeBlockCount++] = buffer;
 		
 		// push all but the first one, return the first instead
-		for(int i=1; i<count; i++) NodeRecycle(tree, buffer + i);
-		return buffer;
+		for(int i=BLOCK_COUNT - 1; i>0; i--) NodeRecycle(tree, (NodeIndex)(first + i));
+		return (NodeIndex)first;
 	}
 }
 
 static inline void
-NodeSetA(Node *node, Node *value)
+NodeSetChild(cpBBTree *tree, NodeIndex node, int slot, NodeIndex child, cpBB bb)
 {
-	node->A = value;
-	value->parent = node;
+	Node *n = NodeAt(tree, node);
+	n->child[slot] = child;
+	n->bb[slot] = bb;
+	NodeSetParent(tree, child, node);
 }
 
-static inline void
-NodeSetB(Node *node, Node *value)
-{
-	node->B = value;
-	value->parent = node;
-}
-
-static Node *
-NodeNew(cpBBTree *tree, Node *a, Node *b)
+static NodeIndex
+NodeNew(cpBBTree *tree, NodeIndex a, cpBB bb_a, NodeIndex b, cpBB bb_b)
 {
-	Node *node = NodeFromPool(tree);
+	NodeIndex node = NodeFromPool(tree);
+	NodeAt(tree, node)->parent = NODE_NULL;
 	
-	node->obj = NULL;
-	node->bb = cpBBMerge(a->bb, b->bb);
-	node->parent = NULL;
-	
-	NodeSetA(node, a);
-	NodeSetB(node, b);
+	NodeSetChild(tree, node, 0, a, bb_a);
+	NodeSetChild(tree, node, 1, b, bb_b);
 	
 	return node;
 }
 
-static inline cpBool
-NodeIsLeaf(Node *node)
+// Recalculate the bounds of the node's ancestors after its children changed.
+static void
+NodeRefit(cpBBTree *tree, NodeIndex node)
 {
-	return (node->obj != NULL);
+	for(;;){
+		Node *n = NodeAt(tree, node);
+		cpBB bb = cpBBMerge(n->bb[0], n->bb[1]);
+		
+		NodeIndex parent = n->parent;
+		if(parent == NODE_NULL){
+			tree->rootBB = bb;
+			return;
+		}
+		
+		Node *p = NodeAt(tree, parent);
+		p->bb[NodeSlot(p, node)] = bb;
+		node = parent;
+	}
 }
 
-static inline Node *
-NodeOther(Node *node, Node *child)
+//MARK: Leaf Pool Functions
+
+static void
+LeafRecycle(cpBBTree *tree, NodeIndex leaf)
 {
-	return (node->A == child ? node->B : node->A);
+	LeafAt(tree, leaf)->parent = tree->pooledLeaves;
+	tree->pooledLeaves = leaf;
 }
 
-static inline void
-NodeReplaceChild(Node *parent, Node *child, Node *value, cpBBTree *tree)
+static NodeIndex
+LeafFromPool(cpBBTree *tree)
 {
-	cpAssertSoft(!NodeIsLeaf(parent), "Internal Error: Cannot replace child of a leaf.");
-	cpAssertSoft(child == parent->A || child == parent->B, "Internal Error: Node is not a child of parent.");
+	NodeIndex leaf = tree->pooledLeaves;
 	
-	if(parent->A == child){
-		NodeRecycle(tree, parent->A);
-		NodeSetA(parent, value);
+	if(leaf != NODE_NULL){
+		tree->pooledLeaves = LeafAt(tree, leaf)->parent;
+		return leaf;
 	} else {
-		NodeRecycle(tree, parent->B);
-		NodeSetB(parent, value);
-	}
-	
-	for(Node *node=parent; node; node = node->parent){
-		node->bb = cpBBMerge(node->A->bb, node->B->bb);
+		// Pool is exhausted, make another block
+		// The last leaf's tagged index must stay below NODE_NULL.
+		int first = tree->leafBlockCount*BLOCK_COUNT;
+		cpAssertHard((size_t)(first + BLOCK_COUNT) < LEAF_BIT, "Internal Error: Too many leaves for the tree's index type. Build with CP_USE_SMALL_TREE_INDEX=0.");
+		
+		Leaf *buffer = (Leaf *)cpBufferAlloc(tree->spatialIndex.arena, tree->allocatedBuffers, BLOCK_COUNT*sizeof(Leaf));
+		tree->leafBlocks = (Leaf **)cprealloc(tree->leafBlocks, (tree->leafBlockCount + 1)*sizeof(Leaf *));
+		tree->leafBlocks[tree->leafBlockCount++] = buffer;
+		
+		// push all but the first one, return the first instead
+		for(int i=BLOCK_COUNT - 1; i>0; i--) LeafRecycle(tree, (NodeIndex)(first + i) | LEAF_BIT);
+		return (NodeIndex)first | LEAF_BIT;
 	}
 }
 
@@ -322,62 +425,73 @@ cpBBProximity(cpBB a, cpBB b)
 	return cpfabs(a.l + a.r - b.l - b.r) + cpfabs(a.b + a.t - b.b - b.t);
 }
 
-static Node *
-SubtreeInsert(Node *subtree, Node *leaf, cpBBTree *tree)
+// Returns the new root of the subtree and stores its bounds in result_bb.
+static NodeIndex
+SubtreeInsert(cpBBTree *tree, NodeIndex subtree, cpBB subtree_bb, NodeIndex leaf, cpBB bb, cpBB *result_bb)
 {
-	if(subtree == NULL){
+	if(subtree == NODE_NULL){
+		(*result_bb) = bb;
 		return leaf;
 	} else if(NodeIsLeaf(subtree)){
-		return NodeNew(tree, leaf, subtree);
+		(*result_bb) = cpBBMerge(bb, subtree_bb);
+		return NodeNew(tree, leaf, bb, subtree, subtree_bb);
 	} else {
-		cpFloat cost_a = cpBBArea(subtree->B->bb) + cpBBMergedArea(subtree->A->bb, leaf->bb);
-		cpFloat cost_b = cpBBArea(subtree->A->bb) + cpBBMergedArea(subtree->B->bb, leaf->bb);
+		Node *node = NodeAt(tree, subtree);
+		cpFloat cost_a = cpBBArea(node->bb[1]) + cpBBMergedArea(node->bb[0], bb);
+		cpFloat cost_b = cpBBArea(node->bb[0]) + cpBBMergedArea(node->bb[1], bb);
 		
 		if(cost_a == cost_b){
-			cost_a = cpBBProximity(subtree->A->bb, leaf->bb);
-			cost_b = cpBBProximity(subtree->B->bb, leaf->bb);
+			cost_a = cpBBProximity(node->bb[0], bb);
+			cost_b = cpBBProximity(node->bb[1], bb);
 		}
 		
-		if(cost_b < cost_a){
-			NodeSetB(subtree, SubtreeInsert(subtree->B, leaf, tree));
-		} else {
-			NodeSetA(subtree, SubtreeInsert(subtree->A, leaf, tree));
-		}
+		int slot = (cost_b < cost_a ? 1 : 0);
+		cpBB child_bb;
+		NodeIndex child = SubtreeInsert(tree, node->child[slot], node->bb[slot], leaf, bb, &child_bb);
+		NodeSetChild(tree, subtree, slot, child, child_bb);
 		
-		subtree->bb = cpBBMerge(subtree->bb, leaf->bb);
+		(*result_bb) = cpBBMerge(subtree_bb, bb);
 		return subtree;
 	}
 }
 
 static void
-SubtreeQuery(Node *subtree, void *obj, cpBB bb, cpSpatialIndexQueryFunc func, void *data)
+TreeInsertLeaf(cpBBTree *tree, NodeIndex leaf, cpBB bb)
 {
-	if(cpBBIntersects(subtree->bb, bb)){
-		if(NodeIsLeaf(subtree)){
-			func(obj, subtree->obj, 0, data);
-		} else {
-			SubtreeQuery(subtree->A, obj, bb, func, data);
-			SubtreeQuery(subtree->B, obj, bb, func, data);
-		}
+	tree->root = SubtreeInsert(tree, tree->root, tree->rootBB, leaf, bb, &tree->rootBB);
+	NodeSetParent(tree, tree->root, NODE_NULL);
+}
+
+// The subtree's bounds must already be known to intersect bb.
+static void
+SubtreeQuery(cpBBTree *tree, NodeIndex subtree, void *obj, cpBB bb, cpSpatialIndexQueryFunc func, void *data)
+{
+	if(NodeIsLeaf(subtree)){
+		func(obj, LeafAt(tree, subtree)->obj, 0, data);
+	} else {
+		Node *node = NodeAt(tree, subtree);
+		if(cpBBIntersects(node->bb[0], bb)) SubtreeQuery(tree, node->child[0], obj, bb, func, data);
+		if(cpBBIntersects(node->bb[1], bb)) SubtreeQuery(tree, node->child[1], obj, bb, func, data);
 	}
 }
 
 
 static cpFloat
-SubtreeSegmentQuery(Node *subtree, void *obj, cpVect a, cpVect b, cpFloat t_exit, cpSpatialIndexSegmentQueryFunc func, void *data)
+SubtreeSegmentQuery(cpBBTree *tree, NodeIndex subtree, void *obj, cpVect a, cpVect b, cpFloat t_exit, cpSpatialIndexSegmentQueryFunc func, void *data)
 {
 	if(NodeIsLeaf(subtree)){
-		return func(obj, subtree->obj, data);
+		return func(obj, LeafAt(tree, subtree)->obj, data);
 	} else {
-		cpFloat t_a = cpBBSegmentQuery(subtree->A->bb, a, b);
-		cpFloat t_b = cpBBSegmentQuery(subtree->B->bb, a, b);
+		Node *node = NodeAt(tree, subtree);
+		cpFloat t_a = cpBBSegmentQuery(node->bb[0], a, b);
+		cpFloat t_b = cpBBSegmentQuery(node->bb[1], a, b);
 		
 		if(t_a < t_b){
-			if(t_a < t_exit) t_exit = cpfmin(t_exit, SubtreeSegmentQuery(subtree->A, obj, a, b, t_exit, func, data));
-			if(t_b < t_exit) t_exit = cpfmin(t_exit, SubtreeSegmentQuery(subtree->B, obj, a, b, t_exit, func, data));
+			if(t_a < t_exit) t_exit = cpfmin(t_exit, SubtreeSegmentQuery(tree, node->child[0], obj, a, b, t_exit, func, data));
+			if(t_b < t_exit) t_exit = cpfmin(t_exit, SubtreeSegmentQuery(tree, node->child[1], obj, a, b, t_exit, func, data));
 		} else {
-			if(t_b < t_exit) t_exit = cpfmin(t_exit, SubtreeSegmentQuery(subtree->B, obj, a, b, t_exit, func, data));
-			if(t_a < t_exit) t_exit = cpfmin(t_exit, SubtreeSegmentQuery(subtree->A, obj, a, b, t_exit, func, data));
+			if(t_b < t_exit) t_exit = cpfmin(t_exit, SubtreeSegmentQuery(tree, node->child[1], obj, a, b, t_exit, func, data));
+			if(t_a < t_exit) t_exit = cpfmin(t_exit, SubtreeSegmentQuery(tree, node->child[0], obj, a, b, t_exit, func, data));
 		}
 		
 		return t_exit;
@@ -385,78 +499,147 @@ SubtreeSegmentQuery(Node *subtree, void *obj, cpVect a, cpVect b, cpFloat t_exit
 }
 
 static void
-SubtreeRecycle(cpBBTree *tree, Node *node)
+SubtreeRecycle(cpBBTree *tree, NodeIndex node)
 {
 	if(!NodeIsLeaf(node)){
-		SubtreeRecycle(tree, node->A);
-		SubtreeRecycle(tree, node->B);
+		SubtreeRecycle(tree, NodeAt(tree, node)->child[0]);
+		SubtreeRecycle(tree, NodeAt(tree, node)->child[1]);
 		NodeRecycle(tree, node);
 	}
 }
 
-static inline Node *
-SubtreeRemove(Node *subtree, Node *leaf, cpBBTree *tree)
+static void
+TreeRemoveLeaf(cpBBTree *tree, NodeIndex leaf)
 {
-	if(leaf == subtree){
-		return NULL;
+	NodeIndex parent = LeafAt(tree, leaf)->parent;
+	if(parent == NODE_NULL){
+		tree->root = NODE_NULL;
+		return;
+	}
+	
+	// Replace the parent with the leaf's sibling.
+	Node *p = NodeAt(tree, parent);
+	int slot = NodeSlot(p, leaf);
+	NodeIndex other = p->child[!slot];
+	cpBB other_bb = p->bb[!slot];
+	NodeIndex grandparent = p->parent;
+	
+	NodeRecycle(tree, parent);
+	LeafAt(tree, leaf)->parent = NODE_NULL;
+	
+	if(grandparent == NODE_NULL){
+		NodeSetParent(tree, other, NODE_NULL);
+		tree->root = other;
+		tree->rootBB = other_bb;
 	} else {
-		Node *parent = leaf->parent;
-		if(parent == subtree){
-			Node *other = NodeOther(subtree, leaf);
-			other->parent = subtree->parent;
-			NodeRecycle(tree, subtree);
-			return other;
-		} else {
-			NodeReplaceChild(parent->parent, parent, NodeOther(parent, leaf), tree);
-			return subtree;
+		NodeSetChild(tree, grandparent, NodeSlot(NodeAt(tree, grandparent), parent), other, other_bb);
+		NodeRefit(tree, grandparent);
+	}
+}
+
+//MARK: Rebalancing
+
+// Tree rotations from Kopta et al., "Fast, Effective BVH Updates for Animated Scenes".
+// A child of the node trades places with a grandchild under its sibling when that shrinks the sibling.
+// The node's own bounds don't change, so nothing above it has to be refit.
+static void
+NodeRotate(cpBBTree *tree, NodeIndex node)
+{
+	Node *n = NodeAt(tree, node);
+	cpFloat best = 0.0f;
+	int best_slot = 0, best_grandslot = 0;
+	
+	for(int slot=0; slot<2; slot++){
+		NodeIndex sibling = n->child[!slot];
+		if(NodeIsLeaf(sibling)) continue;
+		
+		Node *s = NodeAt(tree, sibling);
+		cpFloat area = cpBBArea(n->bb[!slot]);
+		for(int grandslot=0; grandslot<2; grandslot++){
+			// Shrinkage of the sibling if child[slot] replaced its child[grandslot].
+			cpFloat gain = area - cpBBMergedArea(n->bb[slot], s->bb[!grandslot]);
+			if(gain > best){
+				best = gain;
+				best_slot = slot;
+				best_grandslot = grandslot;
+			}
 		}
 	}
+	
+	if(best <= 0.0f) return;
+	
+	NodeIndex sibling = n->child[!best_slot];
+	Node *s = NodeAt(tree, sibling);
+	NodeIndex child = n->child[best_slot], grandchild = s->child[best_grandslot];
+	cpBB child_bb = n->bb[best_slot], grandchild_bb = s->bb[best_grandslot];
+	
+	NodeSetChild(tree, sibling, best_grandslot, child, child_bb);
+	NodeSetChild(tree, node, best_slot, grandchild, grandchild_bb);
+	n->bb[!best_slot] = cpBBMerge(s->bb[0], s->bb[1]);
+}
+
+// Try rotations from the node up to the root, while the tree's rebalance budget lasts.
+static void
+TreeRebalance(cpBBTree *tree, NodeIndex node)
+{
+	for(; node != NODE_NULL && tree->rebalanceLeft > 0; node = NodeAt(tree, node)->parent){
+		NodeRotate(tree, node);
+		tree->rebalanceLeft--;
+	}
 }
 
 //MARK: Marking Functions
 
 typedef struct MarkContext {
 	cpBBTree *tree;
-	Node *staticRoot;
+	cpBBTree *staticTree;
 	cpSpatialIndexQueryFunc func;
 	void *data;
 } MarkContext;
 
+// Query the leaf against a subtree of 'tree', which isn't necessarily the tree the leaf belongs to.
+// The subtree's bounds must already be known to intersect the leaf's bounds bb.
 static void
-MarkLeafQuery(Node *subtree, Node *leaf, cpBool left, MarkContext *context)
+MarkLeafQuery(cpBBTree *tree, NodeIndex subtree, Leaf *leaf, cpBB bb, cpBool left, MarkContext *context)
 {
-	if(cpBBIntersects(leaf->bb, subtree->bb)){
-		if(NodeIsLeaf(subtree)){
-			if(left){
-				PairInsert(leaf, subtree, context->tree);
-			} else {
-				if(subtree->STAMP < leaf->STAMP) PairInsert(subtree, leaf, context->tree);
-				context->func(leaf->obj, subtree->obj, 0, context->data);
-			}
+	if(NodeIsLeaf(subtree)){
+		Leaf *other = LeafAt(tree, subtree);
+		if(left){
+			PairInsert(leaf, other, context->tree);
 		} else {
-			MarkLeafQuery(subtree->A, leaf, left, context);
-			MarkLeafQuery(subtree->B, leaf, left, context);
+			if(other->stamp < leaf->stamp) PairInsert(other, leaf, context->tree);
+			context->func(leaf->obj, other->obj, 0, context->data);
 		}
+	} else {
+		Node *node = NodeAt(tree, subtree);
+		if(cpBBIntersects(bb, node->bb[0])) MarkLeafQuery(tree, node->child[0], leaf, bb, left, context);
+		if(cpBBIntersects(bb, node->bb[1])) MarkLeafQuery(tree, node->child[1], leaf, bb, left, context);
 	}
 }
 
 static void
-MarkLeaf(Node *leaf, MarkContext *context)
+MarkLeaf(Leaf *leaf, MarkContext *context)
 {
 	cpBBTree *tree = context->tree;
-	if(leaf->STAMP == GetMasterTree(tree)->stamp){
-		Node *staticRoot = context->staticRoot;
-		if(staticRoot) MarkLeafQuery(staticRoot, leaf, cpFalse, context);
+	if(leaf->stamp == GetMasterTree(tree)->stamp){
+		cpBB bb = LeafBB(tree, leaf);
+		
+		cpBBTree *staticTree = context->staticTree;
+		if(staticTree && cpBBIntersects(bb, staticTree->rootBB)) MarkLeafQuery(staticTree, staticTree->root, leaf, bb, cpFalse, context);
 		
-		for(Node *node = leaf; node->parent; node = node->parent){
-			if(node == node->parent->A){
-				MarkLeafQuery(node->parent->B, leaf, cpTrue, context);
+		for(NodeIndex node = leaf->index, parent = leaf->parent; parent != NODE_NULL;){
+			Node *p = NodeAt(tree, parent);
+			if(node == p->child[0]){
+				if(cpBBIntersects(bb, p->bb[1])) MarkLeafQuery(tree, p->child[1], leaf, bb, cpTrue, context);
 			} else {
-				MarkLeafQuery(node->parent->A, leaf, cpFalse, context);
+				if(cpBBIntersects(bb, p->bb[0])) MarkLeafQuery(tree, p->child[0], leaf, bb, cpFalse, context);
 			}
+			
+			node = parent;
+			parent = p->parent;
 		}
 	} else {
-		Pair *pair = leaf->PAIRS;
+		Pair *pair = leaf->pairs;
 		while(pair){
 			if(leaf == pair->b.leaf){
 				pair->id = context->func(pair->a.leaf->obj, leaf->obj, pair->id, context->data);
@@ -469,46 +652,47 @@ MarkLeaf(Node *leaf, MarkContext *context)
 }
 
 static void
-MarkSubtree(Node *subtree, MarkContext *context)
+MarkSubtree(cpBBTree *tree, NodeIndex subtree, MarkContext *context)
 {
 	if(NodeIsLeaf(subtree)){
-		MarkLeaf(subtree, context);
+		MarkLeaf(LeafAt(tree, subtree), context);
 	} else {
-		MarkSubtree(subtree->A, context);
-		MarkSubtree(subtree->B, context); // TODO: Force TCO here?
+		Node *node = NodeAt(tree, subtree);
+		MarkSubtree(tree, node->child[0], context);
+		MarkSubtree(tree, node->child[1], context); // TODO: Force TCO here?
 	}
 }
 
 //MARK: Leaf Functions
 
-static Node *
-LeafNew(cpBBTree *tree, void *obj, cpBB bb)
+static Leaf *
+LeafNew(cpBBTree *tree, void *obj)
 {
-	Node *node = NodeFromPool(tree);
-	node->obj = obj;
-	node->bb = GetBB(tree, obj);
+	NodeIndex index = LeafFromPool(tree);
 	
-	node->parent = NULL;
-	node->STAMP = 0;
-	node->PAIRS = NULL;
+	Leaf *leaf = LeafAt(tree, index);
+	leaf->obj = obj;
 	
-	return node;
+	leaf->parent = NODE_NULL;
+	leaf->index = index;
+	leaf->stamp = 0;
+	leaf->pairs = NULL;
+	
+	return leaf;
 }
 
 static cpBool
-LeafUpdate(Node *leaf, cpBBTree *tree)
+LeafUpdate(Leaf *leaf, cpBBTree *tree)
 {
-	Node *root = tree->root;
 	cpBB bb = tree->spatialIndex.bbfunc(leaf->obj);
 	
-	if(!cpBBContainsBB(leaf->bb, bb)){
-		leaf->bb = GetBB(tree, leaf->obj);
-		
-		root = SubtreeRemove(root, leaf, tree);
-		tree->root = SubtreeInsert(root, leaf, tree);
+	if(!cpBBContainsBB(LeafBB(tree, leaf), bb)){
+		TreeRemoveLeaf(tree, leaf->index);
+		TreeInsertLeaf(tree, leaf->index, GetBB(tree, leaf->obj));
+		TreeRebalance(tree, leaf->parent);
 		
 		PairsClear(leaf, tree);
-		leaf->STAMP = GetMasterTree(tree)->stamp;
+		leaf->stamp = GetMasterTree(tree)->stamp;
 		
 		return cpTrue;
 	} else {
@@ -519,19 +703,19 @@ LeafUpdate(Node *leaf, cpBBTree *tree)
 static cpCollisionID VoidQueryFunc(void *obj1, void *obj2, cpCollisionID id, void *data){return id;}
 
 static void
-LeafAddPairs(Node *leaf, cpBBTree *tree)
+LeafAddPairs(Leaf *leaf, cpBBTree *tree)
 {
 	cpSpatialIndex *dynamicIndex = tree->spatialIndex.dynamicIndex;
 	if(dynamicIndex){
-		Node *dynamicRoot = GetRootIfTree(dynamicIndex);
-		if(dynamicRoot){
-			cpBBTree *dynamicTree = GetTree(dynamicIndex);
+		cpBBTree *dynamicTree = GetTreeIfRooted(dynamicIndex);
+		cpBB bb = LeafBB(tree, leaf);
+		if(dynamicTree && cpBBIntersects(bb, dynamicTree->rootBB)){
 			MarkContext context = {dynamicTree, NULL, NULL, NULL};
-			MarkLeafQuery(dynamicRoot, leaf, cpTrue, &context);
+			MarkLeafQuery(dynamicTree, dynamicTree->root, leaf, bb, cpTrue, &context);
 		}
 	} else {
-		Node *staticRoot = GetRootIfTree(tree->spatialIndex.staticIndex);
-		MarkContext context = {tree, staticRoot, VoidQueryFunc, NULL};
+		cpBBTree *staticTree = GetTreeIfRooted(tree->spatialIndex.staticIndex);
+		MarkContext context = {tree, staticTree, VoidQueryFunc, NULL};
 		MarkLeaf(leaf, &context);
 	}
 }
@@ -545,15 +729,15 @@ cpBBTreeAlloc(void)
 }
 
 static int
-leafSetEql(void *obj, Node *node)
+leafSetEql(void *obj, Leaf *leaf)
 {
-	return (obj == node->obj);
+	return (obj == leaf->obj);
 }
 
 static void *
 leafSetTrans(void *obj, cpBBTree *tree)
 {
-	return LeafNew(tree, obj, tree->spatialIndex.bbfunc(obj));
+	return LeafNew(tree, obj);
 }
 
 cpSpatialIndex *
@@ -564,11 +748,22 @@ cpBBTreeInit(cpBBTree *tree, cpSpatialIndexBBFunc bbfunc, cpSpatialIndex *static
 	tree->velocityFunc = NULL;
 	
 	tree->leaves = cpHashSetNew(0, (cpHashSetEqlFunc)leafSetEql);
-	tree->root = NULL;
+	tree->root = NODE_NULL;
+	tree->rootBB = cpBBNew(0.0f, 0.0f, 0.0f, 0.0f);
+	
+	tree->nodeBlocks = NULL;
+	tree->nodeBlockCount = 0;
+	tree->pooledNodes = NODE_NULL;
+	
+	tree->leafBlocks = NULL;
+	tree->leafBlockCount = 0;
+	tree->pooledLeaves = NODE_NULL;
 	
-	tree->pooledNodes = NULL;
 	tree->allocatedBuffers = cpArrayNew(0);
 	
+	tree->rebalanceBudget = 0;
+	tree->rebalanceLeft = 0;
+	
 	tree->stamp = 0;
 	
 	return (cpSpatialIndex *)tree;
@@ -585,6 +780,19 @@ cpBBTreeSetVelocityFunc(cpSpatialIndex *index, cpBBTreeVelocityFunc func)
 	((cpBBTree *)index)->velocityFunc = func;
 }
 
+void
+cpBBTreeSetRebalanceBudget(cpSpatialIndex *index, int nodes)
+{
+	if(index->klass != Klass()){
+		cpAssertWarn(cpFalse, "Ignoring cpBBTreeSetRebalanceBudget() call to non-tree spatial index.");
+		return;
+	}
+	
+	cpAssertHard(nodes >= 0, "The rebalance budget cannot be negative.");
+	cpBBTree *tree = (cpBBTree *)index;
+	tree->rebalanceBudget = tree->rebalanceLeft = nodes;
+}
+
 cpSpatialIndex *
 cpBBTreeNew(cpSpatialIndexBBFunc bbfunc, cpSpatialIndex *staticIndex)
 {
@@ -596,8 +804,10 @@ cpBBTreeDestroy(cpBBTree *tree)
 {
 	cpHashSetFree(tree->leaves);
 	
-	if(tree->allocatedBuffers) cpArrayFreeEach(tree->allocatedBuffers, cpfree);
+	if(tree->allocatedBuffers) cpBufferFreeAll(tree->spatialIndex.arena, tree->allocatedBuffers);
 	cpArrayFree(tree->allocatedBuffers);
+	cpfree(tree->nodeBlocks);
+	cpfree(tree->leafBlocks);
 }
 
 //MARK: Insert/Remove
@@ -605,12 +815,10 @@ cpBBTreeDestroy(cpBBTree *tree)
 static void
 cpBBTreeInsert(cpBBTree *tree, void *obj, cpHashValue hashid)
 {
-	Node *leaf = (Node *)cpHashSetInsert(tree->leaves, hashid, obj, (cpHashSetTransFunc)leafSetTrans, tree);
-	
-	Node *root = tree->root;
-	tree->root = SubtreeInsert(root, leaf, tree);
+	Leaf *leaf = (Leaf *)cpHashSetInsert(tree->leaves, hashid, obj, (cpHashSetTransFunc)leafSetTrans, tree);
+	TreeInsertLeaf(tree, leaf->index, GetBB(tree, obj));
 	
-	leaf->STAMP = GetMasterTree(tree)->stamp;
+	leaf->stamp = GetMasterTree(tree)->stamp;
 	LeafAddPairs(leaf, tree);
 	IncrementStamp(tree);
 }
@@ -618,11 +826,11 @@ cpBBTreeInsert(cpBBTree *tree, void *obj, cpHashValue hashid)
 static void
 cpBBTreeRemove(cpBBTree *tree, void *obj, cpHashValue hashid)
 {
-	Node *leaf = (Node *)cpHashSetRemove(tree->leaves, hashid, obj);
+	Leaf *leaf = (Leaf *)cpHashSetRemove(tree->leaves, hashid, obj);
 	
-	tree->root = SubtreeRemove(tree->root, leaf, tree);
+	TreeRemoveLeaf(tree, leaf->index);
 	PairsClear(leaf, tree);
-	NodeRecycle(tree, leaf);
+	LeafRecycle(tree, leaf->index);
 }
 
 static cpBool
@@ -631,24 +839,49 @@ cpBBTreeContains(cpBBTree *tree, void *obj, cpHashValue hashid)
 	return (cpHashSetFind(tree->leaves, hashid, obj) != NULL);
 }
 
+static void
+LeafClear(Leaf *leaf, cpBBTree *tree)
+{
+	PairsClear(leaf, tree);
+	LeafRecycle(tree, leaf->index);
+}
+
+static void
+cpBBTreeClear(cpBBTree *tree)
+{
+	cpHashSetEach(tree->leaves, (cpHashSetIteratorFunc)LeafClear, tree);
+	if(tree->root != NODE_NULL) SubtreeRecycle(tree, tree->root);
+	
+	// Start over with an empty leaf set so it iterates in the same order as a new tree's.
+	cpHashSetFree(tree->leaves);
+	tree->leaves = cpHashSetNew(0, (cpHashSetEqlFunc)leafSetEql);
+	tree->root = NODE_NULL;
+	tree->rootBB = cpBBNew(0.0f, 0.0f, 0.0f, 0.0f);
+	
+	tree->rebalanceLeft = tree->rebalanceBudget;
+	tree->stamp = 0;
+}
+
 //MARK: Reindex
 
-static void LeafUpdateWrap(Node *leaf, cpBBTree *tree) {LeafUpdate(leaf, tree);}
+static void LeafUpdateWrap(Leaf *leaf, cpBBTree *tree) {LeafUpdate(leaf, tree);}
 
 static void
 cpBBTreeReindexQuery(cpBBTree *tree, cpSpatialIndexQueryFunc func, void *data)
 {
-	if(!tree->root) return;
+	if(tree->root == NODE_NULL) return;
+	
+	tree->rebalanceLeft = tree->rebalanceBudget;
 	
 	// LeafUpdate() may modify tree->root. Don't cache it.
 	cpHashSetEach(tree->leaves, (cpHashSetIteratorFunc)LeafUpdateWrap, tree);
 	
 	cpSpatialIndex *staticIndex = tree->spatialIndex.staticIndex;
-	Node *staticRoot = (staticIndex && staticIndex->klass == Klass() ? ((cpBBTree *)staticIndex)->root : NULL);
+	cpBBTree *staticTree = GetTreeIfRooted(staticIndex);
 	
-	MarkContext context = {tree, staticRoot, func, data};
-	MarkSubtree(tree->root, &context);
-	if(staticIndex && !staticRoot) cpSpatialIndexCollideStatic((cpSpatialIndex *)tree, staticIndex, func, data);
+	MarkContext context = {tree, staticTree, func, data};
+	MarkSubtree(tree, tree->root, &context);
+	if(staticIndex && !staticTree) cpSpatialIndexCollideStatic((cpSpatialIndex *)tree, staticIndex, func, data);
 	
 	IncrementStamp(tree);
 }
@@ -662,7 +895,7 @@ cpBBTreeReindex(cpBBTree *tree)
 static void
 cpBBTreeReindexObject(cpBBTree *tree, void *obj, cpHashValue hashid)
 {
-	Node *leaf = (Node *)cpHashSetFind(tree->leaves, hashid, obj);
+	Leaf *leaf = (Leaf *)cpHashSetFind(tree->leaves, hashid, obj);
 	if(leaf){
 		if(LeafUpdate(leaf, tree)) LeafAddPairs(leaf, tree);
 		IncrementStamp(tree);
@@ -674,14 +907,138 @@ cpBBTreeReindexObject(cpBBTree *tree, void *obj, cpHashValue hashid)
 static void
 cpBBTreeSegmentQuery(cpBBTree *tree, void *obj, cpVect a, cpVect b, cpFloat t_exit, cpSpatialIndexSegmentQueryFunc func, void *data)
 {
-	Node *root = tree->root;
-	if(root) SubtreeSegmentQuery(root, obj, a, b, t_exit, func, data);
+	NodeIndex root = tree->root;
+	if(root != NODE_NULL) SubtreeSegmentQuery(tree, root, obj, a, b, t_exit, func, data);
 }
 
 static void
 cpBBTreeQuery(cpBBTree *tree, void *obj, cpBB bb, cpSpatialIndexQueryFunc func, void *data)
 {
-	if(tree->root) SubtreeQuery(tree->root, obj, bb, func, data);
+	if(tree->root != NODE_NULL && cpBBIntersects(tree->rootBB, bb)) SubtreeQuery(tree, tree->root, obj, bb, func, data);
+}
+
+//MARK: Batch Query
+
+// Batches are traversed in packets of up to 32 queries that share one walk down the tree.
+// Each bit of a mask marks a query of the packet that is still active for a node.
+typedef uint32_t PacketMask;
+#define PACKET_SIZE 32
+
+static void
+SubtreeQueryPacket(cpBBTree *tree, NodeIndex subtree, const cpBB *bbs, int first, PacketMask active, cpSpatialIndexBatchQueryFunc func, void *data)
+{
+	if(NodeIsLeaf(subtree)){
+		void *obj = LeafAt(tree, subtree)->obj;
+		for(int i=0; active; i++, active >>= 1){
+			if(active & 1) func(first + i, obj, data);
+		}
+	} else {
+		Node *node = NodeAt(tree, subtree);
+		PacketMask active_a = 0, active_b = 0;
+		PacketMask remaining = active;
+		for(int i=0; remaining; i++, remaining >>= 1){
+			if(!(remaining & 1)) continue;
+			if(cpBBIntersects(node->bb[0], bbs[i])) active_a |= (PacketMask)1 << i;
+			if(cpBBIntersects(node->bb[1], bbs[i])) active_b |= (PacketMask)1 << i;
+		}
+		
+		if(active_a) SubtreeQueryPacket(tree, node->child[0], bbs, first, active_a, func, data);
+		if(active_b) SubtreeQueryPacket(tree, node->child[1], bbs, first, active_b, func, data);
+	}
+}
+
+static void
+cpBBTreeQueryBatch(cpBBTree *tree, const cpBB *bbs, int count, cpSpatialIndexBatchQueryFunc func, void *data)
+{
+	if(tree->root == NODE_NULL) return;
+	
+	for(int first=0; first<count; first += PACKET_SIZE){
+		const cpBB *packet = bbs + first;
+		int n = (count - first < PACKET_SIZE ? count - first : PACKET_SIZE);
+		
+		PacketMask active = 0;
+		for(int i=0; i<n; i++){
+			if(cpBBIntersects(tree->rootBB, packet[i])) active |= (PacketMask)1 << i;
+		}
+		
+		if(active) SubtreeQueryPacket(tree, tree->root, packet, first, active, func, data);
+	}
+}
+
+typedef struct SegmentPacket {
+	cpSpatialIndexSegment *segments;
+	int first;
+	cpSpatialIndexBatchSegmentQueryFunc func;
+	void *data;
+	
+	// Segments whose t_exit was lowered by a hit.
+	PacketMask shortened;
+} SegmentPacket;
+
+static void
+SubtreeSegmentQueryPacket(cpBBTree *tree, NodeIndex subtree, PacketMask active, SegmentPacket *packet)
+{
+	cpSpatialIndexSegment *segments = packet->segments;
+	
+	if(NodeIsLeaf(subtree)){
+		void *obj = LeafAt(tree, subtree)->obj;
+		for(int i=0; active; i++, active >>= 1){
+			if(!(active & 1)) continue;
+			
+			cpFloat t = packet->func(packet->first + i, obj, packet->data);
+			if(t < segments[i].t_exit){
+				segments[i].t_exit = t;
+				packet->shortened |= (PacketMask)1 << i;
+			}
+		}
+	} else {
+		Node *node = NodeAt(tree, subtree);
+		
+		PacketMask mask[2] = {0, 0};
+		int nearer = 0;
+		PacketMask remaining = active;
+		for(int i=0; remaining; i++, remaining >>= 1){
+			const cpSpatialIndexSegment *segment = segments + i;
+			if(!(remaining & 1)) continue;
+			
+			cpFloat t_a = cpBBSegmentQuery(node->bb[0], segment->a, segment->b);
+			cpFloat t_b = cpBBSegmentQuery(node->bb[1], segment->a, segment->b);
+			if(t_a < segment->t_exit) mask[0] |= (PacketMask)1 << i;
+			if(t_b < segment->t_exit) mask[1] |= (PacketMask)1 << i;
+			nearer += (t_a < t_b ? -1 : 1);
+		}
+		
+		// Visit the child most of the packet enters first, like SubtreeSegmentQuery() does for a single segment.
+		int near = (nearer < 0 ? 0 : 1);
+		PacketMask shortened = packet->shortened;
+		packet->shortened = 0;
+		if(mask[near]) SubtreeSegmentQueryPacket(tree, node->child[near], mask[near], packet);
+		
+		// Recheck the far child for the segments that hits in the near child shortened.
+		PacketMask far = mask[!near];
+		PacketMask recheck = far & packet->shortened;
+		for(int i=0; recheck; i++, recheck >>= 1){
+			const cpSpatialIndexSegment *segment = segments + i;
+			if((recheck & 1) && !(cpBBSegmentQuery(node->bb[!near], segment->a, segment->b) < segment->t_exit)) far &= ~((PacketMask)1 << i);
+		}
+		
+		packet->shortened |= shortened;
+		if(far) SubtreeSegmentQueryPacket(tree, node->child[!near], far, packet);
+	}
+}
+
+static void
+cpBBTreeSegmentQueryBatch(cpBBTree *tree, cpSpatialIndexSegment *segments, int count, cpSpatialIndexBatchSegmentQueryFunc func, void *data)
+{
+	if(tree->root == NODE_NULL) return;
+	
+	for(int first=0; first<count; first += PACKET_SIZE){
+		cpSpatialIndexSegment *packet = segments + first;
+		int n = (count - first < PACKET_SIZE ? count - first : PACKET_SIZE);
+		
+		SegmentPacket context = {packet, first, func, data, 0};
+		SubtreeSegmentQueryPacket(tree, tree->root, ((PacketMask)~0 >> (PACKET_SIZE - n)), &context);
+	}
 }
 
 //MARK: Misc
@@ -697,7 +1054,7 @@ typedef struct eachContext {
 	void *data;
 } eachContext;
 
-static void each_helper(Node *node, eachContext *context){context->func(node->obj, context->data);}
+static void each_helper(Leaf *leaf, eachContext *context){context->func(leaf->obj, context->data);}
 
 static void
 cpBBTreeEach(cpBBTree *tree, cpSpatialIndexIteratorFunc func, void *data)
@@ -722,6 +1079,11 @@ static cpSpatialIndexClass klass = {
 	
 	(cpSpatialIndexQueryImpl)cpBBTreeQuery,
 	(cpSpatialIndexSegmentQueryImpl)cpBBTreeSegmentQuery,
+	
+	(cpSpatialIndexQueryBatchImpl)cpBBTreeQueryBatch,
+	(cpSpatialIndexSegmentQueryBatchImpl)cpBBTreeSegmentQueryBatch,
+	
+	(cpSpatialIndexClearImpl)cpBBTreeClear,
 };
 
 static inline cpSpatialIndexClass *Klass(){return &klass;}
@@ -734,43 +1096,55 @@ cpfcompare(const cpFloat *a, const cpFloat *b){
 	return (*a < *b ? -1 : (*b < *a ? 1 : 0));
 }
 
+typedef struct fillContext {
+	cpBBTree *tree;
+	NodeIndex *nodes;
+	cpBB *bbs;
+	int count;
+} fillContext;
+
 static void
-fillNodeArray(Node *node, Node ***cursor){
-	(**cursor) = node;
-	(*cursor)++;
+fillNodeArray(Leaf *leaf, fillContext *context){
+	context->nodes[context->count] = leaf->index;
+	context->bbs[context->count] = LeafBB(context->tree, leaf);
+	context->count++;
 }
 
-static Node *
-partitionNodes(cpBBTree *tree, Node **nodes, int count)
+// Returns the root of the new subtree and stores its bounds in result_bb.
+// bbs holds the bounds of the nodes and is reordered along with them.
+static NodeIndex
+partitionNodes(cpBBTree *tree, NodeIndex *nodes, cpBB *bbs, int count, cpBB *result_bb)
 {
 	if(count == 1){
+		(*result_bb) = bbs[0];
 		return nodes[0];
 	} else if(count == 2) {
-		return NodeNew(tree, nodes[0], nodes[1]);
+		(*result_bb) = cpBBMerge(bbs[0], bbs[1]);
+		return NodeNew(tree, nodes[0], bbs[0], nodes[1], bbs[1]);
 	}
 	
 	// Find the AABB for these nodes
-	cpBB bb = nodes[0]->bb;
-	for(int i=1; i<count; i++) bb = cpBBMerge(bb, nodes[i]->bb);
+	cpBB bb = bbs[0];
+	for(int i=1; i<count; i++) bb = cpBBMerge(bb, bbs[i]);
 	
 	// Split it on it's longest axis
 	cpBool splitWidth = (bb.r - bb.l > bb.t - bb.b);
 	
 	// Sort the bounds and use the median as the splitting point
-	cpFloat *bounds = (cpFloat *)cpcalloc(/*count**/2, sizeof(cpFloat));
+	cpFloat *bounds = (cpFloat *)cpcalloc((size_t)count*2, sizeof(cpFloat));
 	if(splitWidth){
 		for(int i=0; i<count; i++){
-			bounds[2*i + 0] = nodes[i]->bb.l;
-			bounds[2*i + 1] = nodes[i]->bb.r;
+			bounds[2*i + 0] = bbs[i].l;
+			bounds[2*i + 1] = bbs[i].r;
 		}
 	} else {
 		for(int i=0; i<count; i++){
-			bounds[2*i + 0] = nodes[i]->bb.b;
-			bounds[2*i + 1] = nodes[i]->bb.t;
+			bounds[2*i + 0] = bbs[i].b;
+			bounds[2*i + 1] = bbs[i].t;
 		}
 	}
 	
-	qsort(bounds, count*2, sizeof(cpFloat), (int (*)(const void *, const void *))cpfcompare);
+	qsort(bounds, (size_t)count*2, sizeof(cpFloat), (int (*)(const void *, const void *))cpfcompare);
 	cpFloat split = (bounds[count - 1] + bounds[count])*0.5f; // use the medain as the split
 	cpfree(bounds);
 
@@ -781,28 +1155,34 @@ partitionNodes(cpBBTree *tree, Node **nodes, int count)
 	// Partition the nodes
 	int right = count;
 	for(int left=0; left < right;){
-		Node *node = nodes[left];
-		if(cpBBMergedArea(node->bb, b) < cpBBMergedArea(node->bb, a)){
-//		if(cpBBProximity(node->bb, b) < cpBBProximity(node->bb, a)){
+		NodeIndex node = nodes[left];
+		cpBB node_bb = bbs[left];
+		if(cpBBMergedArea(node_bb, b) < cpBBMergedArea(node_bb, a)){
+//		if(cpBBProximity(node_bb, b) < cpBBProximity(node_bb, a)){
 			right--;
 			nodes[left] = nodes[right];
 			nodes[right] = node;
+			bbs[left] = bbs[right];
+			bbs[right] = node_bb;
 		} else {
 			left++;
 		}
 	}
 	
 	if(right == count){
-		Node *node = NULL;
-		for(int i=0; i<count; i++) node = SubtreeInsert(node, nodes[i], tree);
+		NodeIndex node = NODE_NULL;
+		(*result_bb) = bbs[0];
+		for(int i=0; i<count; i++) node = SubtreeInsert(tree, node, (*result_bb), nodes[i], bbs[i], result_bb);
 		return node;
 	}
 	
 	// Recurse and build the node!
-	return NodeNew(tree,
-		partitionNodes(tree, nodes, right),
-		partitionNodes(tree, nodes + right, count - right)
-	);
+	cpBB bb_a, bb_b;
+	NodeIndex node_a = partitionNodes(tree, nodes, bbs, right, &bb_a);
+	NodeIndex node_b = partitionNodes(tree, nodes + right, bbs + right, count - right, &bb_b);
+	
+	(*result_bb) = cpBBMerge(bb_a, bb_b);
+	return NodeNew(tree, node_a, bb_a, node_b, bb_b);
 }
 
 //static void
@@ -833,18 +1213,57 @@ cpBBTreeOptimize(cpSpatialIndex *index)
 	}
 	
 	cpBBTree *tree = (cpBBTree *)index;
-	Node *root = tree->root;
-	if(!root) return;
+	NodeIndex root = tree->root;
+	if(root == NODE_NULL) return;
 	
 	int count = cpBBTreeCount(tree);
-	Node **nodes = (Node **)cpcalloc(count, sizeof(Node *));
-	Node **cursor = nodes;
+	fillContext context = {tree, (NodeIndex *)cpcalloc(count, sizeof(NodeIndex)), (cpBB *)cpcalloc(count, sizeof(cpBB)), 0};
 	
-	cpHashSetEach(tree->leaves, (cpHashSetIteratorFunc)fillNodeArray, &cursor);
+	// The leaves' bounds are stored in their parents, so collect them before recycling the nodes.
+	cpHashSetEach(tree->leaves, (cpHashSetIteratorFunc)fillNodeArray, &context);
 	
 	SubtreeRecycle(tree, root);
-	tree->root = partitionNodes(tree, nodes, count);
-	cpfree(nodes);
+	tree->root = partitionNodes(tree, context.nodes, context.bbs, count, &tree->rootBB);
+	NodeSetParent(tree, tree->root, NODE_NULL);
+	
+	cpfree(context.nodes);
+	cpfree(context.bbs);
+}
+
+//MARK: Tree Quality
+
+static void
+SubtreeMeasure(cpBBTree *tree, NodeIndex subtree, cpBB bb, int depth, cpBBTreeQuality *quality)
+{
+	if(NodeIsLeaf(subtree)){
+		quality->leaves++;
+		if(depth > quality->maxDepth) quality->maxDepth = depth;
+		quality->averageDepth += depth;
+	} else {
+		Node *node = NodeAt(tree, subtree);
+		quality->sahCost += cpBBArea(bb);
+		SubtreeMeasure(tree, node->child[0], node->bb[0], depth + 1, quality);
+		SubtreeMeasure(tree, node->child[1], node->bb[1], depth + 1, quality);
+	}
+}
+
+void
+cpBBTreeGetQuality(cpSpatialIndex *index, cpBBTreeQuality *quality)
+{
+	cpBBTreeQuality result = {0, 0, 0.0f, 0.0f};
+	
+	cpBBTree *tree = GetTreeIfRooted(index);
+	if(tree){
+		SubtreeMeasure(tree, tree->root, tree->rootBB, 0, &result);
+		
+		cpFloat rootArea = cpBBArea(tree->rootBB);
+		result.averageDepth /= result.leaves;
+		result.sahCost = (rootArea > 0.0f ? result.sahCost/rootArea : 0.0f);
+	} else {
+		cpAssertWarn(GetTree(index), "Measuring the quality of a non-tree spatial index.");
+	}
+	
+	(*quality) = result;
 }
 
 //MARK: Debug Draw
@@ -856,14 +1275,14 @@ cpBBTreeOptimize(cpSpatialIndex *index)
 #include <GLUT/glut.h>
 
 static void
-NodeRender(Node *node, int depth)
+NodeRender(cpBBTree *tree, NodeIndex node, int depth)
 {
 	if(!NodeIsLeaf(node) && depth <= 10){
-		NodeRender(node->a, depth + 1);
-		NodeRender(node->b, depth + 1);
+		NodeRender(tree, NodeAt(tree, node)->child[0], depth + 1);
+		NodeRender(tree, NodeAt(tree, node)->child[1], depth + 1);
 	}
 	
-	cpBB bb = node->bb;
+	cpBB bb = NodeBB(tree, node);
 	
 //	GLfloat v = depth/2.0f;	
 //	glColor3f(1.0f - v, v, 0.0f);
@@ -891,6 +1310,6 @@ cpBBTreeRenderDebug(cpSpatialIndex *index){
 	}
 	
 	cpBBTree *tree = (cpBBTree *)index;
-	if(tree->root) NodeRender(tree->root, 0);
+	if(tree->root != NODE_NULL) NodeRender(tree, tree->root, 0);
 }
 #endif
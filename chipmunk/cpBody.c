@@ -34,6 +34,7 @@ cpBody *
 cpBodyInit(cpBody *body, cpFloat mass, cpFloat moment)
 {
 	body->space = NULL;
+	body->hashid = 0;
 	body->shapeList = NULL;
 	body->arbiterList = NULL;
 	body->constraintList = NULL;
@@ -55,6 +56,9 @@ cpBodyInit(cpBody *body, cpFloat mass, cpFloat moment)
 	body->v_bias = cpvzero;
 	body->w_bias = 0.0f;
 	
+	body->continuous = cpFalse;
+	body->impactTime = 1.0f;
+	
 	body->userData = NULL;
 	
 	// Setters must be called after full initialization so the sanity checks don't assert on garbage data.
@@ -151,6 +155,14 @@ cpBodySetType(cpBody *body, cpBodyType type)
 	cpBodyType oldType = cpBodyGetType(body);
 	if(oldType == type) return;
 	
+	// Wake the body up while it's still dynamic. Once the mass is changed cpBodyActivate() ignores it,
+	// which would leave it in a sleeping component and its shapes in the static index.
+	cpSpace *space = cpBodyGetSpace(body);
+	if(space != NULL && oldType == CP_BODY_TYPE_DYNAMIC){
+		cpAssertSpaceUnlocked(space);
+		cpBodyActivate(body);
+	}
+	
 	// Static bodies have their idle timers set to infinity.
 	// Non-static bodies should have their idle timer reset.
 	body->sleeping.idleTime = (type == CP_BODY_TYPE_STATIC ? INFINITY : 0.0f);
@@ -169,7 +181,6 @@ cpBodySetType(cpBody *body, cpBodyType type)
 	}
 	
 	// If the body is added to a space already, we'll need to update some space data structures.
-	cpSpace *space = cpBodyGetSpace(body);
 	if(space != NULL){
 		cpAssertSpaceUnlocked(space);
 		
@@ -200,6 +211,18 @@ cpBodySetType(cpBody *body, cpBodyType type)
 	}
 }
 
+cpBool
+cpBodyGetContinuousCollision(const cpBody *body)
+{
+	return body->continuous;
+}
+
+void
+cpBodySetContinuousCollision(cpBody *body, cpBool continuous)
+{
+	body->continuous = continuous;
+}
+
 
 
 // Should *only* be called when shapes with mass info are modified, added or removed.
@@ -522,6 +545,21 @@ cpBodyUpdatePosition(cpBody *body, cpFloat dt)
 	cpAssertSaneBody(body);
 }
 
+void
+cpBodySweepRewind(cpBody *body, cpFloat t, cpFloat dt)
+{
+	// Kinematic bodies go where they are told.
+	if(cpBodyGetType(body) != CP_BODY_TYPE_DYNAMIC || !cpBodyIsSwept(body) || t >= body->impactTime) return;
+	
+	cpFloat back = (body->impactTime - t)*dt;
+	cpVect p = body->p = cpvsub(body->p, cpvmult(body->v, back));
+	cpFloat a = SetAngle(body, body->a - body->w*back);
+	SetTransform(body, p, a);
+	body->impactTime = t;
+	
+	CP_BODY_FOREACH_SHAPE(body, shape) cpShapeCacheBB(shape);
+}
+
 cpVect
 cpBodyLocalToWorld(const cpBody *body, const cpVect point)
 {
@@ -81,6 +81,14 @@ CP_EXPORT cpBodyType cpBodyGetType(cpBody *body);
 /// Set the type of the body.
 CP_EXPORT void cpBodySetType(cpBody *body, cpBodyType type);
 
+/// Get if the body uses continuous collision detection.
+CP_EXPORT cpBool cpBodyGetContinuousCollision(const cpBody *body);
+/// Set if the body uses continuous collision detection.
+/// Its shapes are tested over their whole motion during a step instead of only where they end up, so they can't pass through thin shapes.
+/// When they would, a dynamic body is moved back to the time of impact and collides there. Kinematic bodies are never moved back.
+/// Triggers, sensors and pairs that are never solved, like two kinematic bodies, report the overlap where they first touched instead.
+CP_EXPORT void cpBodySetContinuousCollision(cpBody *body, cpBool continuous);
+
 /// Get the space this body is added to.
 CP_EXPORT cpSpace* cpBodyGetSpace(const cpBody *body);
 
@@ -0,0 +1,200 @@
+#include "chipmunk/chipmunk_private.h"
+
+//MARK: Population Statistics
+
+void
+cpBroadphasePopulationAdd(cpBroadphasePopulation *population, cpBB bb)
+{
+	cpFloat extent = cpfmax(bb.r - bb.l, bb.t - bb.b);
+
+	population->count++;
+	population->totalExtent += extent;
+	population->maxExtent = cpfmax(population->maxExtent, extent);
+}
+
+void
+cpBroadphaseHashSize(const cpBroadphasePopulation *population, cpFloat *celldim, int *numcells)
+{
+	// Cells about the size of the average object, and a table ~10x larger than the object count.
+	cpFloat mean = (population->count > 0 ? population->totalExtent/population->count : 0.0f);
+	(*celldim) = (mean > 0.0f ? mean : 1.0f);
+	(*numcells) = 10*(population->count > 100 ? population->count : 100);
+}
+
+//MARK: Recording
+
+static const cpBB EmptyBB = {INFINITY, INFINITY, -INFINITY, -INFINITY};
+
+static inline cpBool
+IsEmpty(cpBB bb)
+{
+	return (bb.l > bb.r);
+}
+
+cpBroadphaseRecording *
+cpBroadphaseRecordingInit(cpBroadphaseRecording *recording, cpBB *bbs, int capacity, int maxFrames)
+{
+	cpAssertHard(capacity > 0 && maxFrames > 0, "A recording must have room for at least one object and one frame.");
+
+	recording->capacity = capacity;
+	recording->frames = 0;
+	recording->maxFrames = maxFrames;
+	recording->dt = 0.0f;
+	recording->bbs = bbs;
+
+	return recording;
+}
+
+struct RecordContext {
+	cpBB *frame;
+	int capacity;
+};
+
+static void
+RecordShape(cpShape *shape, struct RecordContext *context)
+{
+	if(shape->hashid < (cpHashValue)context->capacity) context->frame[shape->hashid] = shape->bb;
+}
+
+cpBool
+cpSpaceRecordBroadphaseFrame(cpSpace *space, cpBroadphaseRecording *recording)
+{
+	if(recording->frames == recording->maxFrames) return cpFalse;
+
+	cpBB *frame = recording->bbs + recording->frames*recording->capacity;
+	for(int i=0; i<recording->capacity; i++) frame[i] = EmptyBB;
+
+	struct RecordContext context = {frame, recording->capacity};
+	cpSpatialIndexEach(space->dynamicShapes, (cpSpatialIndexIteratorFunc)RecordShape, &context);
+
+	if(recording->dt == 0.0f) recording->dt = space->curr_dt;
+	recording->frames++;
+
+	return cpTrue;
+}
+
+//MARK: Replay
+
+typedef struct ReplayObject {
+	cpBB bb;
+	cpVect v;
+	cpBool inIndex;
+} ReplayObject;
+
+static cpBB ReplayObjectBB(ReplayObject *obj){return obj->bb;}
+static cpVect ReplayObjectVelocity(ReplayObject *obj){return obj->v;}
+
+static cpCollisionID
+IgnoreQuery(void *obj1, void *obj2, cpCollisionID id, void *unused)
+{
+	return id;
+}
+
+static cpCollisionID
+CountPair(void *obj1, void *obj2, cpCollisionID id, unsigned long *pairs)
+{
+	(*pairs)++;
+	return id;
+}
+
+static cpSpatialIndex *
+ReplayIndexNew(const cpBroadphaseRecording *recording, cpBroadphaseType type)
+{
+	cpSpatialIndexBBFunc bbfunc = (cpSpatialIndexBBFunc)ReplayObjectBB;
+
+	switch(type){
+		case CP_BROADPHASE_BBTREE: {
+			cpSpatialIndex *index = cpBBTreeNew(bbfunc, NULL);
+			if(recording->dt > 0.0f) cpBBTreeSetVelocityFunc(index, (cpBBTreeVelocityFunc)ReplayObjectVelocity);
+			return index;
+		}
+		case CP_BROADPHASE_SPACE_HASH:
+		case CP_BROADPHASE_GRID: {
+			cpBroadphasePopulation population = {0};
+			for(int i=0; i<recording->capacity; i++){
+				if(!IsEmpty(recording->bbs[i])) cpBroadphasePopulationAdd(&population, recording->bbs[i]);
+			}
+
+			cpFloat celldim; int numcells;
+			cpBroadphaseHashSize(&population, &celldim, &numcells);
+			if(type == CP_BROADPHASE_SPACE_HASH) return cpSpaceHashNew(celldim, numcells, bbfunc, NULL);
+
+			cpBB bounds = EmptyBB;
+			for(int i=0, count=recording->frames*recording->capacity; i<count; i++){
+				if(!IsEmpty(recording->bbs[i])) bounds = cpBBMerge(bounds, recording->bbs[i]);
+			}
+
+			return cpGridNew(bounds, celldim, bbfunc, NULL);
+		}
+		case CP_BROADPHASE_SWEEP_1D:
+			return cpSweep1DNew(bbfunc, NULL);
+		default:
+			cpAssertHard(cpFalse, "Unknown broadphase type.");
+			return NULL;
+	}
+}
+
+// Replays the recording once. The pair pass uses a fresh index so its cost isn't hidden by an earlier reindex,
+// and matches what cpSpaceStep() does with a single cpSpatialIndexReindexQuery() call per step.
+static void
+ReplayPass(const cpBroadphaseRecording *recording, cpBroadphaseType type, cpBroadphaseClockFunc clock, cpBroadphaseCost *cost, cpBool findPairs)
+{
+	int capacity = recording->capacity;
+	ReplayObject *objects = (ReplayObject *)cpcalloc(capacity, sizeof(ReplayObject));
+	cpSpatialIndex *index = ReplayIndexNew(recording, type);
+
+	for(int frame=0; frame<recording->frames; frame++){
+		const cpBB *bbs = recording->bbs + frame*capacity;
+
+		uint64_t start = clock();
+		for(int i=0; i<capacity; i++){
+			ReplayObject *obj = objects + i;
+			cpBB bb = bbs[i];
+
+			if(!IsEmpty(bb)){
+				if(obj->inIndex){
+					if(recording->dt > 0.0f) obj->v = cpvmult(cpvsub(cpBBCenter(bb), cpBBCenter(obj->bb)), 1.0f/recording->dt);
+					obj->bb = bb;
+				} else {
+					obj->v = cpvzero;
+					obj->bb = bb;
+					cpSpatialIndexInsert(index, obj, i);
+					obj->inIndex = cpTrue;
+				}
+			} else if(obj->inIndex){
+				cpSpatialIndexRemove(index, obj, i);
+				obj->inIndex = cpFalse;
+			}
+		}
+		uint64_t insertTime = clock() - start;
+
+		if(findPairs){
+			start = clock();
+			cpSpatialIndexReindexQuery(index, (cpSpatialIndexQueryFunc)CountPair, &cost->pairs);
+			cost->pairTime += clock() - start;
+		} else {
+			cost->insertTime += insertTime;
+
+			start = clock();
+			cpSpatialIndexReindex(index);
+			cost->reindexTime += clock() - start;
+
+			start = clock();
+			for(int i=0; i<capacity; i++){
+				ReplayObject *obj = objects + i;
+				if(obj->inIndex) cpSpatialIndexQuery(index, obj, obj->bb, IgnoreQuery, NULL);
+			}
+			cost->queryTime += clock() - start;
+		}
+	}
+
+	cpSpatialIndexFree(index);
+	cpfree(objects);
+}
+
+void
+cpBroadphaseReplay(const cpBroadphaseRecording *recording, cpBroadphaseType type, cpBroadphaseClockFunc clock, cpBroadphaseCost *cost)
+{
+	ReplayPass(recording, type, clock, cost, cpFalse);
+	ReplayPass(recording, type, clock, cost, cpTrue);
+}
@@ -265,48 +265,82 @@ ClosestDist(const cpVect v0,const cpVect v1)
 	return cpvlengthsq(LerpT(v0, v1, ClosestT(v0, v1)));
 }
 
-// Recursive implementation of the EPA loop.
-// Each recursion adds a point to the convex hull until it's known that we have the closest point on the surface.
+// Check if p is far enough beyond the edge (v0, v1) to be worth adding to the hull.
+// Single precision builds need some slack, otherwise EPA can keep inserting points that only differ by rounding.
+static inline cpBool
+EPACheckProgress(const cpVect v0, const cpVect v1, const cpVect p)
+{
+	if(!cpCheckPointGreater(v0, v1, p)) return cpFalse;
+	
+#if CP_USE_DOUBLES
+	return cpTrue;
+#else
+	cpVect delta = cpvsub(v1, v0);
+	cpVect offset = cpvsub(p, v0);
+	return cpvcross(delta, offset) > CP_COLLISION_EPSILON*(cpvlengthsq(delta) + cpvlengthsq(offset));
+#endif
+}
+// The EPA hull starts as a triangle and gains at most one point per iteration.
+#define MAX_EPA_HULL (MAX_EPA_ITERATIONS + 2)
+
+// Find the closest points on the surface of two overlapping shapes using the EPA algorithm.
+// EPA is called from GJK when two shapes overlap.
+// This is a moderately expensive step! Avoid it by adding radii to your shapes so their inner polygons won't overlap.
+// Each iteration adds a point to the convex hull until it's known that we have the closest point on the surface.
+// The hull is rebuilt back and forth between two fixed size buffers so the stack use is bounded.
 static struct ClosestPoints
-EPARecurse(const struct SupportContext *ctx, const int count, const struct MinkowskiPoint *hull, const int iteration)
-{
-	int mini = 0;
-	cpFloat minDist = INFINITY;
-	
-	// TODO: precalculate this when building the hull and save a step.
-	// Find the closest segment hull[i] and hull[i + 1] to (0, 0)
-	for(int j=0, i=count-1; j<count; i=j, j++){
-		cpFloat d = ClosestDist(hull[i].ab, hull[j].ab);
-		if(d < minDist){
-			minDist = d;
-			mini = i;
-		}
-	}
-	
-	struct MinkowskiPoint v0 = hull[mini];
-	struct MinkowskiPoint v1 = hull[(mini + 1)%count];
-	cpAssertSoft(!cpveql(v0.ab, v1.ab), "Internal Error: EPA vertexes are the same (%d and %d)", mini, (mini + 1)%count);
+EPA(const struct SupportContext *ctx, const struct MinkowskiPoint v0, const struct MinkowskiPoint v1, const struct MinkowskiPoint v2)
+{
+	struct MinkowskiPoint buffer1[MAX_EPA_HULL], buffer2[MAX_EPA_HULL];
+	struct MinkowskiPoint *hull = buffer1, *hull2 = buffer2;
 	
-	// Check if there is a point on the minkowski difference beyond this edge.
-	struct MinkowskiPoint p = Support(ctx, cpvperp(cpvsub(v1.ab, v0.ab)));
+	int count = 3;
+	hull[0] = v0;
+	hull[1] = v1;
+	hull[2] = v2;
 	
+	for(int iteration = 1;; iteration++){
+		int mini = 0;
+		cpFloat minDist = INFINITY;
+		
+		// TODO: precalculate this when building the hull and save a step.
+		// Find the closest segment hull[i] and hull[i + 1] to (0, 0)
+		for(int j=0, i=count-1; j<count; i=j, j++){
+			cpFloat d = ClosestDist(hull[i].ab, hull[j].ab);
+			if(d < minDist){
+				minDist = d;
+				mini = i;
+			}
+		}
+		
+		struct MinkowskiPoint e0 = hull[mini];
+		struct MinkowskiPoint e1 = hull[(mini + 1)%count];
+		cpAssertSoft(!cpveql(e0.ab, e1.ab), "Internal Error: EPA vertexes are the same (%d and %d)", mini, (mini + 1)%count);
+		
+		// Check if there is a point on the minkowski difference beyond this edge.
+		struct MinkowskiPoint p = Support(ctx, cpvperp(cpvsub(e1.ab, e0.ab)));
+		
 #if DRAW_EPA
-	cpVect verts[count];
-	for(int i=0; i<count; i++) verts[i] = hull[i].ab;
-	
-	ChipmunkDebugDrawPolygon(count, verts, 0.0, RGBAColor(1, 1, 0, 1), RGBAColor(1, 1, 0, 0.25));
-	ChipmunkDebugDrawSegment(v0.ab, v1.ab, RGBAColor(1, 0, 0, 1));
-	
-	ChipmunkDebugDrawDot(5, p.ab, LAColor(1, 1));
+		cpVect verts[count];
+		for(int i=0; i<count; i++) verts[i] = hull[i].ab;
+		
+		ChipmunkDebugDrawPolygon(count, verts, 0.0, RGBAColor(1, 1, 0, 1), RGBAColor(1, 1, 0, 0.25));
+		ChipmunkDebugDrawSegment(e0.ab, e1.ab, RGBAColor(1, 0, 0, 1));
+		
+		ChipmunkDebugDrawDot(5, p.ab, LAColor(1, 1));
 #endif
-	
-	// The usual exit condition is a duplicated vertex.
-	// Much faster to check the ids than to check the signed area.
-	cpBool duplicate = (p.id == v0.id || p.id == v1.id);
-	
-	if(!duplicate && cpCheckPointGreater(v0.ab, v1.ab, p.ab) && iteration < MAX_EPA_ITERATIONS){
+		
+		// The usual exit condition is a duplicated vertex.
+		// Much faster to check the ids than to check the signed area.
+		cpBool duplicate = (p.id == e0.id || p.id == e1.id);
+		
+		if(duplicate || !EPACheckProgress(e0.ab, e1.ab, p.ab) || iteration >= MAX_EPA_ITERATIONS){
+			// Could not find a new point to insert, so we have found the closest edge of the minkowski difference.
+			cpAssertWarn(iteration < WARN_EPA_ITERATIONS, "High EPA iterations: %d", iteration);
+			return ClosestPointsNew(e0, e1);
+		}
+		
 		// Rebuild the convex hull by inserting p.
-		struct MinkowskiPoint *hull2 = (struct MinkowskiPoint *)alloca((count + 1)*sizeof(struct MinkowskiPoint));
 		int count2 = 1;
 		hull2[0] = p;
 		
@@ -323,44 +357,42 @@ EPARecurse(const struct SupportContext *ctx, const int count, const struct Minko
 			}
 		}
 		
-		return EPARecurse(ctx, count2, hull2, iteration + 1);
-	} else {
-		// Could not find a new point to insert, so we have found the closest edge of the minkowski difference.
-		cpAssertWarn(iteration < WARN_EPA_ITERATIONS, "High EPA iterations: %d", iteration);
-		return ClosestPointsNew(v0, v1);
+		struct MinkowskiPoint *swap = hull;
+		hull = hull2;
+		hull2 = swap;
+		count = count2;
 	}
 }
 
-// Find the closest points on the surface of two overlapping shapes using the EPA algorithm.
-// EPA is called from GJK when two shapes overlap.
-// This is a moderately expensive step! Avoid it by adding radii to your shapes so their inner polygons won't overlap.
-static struct ClosestPoints
-EPA(const struct SupportContext *ctx, const struct MinkowskiPoint v0, const struct MinkowskiPoint v1, const struct MinkowskiPoint v2)
-{
-	// TODO: allocate a NxM array here and do an in place convex hull reduction in EPARecurse?
-	struct MinkowskiPoint hull[3] = {v0, v1, v2};
-	return EPARecurse(ctx, 3, hull, 1);
-}
-
 //MARK: GJK Functions.
 
-// Recursive implementation of the GJK loop.
+// Iterative implementation of the GJK loop.
+// Exits early once a search direction separates the shapes by more than 'rsum'.
+// Starting from last frame's cached edge, that usually happens on the first iteration.
 static inline struct ClosestPoints
-GJKRecurse(const struct SupportContext *ctx, const struct MinkowskiPoint v0, const struct MinkowskiPoint v1, const int iteration)
+GJKIterate(const struct SupportContext *ctx, struct MinkowskiPoint v0, struct MinkowskiPoint v1, const cpFloat rsum)
 {
-	if(iteration > MAX_GJK_ITERATIONS){
-		cpAssertWarn(iteration < WARN_GJK_ITERATIONS, "High GJK iterations: %d", iteration);
-		return ClosestPointsNew(v0, v1);
-	}
-	
-	if(cpCheckPointGreater(v1.ab, v0.ab, cpvzero)){
-		// Origin is behind axis. Flip and try again.
-		return GJKRecurse(ctx, v1, v0, iteration);
-	} else {
+	for(int iteration = 1; iteration <= MAX_GJK_ITERATIONS;){
+		if(cpCheckPointGreater(v1.ab, v0.ab, cpvzero)){
+			// Origin is behind axis. Flip and try again.
+			struct MinkowskiPoint swap = v0;
+			v0 = v1;
+			v1 = swap;
+			continue;
+		}
+		
 		cpFloat t = ClosestT(v0.ab, v1.ab);
 		cpVect n = (-1.0f < t && t < 1.0f ? cpvperp(cpvsub(v1.ab, v0.ab)) : cpvneg(LerpT(v0.ab, v1.ab, t)));
 		struct MinkowskiPoint p = Support(ctx, n);
 		
+		// Nothing on the minkowski difference is further than p along n, so -n is a separating axis if p is far enough behind the origin.
+		cpFloat dp = cpvdot(n, p.ab);
+		if(dp < 0.0f && dp*dp > rsum*rsum*cpvlengthsq(n)){
+			cpFloat nlength = cpvlength(n);
+			struct ClosestPoints points = {p.a, p.b, cpvmult(n, -1.0f/nlength), -dp/nlength, (v0.id & 0xFFFF)<<16 | (v1.id & 0xFFFF)};
+			return points;
+		}
+		
 #if DRAW_GJK
 		ChipmunkDebugDrawSegment(v0.ab, v1.ab, RGBAColor(1, 1, 1, 1));
 		cpVect c = cpvlerp(v0.ab, v1.ab, 0.5);
@@ -373,22 +405,25 @@ GJKRecurse(const struct SupportContext *ctx, const struct MinkowskiPoint v0, con
 			// The triangle v0, p, v1 contains the origin. Use EPA to find the MSA.
 			cpAssertWarn(iteration < WARN_GJK_ITERATIONS, "High GJK->EPA iterations: %d", iteration);
 			return EPA(ctx, v0, p, v1);
+		} else if(cpCheckAxis(v0.ab, v1.ab, p.ab, n)){
+			// The edge v0, v1 that we already have is the closest to (0, 0) since p was not closer.
+			cpAssertWarn(iteration < WARN_GJK_ITERATIONS, "High GJK iterations: %d", iteration);
+			return ClosestPointsNew(v0, v1);
 		} else {
-			if(cpCheckAxis(v0.ab, v1.ab, p.ab, n)){
-				// The edge v0, v1 that we already have is the closest to (0, 0) since p was not closer.
-				cpAssertWarn(iteration < WARN_GJK_ITERATIONS, "High GJK iterations: %d", iteration);
-				return ClosestPointsNew(v0, v1);
+			// p was closer to the origin than our existing edge.
+			// Need to figure out which existing point to drop.
+			if(ClosestDist(v0.ab, p.ab) < ClosestDist(p.ab, v1.ab)){
+				v1 = p;
 			} else {
-				// p was closer to the origin than our existing edge.
-				// Need to figure out which existing point to drop.
-				if(ClosestDist(v0.ab, p.ab) < ClosestDist(p.ab, v1.ab)){
-					return GJKRecurse(ctx, v0, p, iteration + 1);
-				} else {
-					return GJKRecurse(ctx, p, v1, iteration + 1);
-				}
+				v0 = p;
 			}
+			
+			iteration++;
 		}
 	}
+	
+	cpAssertWarn(cpFalse, "High GJK iterations: %d", MAX_GJK_ITERATIONS + 1);
+	return ClosestPointsNew(v0, v1);
 }
 
 // Get a SupportPoint from a cached shape and index.
@@ -413,8 +448,9 @@ ShapePoint(const cpShape *shape, const int i)
 }
 
 // Find the closest points between two shapes using the GJK algorithm.
+// If the shapes are separated by more than 'rsum', the returned distance is only a lower bound.
 static struct ClosestPoints
-GJK(const struct SupportContext *ctx, cpCollisionID *id)
+GJK(const struct SupportContext *ctx, const cpFloat rsum, cpCollisionID *id)
 {
 #if DRAW_GJK || DRAW_EPA
 	int count1 = 1;
@@ -466,7 +502,7 @@ GJK(const struct SupportContext *ctx, cpCollisionID *id)
 		v1 = Support(ctx, cpvneg(axis));
 	}
 	
-	struct ClosestPoints points = GJKRecurse(ctx, v0, v1, 1);
+	struct ClosestPoints points = GJKIterate(ctx, v0, v1, rsum);
 	*id = points.id;
 	return points;
 }
@@ -572,7 +608,7 @@ static void
 SegmentToSegment(const cpSegmentShape *seg1, const cpSegmentShape *seg2, struct cpCollisionInfo *info)
 {
 	struct SupportContext context = {(cpShape *)seg1, (cpShape *)seg2, (SupportPointFunc)SegmentSupportPoint, (SupportPointFunc)SegmentSupportPoint};
-	struct ClosestPoints points = GJK(&context, &info->id);
+	struct ClosestPoints points = GJK(&context, seg1->r + seg2->r, &info->id);
 	
 #if DRAW_CLOSEST
 #if PRINT_LOG
@@ -603,11 +639,65 @@ SegmentToSegment(const cpSegmentShape *seg1, const cpSegmentShape *seg2, struct
 	}
 }
 
+// Find the face of box a with the largest separation from box b.
+static inline cpFloat
+BoxFaceSeparation(const cpPolyShape *a, const cpPolyShape *b, int *face)
+{
+	const struct cpSplittingPlane *planesA = a->planes;
+	const struct cpSplittingPlane *planesB = b->planes;
+	cpFloat max = -INFINITY;
+	
+	for(int i=0; i<4; i++){
+		cpVect n = planesA[i].n;
+		cpFloat d = cpfmin(
+			cpfmin(cpvdot(n, planesB[0].v0), cpvdot(n, planesB[1].v0)),
+			cpfmin(cpvdot(n, planesB[2].v0), cpvdot(n, planesB[3].v0))
+		) - cpvdot(n, planesA[i].v0);
+		
+		if(d > max){
+			max = d;
+			(*face) = i;
+			
+			// Early out on a separating axis.
+			if(d > 0.0f) break;
+		}
+	}
+	
+	return max;
+}
+
+// Separating axis test for a pair of rectangles.
+// Returns cpFalse if the boxes are separated but within their rounding radii and need the GJK path.
+// The contacts are built from the same support edges as the GJK path so their hashes match.
+static cpBool
+BoxToBox(const cpPolyShape *poly1, const cpPolyShape *poly2, struct cpCollisionInfo *info)
+{
+	int face1 = 0, face2 = 0;
+	cpFloat rsum = poly1->r + poly2->r;
+	
+	cpFloat d1 = BoxFaceSeparation(poly1, poly2, &face1);
+	if(d1 > 0.0f) return (d1 - rsum > 0.0f);
+	
+	cpFloat d2 = BoxFaceSeparation(poly2, poly1, &face2);
+	if(d2 > 0.0f) return (d2 - rsum > 0.0f);
+	
+	struct ClosestPoints points = {cpvzero, cpvzero, poly1->planes[face1].n, d1, 0};
+	if(d2 > d1){
+		points.n = cpvneg(poly2->planes[face2].n);
+		points.d = d2;
+	}
+	
+	ContactPoints(SupportEdgeForPoly(poly1, points.n), SupportEdgeForPoly(poly2, cpvneg(points.n)), points, info);
+	return cpTrue;
+}
+
 static void
 PolyToPoly(const cpPolyShape *poly1, const cpPolyShape *poly2, struct cpCollisionInfo *info)
 {
+	if(poly1->isBox && poly2->isBox && BoxToBox(poly1, poly2, info)) return;
+	
 	struct SupportContext context = {(cpShape *)poly1, (cpShape *)poly2, (SupportPointFunc)PolySupportPoint, (SupportPointFunc)PolySupportPoint};
-	struct ClosestPoints points = GJK(&context, &info->id);
+	struct ClosestPoints points = GJK(&context, poly1->r + poly2->r, &info->id);
 	
 #if DRAW_CLOSEST
 #if PRINT_LOG
@@ -630,7 +720,7 @@ static void
 SegmentToPoly(const cpSegmentShape *seg, const cpPolyShape *poly, struct cpCollisionInfo *info)
 {
 	struct SupportContext context = {(cpShape *)seg, (cpShape *)poly, (SupportPointFunc)SegmentSupportPoint, (SupportPointFunc)PolySupportPoint};
-	struct ClosestPoints points = GJK(&context, &info->id);
+	struct ClosestPoints points = GJK(&context, seg->r + poly->r, &info->id);
 	
 #if DRAW_CLOSEST
 #if PRINT_LOG
@@ -662,7 +752,7 @@ static void
 CircleToPoly(const cpCircleShape *circle, const cpPolyShape *poly, struct cpCollisionInfo *info)
 {
 	struct SupportContext context = {(cpShape *)circle, (cpShape *)poly, (SupportPointFunc)CircleSupportPoint, (SupportPointFunc)PolySupportPoint};
-	struct ClosestPoints points = GJK(&context, &info->id);
+	struct ClosestPoints points = GJK(&context, circle->r + poly->r, &info->id);
 	
 #if DRAW_CLOSEST
 	ChipmunkDebugDrawDot(3.0, points.a, RGBAColor(1, 1, 1, 1));
@@ -724,3 +814,155 @@ cpCollide(const cpShape *a, const cpShape *b, cpCollisionID id, struct cpContact
 	
 	return info;
 }
+
+//MARK: Overlap Tests
+
+static const SupportPointFunc OverlapSupportFuncs[CP_NUM_SHAPES] = {
+	(SupportPointFunc)CircleSupportPoint,
+	(SupportPointFunc)SegmentSupportPoint,
+	(SupportPointFunc)PolySupportPoint,
+};
+
+static inline cpFloat
+ShapeRadius(const cpShape *shape)
+{
+	switch(shape->klass->type){
+		case CP_CIRCLE_SHAPE: return ((cpCircleShape *)shape)->r;
+		case CP_SEGMENT_SHAPE: return ((cpSegmentShape *)shape)->r;
+		case CP_POLY_SHAPE: return ((cpPolyShape *)shape)->r;
+		default: return 0.0f;
+	}
+}
+
+// Like cpCollide(), but only answers whether the shapes touch, so no contact points are made.
+// Segment endcap tangents are ignored.
+cpBool
+cpShapesOverlap(const cpShape *a, const cpShape *b)
+{
+	cpShapeType typeA = a->klass->type, typeB = b->klass->type;
+	cpFloat rsum = ShapeRadius(a) + ShapeRadius(b);
+	
+	if(typeA == CP_CIRCLE_SHAPE && typeB == CP_CIRCLE_SHAPE){
+		return (cpvdistsq(((cpCircleShape *)a)->tc, ((cpCircleShape *)b)->tc) < rsum*rsum);
+	}
+	
+	if(typeA == CP_POLY_SHAPE && typeB == CP_POLY_SHAPE && ((cpPolyShape *)a)->isBox && ((cpPolyShape *)b)->isBox){
+		// A separating axis test settles boxes without GJK, unless they are only separated by less than their radii.
+		int face;
+		cpFloat d = cpfmax(BoxFaceSeparation((cpPolyShape *)a, (cpPolyShape *)b, &face), BoxFaceSeparation((cpPolyShape *)b, (cpPolyShape *)a, &face));
+		if(d > rsum) return cpFalse;
+		if(d <= 0.0f) return cpTrue;
+	}
+	
+	struct SupportContext context = {a, b, OverlapSupportFuncs[typeA], OverlapSupportFuncs[typeB]};
+	cpCollisionID id = 0;
+	return (GJK(&context, rsum, &id).d <= rsum);
+}
+
+//MARK: Time of Impact
+
+#define MAX_TOI_ITERATIONS 20
+
+// Distance from a shape's body's center of gravity to the furthest point of the shape.
+static cpFloat
+ShapeSweepRadius(const cpShape *shape)
+{
+	cpVect p = shape->body->p;
+	
+	switch(shape->klass->type){
+		case CP_CIRCLE_SHAPE: {
+			cpCircleShape *circle = (cpCircleShape *)shape;
+			return cpvdist(circle->tc, p) + circle->r;
+		} case CP_SEGMENT_SHAPE: {
+			cpSegmentShape *seg = (cpSegmentShape *)shape;
+			return cpfmax(cpvdist(seg->ta, p), cpvdist(seg->tb, p)) + seg->r;
+		} case CP_POLY_SHAPE: {
+			cpPolyShape *poly = (cpPolyShape *)shape;
+			cpFloat max = 0.0f;
+			for(int i=0; i<poly->count; i++) max = cpfmax(max, cpvdist(poly->planes[i].v0, p));
+			return max + poly->r;
+		} default: {
+			return 0.0f;
+		}
+	}
+}
+
+static inline void
+ShapeSweepPose(const cpShape *shape, cpTransform transform)
+{
+	if(cpBodyIsSwept(shape->body)) shape->klass->cacheData((cpShape *)shape, transform);
+}
+
+// Conservative advancement: step forward in time by the gap between the shapes divided by how fast any of their points
+// could be closing it, which can never step past the impact. Continuous bodies are moved back along their velocities,
+// other bodies stay where they are. The target is a small overlap so the shapes collide at the returned time.
+// Shapes that never reach the target during the step return INFINITY. Fast spinning shapes that run out of iterations
+// return the time reached so far.
+// The cached data of the shapes is left at their current pose, but not their bounding boxes.
+cpFloat
+cpShapesTimeOfImpact(const cpShape *a, const cpShape *b, cpFloat dt, cpFloat tolerance)
+{
+	cpBody *bodyA = a->body, *bodyB = b->body;
+	
+	// Bound how far the shapes' points can move towards each other over the whole step.
+	cpVect delta = cpvzero;
+	cpFloat spin = 0.0f;
+	
+	if(cpBodyIsSwept(bodyA)){
+		delta = cpvsub(delta, cpvmult(bodyA->v, dt));
+		spin += cpfabs(bodyA->w*dt)*ShapeSweepRadius(a);
+	}
+	
+	if(cpBodyIsSwept(bodyB)){
+		delta = cpvadd(delta, cpvmult(bodyB->v, dt));
+		spin += cpfabs(bodyB->w*dt)*ShapeSweepRadius(b);
+	}
+	
+	cpFloat rsum = ShapeRadius(a) + ShapeRadius(b);
+	struct SupportContext context = {a, b, OverlapSupportFuncs[a->klass->type], OverlapSupportFuncs[b->klass->type]};
+	cpCollisionID id = 0;
+	cpFloat target = -0.5f*tolerance;
+	
+	cpFloat t = 0.0f, toi = INFINITY;
+	for(int i=0; ; i++){
+		ShapeSweepPose(a, cpBodySweepTransform(bodyA, t, dt));
+		ShapeSweepPose(b, cpBodySweepTransform(bodyB, t, dt));
+		
+		struct ClosestPoints points = GJK(&context, rsum, &id);
+		cpFloat gap = points.d - rsum;
+		
+		// Shapes that start out overlapping may only sink a little deeper than they already are.
+		if(i == 0) target = cpfmin(target, gap - tolerance);
+		
+		// Every step so far was safe, so running out of iterations stops the shapes short of the impact.
+		if(gap <= target + 0.25f*tolerance || i == MAX_TOI_ITERATIONS){
+			toi = t;
+			break;
+		}
+		
+		cpFloat speed = cpfabs(cpvdot(delta, points.n)) + spin;
+		if(speed <= 0.0f) break;
+		
+		t += (gap - target)/speed;
+		if(t > 1.0f) break;
+	}
+	
+	ShapeSweepPose(a, bodyA->transform);
+	ShapeSweepPose(b, bodyB->transform);
+	
+	return toi;
+}
+
+struct cpCollisionInfo
+cpCollideAt(const cpShape *a, const cpShape *b, cpFloat t, cpFloat dt, cpCollisionID id, struct cpContact *contacts)
+{
+	ShapeSweepPose(a, cpBodySweepTransform(a->body, t, dt));
+	ShapeSweepPose(b, cpBodySweepTransform(b->body, t, dt));
+	
+	struct cpCollisionInfo info = cpCollide(a, b, id, contacts);
+	
+	ShapeSweepPose(a, a->body->transform);
+	ShapeSweepPose(b, b->body->transform);
+	
+	return info;
+}
@@ -0,0 +1,167 @@
+#include <math.h>
+
+#include "chipmunk/chipmunk.h"
+#include "chipmunk/cpFixed.h"
+
+// The kernels work internally on 64 bit integers with 30 fractional bits (Q30).
+// The work is done with integer operations, so results are bit-exact on every platform.
+
+#define Q30_PI ((int64_t)3373259426)
+#define Q30_HALF_PI ((int64_t)1686629713)
+
+// Reciprocal of the CORDIC gain.
+#define CORDIC_K ((int64_t)652032874)
+#define CORDIC_ITERATIONS 30
+
+// atan(2^-i) in Q30.
+static const int64_t CordicAngles[CORDIC_ITERATIONS] = {
+	843314857, 497837829, 263043837, 133525159, 67021687, 33543516, 16775851, 8388437,
+	4194283, 2097149, 1048576, 524288, 262144, 131072, 65536, 32768,
+	16384, 8192, 4096, 2048, 1024, 512, 256, 128,
+	64, 32, 16, 8, 4, 2,
+};
+
+static uint64_t
+ISqrt64(uint64_t v)
+{
+	uint64_t result = 0;
+	uint64_t bit = (uint64_t)1 << 62;
+	while(bit > v) bit >>= 2;
+
+	while(bit){
+		if(v >= result + bit){
+			v -= result + bit;
+			result = (result >> 1) + bit;
+		} else {
+			result >>= 1;
+		}
+		bit >>= 2;
+	}
+
+	return result;
+}
+
+// Wrap a Q30 angle into [-pi, pi].
+static int64_t
+ReduceAngle(int64_t a)
+{
+	a %= 2*Q30_PI;
+	if(a > Q30_PI) a -= 2*Q30_PI;
+	if(a < -Q30_PI) a += 2*Q30_PI;
+	return a;
+}
+
+// CORDIC rotation mode. Returns sin and cos of a Q30 angle in Q30.
+static void
+SinCos(int64_t a, int64_t *s, int64_t *c)
+{
+	a = ReduceAngle(a);
+
+	// CORDIC only converges for |a| <= pi/2.
+	int64_t sign = 1;
+	if(a > Q30_HALF_PI){
+		a -= Q30_PI;
+		sign = -1;
+	} else if(a < -Q30_HALF_PI){
+		a += Q30_PI;
+		sign = -1;
+	}
+
+	int64_t x = CORDIC_K, y = 0;
+	for(int i = 0; i < CORDIC_ITERATIONS; i++){
+		int64_t dx = y >> i, dy = x >> i;
+		if(a >= 0){
+			x -= dx; y += dy; a -= CordicAngles[i];
+		} else {
+			x += dx; y -= dy; a += CordicAngles[i];
+		}
+	}
+
+	*s = sign*y;
+	*c = sign*x;
+}
+
+// CORDIC vectoring mode. Returns the Q30 angle of (x, y).
+// The inputs must already be scaled so their magnitude is below 2^60.
+static int64_t
+Atan2(int64_t y, int64_t x)
+{
+	if(x == 0 && y == 0) return 0;
+
+	// Rotate into the right half plane.
+	int64_t a = 0;
+	if(x < 0){
+		a = (y >= 0 ? Q30_PI : -Q30_PI);
+		x = -x; y = -y;
+	}
+
+	for(int i = 0; i < CORDIC_ITERATIONS; i++){
+		int64_t dx = y >> i, dy = x >> i;
+		if(y > 0){
+			x += dx; y -= dy; a += CordicAngles[i];
+		} else {
+			x -= dx; y += dy; a -= CordicAngles[i];
+		}
+	}
+
+	return a;
+}
+
+//MARK: cpFloat Kernels
+
+// These take and return cpFloats so they can stand in for the libm functions.
+// frexp() and ldexp() are exact, so the conversions don't add any rounding of their own.
+
+static inline int64_t
+FloatToQ30(cpFloat f)
+{
+	return (int64_t)ldexp(f, 30);
+}
+
+static inline cpFloat
+Q30ToFloat(int64_t v)
+{
+	return (cpFloat)ldexp((double)v, -30);
+}
+
+cpFloat
+cpFixedKernelSqrt(cpFloat x)
+{
+	if(!(x > 0.0f)) return 0.0f;
+
+	// Split into a mantissa in [0.5, 2) and an even exponent.
+	int e;
+	double m = frexp(x, &e);
+	if(e & 1){
+		m = ldexp(m, 1);
+		e -= 1;
+	}
+
+	uint64_t root = ISqrt64((uint64_t)ldexp(m, 60));
+	return (cpFloat)ldexp((double)root, e/2 - 30);
+}
+
+cpFloat
+cpFixedKernelSin(cpFloat angle)
+{
+	int64_t s, c;
+	SinCos(ReduceAngle(FloatToQ30(cpfmod(angle, 2.0f*CP_PI))), &s, &c);
+	return Q30ToFloat(s);
+}
+
+cpFloat
+cpFixedKernelCos(cpFloat angle)
+{
+	int64_t s, c;
+	SinCos(ReduceAngle(FloatToQ30(cpfmod(angle, 2.0f*CP_PI))), &s, &c);
+	return Q30ToFloat(c);
+}
+
+cpFloat
+cpFixedKernelAtan2(cpFloat y, cpFloat x)
+{
+	// Scale both components by the same power of two so the larger one is around 2^56.
+	int e;
+	frexp(cpfmax(cpfabs(x), cpfabs(y)), &e);
+	return Q30ToFloat(Atan2((int64_t)ldexp(y, 56 - e), (int64_t)ldexp(x, 56 - e)));
+}
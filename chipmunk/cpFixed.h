@@ -0,0 +1,20 @@
+#ifndef CHIPMUNK_FIXED_H
+#define CHIPMUNK_FIXED_H
+
+#include "chipmunk_types.h"
+
+/// @defgroup cpFixed cpFixed
+/// Integer kernels for the cpFloat math functions.
+/// They compute in 64 bit fixed point, and their conversions in and out are exact, so their results are bit-exact
+/// on the host and on the N64.
+/// Define CP_USE_FIXED_KERNELS=1 to route cpfsqrt(), cpfsin(), cpfcos() and cpfatan2() through them.
+/// @{
+
+CP_EXPORT cpFloat cpFixedKernelSqrt(cpFloat x);
+CP_EXPORT cpFloat cpFixedKernelSin(cpFloat angle);
+CP_EXPORT cpFloat cpFixedKernelCos(cpFloat angle);
+CP_EXPORT cpFloat cpFixedKernelAtan2(cpFloat y, cpFloat x);
+
+/// @}
+
+#endif
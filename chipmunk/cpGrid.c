@@ -0,0 +1,503 @@
+#include <string.h>
+
+#include "chipmunk/chipmunk_private.h"
+
+static inline cpSpatialIndexClass *Klass(void);
+
+// A dense uniform grid over fixed world bounds.
+// Cells are indexed directly from their coordinates, and the grid is rebuilt from scratch by a counting sort
+// so the objects in each cell end up packed next to each other.
+// Objects that stick out of the bounds are kept in the edge cells and on an overflow list for segment queries.
+
+//MARK: Basic Structures
+
+typedef struct GridHandle {
+	void *obj;
+	cpBB bb;
+	cpTimestamp stamp;
+	// Position in the grid's list of handles.
+	int index;
+} GridHandle;
+
+struct cpGrid {
+	cpSpatialIndex spatialIndex;
+
+	cpBB bounds;
+	cpFloat celldim, inv_celldim;
+	int cols, rows;
+
+	// Handles in insertion order. Removal swaps the last handle into the hole.
+	int num, max;
+	GridHandle **handles;
+	// Finds an object's handle from its hashid.
+	cpHashSet *handleSet;
+
+	// The objects in cell i are cellItems[cellStart[i]] .. cellItems[cellStart[i + 1] - 1].
+	int *cellStart;
+	GridHandle **cellItems;
+	int maxItems;
+
+	GridHandle **overflow;
+	int numOverflow;
+
+	cpArray *pooledHandles;
+	// The handle pool and the arrays above are allocated with cpBufferAlloc().
+	cpArray *allocatedBuffers;
+
+	// Set when objects were added or removed since the last rebuild.
+	cpBool dirty;
+	cpTimestamp stamp;
+};
+
+static inline int
+CellX(cpGrid *grid, cpFloat x)
+{
+	cpFloat f = (x - grid->bounds.l)*grid->inv_celldim;
+	return (f <= 0.0f ? 0 : (f >= grid->cols ? grid->cols - 1 : (int)f));
+}
+
+static inline int
+CellY(cpGrid *grid, cpFloat y)
+{
+	cpFloat f = (y - grid->bounds.b)*grid->inv_celldim;
+	return (f <= 0.0f ? 0 : (f >= grid->rows ? grid->rows - 1 : (int)f));
+}
+
+//MARK: Memory Management Functions
+
+cpGrid *
+cpGridAlloc(void)
+{
+	return (cpGrid *)cpcalloc(1, sizeof(cpGrid));
+}
+
+// The arrays grow by copying into a new buffer twice the size.
+// The old buffers are given back with the rest when the grid is destroyed.
+static void *
+GrowArray(cpGrid *grid, void *arr, int count, int size, size_t bytes)
+{
+	void *buffer = cpBufferAlloc(grid->spatialIndex.arena, grid->allocatedBuffers, size*bytes);
+	if(count) memcpy(buffer, arr, count*bytes);
+	
+	return buffer;
+}
+
+static void
+ResizeHandles(cpGrid *grid, int size)
+{
+	grid->handles = (GridHandle **)GrowArray(grid, grid->handles, grid->num, size, sizeof(GridHandle *));
+	grid->overflow = (GridHandle **)GrowArray(grid, grid->overflow, grid->numOverflow, size, sizeof(GridHandle *));
+	grid->max = size;
+}
+
+static int handleSetEql(void *obj, GridHandle *handle){return (obj == handle->obj);}
+
+static void *
+handleSetTrans(void *obj, cpGrid *grid)
+{
+	if(grid->pooledHandles->num == 0){
+		// handle pool is exhausted, make more
+		int count = CP_BUFFER_BYTES/sizeof(GridHandle);
+		cpAssertHard(count, "Internal Error: Buffer size is too small.");
+		
+		GridHandle *buffer = (GridHandle *)cpBufferAlloc(grid->spatialIndex.arena, grid->allocatedBuffers, CP_BUFFER_BYTES);
+		for(int i=0; i<count; i++) cpArrayPush(grid->pooledHandles, buffer + i);
+	}
+	
+	if(grid->num == grid->max) ResizeHandles(grid, grid->max ? grid->max*2 : 32);
+	
+	GridHandle *handle = (GridHandle *)cpArrayPop(grid->pooledHandles);
+	handle->obj = obj;
+	handle->bb = grid->spatialIndex.bbfunc(obj);
+	handle->stamp = 0;
+	handle->index = grid->num;
+	
+	grid->handles[grid->num++] = handle;
+	return handle;
+}
+
+cpSpatialIndex *
+cpGridInit(cpGrid *grid, cpBB bounds, cpFloat celldim, cpSpatialIndexBBFunc bbfunc, cpSpatialIndex *staticIndex)
+{
+	cpAssertHard(bounds.l < bounds.r && bounds.b < bounds.t, "Grid bounds must not be empty.");
+	cpAssertHard(celldim > 0.0f, "Grid cell size must be positive.");
+
+	cpSpatialIndexInit((cpSpatialIndex *)grid, Klass(), bbfunc, staticIndex);
+
+	grid->bounds = bounds;
+	grid->celldim = celldim;
+	grid->inv_celldim = 1.0f/celldim;
+	grid->cols = (int)cpfceil((bounds.r - bounds.l)/celldim);
+	grid->rows = (int)cpfceil((bounds.t - bounds.b)/celldim);
+
+	// Nothing is allocated until it's needed, since the space sets the arena after creating the grid.
+	grid->num = grid->max = 0;
+	grid->handles = NULL;
+	grid->handleSet = cpHashSetNew(0, (cpHashSetEqlFunc)handleSetEql);
+
+	grid->cellStart = NULL;
+	grid->cellItems = NULL;
+	grid->maxItems = 0;
+	grid->overflow = NULL;
+	grid->numOverflow = 0;
+
+	grid->pooledHandles = cpArrayNew(0);
+	grid->allocatedBuffers = cpArrayNew(0);
+
+	grid->dirty = cpTrue;
+	grid->stamp = 1;
+
+	return (cpSpatialIndex *)grid;
+}
+
+cpSpatialIndex *
+cpGridNew(cpBB bounds, cpFloat celldim, cpSpatialIndexBBFunc bbfunc, cpSpatialIndex *staticIndex)
+{
+	return cpGridInit(cpGridAlloc(), bounds, celldim, bbfunc, staticIndex);
+}
+
+static void
+cpGridDestroy(cpGrid *grid)
+{
+	cpHashSetFree(grid->handleSet);
+
+	cpBufferFreeAll(grid->spatialIndex.arena, grid->allocatedBuffers);
+	cpArrayFree(grid->allocatedBuffers);
+	cpArrayFree(grid->pooledHandles);
+
+	grid->handleSet = NULL;
+	grid->handles = NULL;
+	grid->overflow = NULL;
+	grid->cellStart = NULL;
+	grid->cellItems = NULL;
+}
+
+//MARK: Rebuilding
+
+static void
+Rebuild(cpGrid *grid)
+{
+	int cells = grid->cols*grid->rows;
+	// At least four entries, the smallest buffer the arena can take back.
+	if(!grid->cellStart) grid->cellStart = (int *)GrowArray(grid, NULL, 0, (cells + 1 > 4 ? cells + 1 : 4), sizeof(int));
+
+	int *cellStart = grid->cellStart;
+	GridHandle **handles = grid->handles;
+
+	// Count the objects in each cell.
+	for(int i=0; i<cells; i++) cellStart[i] = 0;
+
+	int total = 0;
+	grid->numOverflow = 0;
+	for(int i=0, count=grid->num; i<count; i++){
+		cpBB bb = handles[i]->bb;
+		int l = CellX(grid, bb.l), r = CellX(grid, bb.r);
+		int b = CellY(grid, bb.b), t = CellY(grid, bb.t);
+
+		for(int y=b; y<=t; y++){
+			for(int x=l; x<=r; x++) cellStart[y*grid->cols + x]++;
+		}
+
+		total += (r - l + 1)*(t - b + 1);
+		if(!cpBBContainsBB(grid->bounds, bb)) grid->overflow[grid->numOverflow++] = handles[i];
+	}
+
+	if(total > grid->maxItems){
+		int size = (grid->maxItems ? grid->maxItems : 64);
+		while(size < total) size *= 2;
+
+		// The items are all rewritten below, so there's nothing to copy.
+		grid->cellItems = (GridHandle **)GrowArray(grid, NULL, 0, size, sizeof(GridHandle *));
+		grid->maxItems = size;
+	}
+
+	// Turn the counts into the end of each cell's range, then fill the ranges back to front.
+	for(int i=1; i<cells; i++) cellStart[i] += cellStart[i - 1];
+	cellStart[cells] = total;
+
+	GridHandle **cellItems = grid->cellItems;
+	for(int i=grid->num - 1; i>=0; i--){
+		cpBB bb = handles[i]->bb;
+		int l = CellX(grid, bb.l), r = CellX(grid, bb.r);
+		int b = CellY(grid, bb.b), t = CellY(grid, bb.t);
+
+		for(int y=b; y<=t; y++){
+			for(int x=l; x<=r; x++) cellItems[--cellStart[y*grid->cols + x]] = handles[i];
+		}
+	}
+
+	grid->dirty = cpFalse;
+}
+
+static inline void
+UpdateIfDirty(cpGrid *grid)
+{
+	if(grid->dirty) Rebuild(grid);
+}
+
+//MARK: Misc
+
+static int
+cpGridCount(cpGrid *grid)
+{
+	return grid->num;
+}
+
+static void
+cpGridEach(cpGrid *grid, cpSpatialIndexIteratorFunc func, void *data)
+{
+	GridHandle **handles = grid->handles;
+	for(int i=0, count=grid->num; i<count; i++) func(handles[i]->obj, data);
+}
+
+static int
+cpGridContains(cpGrid *grid, void *obj, cpHashValue hashid)
+{
+	return cpHashSetFind(grid->handleSet, hashid, obj) != NULL;
+}
+
+//MARK: Basic Operations
+
+static void
+cpGridInsert(cpGrid *grid, void *obj, cpHashValue hashid)
+{
+	cpHashSetInsert(grid->handleSet, hashid, obj, (cpHashSetTransFunc)handleSetTrans, grid);
+	grid->dirty = cpTrue;
+}
+
+static void
+cpGridRemove(cpGrid *grid, void *obj, cpHashValue hashid)
+{
+	GridHandle *handle = (GridHandle *)cpHashSetRemove(grid->handleSet, hashid, obj);
+
+	if(handle){
+		GridHandle *last = grid->handles[--grid->num];
+		grid->handles[handle->index] = last;
+		last->index = handle->index;
+
+		cpArrayPush(grid->pooledHandles, handle);
+		grid->dirty = cpTrue;
+	}
+}
+
+static cpBool
+handleClear(GridHandle *handle, cpGrid *grid)
+{
+	cpArrayPush(grid->pooledHandles, handle);
+	return cpFalse;
+}
+
+static void
+cpGridClear(cpGrid *grid)
+{
+	cpHashSetFilter(grid->handleSet, (cpHashSetFilterFunc)handleClear, grid);
+
+	grid->num = 0;
+	grid->numOverflow = 0;
+	grid->dirty = cpTrue;
+	grid->stamp = 1;
+}
+
+//MARK: Reindexing Functions
+
+static void
+cpGridReindexObject(cpGrid *grid, void *obj, cpHashValue hashid)
+{
+	GridHandle *handle = (GridHandle *)cpHashSetFind(grid->handleSet, hashid, obj);
+
+	if(handle){
+		handle->bb = grid->spatialIndex.bbfunc(obj);
+		grid->dirty = cpTrue;
+	}
+}
+
+static void
+cpGridReindex(cpGrid *grid)
+{
+	GridHandle **handles = grid->handles;
+	cpSpatialIndexBBFunc bbfunc = grid->spatialIndex.bbfunc;
+	for(int i=0, count=grid->num; i<count; i++) handles[i]->bb = bbfunc(handles[i]->obj);
+
+	Rebuild(grid);
+}
+
+//MARK: Query Functions
+
+// An overlapping pair is only reported from the cell holding the lower left corner of the overlap,
+// so objects spanning several cells aren't reported more than once.
+static inline cpBool
+OwnsOverlap(cpGrid *grid, int x, int y, cpBB a, cpBB b)
+{
+	return (CellX(grid, cpfmax(a.l, b.l)) == x && CellY(grid, cpfmax(a.b, b.b)) == y);
+}
+
+static void
+cpGridQuery(cpGrid *grid, void *obj, cpBB bb, cpSpatialIndexQueryFunc func, void *data)
+{
+	UpdateIfDirty(grid);
+
+	int l = CellX(grid, bb.l), r = CellX(grid, bb.r);
+	int b = CellY(grid, bb.b), t = CellY(grid, bb.t);
+
+	int *cellStart = grid->cellStart;
+	GridHandle **cellItems = grid->cellItems;
+
+	for(int y=b; y<=t; y++){
+		for(int x=l; x<=r; x++){
+			int cell = y*grid->cols + x;
+			for(int i=cellStart[cell], end=cellStart[cell + 1]; i<end; i++){
+				GridHandle *handle = cellItems[i];
+				if(handle->obj != obj && cpBBIntersects(bb, handle->bb) && OwnsOverlap(grid, x, y, bb, handle->bb)){
+					func(obj, handle->obj, 0, data);
+				}
+			}
+		}
+	}
+}
+
+static inline cpFloat
+SegmentQueryHandle(cpGrid *grid, GridHandle *handle, void *obj, cpVect a, cpVect b, cpFloat t_exit, cpSpatialIndexSegmentQueryFunc func, void *data)
+{
+	if(handle->stamp != grid->stamp && cpBBSegmentQuery(handle->bb, a, b) < t_exit){
+		handle->stamp = grid->stamp;
+		return cpfmin(t_exit, func(obj, handle->obj, data));
+	} else {
+		return t_exit;
+	}
+}
+
+// Clip the segment to the grid bounds. Returns false if it misses them completely.
+static cpBool
+ClipSegment(cpBB bb, cpVect a, cpVect b, cpFloat *t0, cpFloat *t1)
+{
+	cpVect delta = cpvsub(b, a);
+	cpFloat tmin = 0.0f, tmax = 1.0f;
+
+	if(delta.x == 0.0f){
+		if(a.x < bb.l || bb.r < a.x) return cpFalse;
+	} else {
+		cpFloat tl = (bb.l - a.x)/delta.x, tr = (bb.r - a.x)/delta.x;
+		tmin = cpfmax(tmin, cpfmin(tl, tr));
+		tmax = cpfmin(tmax, cpfmax(tl, tr));
+	}
+
+	if(delta.y == 0.0f){
+		if(a.y < bb.b || bb.t < a.y) return cpFalse;
+	} else {
+		cpFloat tb = (bb.b - a.y)/delta.y, tt = (bb.t - a.y)/delta.y;
+		tmin = cpfmax(tmin, cpfmin(tb, tt));
+		tmax = cpfmin(tmax, cpfmax(tb, tt));
+	}
+
+	(*t0) = tmin;
+	(*t1) = tmax;
+	return (tmin <= tmax);
+}
+
+static void
+cpGridSegmentQuery(cpGrid *grid, void *obj, cpVect a, cpVect b, cpFloat t_exit, cpSpatialIndexSegmentQueryFunc func, void *data)
+{
+	UpdateIfDirty(grid);
+	grid->stamp++;
+
+	int *cellStart = grid->cellStart;
+	GridHandle **cellItems = grid->cellItems;
+
+	cpFloat t0, t1;
+	cpBool inside = ClipSegment(grid->bounds, a, b, &t0, &t1);
+
+	// Objects sticking out of the grid can be hit by the parts of the segment outside of it.
+	if(!inside || t0 > 0.0f || t1 < 1.0f){
+		for(int i=0; i<grid->numOverflow; i++){
+			t_exit = SegmentQueryHandle(grid, grid->overflow[i], obj, a, b, t_exit, func, data);
+		}
+	}
+
+	if(!inside) return;
+
+	// Walk the cells along the clipped segment, as in cpSpaceHashSegmentQuery().
+	cpFloat dim = grid->celldim;
+	cpVect start = cpvlerp(a, b, t0);
+	int cell_x = CellX(grid, start.x), cell_y = CellY(grid, start.y);
+
+	cpFloat dx = cpfabs(b.x - a.x)/dim, dy = cpfabs(b.y - a.y)/dim;
+	cpFloat dt_dx = (dx ? 1.0f/dx : INFINITY), dt_dy = (dy ? 1.0f/dy : INFINITY);
+
+	int x_inc = (b.x > a.x ? 1 : -1), y_inc = (b.y > a.y ? 1 : -1);
+	cpFloat cx = (start.x - grid->bounds.l)/dim - cell_x, cy = (start.y - grid->bounds.b)/dim - cell_y;
+	cpFloat next_h = (dx ? t0 + (x_inc > 0 ? 1.0f - cx : cx)*dt_dx : INFINITY);
+	cpFloat next_v = (dy ? t0 + (y_inc > 0 ? 1.0f - cy : cy)*dt_dy : INFINITY);
+
+	cpFloat t = t0;
+	while(t <= t1 && t < t_exit){
+		int cell = cell_y*grid->cols + cell_x;
+		for(int i=cellStart[cell], end=cellStart[cell + 1]; i<end; i++){
+			t_exit = SegmentQueryHandle(grid, cellItems[i], obj, a, b, t_exit, func, data);
+		}
+
+		if(next_v < next_h){
+			cell_y += y_inc;
+			t = next_v;
+			next_v += dt_dy;
+		} else {
+			cell_x += x_inc;
+			t = next_h;
+			next_h += dt_dx;
+		}
+
+		if(cell_x < 0 || cell_x >= grid->cols || cell_y < 0 || cell_y >= grid->rows) break;
+	}
+}
+
+//MARK: Reindex/Query
+
+static void
+cpGridReindexQuery(cpGrid *grid, cpSpatialIndexQueryFunc func, void *data)
+{
+	cpGridReindex(grid);
+
+	int *cellStart = grid->cellStart;
+	GridHandle **cellItems = grid->cellItems;
+
+	for(int y=0; y<grid->rows; y++){
+		for(int x=0; x<grid->cols; x++){
+			int cell = y*grid->cols + x;
+
+			for(int i=cellStart[cell], end=cellStart[cell + 1]; i<end; i++){
+				GridHandle *a = cellItems[i];
+
+				for(int j=i+1; j<end; j++){
+					GridHandle *b = cellItems[j];
+					if(cpBBIntersects(a->bb, b->bb) && OwnsOverlap(grid, x, y, a->bb, b->bb)) func(a->obj, b->obj, 0, data);
+				}
+			}
+		}
+	}
+
+	cpSpatialIndexCollideStatic((cpSpatialIndex *)grid, grid->spatialIndex.staticIndex, func, data);
+}
+
+static cpSpatialIndexClass klass = {
+	(cpSpatialIndexDestroyImpl)cpGridDestroy,
+
+	(cpSpatialIndexCountImpl)cpGridCount,
+	(cpSpatialIndexEachImpl)cpGridEach,
+	(cpSpatialIndexContainsImpl)cpGridContains,
+
+	(cpSpatialIndexInsertImpl)cpGridInsert,
+	(cpSpatialIndexRemoveImpl)cpGridRemove,
+
+	(cpSpatialIndexReindexImpl)cpGridReindex,
+	(cpSpatialIndexReindexObjectImpl)cpGridReindexObject,
+	(cpSpatialIndexReindexQueryImpl)cpGridReindexQuery,
+
+	(cpSpatialIndexQueryImpl)cpGridQuery,
+	(cpSpatialIndexSegmentQueryImpl)cpGridSegmentQuery,
+	
+	NULL,
+	NULL,
+	
+	(cpSpatialIndexClearImpl)cpGridClear,
+};
+
+static inline cpSpatialIndexClass *Klass(){return &klass;}
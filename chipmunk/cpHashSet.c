@@ -20,35 +20,91 @@
  */
 
 #include "chipmunk/chipmunk_private.h"
-#include "prime.h"
 
-typedef struct cpHashSetBin {
-	void *elt;
+// Open addressing with Robin Hood probing. Each slot holds an element and its full hash, so lookups compare hashes
+// in the table and only call the equality function (which dereferences the element) when the hash matches.
+// Removal shifts the following slots of the cluster back instead of leaving tombstones.
+
+// Grow the table when it's this full. Fuller tables make lookups probe more slots than chained bins would walk.
+#define MAX_LOAD_NUM 5
+#define MAX_LOAD_DEN 8
+#define MIN_SLOTS 8
+
+typedef struct cpHashSetSlot {
 	cpHashValue hash;
-	struct cpHashSetBin *next;
-} cpHashSetBin;
+	// NULL for an empty slot.
+	void *elt;
+} cpHashSetSlot;
 
 struct cpHashSet {
-	unsigned int entries, size;
+	unsigned int entries, capacity;
+	unsigned int mask, shift;
 	
 	cpHashSetEqlFunc eql;
 	void *default_value;
 	
-	cpHashSetBin **table;
-	cpHashSetBin *pooledBins;
+	cpHashSetSlot *slots;
 	
-	cpArray *allocatedBuffers;
+	cpArena *arena;
 };
 
+// Fibonacci hashing, so sequential hashes (shape ids) spread out and the slot uses the well mixed high bits.
+static inline unsigned int
+HomeSlot(cpHashSet *set, cpHashValue hash)
+{
+	return (unsigned int)(((uint32_t)hash*2654435769u) >> set->shift);
+}
+
+static inline unsigned int
+ProbeDistance(cpHashSet *set, cpHashValue hash, unsigned int slot)
+{
+	return (slot - HomeSlot(set, hash))&set->mask;
+}
+
+// Put an element into the table, displacing elements that are closer to their home slot.
+static void
+PlaceSlot(cpHashSet *set, cpHashSetSlot slot)
+{
+	cpHashSetSlot *slots = set->slots;
+	unsigned int mask = set->mask;
+	
+	for(unsigned int i = HomeSlot(set, slot.hash), dist = 0;; i = (i + 1)&mask, dist++){
+		if(slots[i].elt == NULL){
+			slots[i] = slot;
+			return;
+		}
+		
+		unsigned int d = ProbeDistance(set, slots[i].hash, i);
+		if(d < dist){
+			cpHashSetSlot tmp = slots[i];
+			slots[i] = slot;
+			slot = tmp;
+			dist = d;
+		}
+	}
+}
+
+// Remove the element in slot 'i' and shift the rest of its cluster back.
+static void
+RemoveSlot(cpHashSet *set, unsigned int i)
+{
+	cpHashSetSlot *slots = set->slots;
+	unsigned int mask = set->mask;
+	
+	for(unsigned int j = (i + 1)&mask; slots[j].elt && ProbeDistance(set, slots[j].hash, j) > 0; i = j, j = (j + 1)&mask){
+		slots[i] = slots[j];
+	}
+	
+	slots[i].elt = NULL;
+	set->entries--;
+}
+
 void
 cpHashSetFree(cpHashSet *set)
 {
 	if(set){
-		cpfree(set->table);
-		
-		cpArrayFreeEach(set->allocatedBuffers, cpfree);
-		cpArrayFree(set->allocatedBuffers);
-		
+		// Arena memory is released with the arena.
+		if(!set->arena) cpfree(set->slots);
 		cpfree(set);
 	}
 }
@@ -58,16 +114,19 @@ cpHashSetNew(int size, cpHashSetEqlFunc eqlFunc)
 {
 	cpHashSet *set = (cpHashSet *)cpcalloc(1, sizeof(cpHashSet));
 	
-	set->size = next_prime(size);
 	set->entries = 0;
 	
 	set->eql = eqlFunc;
 	set->default_value = NULL;
 	
-	set->table = (cpHashSetBin **)cpcalloc(set->size, sizeof(cpHashSetBin *));
-	set->pooledBins = NULL;
+	// The table is allocated by the first insert.
+	unsigned int slotCount = MIN_SLOTS;
+	while(slotCount/MAX_LOAD_DEN*MAX_LOAD_NUM < (unsigned int)size) slotCount *= 2;
+	set->mask = slotCount - 1;
+	set->capacity = 0;
+	set->slots = NULL;
 	
-	set->allocatedBuffers = cpArrayNew(0);
+	set->arena = NULL;
 	
 	return set;
 }
@@ -78,152 +137,132 @@ cpHashSetSetDefaultValue(cpHashSet *set, void *default_value)
 	set->default_value = default_value;
 }
 
-static int
-setIsFull(cpHashSet *set)
+void
+cpHashSetSetArena(cpHashSet *set, cpArena *arena)
 {
-	return (set->entries >= set->size);
+	cpAssertHard(set->slots == NULL, "Internal Error: The arena must be set before the hash set is used.");
+	
+	// Tables the set outgrows stay in the arena until it's destroyed.
+	// That's less memory than the final table since they double in size.
+	set->arena = arena;
 }
 
 static void
 cpHashSetResize(cpHashSet *set)
 {
-	// Get the next approximate doubled prime.
-	unsigned int newSize = next_prime(set->size + 1);
-	// Allocate a new table.
-	cpHashSetBin **newTable = (cpHashSetBin **)cpcalloc(newSize, sizeof(cpHashSetBin *));
-	
-	// Iterate over the chains.
-	for(unsigned int i=0; i<set->size; i++){
-		// Rehash the bins into the new table.
-		cpHashSetBin *bin = set->table[i];
-		while(bin){
-			cpHashSetBin *next = bin->next;
-			
-			cpHashValue idx = bin->hash%newSize;
-			bin->next = newTable[idx];
-			newTable[idx] = bin;
-			
-			bin = next;
-		}
-	}
+	cpHashSetSlot *oldSlots = set->slots;
+	unsigned int oldCount = (oldSlots ? set->mask + 1 : 0);
+	unsigned int slotCount = (oldSlots ? 2*oldCount : set->mask + 1);
+	
+	unsigned int bits = 0;
+	while((1u << bits) < slotCount) bits++;
+	
+	set->mask = slotCount - 1;
+	set->shift = 32 - bits;
+	set->capacity = slotCount/MAX_LOAD_DEN*MAX_LOAD_NUM;
 	
-	cpfree(set->table);
+	// Zeroed memory is a table of empty slots.
+	size_t bytes = slotCount*sizeof(cpHashSetSlot);
+	set->slots = (cpHashSetSlot *)(set->arena ? cpArenaAlloc(set->arena, bytes) : cpcalloc(1, bytes));
 	
-	set->table = newTable;
-	set->size = newSize;
+	for(unsigned int i=0; i<oldCount; i++){
+		if(oldSlots[i].elt) PlaceSlot(set, oldSlots[i]);
+	}
+	
+	if(!set->arena) cpfree(oldSlots);
 }
 
-static inline void
-recycleBin(cpHashSet *set, cpHashSetBin *bin)
+int
+cpHashSetCount(cpHashSet *set)
 {
-	bin->next = set->pooledBins;
-	set->pooledBins = bin;
-	bin->elt = NULL;
+	return set->entries;
 }
 
-static cpHashSetBin *
-getUnusedBin(cpHashSet *set)
+// Returns the slot of the element matching 'ptr', or -1.
+// Inlined, since a second call costs about as much as the lookup itself in a small table.
+static inline int
+FindSlot(cpHashSet *set, cpHashValue hash, const void *ptr)
 {
-	cpHashSetBin *bin = set->pooledBins;
+	if(set->entries == 0) return -1;
 	
-	if(bin){
-		set->pooledBins = bin->next;
-		return bin;
-	} else {
-		// Pool is exhausted, make more
-		int count = CP_BUFFER_BYTES/sizeof(cpHashSetBin);
-		cpAssertHard(count, "Internal Error: Buffer size is too small.");
+	cpHashSetSlot *slots = set->slots;
+	unsigned int mask = set->mask;
+	
+	for(unsigned int i = HomeSlot(set, hash), dist = 0;; i = (i + 1)&mask, dist++){
+		cpHashSetSlot *slot = slots + i;
 		
-		cpHashSetBin *buffer = (cpHashSetBin *)cpcalloc(1, CP_BUFFER_BYTES);
-		cpArrayPush(set->allocatedBuffers, buffer);
+		if(slot->elt == NULL) return -1;
+		if(slot->hash == hash && set->eql(ptr, slot->elt)) return (int)i;
 		
-		// push all but the first one, return it instead
-		for(int i=1; i<count; i++) recycleBin(set, buffer + i);
-		return buffer;
+		// Robin Hood order means the element would have been placed before a slot closer to its home.
+		if(ProbeDistance(set, slot->hash, i) < dist) return -1;
 	}
 }
 
-int
-cpHashSetCount(cpHashSet *set)
-{
-	return set->entries;
-}
-
 const void *
 cpHashSetInsert(cpHashSet *set, cpHashValue hash, const void *ptr, cpHashSetTransFunc trans, void *data)
 {
-	cpHashValue idx = hash%set->size;
+	int i = FindSlot(set, hash, ptr);
+	if(i >= 0) return set->slots[i].elt;
 	
-	// Find the bin with the matching element.
-	cpHashSetBin *bin = set->table[idx];
-	while(bin && !set->eql(ptr, bin->elt))
-		bin = bin->next;
+	// Create it.
+	void *elt = (trans ? trans(ptr, data) : data);
+	cpAssertSoft(elt, "Internal Error: Hash set elements can't be NULL.");
 	
-	// Create it if necessary.
-	if(!bin){
-		bin = getUnusedBin(set);
-		bin->hash = hash;
-		bin->elt = (trans ? trans(ptr, data) : data);
-		
-		bin->next = set->table[idx];
-		set->table[idx] = bin;
-		
-		set->entries++;
-		if(setIsFull(set)) cpHashSetResize(set);
-	}
+	if(set->entries == set->capacity) cpHashSetResize(set);
 	
-	return bin->elt;
+	cpHashSetSlot slot = {hash, elt};
+	PlaceSlot(set, slot);
+	set->entries++;
+	
+	return elt;
 }
 
 const void *
 cpHashSetRemove(cpHashSet *set, cpHashValue hash, const void *ptr)
 {
-	cpHashValue idx = hash%set->size;
+	int i = FindSlot(set, hash, ptr);
+	if(i < 0) return NULL;
 	
-	cpHashSetBin **prev_ptr = &set->table[idx];
-	cpHashSetBin *bin = set->table[idx];
+	const void *elt = set->slots[i].elt;
+	RemoveSlot(set, (unsigned int)i);
 	
-	// Find the bin
-	while(bin && !set->eql(ptr, bin->elt)){
-		prev_ptr = &bin->next;
-		bin = bin->next;
-	}
-	
-	// Remove it if it exists.
-	if(bin){
-		// Update the previous linked list pointer
-		(*prev_ptr) = bin->next;
-		set->entries--;
-		
-		const void *elt = bin->elt;
-		recycleBin(set, bin);
-		
-		return elt;
-	}
-	
-	return NULL;
+	return elt;
 }
 
 const void *
 cpHashSetFind(cpHashSet *set, cpHashValue hash, const void *ptr)
-{	
-	cpHashValue idx = hash%set->size;
-	cpHashSetBin *bin = set->table[idx];
-	while(bin && !set->eql(ptr, bin->elt))
-		bin = bin->next;
-		
-	return (bin ? bin->elt : set->default_value);
+{
+	int i = FindSlot(set, hash, ptr);
+	return (i >= 0 ? set->slots[i].elt : set->default_value);
+}
+
+// Removing an element shifts the rest of its cluster back, which moves unvisited elements into the slot.
+// Clusters never extend across an empty slot, so starting just after one visits every element exactly once.
+static inline unsigned int
+IterationStart(cpHashSet *set)
+{
+	unsigned int i = 0;
+	while(set->slots[i].elt) i++;
+	return (i + 1)&set->mask;
 }
 
 void
 cpHashSetEach(cpHashSet *set, cpHashSetIteratorFunc func, void *data)
 {
-	for(unsigned int i=0; i<set->size; i++){
-		cpHashSetBin *bin = set->table[i];
-		while(bin){
-			cpHashSetBin *next = bin->next;
-			func(bin->elt, data);
-			bin = next;
+	if(set->entries == 0) return;
+	
+	cpHashSetSlot *slots = set->slots;
+	unsigned int mask = set->mask;
+	
+	for(unsigned int i = IterationStart(set), n = 0; n <= mask;){
+		void *elt = slots[i].elt;
+		if(elt) func(elt, data);
+		
+		// Look at the slot again if the callback removed its element.
+		if(elt == NULL || slots[i].elt == elt){
+			i = (i + 1)&mask;
+			n++;
 		}
 	}
 }
@@ -231,23 +270,20 @@ cpHashSetEach(cpHashSet *set, cpHashSetIteratorFunc func, void *data)
 void
 cpHashSetFilter(cpHashSet *set, cpHashSetFilterFunc func, void *data)
 {
-	for(unsigned int i=0; i<set->size; i++){
-		// The rest works similarly to cpHashSetRemove() above.
-		cpHashSetBin **prev_ptr = &set->table[i];
-		cpHashSetBin *bin = set->table[i];
-		while(bin){
-			cpHashSetBin *next = bin->next;
-			
-			if(func(bin->elt, data)){
-				prev_ptr = &bin->next;
-			} else {
-				(*prev_ptr) = next;
-
-				set->entries--;
-				recycleBin(set, bin);
-			}
-			
-			bin = next;
+	if(set->entries == 0) return;
+	
+	cpHashSetSlot *slots = set->slots;
+	unsigned int mask = set->mask;
+	
+	for(unsigned int i = IterationStart(set), n = 0; n <= mask;){
+		void *elt = slots[i].elt;
+		
+		if(elt && !func(elt, data)){
+			// Look at the slot again since the rest of the cluster shifted into it.
+			RemoveSlot(set, i);
+		} else {
+			i = (i + 1)&mask;
+			n++;
 		}
 	}
 }
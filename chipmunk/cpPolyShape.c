@@ -144,6 +144,21 @@ cpPolyShapeSegmentQuery(cpPolyShape *poly, cpVect a, cpVect b, cpFloat r2, cpSeg
 	}
 }
 
+// A hull is a rectangle when its opposite normals are antiparallel and its adjacent normals are perpendicular.
+static cpBool
+IsBox(int count, const struct cpSplittingPlane *planes)
+{
+	if(count != 4) return cpFalse;
+	
+	for(int i=0; i<2; i++){
+		cpVect n = planes[i].n;
+		if(cpfabs(cpvdot(n, planes[i + 1].n)) > MAGIC_EPSILON) return cpFalse;
+		if(cpvdot(n, planes[i + 2].n) > MAGIC_EPSILON - 1.0f) return cpFalse;
+	}
+	
+	return cpTrue;
+}
+
 static void
 SetVerts(cpPolyShape *poly, int count, const cpVect *verts)
 {
@@ -162,6 +177,8 @@ SetVerts(cpPolyShape *poly, int count, const cpVect *verts)
 		poly->planes[i + count].v0 = b;
 		poly->planes[i + count].n = n;
 	}
+	
+	poly->isBox = IsBox(count, poly->planes + count);
 }
 
 static struct cpShapeMassInfo
@@ -137,7 +137,8 @@ cpPolylineSimplifyVertexes(cpPolyline *line, cpFloat tol)
 {
 	cpPolyline *reduced = cpPolylineMake2(0, line->verts[0], line->verts[1]);
 	
-	cpFloat minSharp = -cpfcos(tol);
+	// Allow for rounding so collinear vertexes are still joined in single precision builds.
+	cpFloat minSharp = -cpfcos(tol) + CP_COLLISION_EPSILON;
 	
 	for(int i=2; i<line->count; i++){
 		cpVect vert = line->verts[i];
@@ -186,7 +187,7 @@ DouglasPeucker(
 	cpFloat d = cpvdot(n, a);
 	
 	for(int i=Next(start, length); i!=end; i=Next(i, length)){
-		cpFloat dist = fabs(cpvdot(n, verts[i]) - d);
+		cpFloat dist = cpfabs(cpvdot(n, verts[i]) - d);
 		
 		if(dist > max){
 			max = dist;
@@ -1,13 +1,25 @@
+#include "chipmunk/chipmunk.h"
 #include "chipmunk/cpRobust.h"
 
+// With CP_USE_DOUBLE_PREDICATES the predicates are evaluated in double precision even in a single precision build.
+// That makes the products exact for float inputs, at the cost of double precision arithmetic in the narrow phase.
+#if CP_USE_DOUBLE_PREDICATES
+	typedef double cpRobustFloat;
+#else
+	typedef cpFloat cpRobustFloat;
+#endif
 
 cpBool
 cpCheckPointGreater(const cpVect a, const cpVect b, const cpVect c)
 {
-	return (b.y - a.y)*(a.x + b.x - 2*c.x) > (b.x - a.x)*(a.y + b.y - 2*c.y);
+	cpRobustFloat ax = a.x, ay = a.y, bx = b.x, by = b.y, cx = c.x, cy = c.y;
+	return (by - ay)*(ax + bx - 2*cx) > (bx - ax)*(ay + by - 2*cy);
 }
 
 cpBool
 cpCheckAxis(cpVect v0, cpVect v1, cpVect p, cpVect n){
-	return cpvdot(p, n) <= cpfmax(cpvdot(v0, n), cpvdot(v1, n));
+	cpRobustFloat d0 = (cpRobustFloat)v0.x*n.x + (cpRobustFloat)v0.y*n.y;
+	cpRobustFloat d1 = (cpRobustFloat)v1.x*n.x + (cpRobustFloat)v1.y*n.y;
+	cpRobustFloat dp = (cpRobustFloat)p.x*n.x + (cpRobustFloat)p.y*n.y;
+	return dp <= (d0 > d1 ? d0 : d1);
 }
@@ -37,6 +37,7 @@ cpShapeInit(cpShape *shape, const cpShapeClass *klass, cpBody *body, struct cpSh
 	shape->massInfo = massInfo;
 	
 	shape->sensor = 0;
+	shape->trigger = 0;
 	
 	shape->e = 0.0f;
 	shape->u = 0.0f;
@@ -128,6 +129,19 @@ cpShapeSetSensor(cpShape *shape, cpBool sensor)
 	shape->sensor = sensor;
 }
 
+cpBool
+cpShapeGetTrigger(const cpShape *shape)
+{
+	return shape->trigger;
+}
+
+void
+cpShapeSetTrigger(cpShape *shape, cpBool trigger)
+{
+	cpBodyActivate(shape->body);
+	shape->trigger = trigger;
+}
+
 cpFloat
 cpShapeGetElasticity(const cpShape *shape)
 {
@@ -128,6 +128,13 @@ CP_EXPORT cpBool cpShapeGetSensor(const cpShape *shape);
 /// Set if the shape is a sensor or not.
 CP_EXPORT void cpShapeSetSensor(cpShape *shape, cpBool sensor);
 
+/// Get if the shape is set to be a trigger or not.
+CP_EXPORT cpBool cpShapeGetTrigger(const cpShape *shape);
+/// Set if the shape is a trigger or not.
+/// Triggers never collide or make arbiters. Shapes overlapping a trigger are found with a boolean overlap test
+/// and reported to the triggerEnterFunc and triggerExitFunc of the collision handler for their collision types.
+CP_EXPORT void cpShapeSetTrigger(cpShape *shape, cpBool trigger);
+
 /// Get the elasticity of this shape.
 CP_EXPORT cpFloat cpShapeGetElasticity(const cpShape *shape);
 /// Set the elasticity of this shape.
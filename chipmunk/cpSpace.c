@@ -35,6 +35,16 @@ arbiterSetEql(cpShape **shapes, cpArbiter *arb)
 	return ((a == arb->a && b == arb->b) || (b == arb->a && a == arb->b));
 }
 
+// Equal function for triggerPairs.
+static cpBool
+triggerPairSetEql(cpShape **shapes, cpTriggerPair *pair)
+{
+	cpShape *a = shapes[0];
+	cpShape *b = shapes[1];
+	
+	return ((a == pair->a && b == pair->b) || (b == pair->a && a == pair->b));
+}
+
 //MARK: Collision Handler Set HelperFunctions
 
 // Equals function for collisionHandlers.
@@ -128,6 +138,16 @@ cpSpaceInit(cpSpace *space)
 #endif
 
 	space->iterations = 10;
+	space->substeps = 1;
+	space->useStepBudget = cpFalse;
+	space->lastStepTime = 0;
+	space->prevStepTime = CP_NO_STEP_TIME;
+#if CP_USE_STEP_PROFILE
+	space->profileClock = NULL;
+	space->profiles = NULL;
+	space->profileCapacity = space->profileCount = space->profileNext = 0;
+	space->profileMark = 0;
+#endif
 	
 	space->gravity = cpvzero;
 	space->damping = 1.0f;
@@ -139,12 +159,19 @@ cpSpaceInit(cpSpace *space)
 	space->locked = 0;
 	space->stamp = 0;
 	
+	space->allocator = cpSpaceAllocatorDefault;
+	cpArenaInit(&space->persistentArena, &space->allocator, space->allocator.persistentChunkBytes);
+	cpArenaInit(&space->scratchArena, &space->allocator, space->allocator.scratchChunkBytes);
+	
 	space->shapeIDCounter = 0;
 	space->staticShapes = cpBBTreeNew((cpSpatialIndexBBFunc)cpShapeGetBB, NULL);
 	space->dynamicShapes = cpBBTreeNew((cpSpatialIndexBBFunc)cpShapeGetBB, space->staticShapes);
+	space->staticShapes->arena = space->dynamicShapes->arena = &space->persistentArena;
 	cpBBTreeSetVelocityFunc(space->dynamicShapes, (cpBBTreeVelocityFunc)ShapeVelocityFunc);
-	
-	space->allocatedBuffers = cpArrayNew(0);
+	space->dynamicShapesType = CP_BROADPHASE_BBTREE;
+	space->spareDynamicShapes = NULL;
+	space->autoSelectBroadphase = cpFalse;
+	space->treeRebalanceBudget = 0;
 	
 	space->dynamicBodies = cpArrayNew(0);
 	space->staticBodies = cpArrayNew(0);
@@ -153,12 +180,28 @@ cpSpaceInit(cpSpace *space)
 	
 	space->sleepTimeThreshold = INFINITY;
 	space->idleSpeedThreshold = 0.0f;
+	space->awakeBodyCount = 0;
+	space->sleepingBodyCount = 0;
+	space->bodyIDCounter = 0;
 	
 	space->arbiters = cpArrayNew(0);
 	space->pooledArbiters = cpArrayNew(0);
+	space->pooledSleepingContacts = cpArrayNew(0);
+#if CP_USE_PACKED_SOLVER
+	space->solverArbiters = NULL;
+#endif
+#if CP_USE_THREADS
+	space->solverPool = NULL;
+#endif
 	
 	space->contactBuffersHead = NULL;
 	space->cachedArbiters = cpHashSetNew(0, (cpHashSetEqlFunc)arbiterSetEql);
+	cpHashSetSetArena(space->cachedArbiters, &space->persistentArena);
+	
+	space->triggerPairs = cpHashSetNew(0, (cpHashSetEqlFunc)triggerPairSetEql);
+	cpHashSetSetArena(space->triggerPairs, &space->persistentArena);
+	space->pooledTriggerPairs = cpArrayNew(0);
+	space->sweptPairs = cpArrayNew(0);
 	
 	space->constraints = cpArrayNew(0);
 	
@@ -167,6 +210,7 @@ cpSpaceInit(cpSpace *space)
 	space->collisionHandlers = cpHashSetNew(0, (cpHashSetEqlFunc)handlerSetEql);
 	
 	space->postStepCallbacks = cpArrayNew(0);
+	space->pooledPostStepCallbacks = cpArrayNew(0);
 	space->skipPostStep = cpFalse;
 	
 	cpBody *staticBody = cpBodyInit(&space->_staticBody, 0.0f, 0.0f);
@@ -191,6 +235,7 @@ cpSpaceDestroy(cpSpace *space)
 	
 	cpSpatialIndexFree(space->staticShapes);
 	cpSpatialIndexFree(space->dynamicShapes);
+	cpSpatialIndexFree(space->spareDynamicShapes);
 	
 	cpArrayFree(space->dynamicBodies);
 	cpArrayFree(space->staticBodies);
@@ -200,22 +245,37 @@ cpSpaceDestroy(cpSpace *space)
 	cpArrayFree(space->constraints);
 	
 	cpHashSetFree(space->cachedArbiters);
+	cpHashSetFree(space->triggerPairs);
+	cpArrayFree(space->pooledTriggerPairs);
+	cpArrayFree(space->sweptPairs);
 	
 	cpArrayFree(space->arbiters);
 	cpArrayFree(space->pooledArbiters);
+	cpArrayFree(space->pooledSleepingContacts);
+#if CP_USE_THREADS
+	cpSolverPoolFree(space->solverPool);
+#endif
 	
-	if(space->allocatedBuffers){
-		cpArrayFreeEach(space->allocatedBuffers, cpfree);
-		cpArrayFree(space->allocatedBuffers);
-	}
-	
-	if(space->postStepCallbacks){
-		cpArrayFreeEach(space->postStepCallbacks, cpfree);
-		cpArrayFree(space->postStepCallbacks);
-	}
+	// Post-step callbacks and sleeping contacts live in the persistent arena.
+	cpArrayFree(space->postStepCallbacks);
+	cpArrayFree(space->pooledPostStepCallbacks);
 	
 	if(space->collisionHandlers) cpHashSetEach(space->collisionHandlers, FreeWrap, NULL);
 	cpHashSetFree(space->collisionHandlers);
+	
+	cpArenaDestroy(&space->persistentArena);
+	cpArenaDestroy(&space->scratchArena);
+}
+
+void
+cpSpaceSetAllocator(cpSpace *space, const cpSpaceAllocator *allocator)
+{
+	cpAssertHard(space->persistentArena.chunks == NULL && space->scratchArena.chunks == NULL,
+		"The allocator must be set before any bodies, shapes or constraints are added to the space.");
+	
+	space->allocator = *allocator;
+	cpArenaInit(&space->persistentArena, &space->allocator, allocator->persistentChunkBytes);
+	cpArenaInit(&space->scratchArena, &space->allocator, allocator->scratchChunkBytes);
 }
 
 void
@@ -298,6 +358,18 @@ cpSpaceSetSleepTimeThreshold(cpSpace *space, cpFloat sleepTimeThreshold)
 	space->sleepTimeThreshold = sleepTimeThreshold;
 }
 
+int
+cpSpaceGetAwakeBodyCount(const cpSpace *space)
+{
+	return space->awakeBodyCount;
+}
+
+int
+cpSpaceGetSleepingBodyCount(const cpSpace *space)
+{
+	return space->sleepingBodyCount;
+}
+
 cpFloat
 cpSpaceGetCollisionSlop(const cpSpace *space)
 {
@@ -445,6 +517,7 @@ cpSpaceAddBody(cpSpace *space, cpBody *body)
 	
 	cpArrayPush(cpSpaceArrayForBodyType(space, cpBodyGetType(body)), body);
 	body->space = space;
+	body->hashid = space->bodyIDCounter++;
 	
 	return body;
 }
@@ -509,12 +582,34 @@ cachedArbitersFilter(cpArbiter *arb, struct arbiterFilterContext *context)
 	return cpTrue;
 }
 
+static cpBool
+triggerPairsFilter(cpTriggerPair *pair, struct arbiterFilterContext *context)
+{
+	cpShape *shape = context->shape;
+	cpBody *body = context->body;
+	
+	if(
+		(body == pair->a->body && (shape == pair->a || shape == NULL)) ||
+		(body == pair->b->body && (shape == pair->b || shape == NULL))
+	){
+		// Call exit when removing shapes.
+		cpCollisionHandler *handler = pair->handler;
+		if(shape && handler->triggerExitFunc) handler->triggerExitFunc(pair->a, pair->b, context->space, handler->userData);
+		
+		cpArrayPush(context->space->pooledTriggerPairs, pair);
+		return cpFalse;
+	}
+	
+	return cpTrue;
+}
+
 void
 cpSpaceFilterArbiters(cpSpace *space, cpBody *body, cpShape *filter)
 {
 	cpSpaceLock(space); {
 		struct arbiterFilterContext context = {space, body, filter};
 		cpHashSetFilter(space->cachedArbiters, (cpHashSetFilterFunc)cachedArbitersFilter, &context);
+		cpHashSetFilter(space->triggerPairs, (cpHashSetFilterFunc)triggerPairsFilter, &context);
 	} cpSpaceUnlock(space, cpTrue);
 }
 
@@ -689,12 +784,176 @@ cpSpaceUseSpatialHash(cpSpace *space, cpFloat dim, int count)
 	cpSpatialIndex *staticShapes = cpSpaceHashNew(dim, count, (cpSpatialIndexBBFunc)cpShapeGetBB, NULL);
 	cpSpatialIndex *dynamicShapes = cpSpaceHashNew(dim, count, (cpSpatialIndexBBFunc)cpShapeGetBB, staticShapes);
 	
+	staticShapes->arena = dynamicShapes->arena = &space->persistentArena;
+	
+	cpSpatialIndexEach(space->staticShapes, (cpSpatialIndexIteratorFunc)copyShapes, staticShapes);
+	cpSpatialIndexEach(space->dynamicShapes, (cpSpatialIndexIteratorFunc)copyShapes, dynamicShapes);
+	
+	// The old indexes give their pool buffers back to the persistent arena, where later indexes reuse the ones of the same size.
+	cpSpatialIndexFree(space->staticShapes);
+	cpSpatialIndexFree(space->dynamicShapes);
+	cpSpatialIndexFree(space->spareDynamicShapes);
+	
+	space->staticShapes = staticShapes;
+	space->dynamicShapes = dynamicShapes;
+	space->dynamicShapesType = CP_BROADPHASE_SPACE_HASH;
+	space->spareDynamicShapes = NULL;
+}
+
+void
+cpSpaceUseGrid(cpSpace *space, cpBB bounds, cpFloat dim)
+{
+	cpSpatialIndex *staticShapes = cpGridNew(bounds, dim, (cpSpatialIndexBBFunc)cpShapeGetBB, NULL);
+	cpSpatialIndex *dynamicShapes = cpGridNew(bounds, dim, (cpSpatialIndexBBFunc)cpShapeGetBB, staticShapes);
+	
+	staticShapes->arena = dynamicShapes->arena = &space->persistentArena;
+	
 	cpSpatialIndexEach(space->staticShapes, (cpSpatialIndexIteratorFunc)copyShapes, staticShapes);
 	cpSpatialIndexEach(space->dynamicShapes, (cpSpatialIndexIteratorFunc)copyShapes, dynamicShapes);
 	
 	cpSpatialIndexFree(space->staticShapes);
 	cpSpatialIndexFree(space->dynamicShapes);
+	cpSpatialIndexFree(space->spareDynamicShapes);
 	
 	space->staticShapes = staticShapes;
 	space->dynamicShapes = dynamicShapes;
+	space->dynamicShapesType = CP_BROADPHASE_GRID;
+	space->spareDynamicShapes = NULL;
+}
+
+//MARK: Broadphase Auto-Selection
+
+// Measured on the host with cpBroadphaseReplay() using moving boxes, with 10% of them up to 20x larger.
+// The hash beat the tree from ~100 shapes once each shape also does a box query per step.
+// With pair finding alone the tree was faster at every size tried, so only turn this on for query heavy spaces.
+const cpBroadphaseThresholds cpBroadphaseThresholdsDefault = {
+	30, 100, 75, 20.0f,
+};
+
+void
+cpSpaceSetBroadphaseAutoSelect(cpSpace *space, const cpBroadphaseThresholds *thresholds)
+{
+	if(thresholds){
+		cpAssertHard(thresholds->checkInterval > 0, "The check interval must be at least one step.");
+		cpAssertHard(thresholds->treeMaxShapes <= thresholds->hashMinShapes, "treeMaxShapes must not be larger than hashMinShapes.");
+		space->broadphaseThresholds = (*thresholds);
+	}
+	
+	space->autoSelectBroadphase = (thresholds != NULL);
+}
+
+cpBroadphaseType
+cpSpaceGetDynamicBroadphaseType(const cpSpace *space)
+{
+	return space->dynamicShapesType;
+}
+
+void
+cpSpaceSetTreeRebalanceBudget(cpSpace *space, int nodes)
+{
+	cpAssertHard(nodes >= 0, "The rebalance budget cannot be negative.");
+	space->treeRebalanceBudget = nodes;
+	
+	// The spare index is only ever a tree while the space is using a spatial hash.
+	if(space->dynamicShapesType == CP_BROADPHASE_BBTREE){
+		cpBBTreeSetRebalanceBudget(space->dynamicShapes, nodes);
+	} else if(space->dynamicShapesType == CP_BROADPHASE_SPACE_HASH && space->spareDynamicShapes){
+		cpBBTreeSetRebalanceBudget(space->spareDynamicShapes, nodes);
+	}
+}
+
+cpBool
+cpSpaceGetTreeQuality(cpSpace *space, cpBBTreeQuality *quality)
+{
+	if(space->dynamicShapesType == CP_BROADPHASE_BBTREE){
+		cpBBTreeGetQuality(space->dynamicShapes, quality);
+		return cpTrue;
+	} else {
+		cpBBTreeQuality empty = {0, 0, 0.0f, 0.0f};
+		(*quality) = empty;
+		return cpFalse;
+	}
+}
+
+static void
+populationAddShape(cpShape *shape, cpBroadphasePopulation *population)
+{
+	cpBroadphasePopulationAdd(population, shape->bb);
+}
+
+struct collectShapesContext {
+	cpShape **shapes;
+	int count;
+};
+
+static void
+collectShapes(cpShape *shape, struct collectShapesContext *context)
+{
+	context->shapes[context->count++] = shape;
+}
+
+static void
+cpSpaceSwapDynamicShapes(cpSpace *space, cpSpatialIndex *index, cpBroadphaseType type)
+{
+	cpSpatialIndex *old = space->dynamicShapes;
+	
+	// Shapes can't be removed from an index while iterating it.
+	struct collectShapesContext context = {(cpShape **)cpArenaAlloc(&space->scratchArena, cpSpatialIndexCount(old)*sizeof(cpShape *)), 0};
+	cpSpatialIndexEach(old, (cpSpatialIndexIteratorFunc)collectShapes, &context);
+	for(int i=0; i<context.count; i++) cpSpatialIndexRemove(old, context.shapes[i], context.shapes[i]->hashid);
+	
+	// Only the active dynamic index is linked to the static index.
+	old->staticIndex = NULL;
+	index->staticIndex = space->staticShapes;
+	space->staticShapes->dynamicIndex = index;
+	
+	for(int i=0; i<context.count; i++) cpSpatialIndexInsert(index, context.shapes[i], context.shapes[i]->hashid);
+	
+	// Keep the old index and its pools around in case the population changes back.
+	space->spareDynamicShapes = old;
+	space->dynamicShapes = index;
+	space->dynamicShapesType = type;
+}
+
+void
+cpSpaceUpdateBroadphase(cpSpace *space)
+{
+	cpBroadphaseThresholds *thresholds = &space->broadphaseThresholds;
+	if(!space->autoSelectBroadphase || space->stamp%thresholds->checkInterval != 0) return;
+	
+	// Only switches between the tree and the hash. A grid was picked deliberately for known bounds.
+	cpBroadphaseType type = space->dynamicShapesType;
+	if(type != CP_BROADPHASE_BBTREE && type != CP_BROADPHASE_SPACE_HASH) return;
+	
+	cpBroadphasePopulation population = {0};
+	cpSpatialIndexEach(space->dynamicShapes, (cpSpatialIndexIteratorFunc)populationAddShape, &population);
+	
+	int count = population.count;
+	cpBool uniform = (population.maxExtent*count <= thresholds->hashMaxSizeRatio*population.totalExtent);
+	cpSpatialIndex *spare = space->spareDynamicShapes;
+	
+	if(type == CP_BROADPHASE_SPACE_HASH){
+		if(count < thresholds->treeMaxShapes || !uniform){
+			if(spare == NULL){
+				spare = cpBBTreeNew((cpSpatialIndexBBFunc)cpShapeGetBB, NULL);
+				spare->arena = &space->persistentArena;
+				cpBBTreeSetVelocityFunc(spare, (cpBBTreeVelocityFunc)ShapeVelocityFunc);
+				cpBBTreeSetRebalanceBudget(spare, space->treeRebalanceBudget);
+			}
+			
+			cpSpaceSwapDynamicShapes(space, spare, CP_BROADPHASE_BBTREE);
+		}
+	} else if(count >= thresholds->hashMinShapes && uniform){
+		cpFloat celldim; int numcells;
+		cpBroadphaseHashSize(&population, &celldim, &numcells);
+		
+		if(spare == NULL){
+			spare = cpSpaceHashNew(celldim, numcells, (cpSpatialIndexBBFunc)cpShapeGetBB, NULL);
+			spare->arena = &space->persistentArena;
+		} else {
+			cpSpaceHashResize((cpSpaceHash *)spare, celldim, numcells);
+		}
+		
+		cpSpaceSwapDynamicShapes(space, spare, CP_BROADPHASE_SPACE_HASH);
+	}
 }
@@ -35,6 +35,9 @@ typedef cpBool (*cpCollisionPreSolveFunc)(cpArbiter *arb, cpSpace *space, cpData
 typedef void (*cpCollisionPostSolveFunc)(cpArbiter *arb, cpSpace *space, cpDataPointer userData);
 /// Collision separate event function callback type.
 typedef void (*cpCollisionSeparateFunc)(cpArbiter *arb, cpSpace *space, cpDataPointer userData);
+/// Trigger enter and exit event function callback type.
+/// The shapes are passed in the order of the handler's collision types.
+typedef void (*cpTriggerFunc)(cpShape *a, cpShape *b, cpSpace *space, cpDataPointer userData);
 
 /// Struct that holds function callback pointers to configure custom collision handling.
 /// Collision handlers have a pair of types; when a collision occurs between two shapes that have these types, the collision handler functions are triggered.
@@ -57,8 +60,33 @@ struct cpCollisionHandler {
 	cpCollisionSeparateFunc separateFunc;
 	/// This is a user definable context pointer that is passed to all of the collision handler functions.
 	cpDataPointer userData;
+	/// This function is called when a trigger shape starts overlapping a shape, if the pair of types matches this handler.
+	/// Wildcard handlers are not called for triggers.
+	cpTriggerFunc triggerEnterFunc;
+	/// This function is called when a trigger shape stops overlapping a shape, or one of them is removed from the space.
+	cpTriggerFunc triggerExitFunc;
 };
 
+/// Memory callbacks and chunk sizes a space uses for its internal buffers.
+/// The arbiter, contact, post-step callback and spatial index pools are carved out of a persistent arena that's only
+/// released with the space. Per-step allocations (such as the packed solver's copies) come from a scratch arena that's
+/// reset at the start of every cpSpaceStep().
+typedef struct cpSpaceAllocator {
+	/// Allocate @c bytes of memory. The memory doesn't need to be zeroed.
+	void *(*alloc)(size_t bytes, void *userData);
+	/// Free memory returned by alloc.
+	void (*free)(void *ptr, void *userData);
+	/// User definable context pointer passed to alloc and free.
+	void *userData;
+	/// Size of the chunks requested by the persistent arena. Must be at least CP_BUFFER_BYTES to avoid wasting space.
+	size_t persistentChunkBytes;
+	/// Size of the chunks requested by the scratch arena.
+	size_t scratchChunkBytes;
+} cpSpaceAllocator;
+
+/// The default allocator. Uses cpcalloc() and cpfree() with CP_BUFFER_BYTES sized chunks.
+CP_EXPORT extern const cpSpaceAllocator cpSpaceAllocatorDefault;
+
 // TODO: Make timestep a parameter?
 
 
@@ -71,6 +99,10 @@ CP_EXPORT cpSpace* cpSpaceInit(cpSpace *space);
 /// Allocate and initialize a cpSpace.
 CP_EXPORT cpSpace* cpSpaceNew(void);
 
+/// Set the allocator used for the space's internal buffers.
+/// Must be called before any bodies, shapes or constraints are added.
+CP_EXPORT void cpSpaceSetAllocator(cpSpace *space, const cpSpaceAllocator *allocator);
+
 /// Destroy a cpSpace.
 CP_EXPORT void cpSpaceDestroy(cpSpace *space);
 /// Destroy and free a cpSpace.
@@ -105,6 +137,11 @@ CP_EXPORT void cpSpaceSetIdleSpeedThreshold(cpSpace *space, cpFloat idleSpeedThr
 CP_EXPORT cpFloat cpSpaceGetSleepTimeThreshold(const cpSpace *space);
 CP_EXPORT void cpSpaceSetSleepTimeThreshold(cpSpace *space, cpFloat sleepTimeThreshold);
 
+/// Number of dynamic bodies that were awake during the last call to cpSpaceStep().
+CP_EXPORT int cpSpaceGetAwakeBodyCount(const cpSpace *space);
+/// Number of bodies that are currently sleeping.
+CP_EXPORT int cpSpaceGetSleepingBodyCount(const cpSpace *space);
+
 /// Amount of encouraged penetration between colliding shapes.
 /// Used to reduce oscillating contacts and keep the collision cache warm.
 /// Defaults to 0.1. If you have poor simulation quality,
@@ -120,6 +157,7 @@ CP_EXPORT void cpSpaceSetCollisionBias(cpSpace *space, cpFloat collisionBias);
 
 /// Number of frames that contact information should persist.
 /// Defaults to 3. There is probably never a reason to change this value.
+/// Frames are substeps, so while a step budget runs two substeps a step, contacts persist for half as long.
 CP_EXPORT cpTimestamp cpSpaceGetCollisionPersistence(const cpSpace *space);
 CP_EXPORT void cpSpaceSetCollisionPersistence(cpSpace *space, cpTimestamp collisionPersistence);
 
@@ -206,6 +244,31 @@ CP_EXPORT void cpSpaceSegmentQuery(cpSpace *space, cpVect start, cpVect end, cpF
 /// Perform a directed line segment query (like a raycast) against the space and return the first shape hit. Returns NULL if no shapes were hit.
 CP_EXPORT cpShape *cpSpaceSegmentQueryFirst(cpSpace *space, cpVect start, cpVect end, cpFloat radius, cpShapeFilter filter, cpSegmentQueryInfo *out);
 
+/// One query of a batch passed to cpSpacePointQueryNearestBatch().
+typedef struct cpBatchPointQuery {
+	cpVect point;
+	cpFloat maxDistance;
+	cpShapeFilter filter;
+} cpBatchPointQuery;
+
+/// One query of a batch passed to cpSpaceSegmentQueryFirstBatch().
+typedef struct cpBatchSegmentQuery {
+	cpVect start, end;
+	cpFloat radius;
+	cpShapeFilter filter;
+} cpBatchSegmentQuery;
+
+/// Run cpSpacePointQueryNearest() for each of the @c count queries and store the results in @c out.
+/// Nearby queries share their trips through the spatial indexes, so order the batch so that neighbouring entries are close together.
+/// Returns the number of queries that found a shape.
+CP_EXPORT int cpSpacePointQueryNearestBatch(cpSpace *space, const cpBatchPointQuery *queries, int count, cpPointQueryInfo *out);
+/// Run cpSpaceSegmentQueryFirst() for each of the @c count queries and store the results in @c out.
+/// Like cpSpacePointQueryNearestBatch(), neighbouring entries should be close together.
+/// Queries with a radius check every shape whose bounding box the centre line crosses, so they can find a nearer hit
+/// than cpSpaceSegmentQueryFirst(), which skips the parts of the indexes past its nearest hit so far.
+/// Returns the number of queries that hit a shape.
+CP_EXPORT int cpSpaceSegmentQueryFirstBatch(cpSpace *space, const cpBatchSegmentQuery *queries, int count, cpSegmentQueryInfo *out);
+
 /// Rectangle Query callback function type.
 typedef void (*cpSpaceBBQueryFunc)(cpShape *shape, void *data);
 /// Perform a fast rectangle query on the space calling @c func for each shape found.
@@ -247,6 +310,60 @@ CP_EXPORT void cpSpaceReindexShapesForBody(cpSpace *space, cpBody *body);
 
 /// Switch the space to use a spatial has as it's spatial index.
 CP_EXPORT void cpSpaceUseSpatialHash(cpSpace *space, cpFloat dim, int count);
+/// Switch the space to use uniform grids over @c bounds with cells of size @c dim as its spatial index.
+/// Works best for bounded worlds where most objects are about the same size as the cells.
+CP_EXPORT void cpSpaceUseGrid(cpSpace *space, cpBB bounds, cpFloat dim);
+
+/// Thresholds used by cpSpaceSetBroadphaseAutoSelect() to pick the dynamic spatial index.
+typedef struct cpBroadphaseThresholds {
+	/// Number of steps between checks of the dynamic shape population.
+	int checkInterval;
+	/// Switch to a spatial hash once there are at least this many dynamic shapes.
+	int hashMinShapes;
+	/// Switch back to a bounding box tree once there are fewer than this many dynamic shapes.
+	int treeMaxShapes;
+	/// Only use the spatial hash while the largest dynamic shape is at most this many times the average size.
+	cpFloat hashMaxSizeRatio;
+} cpBroadphaseThresholds;
+
+/// Thresholds measured with cpBroadphaseReplay().
+CP_EXPORT extern const cpBroadphaseThresholds cpBroadphaseThresholdsDefault;
+
+/// Let the space switch its dynamic shapes between a bounding box tree and a spatial hash as the population changes.
+/// The static shapes keep whatever index they are using, and a space using grids is left alone.
+/// Pass NULL to turn it off again. Off by default.
+CP_EXPORT void cpSpaceSetBroadphaseAutoSelect(cpSpace *space, const cpBroadphaseThresholds *thresholds);
+/// The type of spatial index currently used for the space's dynamic shapes.
+CP_EXPORT cpBroadphaseType cpSpaceGetDynamicBroadphaseType(const cpSpace *space);
+
+/// Let the space's dynamic bounding box tree rebalance itself, examining up to @c nodes tree nodes per step.
+/// See cpBBTreeSetRebalanceBudget(). Also applies to a tree picked later by broadphase auto-selection. 0 (off) by default.
+CP_EXPORT void cpSpaceSetTreeRebalanceBudget(cpSpace *space, int nodes);
+/// Measure the space's dynamic bounding box tree.
+/// Returns false and zeroes @c quality if the dynamic shapes are not in a tree.
+CP_EXPORT cpBool cpSpaceGetTreeQuality(cpSpace *space, cpBBTreeQuality *quality);
+
+/// Add the dynamic shapes of the space to the next frame of @c recording, using the shape's hash id as its slot.
+/// Shapes with ids past the recording's capacity are skipped. Returns false if the recording is already full.
+CP_EXPORT cpBool cpSpaceRecordBroadphaseFrame(cpSpace *space, cpBroadphaseRecording *recording);
+
+
+//MARK: Snapshots
+
+/// Save the complete simulation state of the space into @c buffer, including the cached contact impulses.
+/// Returns the number of bytes the snapshot needs. Nothing useful is written if that's more than @c capacity,
+/// so pass a NULL buffer first to find out how big it has to be.
+/// Taking a snapshot doesn't change the space. Snapshots are little endian, and record whether cpFloat is a float or a double.
+CP_EXPORT size_t cpSpaceSnapshot(cpSpace *space, void *buffer, size_t capacity);
+/// Restore a snapshot taken with cpSpaceSnapshot(). Spaces restored from the same snapshot step bit-identically to each other.
+/// The space the snapshot was taken from is not one of them until it is restored from it as well.
+/// The space must hold the same bodies, shapes and constraints as the one the snapshot was taken from,
+/// and use the same kind of dynamic spatial index. Either the same space, or one built the same way.
+/// A snapshot from a build of the other precision is converted, which rounds its values, so it doesn't step bit-identically.
+/// Collision handlers, user data and function pointers are not part of the snapshot and are left alone.
+/// That includes the step budget's clock, so a snapshot with a step budget on only restores into a space that has had one set.
+/// Returns false without changing the space if the snapshot doesn't match it.
+CP_EXPORT cpBool cpSpaceRestore(cpSpace *space, const void *buffer, size_t size);
 
 
 //MARK: Time Stepping
@@ -254,6 +371,85 @@ CP_EXPORT void cpSpaceUseSpatialHash(cpSpace *space, cpFloat dim, int count);
 /// Step the space forward in time by @c dt.
 CP_EXPORT void cpSpaceStep(cpSpace *space, cpFloat dt);
 
+/// Clock used to time steps, in monotonic ticks of any length.
+typedef uint64_t (*cpStepClockFunc)(void);
+
+/// Time budget used by cpSpaceSetStepBudget().
+typedef struct cpStepBudget {
+	/// Clock used to time each call to cpSpaceStep().
+	cpStepClockFunc clock;
+	/// Time a call to cpSpaceStep() should take, in clock ticks.
+	uint64_t target;
+	/// Range of solver iterations to choose from.
+	int minIterations, maxIterations;
+	/// Range of substeps to choose from. Each substep is a full step of dt/substeps.
+	int minSubsteps, maxSubsteps;
+} cpStepBudget;
+
+/// Let the space pick its iterations and substeps after each step so cpSpaceStep() stays within @c budget->target.
+/// Iterations are raised first and substeps after them while there is time to spare, and cut in the reverse order.
+/// The whole step is timed, not just the solver, since every substep repeats the broadphase, the narrow phase and the
+/// callbacks too. So a step made slow by any of them, like a burst of new pairs, cuts the quality like a slow solve.
+/// Pass NULL to turn it off again, which keeps the current iterations and goes back to a single substep. Off by default.
+CP_EXPORT void cpSpaceSetStepBudget(cpSpace *space, const cpStepBudget *budget);
+/// Number of substeps each call to cpSpaceStep() is split into.
+CP_EXPORT int cpSpaceGetSubsteps(const cpSpace *space);
+/// Clock ticks the last call to cpSpaceStep() took. Only measured while a step budget is set.
+CP_EXPORT uint64_t cpSpaceGetLastStepTime(const cpSpace *space);
+
+#if CP_USE_STEP_PROFILE
+/// Phases of cpSpaceStep() timed by the step profiler. Each one adds up its time over all the substeps of a step.
+typedef enum cpStepPhase {
+	/// Updating the shapes' bounding boxes and finding the pairs that overlap, not counting the narrow phase.
+	CP_STEP_PHASE_BROADPHASE,
+	/// Colliding the pairs found by the broadphase, including the begin and pre-solve callbacks.
+	CP_STEP_PHASE_NARROWPHASE,
+	/// Rebuilding the contact graph, putting bodies to sleep and throwing away old arbiters with their separate callbacks.
+	CP_STEP_PHASE_COMPONENTS,
+	/// Integrating body positions and velocities.
+	CP_STEP_PHASE_INTEGRATE,
+	/// Preparing the arbiters and constraints for the solver.
+	CP_STEP_PHASE_PRESTEP,
+	/// Applying the cached impulses and running the solver iterations.
+	CP_STEP_PHASE_SOLVER,
+	/// Post-solve and post-step callbacks.
+	CP_STEP_PHASE_POST_SOLVE,
+	CP_STEP_PHASE_COUNT,
+} cpStepPhase;
+
+/// Profile of one call to cpSpaceStep().
+typedef struct cpStepProfile {
+	/// Time stamp of the space after the step.
+	cpTimestamp stamp;
+	/// Clock ticks the whole step took, and each phase of it.
+	uint64_t total;
+	uint64_t phases[CP_STEP_PHASE_COUNT];
+	/// Solver settings the step ran with.
+	int substeps, iterations;
+	/// Pairs the broadphase found, over all substeps.
+	int pairs;
+	/// Arbiters and contacts the solver ran on in the last substep.
+	int arbiters, contacts;
+} cpStepProfile;
+
+/// Profile every call to cpSpaceStep() into @c buffer, which is used as a ring of @c capacity profiles.
+/// @c clock is read a few times per phase and twice for every pair the broadphase finds, so it should be cheap.
+/// Pass a NULL clock to stop profiling. The buffer has to stay around until then.
+CP_EXPORT void cpSpaceSetStepProfiler(cpSpace *space, cpStepClockFunc clock, cpStepProfile *buffer, int capacity);
+/// Number of profiles in the ring, up to its capacity.
+CP_EXPORT int cpSpaceGetStepProfileCount(const cpSpace *space);
+/// Profile of a recent step, with 0 being the latest. Returns NULL past the oldest one kept.
+CP_EXPORT const cpStepProfile *cpSpaceGetStepProfile(const cpSpace *space, int index);
+#endif
+
+#if CP_USE_THREADS
+/// Solve independent islands of the contact graph on @c threads threads during cpSpaceStep(), counting the calling thread.
+/// The results are bit-identical to the single threaded solver for any thread count. Defaults to 1.
+CP_EXPORT void cpSpaceSetThreads(cpSpace *space, int threads);
+/// Number of threads used to solve the space, counting the thread calling cpSpaceStep().
+CP_EXPORT int cpSpaceGetThreads(const cpSpace *space);
+#endif
+
 
 //MARK: Debug API
 
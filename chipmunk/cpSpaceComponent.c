@@ -25,6 +25,29 @@
 
 //MARK: Sleeping Functions
 
+// Sleeping arbiters keep their contacts in blocks from the persistent arena so they won't time out with the
+// contact buffers. Every block has room for CP_MAX_CONTACTS_PER_ARBITER contacts.
+struct cpContact *
+cpSpaceAllocSleepingContacts(cpSpace *space)
+{
+	if(space->pooledSleepingContacts->num == 0){
+		// contact pool is exhausted, make more
+		int count = CP_BUFFER_BYTES/(CP_MAX_CONTACTS_PER_ARBITER*sizeof(struct cpContact));
+		cpAssertHard(count, "Internal Error: Buffer size too small.");
+		
+		struct cpContact *buffer = (struct cpContact *)cpArenaAlloc(&space->persistentArena, CP_BUFFER_BYTES);
+		for(int i=0; i<count; i++) cpArrayPush(space->pooledSleepingContacts, buffer + i*CP_MAX_CONTACTS_PER_ARBITER);
+	}
+	
+	return (struct cpContact *)cpArrayPop(space->pooledSleepingContacts);
+}
+
+void
+cpSpaceFreeSleepingContacts(cpSpace *space, struct cpContact *contacts)
+{
+	cpArrayPush(space->pooledSleepingContacts, contacts);
+}
+
 void
 cpSpaceActivateBody(cpSpace *space, cpBody *body)
 {
@@ -36,6 +59,7 @@ cpSpaceActivateBody(cpSpace *space, cpBody *body)
 	} else {
 		cpAssertSoft(body->sleeping.root == NULL && body->sleeping.next == NULL, "Internal error: Activating body non-NULL node pointers.");
 		cpArrayPush(space->dynamicBodies, body);
+		space->sleepingBodyCount--;
 
 		CP_BODY_FOREACH_SHAPE(body, shape){
 			cpSpatialIndexRemove(space->staticShapes, shape, shape->hashid);
@@ -68,7 +92,7 @@ cpSpaceActivateBody(cpSpace *space, cpBody *body)
 				arb->stamp = space->stamp;
 				cpArrayPush(space->arbiters, arb);
 				
-				cpfree(contacts);
+				cpSpaceFreeSleepingContacts(space, contacts);
 			}
 		}
 		
@@ -85,6 +109,7 @@ cpSpaceDeactivateBody(cpSpace *space, cpBody *body)
 	cpAssertHard(cpBodyGetType(body) == CP_BODY_TYPE_DYNAMIC, "Internal error: Attempting to deactivate a non-dynamic body.");
 	
 	cpArrayDeleteObj(space->dynamicBodies, body);
+	space->sleepingBodyCount++;
 	
 	CP_BODY_FOREACH_SHAPE(body, shape){
 		cpSpatialIndexRemove(space->dynamicShapes, shape, shape->hashid);
@@ -97,9 +122,8 @@ cpSpaceDeactivateBody(cpSpace *space, cpBody *body)
 			cpSpaceUncacheArbiter(space, arb);
 			
 			// Save contact values to a new block of memory so they won't time out
-			size_t bytes = arb->count*sizeof(struct cpContact);
-			struct cpContact *contacts = (struct cpContact *)cpcalloc(1, bytes);
-			memcpy(contacts, arb->contacts, bytes);
+			struct cpContact *contacts = cpSpaceAllocSleepingContacts(space);
+			memcpy(contacts, arb->contacts, arb->count*sizeof(struct cpContact));
 			arb->contacts = contacts;
 		}
 	}
@@ -220,7 +244,7 @@ ComponentActive(cpBody *root, cpFloat threshold)
 void
 cpSpaceProcessComponents(cpSpace *space, cpFloat dt)
 {
-	cpBool sleep = 0;// (space->sleepTimeThreshold != INFINITY);
+	cpBool sleep = (space->sleepTimeThreshold != INFINITY);
 	cpArray *bodies = space->dynamicBodies;
 	
 #ifndef NDEBUG
@@ -304,8 +328,87 @@ cpSpaceProcessComponents(cpSpace *space, cpFloat dt)
 			body->sleeping.next = NULL;
 		}
 	}
+	
+	// Kinematic bodies share the dynamic body array, but they don't count as awake.
+	int awake = 0;
+	for(int i=0; i<bodies->num; i++){
+		if(cpBodyGetType((cpBody*)bodies->arr[i]) == CP_BODY_TYPE_DYNAMIC) awake++;
+	}
+	space->awakeBodyCount = awake;
+}
+
+#if CP_USE_PACKED_SOLVER
+
+int
+cpSpaceArbiterSolverOrder(cpSpace *space, cpArbiter **order)
+{
+	cpArray *bodies = space->dynamicBodies;
+	int capacity = space->arbiters->num, count = 0;
+	
+	for(int i=0; i<bodies->num; i++){
+		cpBody *root = (cpBody*)bodies->arr[i];
+		if(cpBodyGetType(root) != CP_BODY_TYPE_DYNAMIC || ComponentRoot(root) != NULL) continue;
+		
+		// Walk the bodies of each component, listing each of this step's arbiters under its first dynamic body.
+		FloodFillComponent(root, root);
+		CP_BODY_FOREACH_COMPONENT(root, body){
+			CP_BODY_FOREACH_ARBITER(body, arb){
+				cpBody *owner = (cpBodyGetType(arb->body_a) == CP_BODY_TYPE_DYNAMIC ? arb->body_a : arb->body_b);
+				if(owner == body && arb->stamp == space->stamp && count < capacity) order[count++] = arb;
+			}
+		}
+	}
+	
+	// Awake bodies must not keep their component pointers, cpBodyIsSleeping() checks them.
+	for(int i=0; i<bodies->num; i++){
+		cpBody *body = (cpBody*)bodies->arr[i];
+		body->sleeping.root = NULL;
+		body->sleeping.next = NULL;
+	}
+	
+	return count;
+}
+
+#endif
+
+#if CP_USE_THREADS
+
+void
+cpSpaceComponentRoots(cpSpace *space, cpBody **arbiterRoots, cpBody **constraintRoots)
+{
+	cpArray *bodies = space->dynamicBodies;
+	
+	// Label the awake bodies with their component roots the same way the sleeping pass does.
+	for(int i=0; i<bodies->num; i++){
+		cpBody *body = (cpBody*)bodies->arr[i];
+		if(ComponentRoot(body) == NULL) FloodFillComponent(body, body);
+	}
+	
+	// Kinematic and static bodies aren't part of any component, so use the root of the dynamic body.
+	cpArray *arbiters = space->arbiters;
+	for(int i=0; i<arbiters->num; i++){
+		cpArbiter *arb = (cpArbiter*)arbiters->arr[i];
+		cpBody *a = arb->body_a, *b = arb->body_b;
+		arbiterRoots[i] = (cpBodyGetType(a) == CP_BODY_TYPE_DYNAMIC ? ComponentRoot(a) : ComponentRoot(b));
+	}
+	
+	cpArray *constraints = space->constraints;
+	for(int i=0; i<constraints->num; i++){
+		cpConstraint *constraint = (cpConstraint *)constraints->arr[i];
+		cpBody *a = constraint->a, *b = constraint->b;
+		constraintRoots[i] = (cpBodyGetType(a) == CP_BODY_TYPE_DYNAMIC ? ComponentRoot(a) : ComponentRoot(b));
+	}
+	
+	// Awake bodies must not keep their component pointers, cpBodyIsSleeping() checks them.
+	for(int i=0; i<bodies->num; i++){
+		cpBody *body = (cpBody*)bodies->arr[i];
+		body->sleeping.root = NULL;
+		body->sleeping.next = NULL;
+	}
 }
 
+#endif
+
 void
 cpBodySleep(cpBody *body)
 {
@@ -79,8 +79,7 @@ handleSetTrans(void *obj, cpSpaceHash *hash)
 		int count = CP_BUFFER_BYTES/sizeof(cpHandle);
 		cpAssertHard(count, "Internal Error: Buffer size is too small.");
 		
-		cpHandle *buffer = (cpHandle *)cpcalloc(1, CP_BUFFER_BYTES);
-		cpArrayPush(hash->allocatedBuffers, buffer);
+		cpHandle *buffer = (cpHandle *)cpBufferAlloc(hash->spatialIndex.arena, hash->allocatedBuffers, CP_BUFFER_BYTES);
 		
 		for(int i=0; i<count; i++) cpArrayPush(hash->pooledHandles, buffer + i);
 	}
@@ -141,8 +140,7 @@ getEmptyBin(cpSpaceHash *hash)
 		int count = CP_BUFFER_BYTES/sizeof(cpSpaceHashBin);
 		cpAssertHard(count, "Internal Error: Buffer size is too small.");
 		
-		cpSpaceHashBin *buffer = (cpSpaceHashBin *)cpcalloc(1, CP_BUFFER_BYTES);
-		cpArrayPush(hash->allocatedBuffers, buffer);
+		cpSpaceHashBin *buffer = (cpSpaceHashBin *)cpBufferAlloc(hash->spatialIndex.arena, hash->allocatedBuffers, CP_BUFFER_BYTES);
 		
 		// push all but the first one, return the first instead
 		for(int i=1; i<count; i++) recycleBin(hash, buffer + i);
@@ -204,7 +202,7 @@ cpSpaceHashDestroy(cpSpaceHash *hash)
 	
 	cpHashSetFree(hash->handleSet);
 	
-	cpArrayFreeEach(hash->allocatedBuffers, cpfree);
+	cpBufferFreeAll(hash->spatialIndex.arena, hash->allocatedBuffers);
 	cpArrayFree(hash->allocatedBuffers);
 	cpArrayFree(hash->pooledHandles);
 }
@@ -313,6 +311,25 @@ cpSpaceHashRemove(cpSpaceHash *hash, void *obj, cpHashValue hashid)
 	}
 }
 
+static void
+handleClear(cpHandle *hand, cpSpaceHash *hash)
+{
+	hand->obj = NULL;
+	cpHandleRelease(hand, hash->pooledHandles);
+}
+
+static void
+cpSpaceHashClear(cpSpaceHash *hash)
+{
+	clearTable(hash);
+	
+	cpHashSetEach(hash->handleSet, (cpHashSetIteratorFunc)handleClear, hash);
+	cpHashSetFree(hash->handleSet);
+	hash->handleSet = cpHashSetNew(0, (cpHashSetEqlFunc)handleSetEql);
+	
+	hash->stamp = 1;
+}
+
 typedef struct eachContext {
 	cpSpatialIndexIteratorFunc func;
 	void *data;
@@ -586,6 +603,11 @@ static cpSpatialIndexClass klass = {
 	
 	(cpSpatialIndexQueryImpl)cpSpaceHashQuery,
 	(cpSpatialIndexSegmentQueryImpl)cpSpaceHashSegmentQuery,
+	
+	NULL,
+	NULL,
+	
+	(cpSpatialIndexClearImpl)cpSpaceHashClear,
 };
 
 static inline cpSpatialIndexClass *Klass(){return &klass;}
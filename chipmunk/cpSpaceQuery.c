@@ -175,6 +175,112 @@ cpSpaceSegmentQueryFirst(cpSpace *space, cpVect start, cpVect end, cpFloat radiu
 	return (cpShape *)out->shape;
 }
 
+//MARK: Batch Query Functions
+
+// Batches are passed to the spatial indexes in chunks so the index arguments can live on the stack.
+#define BATCH_CHUNK 32
+
+struct PointBatchContext {
+	const cpBatchPointQuery *queries;
+	cpPointQueryInfo *out;
+};
+
+static void
+NearestPointQueryBatch(int i, cpShape *shape, struct PointBatchContext *context)
+{
+	const cpBatchPointQuery *query = context->queries + i;
+	cpPointQueryInfo *out = context->out + i;
+	
+	if(
+		!cpShapeFilterReject(shape->filter, query->filter) && !shape->sensor
+	){
+		cpPointQueryInfo info;
+		cpShapePointQuery(shape, query->point, &info);
+		
+		if(info.distance < out->distance) (*out) = info;
+	}
+}
+
+int
+cpSpacePointQueryNearestBatch(cpSpace *space, const cpBatchPointQuery *queries, int count, cpPointQueryInfo *out)
+{
+	int found = 0;
+	
+	for(int first=0; first<count; first += BATCH_CHUNK){
+		int n = (count - first < BATCH_CHUNK ? count - first : BATCH_CHUNK);
+		const cpBatchPointQuery *chunk = queries + first;
+		struct PointBatchContext context = {chunk, out + first};
+		
+		cpBB bbs[BATCH_CHUNK];
+		for(int i=0; i<n; i++){
+			cpPointQueryInfo info = {NULL, cpvzero, chunk[i].maxDistance, cpvzero};
+			context.out[i] = info;
+			bbs[i] = cpBBNewForCircle(chunk[i].point, cpfmax(chunk[i].maxDistance, 0.0f));
+		}
+		
+		cpSpatialIndexQueryBatch(space->dynamicShapes, bbs, n, (cpSpatialIndexBatchQueryFunc)NearestPointQueryBatch, &context);
+		cpSpatialIndexQueryBatch(space->staticShapes, bbs, n, (cpSpatialIndexBatchQueryFunc)NearestPointQueryBatch, &context);
+		
+		for(int i=0; i<n; i++) if(context.out[i].shape) found++;
+	}
+	
+	return found;
+}
+
+struct SegmentBatchContext {
+	const cpBatchSegmentQuery *queries;
+	cpSegmentQueryInfo *out;
+};
+
+static cpFloat
+SegmentQueryFirstBatch(int i, cpShape *shape, struct SegmentBatchContext *context)
+{
+	const cpBatchSegmentQuery *query = context->queries + i;
+	cpSegmentQueryInfo *out = context->out + i;
+	cpSegmentQueryInfo info;
+	
+	if(
+		!cpShapeFilterReject(shape->filter, query->filter) && !shape->sensor &&
+		cpShapeSegmentQuery(shape, query->start, query->end, query->radius, &info) &&
+		info.alpha < out->alpha
+	){
+		(*out) = info;
+	}
+	
+	// The indexes only follow the centre line, so a hit by a thick segment doesn't rule out shapes it enters later.
+	// Thick segments aren't shortened, and find the nearest hit whatever order the packets visit the shapes in.
+	return (query->radius > 0.0f ? 1.0f : out->alpha);
+}
+
+int
+cpSpaceSegmentQueryFirstBatch(cpSpace *space, const cpBatchSegmentQuery *queries, int count, cpSegmentQueryInfo *out)
+{
+	int found = 0;
+	
+	for(int first=0; first<count; first += BATCH_CHUNK){
+		int n = (count - first < BATCH_CHUNK ? count - first : BATCH_CHUNK);
+		const cpBatchSegmentQuery *chunk = queries + first;
+		struct SegmentBatchContext context = {chunk, out + first};
+		
+		cpSpatialIndexSegment segments[BATCH_CHUNK];
+		for(int i=0; i<n; i++){
+			cpSegmentQueryInfo info = {NULL, chunk[i].end, cpvzero, 1.0f};
+			context.out[i] = info;
+			
+			cpSpatialIndexSegment segment = {chunk[i].start, chunk[i].end, 1.0f};
+			segments[i] = segment;
+		}
+		
+		// The static hits shorten the segments before the dynamic shapes are searched.
+		cpSpatialIndexSegmentQueryBatch(space->staticShapes, segments, n, (cpSpatialIndexBatchSegmentQueryFunc)SegmentQueryFirstBatch, &context);
+		cpSpatialIndexSegmentQueryBatch(space->dynamicShapes, segments, n, (cpSpatialIndexBatchSegmentQueryFunc)SegmentQueryFirstBatch, &context);
+		
+		for(int i=0; i<n; i++) if(context.out[i].shape) found++;
+	}
+	
+	return found;
+}
+
 //MARK: BB Query Functions
 
 struct BBQueryContext {
@@ -0,0 +1,1375 @@
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "chipmunk/chipmunk_private.h"
+
+// A snapshot is a flat stream of little endian values, so snapshots taken on the N64 restore on a PC. Floats are
+// stored at the precision of the build that took the snapshot, which the header records, and converted when a build
+// of the other precision restores it. After the header and the space's parameters come the
+// bodies, shapes, constraints, arbiters and trigger pairs. Bodies and shapes are listed in hash id order with
+// the space's static body first, constraints are listed by their first body, and arbiters by their shapes.
+// Everything else refers to them by their position in those lists. Restoring matches the objects up the same way,
+// so the space being restored must hold the same objects as the one the snapshot was taken from.
+//
+// Stepping only stays bit-identical if the broadphase finds the same pairs in the same order, and that depends on
+// the history of the spatial indexes. Restoring a snapshot rebuilds the indexes by inserting the shapes in hash id
+// order, so every space restored from the same snapshot starts from the same state. Taking a snapshot leaves the
+// space alone.
+
+#define SNAPSHOT_MAGIC 0x53535043u // "CPSS"
+#define SNAPSHOT_VERSION 2
+
+// Floats and other values written for each contact, see WriteArbiters().
+#define CONTACT_FLOATS 11
+#define CONTACT_UINTS 1
+
+//MARK: Canonical Object Order
+
+typedef struct SnapshotObjects {
+	int bodyCount, shapeCount, constraintCount, arbiterCount;
+	cpBody **bodies;
+	cpShape **shapes;
+	cpConstraint **constraints;
+	cpArbiter **arbiters;
+} SnapshotObjects;
+
+static int
+IDCompare(cpHashValue a, cpHashValue b)
+{
+	return (a > b) - (a < b);
+}
+
+static int
+BodyCompare(cpBody **a, cpBody **b)
+{
+	return IDCompare((*a)->hashid, (*b)->hashid);
+}
+
+static int
+ShapeCompare(cpShape **a, cpShape **b)
+{
+	return IDCompare((*a)->hashid, (*b)->hashid);
+}
+
+static int
+ArbiterCompare(cpArbiter **a, cpArbiter **b)
+{
+	int order = IDCompare((*a)->a->hashid, (*b)->a->hashid);
+	return (order ? order : IDCompare((*a)->b->hashid, (*b)->b->hashid));
+}
+
+static void
+GatherArbiter(cpArbiter *arb, SnapshotObjects *objects)
+{
+	objects->arbiters[objects->arbiterCount++] = arb;
+}
+
+static cpBool
+ArbiterIsCached(cpSpace *space, cpArbiter *arb)
+{
+	const cpShape *shape_pair[] = {arb->a, arb->b};
+	cpHashValue arbHashID = CP_HASH_PAIR((cpHashValue)arb->a, (cpHashValue)arb->b);
+	return (cpHashSetFind(space->cachedArbiters, arbHashID, shape_pair) == arb);
+}
+
+static void
+GatherObjects(cpSpace *space, SnapshotObjects *objects)
+{
+	cpArray *dynamicBodies = space->dynamicBodies, *staticBodies = space->staticBodies, *components = space->sleepingComponents;
+	
+	// The space's static body isn't in any of the body arrays.
+	int bodyCount = 1 + dynamicBodies->num + staticBodies->num;
+	for(int i=0; i<components->num; i++){
+		CP_BODY_FOREACH_COMPONENT((cpBody *)components->arr[i], body) bodyCount++;
+	}
+	
+	cpBody **bodies = (cpBody **)cpcalloc(bodyCount, sizeof(cpBody *));
+	int count = 0;
+	bodies[count++] = space->staticBody;
+	for(int i=0; i<dynamicBodies->num; i++) bodies[count++] = (cpBody *)dynamicBodies->arr[i];
+	for(int i=0; i<staticBodies->num; i++) bodies[count++] = (cpBody *)staticBodies->arr[i];
+	for(int i=0; i<components->num; i++){
+		CP_BODY_FOREACH_COMPONENT((cpBody *)components->arr[i], body) bodies[count++] = body;
+	}
+	qsort(bodies + 1, bodyCount - 1, sizeof(cpBody *), (int (*)(const void *, const void *))BodyCompare);
+	
+	int shapeCount = 0, constraintCount = 0, arbiterCount = cpHashSetCount(space->cachedArbiters);
+	for(int i=0; i<bodyCount; i++){
+		cpBody *body = bodies[i];
+		CP_BODY_FOREACH_SHAPE(body, shape) shapeCount++;
+		CP_BODY_FOREACH_CONSTRAINT(body, constraint) constraintCount += (constraint->a == body);
+		if(cpBodyIsSleeping(body)) CP_BODY_FOREACH_ARBITER(body, arb) arbiterCount++;
+	}
+	
+	objects->bodyCount = bodyCount;
+	objects->bodies = bodies;
+	objects->shapeCount = 0;
+	objects->shapes = (cpShape **)cpcalloc(shapeCount + 1, sizeof(cpShape *));
+	objects->constraintCount = 0;
+	objects->constraints = (cpConstraint **)cpcalloc(constraintCount + 1, sizeof(cpConstraint *));
+	objects->arbiterCount = 0;
+	objects->arbiters = (cpArbiter **)cpcalloc(arbiterCount + 1, sizeof(cpArbiter *));
+	
+	// The arbiters of awake bodies are all in the cache. Sleeping ones are only in their bodies' lists,
+	// and are added once by the same rule cpSpaceDeactivateBody() uses.
+	cpHashSetEach(space->cachedArbiters, (cpHashSetIteratorFunc)GatherArbiter, objects);
+	
+	for(int i=0; i<bodyCount; i++){
+		cpBody *body = bodies[i];
+		CP_BODY_FOREACH_SHAPE(body, shape) objects->shapes[objects->shapeCount++] = shape;
+		CP_BODY_FOREACH_CONSTRAINT(body, constraint){
+			if(constraint->a == body) objects->constraints[objects->constraintCount++] = constraint;
+		}
+		
+		if(cpBodyIsSleeping(body)){
+			CP_BODY_FOREACH_ARBITER(body, arb){
+				cpBody *bodyA = arb->body_a;
+				if((body == bodyA || cpBodyGetType(bodyA) == CP_BODY_TYPE_STATIC) && !ArbiterIsCached(space, arb)) GatherArbiter(arb, objects);
+			}
+		}
+	}
+	
+	qsort(objects->shapes, shapeCount, sizeof(cpShape *), (int (*)(const void *, const void *))ShapeCompare);
+	qsort(objects->arbiters, objects->arbiterCount, sizeof(cpArbiter *), (int (*)(const void *, const void *))ArbiterCompare);
+}
+
+static void
+FreeObjects(SnapshotObjects *objects)
+{
+	cpfree(objects->bodies);
+	cpfree(objects->shapes);
+	cpfree(objects->constraints);
+	cpfree(objects->arbiters);
+}
+
+static int
+BodyOrdinal(cpSpace *space, SnapshotObjects *objects, cpBody *body)
+{
+	if(body == space->staticBody) return 0;
+	
+	int lo = 1, hi = objects->bodyCount;
+	while(lo < hi){
+		int mid = (lo + hi)/2;
+		if(objects->bodies[mid]->hashid < body->hashid) lo = mid + 1; else hi = mid;
+	}
+	
+	cpAssertHard(lo < objects->bodyCount && objects->bodies[lo] == body, "Internal Error: Body is missing from the snapshot.");
+	return lo;
+}
+
+static int
+ShapeOrdinal(SnapshotObjects *objects, const cpShape *shape)
+{
+	int lo = 0, hi = objects->shapeCount;
+	while(lo < hi){
+		int mid = (lo + hi)/2;
+		if(objects->shapes[mid]->hashid < shape->hashid) lo = mid + 1; else hi = mid;
+	}
+	
+	cpAssertHard(lo < objects->shapeCount && objects->shapes[lo] == shape, "Internal Error: Shape is missing from the snapshot.");
+	return lo;
+}
+
+static int
+ArbiterOrdinal(SnapshotObjects *objects, cpArbiter *arb)
+{
+	int lo = 0, hi = objects->arbiterCount;
+	while(lo < hi){
+		int mid = (lo + hi)/2;
+		if(ArbiterCompare(objects->arbiters + mid, &arb) < 0) lo = mid + 1; else hi = mid;
+	}
+	
+	cpAssertHard(lo < objects->arbiterCount && objects->arbiters[lo] == arb, "Internal Error: Arbiter is missing from the snapshot.");
+	return lo;
+}
+
+static int
+ConstraintOrdinal(SnapshotObjects *objects, cpConstraint *constraint)
+{
+	for(int i=0; i<objects->constraintCount; i++){
+		if(objects->constraints[i] == constraint) return i;
+	}
+	
+	cpAssertHard(cpFalse, "Internal Error: Constraint is missing from the snapshot.");
+	return 0;
+}
+
+static cpBool
+ShapeIsStatic(cpShape *shape)
+{
+	cpBody *body = shape->body;
+	return (cpBodyGetType(body) == CP_BODY_TYPE_STATIC || cpBodyIsSleeping(body));
+}
+
+// Empty both spatial indexes and insert the shapes again in hash id order.
+static void
+RebuildIndexes(cpSpace *space, SnapshotObjects *objects)
+{
+	cpSpatialIndex *indexes[] = {space->dynamicShapes, space->staticShapes};
+	for(int i=0; i<2; i++){
+		cpSpatialIndex *index = indexes[i];
+		
+		if(index->klass->clear){
+			index->klass->clear(index);
+		} else {
+			for(int j=0; j<objects->shapeCount; j++){
+				cpShape *shape = objects->shapes[j];
+				if(cpSpatialIndexContains(index, shape, shape->hashid)) cpSpatialIndexRemove(index, shape, shape->hashid);
+			}
+		}
+	}
+	
+	for(int i=0; i<objects->shapeCount; i++){
+		cpShape *shape = objects->shapes[i];
+		if(ShapeIsStatic(shape)) cpSpatialIndexInsert(space->staticShapes, shape, shape->hashid);
+	}
+	
+	for(int i=0; i<objects->shapeCount; i++){
+		cpShape *shape = objects->shapes[i];
+		if(!ShapeIsStatic(shape)) cpSpatialIndexInsert(space->dynamicShapes, shape, shape->hashid);
+	}
+}
+
+//MARK: Constraint Kinds
+
+// A field a constraint class adds to cpConstraint, as a run of cpFloats. Vectors and matrices are runs of their floats.
+typedef struct ConstraintField {
+	size_t offset;
+	int floats;
+} ConstraintField;
+
+#define FIELD(type, name) {offsetof(type, name), sizeof(((type *)NULL)->name)/sizeof(cpFloat)}
+
+static const ConstraintField PinJointFields[] = {
+	FIELD(cpPinJoint, anchorA), FIELD(cpPinJoint, anchorB), FIELD(cpPinJoint, dist),
+	FIELD(cpPinJoint, r1), FIELD(cpPinJoint, r2), FIELD(cpPinJoint, n), FIELD(cpPinJoint, nMass),
+	FIELD(cpPinJoint, jnAcc), FIELD(cpPinJoint, bias),
+};
+
+static const ConstraintField SlideJointFields[] = {
+	FIELD(cpSlideJoint, anchorA), FIELD(cpSlideJoint, anchorB), FIELD(cpSlideJoint, min), FIELD(cpSlideJoint, max),
+	FIELD(cpSlideJoint, r1), FIELD(cpSlideJoint, r2), FIELD(cpSlideJoint, n), FIELD(cpSlideJoint, nMass),
+	FIELD(cpSlideJoint, jnAcc), FIELD(cpSlideJoint, bias),
+};
+
+static const ConstraintField PivotJointFields[] = {
+	FIELD(cpPivotJoint, anchorA), FIELD(cpPivotJoint, anchorB),
+	FIELD(cpPivotJoint, r1), FIELD(cpPivotJoint, r2), FIELD(cpPivotJoint, k),
+	FIELD(cpPivotJoint, jAcc), FIELD(cpPivotJoint, bias),
+};
+
+static const ConstraintField GrooveJointFields[] = {
+	FIELD(cpGrooveJoint, grv_n), FIELD(cpGrooveJoint, grv_a), FIELD(cpGrooveJoint, grv_b), FIELD(cpGrooveJoint, anchorB),
+	FIELD(cpGrooveJoint, grv_tn), FIELD(cpGrooveJoint, clamp), FIELD(cpGrooveJoint, r1), FIELD(cpGrooveJoint, r2), FIELD(cpGrooveJoint, k),
+	FIELD(cpGrooveJoint, jAcc), FIELD(cpGrooveJoint, bias),
+};
+
+static const ConstraintField DampedSpringFields[] = {
+	FIELD(cpDampedSpring, anchorA), FIELD(cpDampedSpring, anchorB),
+	FIELD(cpDampedSpring, restLength), FIELD(cpDampedSpring, stiffness), FIELD(cpDampedSpring, damping),
+	FIELD(cpDampedSpring, target_vrn), FIELD(cpDampedSpring, v_coef),
+	FIELD(cpDampedSpring, r1), FIELD(cpDampedSpring, r2), FIELD(cpDampedSpring, nMass), FIELD(cpDampedSpring, n),
+	FIELD(cpDampedSpring, jAcc),
+};
+
+static const ConstraintField DampedRotarySpringFields[] = {
+	FIELD(cpDampedRotarySpring, restAngle), FIELD(cpDampedRotarySpring, stiffness), FIELD(cpDampedRotarySpring, damping),
+	FIELD(cpDampedRotarySpring, target_wrn), FIELD(cpDampedRotarySpring, w_coef),
+	FIELD(cpDampedRotarySpring, iSum), FIELD(cpDampedRotarySpring, jAcc),
+};
+
+static const ConstraintField RotaryLimitJointFields[] = {
+	FIELD(cpRotaryLimitJoint, min), FIELD(cpRotaryLimitJoint, max),
+	FIELD(cpRotaryLimitJoint, iSum), FIELD(cpRotaryLimitJoint, bias), FIELD(cpRotaryLimitJoint, jAcc),
+};
+
+static const ConstraintField RatchetJointFields[] = {
+	FIELD(cpRatchetJoint, angle), FIELD(cpRatchetJoint, phase), FIELD(cpRatchetJoint, ratchet),
+	FIELD(cpRatchetJoint, iSum), FIELD(cpRatchetJoint, bias), FIELD(cpRatchetJoint, jAcc),
+};
+
+static const ConstraintField GearJointFields[] = {
+	FIELD(cpGearJoint, phase), FIELD(cpGearJoint, ratio), FIELD(cpGearJoint, ratio_inv),
+	FIELD(cpGearJoint, iSum), FIELD(cpGearJoint, bias), FIELD(cpGearJoint, jAcc),
+};
+
+static const ConstraintField SimpleMotorFields[] = {
+	FIELD(cpSimpleMotor, rate),
+	FIELD(cpSimpleMotor, iSum), FIELD(cpSimpleMotor, jAcc),
+};
+
+#define FIELDS(fields) fields, (int)(sizeof(fields)/sizeof(*fields))
+
+// Function pointers aren't fields, they keep their values from the constraint being restored.
+static const struct {
+	cpBool (*is)(const cpConstraint *constraint);
+	const ConstraintField *fields;
+	int fieldCount;
+} ConstraintKinds[] = {
+	{cpConstraintIsPinJoint, FIELDS(PinJointFields)},
+	{cpConstraintIsSlideJoint, FIELDS(SlideJointFields)},
+	{cpConstraintIsPivotJoint, FIELDS(PivotJointFields)},
+	{cpConstraintIsGrooveJoint, FIELDS(GrooveJointFields)},
+	{cpConstraintIsDampedSpring, FIELDS(DampedSpringFields)},
+	{cpConstraintIsDampedRotarySpring, FIELDS(DampedRotarySpringFields)},
+	{cpConstraintIsRotaryLimitJoint, FIELDS(RotaryLimitJointFields)},
+	{cpConstraintIsRatchetJoint, FIELDS(RatchetJointFields)},
+	{cpConstraintIsGearJoint, FIELDS(GearJointFields)},
+	{cpConstraintIsSimpleMotor, FIELDS(SimpleMotorFields)},
+};
+
+#define CONSTRAINT_KIND_COUNT ((int)(sizeof(ConstraintKinds)/sizeof(*ConstraintKinds)))
+
+// Returns -1 for constraint classes defined outside of Chipmunk. Only their common fields are saved.
+static int
+ConstraintKind(const cpConstraint *constraint)
+{
+	for(int i=0; i<CONSTRAINT_KIND_COUNT; i++){
+		if(ConstraintKinds[i].is(constraint)) return i;
+	}
+	
+	return -1;
+}
+
+//MARK: Writing
+
+typedef struct SnapshotWriter {
+	uint8_t *buffer;
+	size_t capacity, size;
+} SnapshotWriter;
+
+// Keeps counting past the end of the buffer so the caller can find out how big it needs to be.
+static inline void
+Write(SnapshotWriter *writer, const void *data, size_t bytes)
+{
+	if(bytes <= writer->capacity && writer->size <= writer->capacity - bytes) memcpy(writer->buffer + writer->size, data, bytes);
+	writer->size += bytes;
+}
+
+static inline void
+WriteU8(SnapshotWriter *writer, uint8_t value)
+{
+	Write(writer, &value, sizeof(value));
+}
+
+static inline void
+WriteU16(SnapshotWriter *writer, uint16_t value)
+{
+	uint8_t bytes[2] = {value & 0xff, value >> 8};
+	Write(writer, bytes, sizeof(bytes));
+}
+
+static inline void
+WriteU32(SnapshotWriter *writer, uint32_t value)
+{
+	uint8_t bytes[4] = {value & 0xff, (value >> 8) & 0xff, (value >> 16) & 0xff, value >> 24};
+	Write(writer, bytes, sizeof(bytes));
+}
+
+static inline void
+WriteU64(SnapshotWriter *writer, uint64_t value)
+{
+	WriteU32(writer, (uint32_t)value);
+	WriteU32(writer, (uint32_t)(value >> 32));
+}
+
+static inline void WriteInt(SnapshotWriter *writer, int32_t value){WriteU32(writer, (uint32_t)value);}
+static inline void WriteUInt(SnapshotWriter *writer, uint64_t value){WriteU64(writer, value);}
+static inline void WriteBool(SnapshotWriter *writer, cpBool value){WriteU8(writer, (value != 0));}
+
+static inline void
+WriteFloat(SnapshotWriter *writer, cpFloat value)
+{
+#if CP_USE_DOUBLES
+	uint64_t bits; memcpy(&bits, &value, sizeof(bits));
+	WriteU64(writer, bits);
+#else
+	uint32_t bits; memcpy(&bits, &value, sizeof(bits));
+	WriteU32(writer, bits);
+#endif
+}
+
+static inline void WriteVect(SnapshotWriter *writer, cpVect value){WriteFloat(writer, value.x); WriteFloat(writer, value.y);}
+
+static void
+WriteBodies(SnapshotWriter *writer, cpSpace *space, SnapshotObjects *objects)
+{
+	for(int i=0; i<objects->bodyCount; i++){
+		cpBody *body = objects->bodies[i];
+		
+		WriteUInt(writer, body->hashid);
+		WriteInt(writer, cpBodyGetType(body));
+		
+		WriteFloat(writer, body->m);
+		WriteFloat(writer, body->m_inv);
+		WriteFloat(writer, body->i);
+		WriteFloat(writer, body->i_inv);
+		WriteVect(writer, body->cog);
+		
+		WriteVect(writer, body->p);
+		WriteVect(writer, body->v);
+		WriteVect(writer, body->f);
+		WriteFloat(writer, body->a);
+		WriteFloat(writer, body->w);
+		WriteFloat(writer, body->t);
+		
+		cpTransform t = body->transform;
+		WriteFloat(writer, t.a); WriteFloat(writer, t.b); WriteFloat(writer, t.c);
+		WriteFloat(writer, t.d); WriteFloat(writer, t.tx); WriteFloat(writer, t.ty);
+		
+		WriteBool(writer, body->continuous);
+		WriteFloat(writer, body->impactTime);
+		WriteVect(writer, body->v_bias);
+		WriteFloat(writer, body->w_bias);
+		WriteFloat(writer, body->sleeping.idleTime);
+	}
+	
+	cpArray *arrays[] = {space->dynamicBodies, space->staticBodies};
+	for(int i=0; i<2; i++){
+		cpArray *arr = arrays[i];
+		WriteInt(writer, arr->num);
+		for(int j=0; j<arr->num; j++) WriteInt(writer, BodyOrdinal(space, objects, (cpBody *)arr->arr[j]));
+	}
+	
+	cpArray *components = space->sleepingComponents;
+	WriteInt(writer, components->num);
+	for(int i=0; i<components->num; i++){
+		cpBody *root = (cpBody *)components->arr[i];
+		
+		int count = 0;
+		CP_BODY_FOREACH_COMPONENT(root, body) count++;
+		
+		WriteInt(writer, count);
+		CP_BODY_FOREACH_COMPONENT(root, body) WriteInt(writer, BodyOrdinal(space, objects, body));
+	}
+}
+
+static void
+WriteShapes(SnapshotWriter *writer, cpSpace *space, SnapshotObjects *objects)
+{
+	for(int i=0; i<objects->shapeCount; i++){
+		cpShape *shape = objects->shapes[i];
+		
+		WriteUInt(writer, shape->hashid);
+		WriteInt(writer, BodyOrdinal(space, objects, shape->body));
+		WriteInt(writer, shape->klass->type);
+		
+		WriteBool(writer, shape->sensor);
+		WriteBool(writer, shape->trigger);
+		WriteFloat(writer, shape->e);
+		WriteFloat(writer, shape->u);
+		WriteVect(writer, shape->surfaceV);
+		
+		WriteUInt(writer, shape->type);
+		WriteUInt(writer, shape->filter.group);
+		WriteUInt(writer, shape->filter.categories);
+		WriteUInt(writer, shape->filter.mask);
+		
+		WriteFloat(writer, shape->massInfo.m);
+		WriteFloat(writer, shape->massInfo.i);
+		WriteVect(writer, shape->massInfo.cog);
+		WriteFloat(writer, shape->massInfo.area);
+		
+		cpBB bb = shape->bb;
+		WriteFloat(writer, bb.l); WriteFloat(writer, bb.b); WriteFloat(writer, bb.r); WriteFloat(writer, bb.t);
+		
+		switch(shape->klass->type){
+			case CP_CIRCLE_SHAPE: {
+				cpCircleShape *circle = (cpCircleShape *)shape;
+				WriteVect(writer, circle->c);
+				WriteFloat(writer, circle->r);
+				break;
+			}
+			case CP_SEGMENT_SHAPE: {
+				cpSegmentShape *seg = (cpSegmentShape *)shape;
+				WriteVect(writer, seg->a);
+				WriteVect(writer, seg->b);
+				WriteVect(writer, seg->n);
+				WriteFloat(writer, seg->r);
+				WriteVect(writer, seg->a_tangent);
+				WriteVect(writer, seg->b_tangent);
+				break;
+			}
+			case CP_POLY_SHAPE: {
+				cpPolyShape *poly = (cpPolyShape *)shape;
+				WriteInt(writer, poly->count);
+				WriteFloat(writer, poly->r);
+				WriteBool(writer, poly->isBox);
+				
+				// The untransformed planes. The transformed ones are recalculated from the body.
+				struct cpSplittingPlane *planes = poly->planes + poly->count;
+				for(int j=0; j<poly->count; j++){
+					WriteVect(writer, planes[j].v0);
+					WriteVect(writer, planes[j].n);
+				}
+				break;
+			}
+			default: break;
+		}
+	}
+}
+
+static void
+WriteConstraints(SnapshotWriter *writer, cpSpace *space, SnapshotObjects *objects)
+{
+	for(int i=0; i<objects->constraintCount; i++){
+		cpConstraint *constraint = objects->constraints[i];
+		int kind = ConstraintKind(constraint);
+		
+		WriteInt(writer, kind);
+		WriteInt(writer, BodyOrdinal(space, objects, constraint->a));
+		WriteInt(writer, BodyOrdinal(space, objects, constraint->b));
+		
+		WriteFloat(writer, constraint->maxForce);
+		WriteFloat(writer, constraint->errorBias);
+		WriteFloat(writer, constraint->maxBias);
+		WriteBool(writer, constraint->collideBodies);
+		
+		if(kind >= 0){
+			for(int j=0; j<ConstraintKinds[kind].fieldCount; j++){
+				ConstraintField field = ConstraintKinds[kind].fields[j];
+				const cpFloat *floats = (const cpFloat *)((const uint8_t *)constraint + field.offset);
+				for(int k=0; k<field.floats; k++) WriteFloat(writer, floats[k]);
+			}
+		}
+	}
+	
+	cpArray *constraints = space->constraints;
+	WriteInt(writer, constraints->num);
+	for(int i=0; i<constraints->num; i++) WriteInt(writer, ConstraintOrdinal(objects, (cpConstraint *)constraints->arr[i]));
+}
+
+static void
+WriteArbiters(SnapshotWriter *writer, cpSpace *space, SnapshotObjects *objects)
+{
+	for(int i=0; i<objects->arbiterCount; i++){
+		cpArbiter *arb = objects->arbiters[i];
+		
+		WriteInt(writer, ShapeOrdinal(objects, arb->a));
+		WriteInt(writer, ShapeOrdinal(objects, arb->b));
+		WriteBool(writer, ArbiterIsCached(space, arb));
+		
+		WriteFloat(writer, arb->e);
+		WriteFloat(writer, arb->u);
+		WriteVect(writer, arb->surface_vr);
+		WriteVect(writer, arb->n);
+		WriteUInt(writer, arb->stamp);
+		WriteInt(writer, arb->state);
+		
+		WriteInt(writer, arb->count);
+		for(int j=0; j<arb->count; j++){
+			struct cpContact *con = arb->contacts + j;
+			WriteVect(writer, con->r1);
+			WriteVect(writer, con->r2);
+			WriteFloat(writer, con->nMass);
+			WriteFloat(writer, con->tMass);
+			WriteFloat(writer, con->bounce);
+			WriteFloat(writer, con->jnAcc);
+			WriteFloat(writer, con->jtAcc);
+			WriteFloat(writer, con->jBias);
+			WriteFloat(writer, con->bias);
+			WriteUInt(writer, con->hash);
+		}
+	}
+	
+	cpArray *arbiters = space->arbiters;
+	WriteInt(writer, arbiters->num);
+	for(int i=0; i<arbiters->num; i++) WriteInt(writer, ArbiterOrdinal(objects, (cpArbiter *)arbiters->arr[i]));
+	
+	// The contact graph, in each body's list order.
+	for(int i=0; i<objects->bodyCount; i++){
+		cpBody *body = objects->bodies[i];
+		
+		int count = 0;
+		CP_BODY_FOREACH_ARBITER(body, arb) count++;
+		
+		WriteInt(writer, count);
+		CP_BODY_FOREACH_ARBITER(body, arb) WriteInt(writer, ArbiterOrdinal(objects, arb));
+	}
+}
+
+typedef struct TriggerPairContext {
+	SnapshotWriter *writer;
+	SnapshotObjects *objects;
+} TriggerPairContext;
+
+static void
+WriteTriggerPair(cpTriggerPair *pair, TriggerPairContext *context)
+{
+	WriteInt(context->writer, ShapeOrdinal(context->objects, pair->a));
+	WriteInt(context->writer, ShapeOrdinal(context->objects, pair->b));
+	WriteUInt(context->writer, pair->stamp);
+}
+
+size_t
+cpSpaceSnapshot(cpSpace *space, void *buffer, size_t capacity)
+{
+	cpAssertHard(!space->locked, "You cannot take a snapshot of a space while it is locked. Take it before or after cpSpaceStep().");
+	
+	SnapshotObjects objects;
+	GatherObjects(space, &objects);
+	
+	SnapshotWriter writer = {(uint8_t *)buffer, (buffer ? capacity : 0), 0};
+	
+	WriteU32(&writer, SNAPSHOT_MAGIC);
+	WriteU16(&writer, SNAPSHOT_VERSION);
+	WriteU8(&writer, sizeof(cpFloat));
+	// Filled in at the end.
+	size_t sizeOffset = writer.size;
+	WriteUInt(&writer, 0);
+	
+	WriteInt(&writer, objects.bodyCount);
+	WriteInt(&writer, objects.shapeCount);
+	WriteInt(&writer, objects.constraintCount);
+	WriteInt(&writer, objects.arbiterCount);
+	WriteInt(&writer, cpHashSetCount(space->triggerPairs));
+	WriteInt(&writer, space->dynamicShapesType);
+	
+	WriteInt(&writer, space->iterations);
+	WriteInt(&writer, space->substeps);
+	WriteVect(&writer, space->gravity);
+	WriteFloat(&writer, space->damping);
+	WriteFloat(&writer, space->idleSpeedThreshold);
+	WriteFloat(&writer, space->sleepTimeThreshold);
+	WriteFloat(&writer, space->collisionSlop);
+	WriteFloat(&writer, space->collisionBias);
+	WriteUInt(&writer, space->collisionPersistence);
+	WriteUInt(&writer, space->stamp);
+	WriteFloat(&writer, space->curr_dt);
+	WriteUInt(&writer, space->shapeIDCounter);
+	WriteUInt(&writer, space->bodyIDCounter);
+	WriteInt(&writer, space->awakeBodyCount);
+	WriteInt(&writer, space->sleepingBodyCount);
+	
+	// The step budget's clock is a function pointer, so it isn't saved.
+	cpStepBudget *budget = &space->stepBudget;
+	WriteBool(&writer, space->useStepBudget);
+	WriteUInt(&writer, budget->target);
+	WriteInt(&writer, budget->minIterations);
+	WriteInt(&writer, budget->maxIterations);
+	WriteInt(&writer, budget->minSubsteps);
+	WriteInt(&writer, budget->maxSubsteps);
+	WriteUInt(&writer, space->lastStepTime);
+	WriteUInt(&writer, space->prevStepTime);
+	
+	WriteBodies(&writer, space, &objects);
+	WriteShapes(&writer, space, &objects);
+	WriteConstraints(&writer, space, &objects);
+	WriteArbiters(&writer, space, &objects);
+	
+	// Pairs are written in the cache's order, restoring them doesn't depend on it.
+	TriggerPairContext context = {&writer, &objects};
+	cpHashSetEach(space->triggerPairs, (cpHashSetIteratorFunc)WriteTriggerPair, &context);
+	
+	if(writer.size <= writer.capacity){
+		SnapshotWriter sizeWriter = {writer.buffer + sizeOffset, sizeof(uint64_t), 0};
+		WriteUInt(&sizeWriter, writer.size);
+	}
+	
+	FreeObjects(&objects);
+	return writer.size;
+}
+
+//MARK: Reading
+
+typedef struct SnapshotReader {
+	const uint8_t *buffer;
+	size_t size, offset;
+	
+	// Cleared on the first read past the end or value that doesn't match the space.
+	// Reads after that return zeroes.
+	cpBool valid;
+	
+	// The first pass only checks the snapshot against the space, the second one applies it.
+	cpBool apply;
+	
+	cpSpace *space;
+	SnapshotObjects *objects;
+	
+	// Size of the snapshot's floats, which may be from a build of the other precision.
+	int floatBytes;
+	
+	int arbiterCount, triggerPairCount;
+	// Shape ordinals of the arbiters in the snapshot, and the arbiters once the second pass has made them.
+	int *arbiterShapes;
+	cpArbiter **arbiters;
+} SnapshotReader;
+
+static inline void
+Read(SnapshotReader *reader, void *data, size_t bytes)
+{
+	if(reader->valid && bytes <= reader->size - reader->offset){
+		memcpy(data, reader->buffer + reader->offset, bytes);
+		reader->offset += bytes;
+	} else {
+		reader->valid = cpFalse;
+		memset(data, 0, bytes);
+	}
+}
+
+static void
+Skip(SnapshotReader *reader, void *data, size_t bytes)
+{
+	if(reader->valid && bytes <= reader->size - reader->offset){
+		reader->offset += bytes;
+	} else {
+		reader->valid = cpFalse;
+	}
+}
+
+static inline uint8_t
+ReadU8(SnapshotReader *reader)
+{
+	uint8_t value;
+	Read(reader, &value, sizeof(value));
+	return value;
+}
+
+static inline uint16_t
+ReadU16(SnapshotReader *reader)
+{
+	uint8_t bytes[2];
+	Read(reader, bytes, sizeof(bytes));
+	return bytes[0] | (bytes[1] << 8);
+}
+
+static inline uint32_t
+ReadU32(SnapshotReader *reader)
+{
+	uint8_t bytes[4];
+	Read(reader, bytes, sizeof(bytes));
+	return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+static inline uint64_t
+ReadU64(SnapshotReader *reader)
+{
+	uint64_t low = ReadU32(reader);
+	return low | ((uint64_t)ReadU32(reader) << 32);
+}
+
+static inline int32_t ReadInt(SnapshotReader *reader){return (int32_t)ReadU32(reader);}
+static inline uint64_t ReadUInt(SnapshotReader *reader){return ReadU64(reader);}
+static inline cpBool ReadBool(SnapshotReader *reader){return ReadU8(reader);}
+
+static inline cpFloat
+ReadFloat(SnapshotReader *reader)
+{
+	if(reader->floatBytes == 8){
+		uint64_t bits = ReadU64(reader);
+		double value; memcpy(&value, &bits, sizeof(value));
+		return (cpFloat)value;
+	} else {
+		uint32_t bits = ReadU32(reader);
+		float value; memcpy(&value, &bits, sizeof(value));
+		return (cpFloat)value;
+	}
+}
+
+static inline cpVect ReadVect(SnapshotReader *reader){cpFloat x = ReadFloat(reader); return cpv(x, ReadFloat(reader));}
+
+static inline void Check(SnapshotReader *reader, cpBool condition){if(!condition) reader->valid = cpFalse;}
+
+// Returns -1 if the ordinal is out of range.
+static int
+ReadOrdinal(SnapshotReader *reader, int count)
+{
+	int32_t ordinal = ReadInt(reader);
+	Check(reader, 0 <= ordinal && ordinal < count);
+	return (reader->valid ? ordinal : -1);
+}
+
+static void
+ReadBodies(SnapshotReader *reader)
+{
+	cpSpace *space = reader->space;
+	SnapshotObjects *objects = reader->objects;
+	cpBool apply = reader->apply;
+	
+	for(int i=0; i<objects->bodyCount && reader->valid; i++){
+		cpBody *body = objects->bodies[i];
+		
+		// The space's static body is always first.
+		cpHashValue hashid = ReadUInt(reader);
+		Check(reader, i == 0 || hashid == body->hashid);
+		Check(reader, ReadInt(reader) == (int32_t)cpBodyGetType(body));
+		
+		cpBody b;
+		b.m = ReadFloat(reader);
+		b.m_inv = ReadFloat(reader);
+		b.i = ReadFloat(reader);
+		b.i_inv = ReadFloat(reader);
+		b.cog = ReadVect(reader);
+		
+		b.p = ReadVect(reader);
+		b.v = ReadVect(reader);
+		b.f = ReadVect(reader);
+		b.a = ReadFloat(reader);
+		b.w = ReadFloat(reader);
+		b.t = ReadFloat(reader);
+		
+		cpTransform *t = &b.transform;
+		t->a = ReadFloat(reader); t->b = ReadFloat(reader); t->c = ReadFloat(reader);
+		t->d = ReadFloat(reader); t->tx = ReadFloat(reader); t->ty = ReadFloat(reader);
+		
+		b.continuous = ReadBool(reader);
+		b.impactTime = ReadFloat(reader);
+		b.v_bias = ReadVect(reader);
+		b.w_bias = ReadFloat(reader);
+		b.sleeping.idleTime = ReadFloat(reader);
+		
+		if(apply){
+			body->m = b.m;
+			body->m_inv = b.m_inv;
+			body->i = b.i;
+			body->i_inv = b.i_inv;
+			body->cog = b.cog;
+			
+			body->p = b.p;
+			body->v = b.v;
+			body->f = b.f;
+			body->a = b.a;
+			body->w = b.w;
+			body->t = b.t;
+			body->transform = b.transform;
+			
+			body->continuous = b.continuous;
+			body->impactTime = b.impactTime;
+			body->v_bias = b.v_bias;
+			body->w_bias = b.w_bias;
+			body->sleeping.idleTime = b.sleeping.idleTime;
+		}
+	}
+	
+	// Every body but the space's static body must be listed exactly once in the arrays and sleeping components.
+	int *listed = NULL;
+	if(!apply){
+		listed = (int *)cpcalloc(objects->bodyCount, sizeof(int));
+	}
+	
+	cpArray *arrays[] = {space->dynamicBodies, space->staticBodies};
+	for(int i=0; i<2 && reader->valid; i++){
+		int count = ReadInt(reader);
+		Check(reader, 0 <= count && count < objects->bodyCount);
+		
+		for(int j=0; j<count && reader->valid; j++){
+			int ordinal = ReadOrdinal(reader, objects->bodyCount);
+			if(ordinal < 0) break;
+			
+			cpBody *body = objects->bodies[ordinal];
+			if(apply){
+				cpArrayPush(arrays[i], body);
+			} else {
+				cpBool isStatic = (cpBodyGetType(body) == CP_BODY_TYPE_STATIC);
+				Check(reader, ordinal != 0 && isStatic == (i == 1) && listed[ordinal]++ == 0);
+			}
+		}
+	}
+	
+	int componentCount = ReadInt(reader);
+	Check(reader, 0 <= componentCount && componentCount < objects->bodyCount);
+	
+	for(int i=0; i<componentCount && reader->valid; i++){
+		int count = ReadInt(reader);
+		Check(reader, 0 < count && count < objects->bodyCount);
+		
+		cpBody *root = NULL, *prev = NULL;
+		for(int j=0; j<count && reader->valid; j++){
+			int ordinal = ReadOrdinal(reader, objects->bodyCount);
+			if(ordinal < 0) break;
+			
+			cpBody *body = objects->bodies[ordinal];
+			if(apply){
+				if(prev) prev->sleeping.next = body; else root = body;
+				body->sleeping.root = root;
+				prev = body;
+			} else {
+				Check(reader, cpBodyGetType(body) == CP_BODY_TYPE_DYNAMIC && listed[ordinal]++ == 0);
+			}
+		}
+		
+		if(apply) cpArrayPush(space->sleepingComponents, root);
+	}
+	
+	if(!apply){
+		for(int i=1; i<objects->bodyCount; i++) Check(reader, listed[i] == 1);
+		cpfree(listed);
+	}
+}
+
+static void
+ReadShapes(SnapshotReader *reader)
+{
+	SnapshotObjects *objects = reader->objects;
+	cpBool apply = reader->apply;
+	
+	for(int i=0; i<objects->shapeCount && reader->valid; i++){
+		cpShape *shape = objects->shapes[i];
+		
+		Check(reader, ReadUInt(reader) == shape->hashid);
+		int body = ReadOrdinal(reader, objects->bodyCount);
+		Check(reader, body >= 0 && objects->bodies[body] == shape->body);
+		
+		cpShapeType type = (cpShapeType)ReadInt(reader);
+		Check(reader, type == shape->klass->type);
+		if(!reader->valid) break;
+		
+		cpShape s;
+		s.sensor = ReadBool(reader);
+		s.trigger = ReadBool(reader);
+		s.e = ReadFloat(reader);
+		s.u = ReadFloat(reader);
+		s.surfaceV = ReadVect(reader);
+		
+		s.type = (cpCollisionType)ReadUInt(reader);
+		s.filter.group = (cpGroup)ReadUInt(reader);
+		s.filter.categories = (cpBitmask)ReadUInt(reader);
+		s.filter.mask = (cpBitmask)ReadUInt(reader);
+		
+		s.massInfo.m = ReadFloat(reader);
+		s.massInfo.i = ReadFloat(reader);
+		s.massInfo.cog = ReadVect(reader);
+		s.massInfo.area = ReadFloat(reader);
+		
+		cpBB *bb = &s.bb;
+		bb->l = ReadFloat(reader); bb->b = ReadFloat(reader); bb->r = ReadFloat(reader); bb->t = ReadFloat(reader);
+		
+		if(apply){
+			shape->sensor = s.sensor;
+			shape->trigger = s.trigger;
+			shape->e = s.e;
+			shape->u = s.u;
+			shape->surfaceV = s.surfaceV;
+			shape->type = s.type;
+			shape->filter = s.filter;
+			shape->massInfo = s.massInfo;
+		}
+		
+		switch(type){
+			case CP_CIRCLE_SHAPE: {
+				cpVect c = ReadVect(reader);
+				cpFloat r = ReadFloat(reader);
+				
+				if(apply){
+					cpCircleShape *circle = (cpCircleShape *)shape;
+					circle->c = c;
+					circle->r = r;
+				}
+				break;
+			}
+			case CP_SEGMENT_SHAPE: {
+				cpSegmentShape seg;
+				seg.a = ReadVect(reader);
+				seg.b = ReadVect(reader);
+				seg.n = ReadVect(reader);
+				seg.r = ReadFloat(reader);
+				seg.a_tangent = ReadVect(reader);
+				seg.b_tangent = ReadVect(reader);
+				
+				if(apply){
+					cpSegmentShape *dst = (cpSegmentShape *)shape;
+					dst->a = seg.a;
+					dst->b = seg.b;
+					dst->n = seg.n;
+					dst->r = seg.r;
+					dst->a_tangent = seg.a_tangent;
+					dst->b_tangent = seg.b_tangent;
+				}
+				break;
+			}
+			case CP_POLY_SHAPE: {
+				cpPolyShape *poly = (cpPolyShape *)shape;
+				Check(reader, ReadInt(reader) == poly->count);
+				cpFloat r = ReadFloat(reader);
+				cpBool isBox = ReadBool(reader);
+				
+				if(apply){
+					poly->r = r;
+					poly->isBox = isBox;
+				}
+				
+				struct cpSplittingPlane *planes = poly->planes + poly->count;
+				for(int j=0; j<poly->count && reader->valid; j++){
+					cpVect v0 = ReadVect(reader), n = ReadVect(reader);
+					
+					if(apply){
+						planes[j].v0 = v0;
+						planes[j].n = n;
+					}
+				}
+				break;
+			}
+			default: break;
+		}
+		
+		if(apply){
+			shape->klass->cacheData(shape, shape->body->transform);
+			shape->bb = s.bb;
+		}
+	}
+}
+
+static void
+ReadConstraints(SnapshotReader *reader)
+{
+	cpSpace *space = reader->space;
+	SnapshotObjects *objects = reader->objects;
+	cpBool apply = reader->apply;
+	
+	for(int i=0; i<objects->constraintCount && reader->valid; i++){
+		cpConstraint *constraint = objects->constraints[i];
+		int kind = ConstraintKind(constraint);
+		
+		Check(reader, ReadInt(reader) == kind);
+		int a = ReadOrdinal(reader, objects->bodyCount);
+		int b = ReadOrdinal(reader, objects->bodyCount);
+		if(!reader->valid) break;
+		Check(reader, objects->bodies[a] == constraint->a && objects->bodies[b] == constraint->b);
+		
+		cpFloat maxForce = ReadFloat(reader);
+		cpFloat errorBias = ReadFloat(reader);
+		cpFloat maxBias = ReadFloat(reader);
+		cpBool collideBodies = ReadBool(reader);
+		
+		if(apply){
+			constraint->maxForce = maxForce;
+			constraint->errorBias = errorBias;
+			constraint->maxBias = maxBias;
+			constraint->collideBodies = collideBodies;
+		}
+		
+		if(kind >= 0){
+			for(int j=0; j<ConstraintKinds[kind].fieldCount; j++){
+				ConstraintField field = ConstraintKinds[kind].fields[j];
+				cpFloat *floats = (cpFloat *)((uint8_t *)constraint + field.offset);
+				
+				for(int k=0; k<field.floats; k++){
+					cpFloat value = ReadFloat(reader);
+					if(apply) floats[k] = value;
+				}
+			}
+		}
+	}
+	
+	int count = ReadInt(reader);
+	Check(reader, 0 <= count && count <= objects->constraintCount);
+	
+	for(int i=0; i<count && reader->valid; i++){
+		int ordinal = ReadOrdinal(reader, objects->constraintCount);
+		if(apply && ordinal >= 0) cpArrayPush(space->constraints, objects->constraints[ordinal]);
+	}
+}
+
+static void
+ReadArbiters(SnapshotReader *reader)
+{
+	cpSpace *space = reader->space;
+	SnapshotObjects *objects = reader->objects;
+	cpBool apply = reader->apply;
+	
+	for(int i=0; i<reader->arbiterCount && reader->valid; i++){
+		int ia = ReadOrdinal(reader, objects->shapeCount);
+		int ib = ReadOrdinal(reader, objects->shapeCount);
+		cpBool cached = ReadBool(reader);
+		if(!reader->valid) break;
+		
+		cpShape *a = objects->shapes[ia], *b = objects->shapes[ib];
+		Check(reader, a->body != b->body);
+		reader->arbiterShapes[2*i + 0] = ia;
+		reader->arbiterShapes[2*i + 1] = ib;
+		
+		cpArbiter arb;
+		arb.e = ReadFloat(reader);
+		arb.u = ReadFloat(reader);
+		arb.surface_vr = ReadVect(reader);
+		arb.n = ReadVect(reader);
+		arb.stamp = (cpTimestamp)ReadUInt(reader);
+		arb.state = (enum cpArbiterState)ReadInt(reader);
+		Check(reader, CP_ARBITER_STATE_FIRST_COLLISION <= arb.state && arb.state <= CP_ARBITER_STATE_CACHED);
+		
+		arb.count = ReadInt(reader);
+		Check(reader, 0 <= arb.count && arb.count <= CP_MAX_CONTACTS_PER_ARBITER);
+		if(!reader->valid) break;
+		
+		// Only the second pass needs the contacts.
+		struct cpContact contacts[CP_MAX_CONTACTS_PER_ARBITER];
+		if(!apply){
+			Skip(reader, NULL, arb.count*(CONTACT_FLOATS*reader->floatBytes + CONTACT_UINTS*sizeof(uint64_t)));
+			continue;
+		}
+		
+		for(int j=0; j<arb.count; j++){
+			struct cpContact *con = contacts + j;
+			con->r1 = ReadVect(reader);
+			con->r2 = ReadVect(reader);
+			con->nMass = ReadFloat(reader);
+			con->tMass = ReadFloat(reader);
+			con->bounce = ReadFloat(reader);
+			con->jnAcc = ReadFloat(reader);
+			con->jtAcc = ReadFloat(reader);
+			con->jBias = ReadFloat(reader);
+			con->bias = ReadFloat(reader);
+			con->hash = (cpHashValue)ReadUInt(reader);
+		}
+		
+		cpShape *shape_pair[] = {a, b};
+		cpArbiter *dst;
+		
+		if(cached){
+			cpHashValue arbHashID = CP_HASH_PAIR((cpHashValue)a, (cpHashValue)b);
+			dst = (cpArbiter *)cpHashSetInsert(space->cachedArbiters, arbHashID, shape_pair, (cpHashSetTransFunc)cpSpaceArbiterSetTrans, space);
+			dst->contacts = cpContactBufferGetArray(space);
+			cpSpacePushContacts(space, arb.count);
+		} else {
+			// Sleeping arbiters keep their contacts in a pool, see cpSpaceDeactivateBody().
+			dst = (cpArbiter *)cpSpaceArbiterSetTrans(shape_pair, space);
+			dst->contacts = cpSpaceAllocSleepingContacts(space);
+		}
+		
+		memcpy(dst->contacts, contacts, arb.count*sizeof(struct cpContact));
+		dst->count = arb.count;
+		
+		dst->e = arb.e;
+		dst->u = arb.u;
+		dst->surface_vr = arb.surface_vr;
+		dst->n = arb.n;
+		dst->stamp = arb.stamp;
+		dst->state = arb.state;
+		cpArbiterUpdateHandlers(dst, space);
+		
+		reader->arbiters[i] = dst;
+	}
+	
+	int count = ReadInt(reader);
+	Check(reader, 0 <= count && count <= reader->arbiterCount);
+	
+	for(int i=0; i<count && reader->valid; i++){
+		int ordinal = ReadOrdinal(reader, reader->arbiterCount);
+		if(apply && ordinal >= 0) cpArrayPush(space->arbiters, reader->arbiters[ordinal]);
+	}
+	
+	for(int i=0; i<objects->bodyCount && reader->valid; i++){
+		cpBody *body = objects->bodies[i];
+		
+		int count = ReadInt(reader);
+		Check(reader, 0 <= count && count <= reader->arbiterCount);
+		
+		cpArbiter *prev = NULL;
+		for(int j=0; j<count && reader->valid; j++){
+			int ordinal = ReadOrdinal(reader, reader->arbiterCount);
+			if(ordinal < 0) break;
+			
+			if(apply){
+				cpArbiter *arb = reader->arbiters[ordinal];
+				struct cpArbiterThread *thread = cpArbiterThreadForBody(arb, body);
+				thread->prev = prev;
+				thread->next = NULL;
+				
+				if(prev) cpArbiterThreadForBody(prev, body)->next = arb; else body->arbiterList = arb;
+				prev = arb;
+			} else {
+				cpBody *a = objects->shapes[reader->arbiterShapes[2*ordinal + 0]]->body;
+				cpBody *b = objects->shapes[reader->arbiterShapes[2*ordinal + 1]]->body;
+				Check(reader, body == a || body == b);
+			}
+		}
+	}
+}
+
+static void
+ReadTriggerPairs(SnapshotReader *reader)
+{
+	cpSpace *space = reader->space;
+	SnapshotObjects *objects = reader->objects;
+	
+	for(int i=0; i<reader->triggerPairCount && reader->valid; i++){
+		int ia = ReadOrdinal(reader, objects->shapeCount);
+		int ib = ReadOrdinal(reader, objects->shapeCount);
+		cpTimestamp stamp = (cpTimestamp)ReadUInt(reader);
+		
+		if(reader->apply && reader->valid){
+			cpShape *a = objects->shapes[ia], *b = objects->shapes[ib];
+			cpShape *shape_pair[] = {a, b};
+			cpHashValue pairHashID = CP_HASH_PAIR((cpHashValue)a, (cpHashValue)b);
+			
+			cpTriggerPair *pair = (cpTriggerPair *)cpHashSetInsert(space->triggerPairs, pairHashID, shape_pair, (cpHashSetTransFunc)cpSpaceTriggerPairSetTrans, space);
+			pair->handler = cpSpaceLookupHandler(space, a->type, b->type, &space->defaultHandler);
+			pair->stamp = stamp;
+		}
+	}
+}
+
+static void
+ReadSnapshot(SnapshotReader *reader)
+{
+	cpSpace *space = reader->space;
+	SnapshotObjects *objects = reader->objects;
+	cpBool apply = reader->apply;
+	
+	Check(reader, ReadU32(reader) == SNAPSHOT_MAGIC);
+	Check(reader, ReadU16(reader) == SNAPSHOT_VERSION);
+	reader->floatBytes = ReadU8(reader);
+	Check(reader, reader->floatBytes == 4 || reader->floatBytes == 8);
+	Check(reader, ReadUInt(reader) == reader->size);
+	
+	Check(reader, ReadInt(reader) == objects->bodyCount);
+	Check(reader, ReadInt(reader) == objects->shapeCount);
+	Check(reader, ReadInt(reader) == objects->constraintCount);
+	reader->arbiterCount = ReadInt(reader);
+	reader->triggerPairCount = ReadInt(reader);
+	Check(reader, 0 <= reader->arbiterCount && (size_t)reader->arbiterCount <= reader->size);
+	Check(reader, 0 <= reader->triggerPairCount && (size_t)reader->triggerPairCount <= reader->size);
+	Check(reader, ReadInt(reader) == (int32_t)space->dynamicShapesType);
+	if(!reader->valid) return;
+	
+	// Freed by cpSpaceRestore().
+	if(!apply){
+		reader->arbiterShapes = (int *)cpcalloc(2*reader->arbiterCount + 1, sizeof(int));
+	} else {
+		reader->arbiters = (cpArbiter **)cpcalloc(reader->arbiterCount + 1, sizeof(cpArbiter *));
+	}
+	
+	cpSpace s;
+	s.iterations = ReadInt(reader);
+	s.substeps = ReadInt(reader);
+	s.gravity = ReadVect(reader);
+	s.damping = ReadFloat(reader);
+	s.idleSpeedThreshold = ReadFloat(reader);
+	s.sleepTimeThreshold = ReadFloat(reader);
+	s.collisionSlop = ReadFloat(reader);
+	s.collisionBias = ReadFloat(reader);
+	s.collisionPersistence = (cpTimestamp)ReadUInt(reader);
+	s.stamp = (cpTimestamp)ReadUInt(reader);
+	s.curr_dt = ReadFloat(reader);
+	s.shapeIDCounter = (cpHashValue)ReadUInt(reader);
+	s.bodyIDCounter = (cpHashValue)ReadUInt(reader);
+	s.awakeBodyCount = ReadInt(reader);
+	s.sleepingBodyCount = ReadInt(reader);
+	Check(reader, s.iterations > 0 && s.substeps > 0);
+	
+	cpStepBudget *budget = &s.stepBudget;
+	s.useStepBudget = ReadBool(reader);
+	budget->target = ReadUInt(reader);
+	budget->minIterations = ReadInt(reader);
+	budget->maxIterations = ReadInt(reader);
+	budget->minSubsteps = ReadInt(reader);
+	budget->maxSubsteps = ReadInt(reader);
+	s.lastStepTime = ReadUInt(reader);
+	s.prevStepTime = ReadUInt(reader);
+	// A budget can only be turned on in a space that has a clock for it.
+	Check(reader, !s.useStepBudget || (
+		space->stepBudget.clock &&
+		0 < budget->minIterations && budget->minIterations <= budget->maxIterations &&
+		0 < budget->minSubsteps && budget->minSubsteps <= budget->maxSubsteps
+	));
+	
+	if(apply){
+		space->iterations = s.iterations;
+		space->substeps = s.substeps;
+		space->gravity = s.gravity;
+		space->damping = s.damping;
+		space->idleSpeedThreshold = s.idleSpeedThreshold;
+		space->sleepTimeThreshold = s.sleepTimeThreshold;
+		space->collisionSlop = s.collisionSlop;
+		space->collisionBias = s.collisionBias;
+		space->collisionPersistence = s.collisionPersistence;
+		space->stamp = s.stamp;
+		space->curr_dt = s.curr_dt;
+		space->shapeIDCounter = s.shapeIDCounter;
+		space->bodyIDCounter = s.bodyIDCounter;
+		space->awakeBodyCount = s.awakeBodyCount;
+		space->sleepingBodyCount = s.sleepingBodyCount;
+		
+		space->useStepBudget = s.useStepBudget;
+		space->stepBudget.target = budget->target;
+		space->stepBudget.minIterations = budget->minIterations;
+		space->stepBudget.maxIterations = budget->maxIterations;
+		space->stepBudget.minSubsteps = budget->minSubsteps;
+		space->stepBudget.maxSubsteps = budget->maxSubsteps;
+		space->lastStepTime = s.lastStepTime;
+		space->prevStepTime = s.prevStepTime;
+		
+		// The restored arbiters get their contacts from a fresh buffer.
+		cpSpaceResetContactBuffers(space);
+	}
+	
+	ReadBodies(reader);
+	ReadShapes(reader);
+	ReadConstraints(reader);
+	ReadArbiters(reader);
+	ReadTriggerPairs(reader);
+	
+	Check(reader, reader->offset == reader->size);
+}
+
+//MARK: Restoring
+
+static cpBool RejectAll(void *elt, void *data){return cpFalse;}
+
+static cpBool
+PoolTriggerPair(cpTriggerPair *pair, cpSpace *space)
+{
+	cpArrayPush(space->pooledTriggerPairs, pair);
+	return cpFalse;
+}
+
+// Return the arbiters and trigger pairs to their pools, and empty the arrays and lists the snapshot refills.
+static void
+ClearTransientState(cpSpace *space, SnapshotObjects *objects)
+{
+	for(int i=0; i<objects->arbiterCount; i++){
+		cpArbiter *arb = objects->arbiters[i];
+		if(!ArbiterIsCached(space, arb)) cpSpaceFreeSleepingContacts(space, arb->contacts);
+		
+		arb->contacts = NULL;
+		arb->count = 0;
+		cpArrayPush(space->pooledArbiters, arb);
+	}
+	
+	cpHashSetFilter(space->cachedArbiters, RejectAll, NULL);
+	cpHashSetFilter(space->triggerPairs, (cpHashSetFilterFunc)PoolTriggerPair, space);
+	
+	space->arbiters->num = 0;
+	space->constraints->num = 0;
+	space->dynamicBodies->num = 0;
+	space->staticBodies->num = 0;
+	space->sleepingComponents->num = 0;
+	
+	for(int i=0; i<objects->bodyCount; i++){
+		cpBody *body = objects->bodies[i];
+		body->arbiterList = NULL;
+		body->sleeping.root = NULL;
+		body->sleeping.next = NULL;
+	}
+}
+
+cpBool
+cpSpaceRestore(cpSpace *space, const void *buffer, size_t size)
+{
+	cpAssertHard(!space->locked, "You cannot restore a snapshot while the space is locked. Restore it before or after cpSpaceStep().");
+	
+	SnapshotObjects objects;
+	GatherObjects(space, &objects);
+	
+	SnapshotReader reader = {(const uint8_t *)buffer, size, 0, cpTrue, cpFalse, space, &objects, sizeof(cpFloat), 0, 0, NULL, NULL};
+	ReadSnapshot(&reader);
+	
+	int *arbiterShapes = reader.arbiterShapes;
+	cpBool valid = reader.valid;
+	
+	if(valid){
+		ClearTransientState(space, &objects);
+		
+		reader = (SnapshotReader){(const uint8_t *)buffer, size, 0, cpTrue, cpTrue, space, &objects, sizeof(cpFloat), 0, 0, arbiterShapes, NULL};
+		ReadSnapshot(&reader);
+		cpAssertHard(reader.valid, "Internal Error: Snapshot changed between checking it and applying it.");
+		
+		RebuildIndexes(space, &objects);
+		cpfree(reader.arbiters);
+	}
+	
+	cpfree(arbiterShapes);
+	FreeObjects(&objects);
+	return valid;
+}
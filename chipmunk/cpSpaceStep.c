@@ -19,6 +19,8 @@
  * SOFTWARE.
  */
 
+#include <string.h>
+
 #include "chipmunk/chipmunk_private.h"
 
 //MARK: Post Step Callback Functions
@@ -45,7 +47,14 @@ cpSpaceAddPostStepCallback(cpSpace *space, cpPostStepFunc func, void *key, void
 		"Post-step callbacks will not called until the end of the next call to cpSpaceStep() or the next query.");
 	
 	if(!cpSpaceGetPostStepCallback(space, key)){
-		cpPostStepCallback *callback = (cpPostStepCallback *)cpcalloc(1, sizeof(cpPostStepCallback));
+		if(space->pooledPostStepCallbacks->num == 0){
+			// callback pool is exhausted, make more
+			int count = CP_BUFFER_BYTES/sizeof(cpPostStepCallback);
+			cpPostStepCallback *buffer = (cpPostStepCallback *)cpArenaAlloc(&space->persistentArena, CP_BUFFER_BYTES);
+			for(int i=0; i<count; i++) cpArrayPush(space->pooledPostStepCallbacks, buffer + i);
+		}
+		
+		cpPostStepCallback *callback = (cpPostStepCallback *)cpArrayPop(space->pooledPostStepCallbacks);
 		callback->func = (func ? func : PostStepDoNothing);
 		callback->key = key;
 		callback->data = data;
@@ -95,7 +104,7 @@ cpSpaceUnlock(cpSpace *space, cpBool runPostStep)
 				if(func) func(space, callback->key, callback->data);
 				
 				arr->arr[i] = NULL;
-				cpfree(callback);
+				cpArrayPush(space->pooledPostStepCallbacks, callback);
 			}
 			
 			arr->num = 0;
@@ -121,8 +130,7 @@ typedef struct cpContactBuffer {
 static cpContactBufferHeader *
 cpSpaceAllocContactBuffer(cpSpace *space)
 {
-	cpContactBuffer *buffer = (cpContactBuffer *)cpcalloc(1, sizeof(cpContactBuffer));
-	cpArrayPush(space->allocatedBuffers, buffer);
+	cpContactBuffer *buffer = (cpContactBuffer *)cpArenaAlloc(&space->persistentArena, sizeof(cpContactBuffer));
 	return (cpContactBufferHeader *)buffer;
 }
 
@@ -157,6 +165,23 @@ cpSpacePushFreshContactBuffer(cpSpace *space)
 	}
 }
 
+// Let the ring reuse every buffer, then start a fresh one for the current step.
+// Used when the arbiters' contacts are replaced wholesale, like when restoring a snapshot.
+void
+cpSpaceResetContactBuffers(cpSpace *space)
+{
+	cpContactBufferHeader *head = space->contactBuffersHead;
+	if(head){
+		cpContactBufferHeader *buffer = head;
+		do {
+			buffer->stamp = space->stamp - space->collisionPersistence - 1;
+			buffer = buffer->next;
+		} while(buffer != head);
+	}
+	
+	cpSpacePushFreshContactBuffer(space);
+}
+
 
 struct cpContact *
 cpContactBufferGetArray(cpSpace *space)
@@ -184,7 +209,7 @@ cpSpacePopContacts(cpSpace *space, int count){
 
 //MARK: Collision Detection Functions
 
-static void *
+void *
 cpSpaceArbiterSetTrans(cpShape **shapes, cpSpace *space)
 {
 	if(space->pooledArbiters->num == 0){
@@ -192,8 +217,7 @@ cpSpaceArbiterSetTrans(cpShape **shapes, cpSpace *space)
 		int count = CP_BUFFER_BYTES/sizeof(cpArbiter);
 		cpAssertHard(count, "Internal Error: Buffer size too small.");
 		
-		cpArbiter *buffer = (cpArbiter *)cpcalloc(1, CP_BUFFER_BYTES);
-		cpArrayPush(space->allocatedBuffers, buffer);
+		cpArbiter *buffer = (cpArbiter *)cpArenaAlloc(&space->persistentArena, CP_BUFFER_BYTES);
 		
 		for(int i=0; i<count; i++) cpArrayPush(space->pooledArbiters, buffer + i);
 	}
@@ -231,15 +255,84 @@ QueryReject(cpShape *a, cpShape *b)
 	);
 }
 
-// Callback from the spatial hash.
-cpCollisionID
-cpSpaceCollideShapes(cpShape *a, cpShape *b, cpCollisionID id, cpSpace *space)
+void *
+cpSpaceTriggerPairSetTrans(cpShape **shapes, cpSpace *space)
 {
-	// Reject any of the simple cases
-	if(QueryReject(a,b)) return id;
+	if(space->pooledTriggerPairs->num == 0){
+		// trigger pair pool is exhausted, make more
+		int count = CP_BUFFER_BYTES/sizeof(cpTriggerPair);
+		cpTriggerPair *buffer = (cpTriggerPair *)cpArenaAlloc(&space->persistentArena, CP_BUFFER_BYTES);
+		
+		for(int i=0; i<count; i++) cpArrayPush(space->pooledTriggerPairs, buffer + i);
+	}
+	
+	cpTriggerPair *pair = (cpTriggerPair *)cpArrayPop(space->pooledTriggerPairs);
+	pair->a = shapes[0];
+	pair->b = shapes[1];
+	pair->handler = NULL;
+	pair->stamp = 0;
+	
+	return pair;
+}
+
+// Triggers skip the narrow phase and arbiters entirely.
+// Only the overlapping pairs are remembered, so the exit callbacks can be called when they stop overlapping.
+static void
+cpSpaceTriggerShapes(cpSpace *space, cpShape *a, cpShape *b)
+{
+	cpCollisionHandler *handler = cpSpaceLookupHandler(space, a->type, b->type, &space->defaultHandler);
+	
+	// Nothing is listening for this pair.
+	if(!handler->triggerEnterFunc && !handler->triggerExitFunc) return;
+	
+	if(!cpShapesOverlap(a, b)){
+		// A continuous body that passed all the way through still counts as an overlap for this step.
+		if(!(a->body->continuous || b->body->continuous)) return;
+		if(cpShapesTimeOfImpact(a, b, space->curr_dt, space->collisionSlop) > 1.0f) return;
+	}
+	
+	// Pass the shapes to the callbacks in the order of the handler's types.
+	if(a->type != handler->typeA && handler->typeA != CP_WILDCARD_COLLISION_TYPE){
+		cpShape *swap = a; a = b; b = swap;
+	}
+	
+	cpShape *shape_pair[] = {a, b};
+	cpHashValue pairHashID = CP_HASH_PAIR((cpHashValue)a, (cpHashValue)b);
+	cpTriggerPair *pair = (cpTriggerPair *)cpHashSetInsert(space->triggerPairs, pairHashID, shape_pair, (cpHashSetTransFunc)cpSpaceTriggerPairSetTrans, space);
+	
+	if(pair->stamp == 0){
+		pair->handler = handler;
+		if(handler->triggerEnterFunc) handler->triggerEnterFunc(a, b, space, handler->userData);
+	}
+	
+	pair->stamp = space->stamp;
+}
+
+// Pairs that are never solved can't stop a swept body, which may have passed all the way through the other shape.
+// They are collided where they first touched instead, so the callbacks still see the hit.
+static struct cpCollisionInfo
+cpSpaceCollideSwept(cpSpace *space, cpShape *a, cpShape *b, struct cpCollisionInfo info)
+{
+	if(!(a->sensor || b->sensor || (a->body->m == INFINITY && b->body->m == INFINITY))) return info;
+	
+	cpFloat dt = space->curr_dt;
+	cpFloat t = cpShapesTimeOfImpact(a, b, dt, space->collisionSlop);
+	if(t > 1.0f) return info;
+	
+	return cpCollideAt(a, b, t, dt, info.id, cpContactBufferGetArray(space));
+}
+
+static cpCollisionID
+cpSpaceCollidePair(cpSpace *space, cpShape *a, cpShape *b, cpCollisionID id)
+{
+	if(a->trigger || b->trigger){
+		cpSpaceTriggerShapes(space, a, b);
+		return id;
+	}
 	
 	// Narrow-phase collision detection.
 	struct cpCollisionInfo info = cpCollide(a, b, id, cpContactBufferGetArray(space));
+	if(info.count == 0 && (cpBodyIsSwept(a->body) || cpBodyIsSwept(b->body))) info = cpSpaceCollideSwept(space, a, b, info);
 	
 	if(info.count == 0) return info.id; // Shapes are not colliding.
 	cpSpacePushContacts(space, info.count);
@@ -288,6 +381,71 @@ cpSpaceCollideShapes(cpShape *a, cpShape *b, cpCollisionID id, cpSpace *space)
 	return info.id;
 }
 
+typedef struct cpSweptPair {
+	cpShape *a, *b;
+	cpCollisionID id;
+} cpSweptPair;
+
+// Callback from the spatial hash.
+cpCollisionID
+cpSpaceCollideShapes(cpShape *a, cpShape *b, cpCollisionID id, cpSpace *space)
+{
+	// Reject any of the simple cases
+	if(QueryReject(a,b)) return id;
+	
+	// A swept body may still be moved back by one of its other pairs, so its pairs wait until they all have been found.
+	if(cpBodyIsSwept(a->body) || cpBodyIsSwept(b->body)){
+		cpSweptPair *pair = (cpSweptPair *)cpArenaAlloc(&space->scratchArena, sizeof(cpSweptPair));
+		pair->a = a;
+		pair->b = b;
+		pair->id = id;
+		cpArrayPush(space->sweptPairs, pair);
+		
+		return id;
+	}
+	
+	return cpSpaceCollidePair(space, a, b, id);
+}
+
+// Move each swept dynamic body back to the earliest impact of its solved pairs, then collide the swept pairs where
+// the bodies ended up. Nothing is collided before every body has been moved, so no contacts come from stale poses.
+static void
+cpSpaceCollideSweptPairs(cpSpace *space)
+{
+	cpArray *pairs = space->sweptPairs;
+	cpFloat dt = space->curr_dt;
+	
+	for(int i=0; i<pairs->num; i++){
+		cpSweptPair *pair = (cpSweptPair *)pairs->arr[i];
+		cpShape *a = pair->a, *b = pair->b;
+		
+		// Only pairs that are solved stop a body.
+		if(a->trigger || b->trigger || a->sensor || b->sensor || (a->body->m == INFINITY && b->body->m == INFINITY)) continue;
+		
+		cpFloat t = cpShapesTimeOfImpact(a, b, dt, space->collisionSlop);
+		if(t > 1.0f) continue;
+		
+		cpBodySweepRewind(a->body, t, dt);
+		cpBodySweepRewind(b->body, t, dt);
+	}
+	
+	// The bodies that weren't moved back still have the bounding boxes of their whole motion.
+	cpArray *bodies = space->dynamicBodies;
+	for(int i=0; i<bodies->num; i++){
+		cpBody *body = (cpBody *)bodies->arr[i];
+		if(cpBodyIsSwept(body) && body->impactTime == 1.0f){
+			CP_BODY_FOREACH_SHAPE(body, shape) cpShapeCacheBB(shape);
+		}
+	}
+	
+	for(int i=0; i<pairs->num; i++){
+		cpSweptPair *pair = (cpSweptPair *)pairs->arr[i];
+		cpSpaceCollidePair(space, pair->a, pair->b, pair->id);
+	}
+	
+	pairs->num = 0;
+}
+
 // Hashset filter func to throw away old arbiters.
 cpBool
 cpSpaceArbiterSetFilter(cpArbiter *arb, cpSpace *space)
@@ -324,6 +482,314 @@ cpSpaceArbiterSetFilter(cpArbiter *arb, cpSpace *space)
 	return cpTrue;
 }
 
+// Hashset filter func to call the exit callbacks of trigger pairs that stopped overlapping.
+cpBool
+cpSpaceTriggerPairSetFilter(cpTriggerPair *pair, cpSpace *space)
+{
+	if(pair->stamp == space->stamp) return cpTrue;
+	
+	// Sleeping and static shapes aren't checked against each other, so keep their pairs like their arbiters.
+	cpBody *a = pair->a->body, *b = pair->b->body;
+	if(
+		(cpBodyGetType(a) == CP_BODY_TYPE_STATIC || cpBodyIsSleeping(a)) &&
+		(cpBodyGetType(b) == CP_BODY_TYPE_STATIC || cpBodyIsSleeping(b))
+	){
+		return cpTrue;
+	}
+	
+	cpCollisionHandler *handler = pair->handler;
+	if(handler->triggerExitFunc) handler->triggerExitFunc(pair->a, pair->b, space, handler->userData);
+	
+	cpArrayPush(space->pooledTriggerPairs, pair);
+	return cpFalse;
+}
+
+//MARK: Packed Solver
+
+// The solver makes many passes over the arbiters, each one touching two bodies and the contacts. In the order
+// arbiters are found, these jump all over memory. The packed solver copies them into one array ordered by contact
+// graph component and then by body, with the contacts packed right after each other in the same order, and solves
+// that instead. The accumulated impulses are copied back to the arbiters afterwards for warm starting and for the
+// callbacks. Solving in a different order gives slightly different (but equally valid) results than the space order.
+// Enabled with CP_USE_PACKED_SOLVER.
+
+#if CP_USE_PACKED_SOLVER
+
+static void
+cpSpacePackArbiters(cpSpace *space)
+{
+	cpArena *arena = &space->scratchArena;
+	cpArray *arbiters = space->arbiters;
+	int count = arbiters->num;
+	
+	cpArbiter **order = (cpArbiter **)cpArenaAlloc(arena, count*sizeof(cpArbiter *));
+	if(cpSpaceArbiterSolverOrder(space, order) != count){
+		cpAssertSoft(cpFalse, "Internal Error: The contact graph doesn't match the space's arbiters.");
+		memcpy(order, arbiters->arr, count*sizeof(cpArbiter *));
+	}
+	
+	int contactCount = 0;
+	for(int i=0; i<count; i++) contactCount += order[i]->count;
+	
+	cpSolverArbiter *packed = (cpSolverArbiter *)cpArenaAlloc(arena, count*sizeof(cpSolverArbiter));
+	struct cpContact *contacts = (struct cpContact *)cpArenaAlloc(arena, contactCount*sizeof(struct cpContact));
+	
+	for(int i=0; i<count; i++){
+		cpArbiter *arb = order[i];
+		cpSolverArbiter *solverArb = packed + i;
+		
+		solverArb->body_a = arb->body_a;
+		solverArb->body_b = arb->body_b;
+		solverArb->n = arb->n;
+		solverArb->surface_vr = arb->surface_vr;
+		solverArb->e = arb->e;
+		solverArb->u = arb->u;
+		solverArb->firstContact = cpArbiterIsFirstContact(arb);
+		
+		solverArb->count = arb->count;
+		solverArb->contacts = contacts;
+		solverArb->arb = arb;
+		
+		memcpy(contacts, arb->contacts, arb->count*sizeof(struct cpContact));
+		contacts += arb->count;
+	}
+	
+	space->solverArbiters = packed;
+}
+
+static void
+cpSpaceUnpackArbiters(cpSpace *space)
+{
+	cpSolverArbiter *packed = space->solverArbiters;
+	for(int i=0, count=space->arbiters->num; i<count; i++){
+		cpSolverArbiter *solverArb = packed + i;
+		memcpy(solverArb->arb->contacts, solverArb->contacts, solverArb->count*sizeof(struct cpContact));
+	}
+	
+	// The packed copies are in the scratch arena and are recycled by the next step.
+	space->solverArbiters = NULL;
+}
+
+static void
+cpSpaceArbitersPreStep(cpSpace *space, cpFloat dt, cpFloat slop, cpFloat biasCoef)
+{
+	cpSpacePackArbiters(space);
+	
+	cpSolverArbiter *packed = space->solverArbiters;
+	for(int i=0, count=space->arbiters->num; i<count; i++){
+		cpSolverArbiterPreStep(packed + i, dt, slop, biasCoef);
+	}
+}
+
+static void
+cpSpaceArbitersApplyCachedImpulse(cpSpace *space, cpFloat dt_coef)
+{
+	cpSolverArbiter *packed = space->solverArbiters;
+	for(int i=0, count=space->arbiters->num; i<count; i++){
+		cpSolverArbiterApplyCachedImpulse(packed + i, dt_coef);
+	}
+}
+
+static void
+cpSpaceArbitersApplyImpulse(cpSpace *space)
+{
+	cpSolverArbiter *packed = space->solverArbiters;
+	for(int i=0, count=space->arbiters->num; i<count; i++){
+		cpSolverArbiterApplyImpulse(packed + i);
+	}
+}
+
+static void
+cpSpaceArbitersFinishSolve(cpSpace *space)
+{
+	cpSpaceUnpackArbiters(space);
+}
+
+#else
+
+static void
+cpSpaceArbitersPreStep(cpSpace *space, cpFloat dt, cpFloat slop, cpFloat biasCoef)
+{
+	cpArray *arbiters = space->arbiters;
+	for(int i=0; i<arbiters->num; i++){
+		cpArbiterPreStep((cpArbiter *)arbiters->arr[i], dt, slop, biasCoef);
+	}
+}
+
+static void
+cpSpaceArbitersApplyCachedImpulse(cpSpace *space, cpFloat dt_coef)
+{
+	cpArray *arbiters = space->arbiters;
+	for(int i=0; i<arbiters->num; i++){
+		cpArbiterApplyCachedImpulse((cpArbiter *)arbiters->arr[i], dt_coef);
+	}
+}
+
+static void
+cpSpaceArbitersApplyImpulse(cpSpace *space)
+{
+	cpArray *arbiters = space->arbiters;
+	for(int j=0; j<arbiters->num; j++){
+		cpArbiterApplyImpulse((cpArbiter *)arbiters->arr[j]);
+	}
+}
+
+static void
+cpSpaceArbitersFinishSolve(cpSpace *space){}
+
+#endif
+
+//MARK: Solver
+
+static void
+cpSpacePreStepArbiters(cpSpace *space, cpFloat dt, cpFloat slop, cpFloat biasCoef)
+{
+#if CP_USE_THREADS
+	if(space->solverPool){
+		cpSpacePreStepIslands(space, dt, slop, biasCoef);
+		return;
+	}
+#endif
+	
+	cpSpaceArbitersPreStep(space, dt, slop, biasCoef);
+}
+
+static void
+cpSpaceSolve(cpSpace *space, cpFloat dt, cpFloat dt_coef)
+{
+#if CP_USE_THREADS
+	if(space->solverPool){
+		cpSpaceSolveIslands(space, dt, dt_coef);
+		return;
+	}
+#endif
+	
+	cpArray *constraints = space->constraints;
+	
+	// Apply cached impulses
+	cpSpaceArbitersApplyCachedImpulse(space, dt_coef);
+	
+	for(int i=0; i<constraints->num; i++){
+		cpConstraint *constraint = (cpConstraint *)constraints->arr[i];
+		constraint->klass->applyCachedImpulse(constraint, dt_coef);
+	}
+	
+	// Run the impulse solver.
+	for(int i=0; i<space->iterations; i++){
+		cpSpaceArbitersApplyImpulse(space);
+			
+		for(int j=0; j<constraints->num; j++){
+			cpConstraint *constraint = (cpConstraint *)constraints->arr[j];
+			constraint->klass->applyImpulse(constraint, dt);
+		}
+	}
+	
+	cpSpaceArbitersFinishSolve(space);
+}
+
+//MARK: Step Profiler
+
+// With CP_USE_STEP_PROFILE, each phase of a step reads the profiler clock when it ends and adds the time since the
+// previous reading to its total. Without it the phase marks compile away to nothing.
+
+#if CP_USE_STEP_PROFILE
+
+#define PROFILE_PHASE(space, phase) cpSpaceProfilePhase(space, phase)
+
+static inline void
+cpSpaceProfilePhase(cpSpace *space, cpStepPhase phase)
+{
+	cpStepClockFunc clock = space->profileClock;
+	if(clock){
+		uint64_t now = clock();
+		space->profile.phases[phase] += now - space->profileMark;
+		space->profileMark = now;
+	}
+}
+
+// Collide a pair found by the broadphase, timing the narrow phase separately from the query calling it.
+static cpCollisionID
+cpSpaceCollideShapesProfiled(cpShape *a, cpShape *b, cpCollisionID id, cpSpace *space)
+{
+	cpSpaceProfilePhase(space, CP_STEP_PHASE_BROADPHASE);
+	space->profile.pairs++;
+	
+	id = cpSpaceCollideShapes(a, b, id, space);
+	
+	cpSpaceProfilePhase(space, CP_STEP_PHASE_NARROWPHASE);
+	return id;
+}
+
+static void
+cpSpaceProfileBegin(cpSpace *space)
+{
+	cpStepClockFunc clock = space->profileClock;
+	if(clock){
+		memset(&space->profile, 0, sizeof(cpStepProfile));
+		space->profileMark = clock();
+	}
+}
+
+static void
+cpSpaceProfileEnd(cpSpace *space, uint64_t start)
+{
+	cpStepClockFunc clock = space->profileClock;
+	if(!clock) return;
+	
+	cpStepProfile *profile = &space->profile;
+	profile->stamp = space->stamp;
+	profile->total = clock() - start;
+	profile->substeps = space->substeps;
+	profile->iterations = space->iterations;
+	
+	cpArray *arbiters = space->arbiters;
+	profile->arbiters = arbiters->num;
+	for(int i=0; i<arbiters->num; i++) profile->contacts += ((cpArbiter *)arbiters->arr[i])->count;
+	
+	space->profiles[space->profileNext] = (*profile);
+	space->profileNext = (space->profileNext + 1)%space->profileCapacity;
+	if(space->profileCount < space->profileCapacity) space->profileCount++;
+}
+
+void
+cpSpaceSetStepProfiler(cpSpace *space, cpStepClockFunc clock, cpStepProfile *buffer, int capacity)
+{
+	cpAssertSpaceUnlocked(space);
+	
+	if(clock){
+		cpAssertHard(buffer && capacity > 0, "A step profiler needs a buffer.");
+		space->profiles = buffer;
+		space->profileCapacity = capacity;
+	} else {
+		space->profiles = NULL;
+		space->profileCapacity = 0;
+	}
+	
+	space->profileClock = clock;
+	space->profileCount = space->profileNext = 0;
+}
+
+int
+cpSpaceGetStepProfileCount(const cpSpace *space)
+{
+	return space->profileCount;
+}
+
+const cpStepProfile *
+cpSpaceGetStepProfile(const cpSpace *space, int index)
+{
+	if(index < 0 || index >= space->profileCount) return NULL;
+	
+	int capacity = space->profileCapacity;
+	return space->profiles + (space->profileNext - 1 - index + capacity)%capacity;
+}
+
+#else
+
+#define PROFILE_PHASE(space, phase)
+
+#endif
+
 //MARK: All Important cpSpaceStep() Function
 
  void
@@ -332,14 +798,33 @@ cpShapeUpdateFunc(cpShape *shape, void *unused)
 	cpShapeCacheBB(shape);
 }
 
-void
-cpSpaceStep(cpSpace *space, cpFloat dt)
+// Shapes of continuous bodies get the bounding box of their whole motion over the step.
+static void
+cpShapeUpdateSweptFunc(cpShape *shape, cpSpace *space)
+{
+	cpBody *body = shape->body;
+	
+	if(body->continuous){
+		body->impactTime = 1.0f;
+		cpBB start = cpShapeUpdate(shape, cpBodySweepTransform(body, 0.0f, space->curr_dt));
+		shape->bb = cpBBMerge(start, cpShapeCacheBB(shape));
+	} else {
+		cpShapeCacheBB(shape);
+	}
+}
+
+static void
+cpSpaceSubstep(cpSpace *space, cpFloat dt)
 {
-	// don't step if the timestep is 0!
-	if(dt == 0.0f) return;
 	
 	space->stamp++;
 	
+	// Recycle last step's scratch memory.
+	cpArenaReset(&space->scratchArena);
+	
+	cpSpaceUpdateBroadphase(space);
+	PROFILE_PHASE(space, CP_STEP_PHASE_BROADPHASE);
+	
 	cpFloat prev_dt = space->curr_dt;
 	space->curr_dt = dt;
 		
@@ -358,6 +843,12 @@ cpSpaceStep(cpSpace *space, cpFloat dt)
 		}
 	}
 	arbiters->num = 0;
+	PROFILE_PHASE(space, CP_STEP_PHASE_COMPONENTS);
+	
+	cpSpatialIndexQueryFunc collide = (cpSpatialIndexQueryFunc)cpSpaceCollideShapes;
+#if CP_USE_STEP_PROFILE
+	if(space->profileClock) collide = (cpSpatialIndexQueryFunc)cpSpaceCollideShapesProfiled;
+#endif
 
 	cpSpaceLock(space); {
 		// Integrate positions
@@ -365,26 +856,31 @@ cpSpaceStep(cpSpace *space, cpFloat dt)
 			cpBody *body = (cpBody *)bodies->arr[i];
 			body->position_func(body, dt);
 		}
+		PROFILE_PHASE(space, CP_STEP_PHASE_INTEGRATE);
 		
 		// Find colliding pairs.
 		cpSpacePushFreshContactBuffer(space);
-		cpSpatialIndexEach(space->dynamicShapes, (cpSpatialIndexIteratorFunc)cpShapeUpdateFunc, NULL);
-		cpSpatialIndexReindexQuery(space->dynamicShapes, (cpSpatialIndexQueryFunc)cpSpaceCollideShapes, space);
+		cpSpatialIndexEach(space->dynamicShapes, (cpSpatialIndexIteratorFunc)cpShapeUpdateSweptFunc, space);
+		cpSpatialIndexReindexQuery(space->dynamicShapes, collide, space);
+		PROFILE_PHASE(space, CP_STEP_PHASE_BROADPHASE);
+		
+		cpSpaceCollideSweptPairs(space);
+		PROFILE_PHASE(space, CP_STEP_PHASE_NARROWPHASE);
 	} cpSpaceUnlock(space, cpFalse);
 	
 	// Rebuild the contact graph (and detect sleeping components if sleeping is enabled)
 	cpSpaceProcessComponents(space, dt);
 	
 	cpSpaceLock(space); {
-		// Clear out old cached arbiters and call separate callbacks
+		// Clear out old cached arbiters and trigger pairs, and call the separate and trigger exit callbacks
 		cpHashSetFilter(space->cachedArbiters, (cpHashSetFilterFunc)cpSpaceArbiterSetFilter, space);
+		cpHashSetFilter(space->triggerPairs, (cpHashSetFilterFunc)cpSpaceTriggerPairSetFilter, space);
+		PROFILE_PHASE(space, CP_STEP_PHASE_COMPONENTS);
 
 		// Prestep the arbiters and constraints.
 		cpFloat slop = space->collisionSlop;
 		cpFloat biasCoef = 1.0f - cpfpow(space->collisionBias, dt);
-		for(int i=0; i<arbiters->num; i++){
-			cpArbiterPreStep((cpArbiter *)arbiters->arr[i], dt, slop, biasCoef);
-		}
+		cpSpacePreStepArbiters(space, dt, slop, biasCoef);
 
 		for(int i=0; i<constraints->num; i++){
 			cpConstraint *constraint = (cpConstraint *)constraints->arr[i];
@@ -394,6 +890,7 @@ cpSpaceStep(cpSpace *space, cpFloat dt)
 			
 			constraint->klass->preStep(constraint, dt);
 		}
+		PROFILE_PHASE(space, CP_STEP_PHASE_PRESTEP);
 	
 		// Integrate velocities.
 		cpFloat damping = cpfpow(space->damping, dt);
@@ -402,29 +899,12 @@ cpSpaceStep(cpSpace *space, cpFloat dt)
 			cpBody *body = (cpBody *)bodies->arr[i];
 			body->velocity_func(body, gravity, damping, dt);
 		}
+		PROFILE_PHASE(space, CP_STEP_PHASE_INTEGRATE);
 		
-		// Apply cached impulses
+		// Apply cached impulses and run the impulse solver.
 		cpFloat dt_coef = (prev_dt == 0.0f ? 0.0f : dt/prev_dt);
-		for(int i=0; i<arbiters->num; i++){
-			cpArbiterApplyCachedImpulse((cpArbiter *)arbiters->arr[i], dt_coef);
-		}
-		
-		for(int i=0; i<constraints->num; i++){
-			cpConstraint *constraint = (cpConstraint *)constraints->arr[i];
-			constraint->klass->applyCachedImpulse(constraint, dt_coef);
-		}
-		
-		// Run the impulse solver.
-		for(int i=0; i<space->iterations; i++){
-			for(int j=0; j<arbiters->num; j++){
-				cpArbiterApplyImpulse((cpArbiter *)arbiters->arr[j]);
-			}
-				
-			for(int j=0; j<constraints->num; j++){
-				cpConstraint *constraint = (cpConstraint *)constraints->arr[j];
-				constraint->klass->applyImpulse(constraint, dt);
-			}
-		}
+		cpSpaceSolve(space, dt, dt_coef);
+		PROFILE_PHASE(space, CP_STEP_PHASE_SOLVER);
 		
 		// Run the constraint post-solve callbacks
 		for(int i=0; i<constraints->num; i++){
@@ -442,4 +922,128 @@ cpSpaceStep(cpSpace *space, cpFloat dt)
 			handler->postSolveFunc(arb, space, handler->userData);
 		}
 	} cpSpaceUnlock(space, cpTrue);
+	PROFILE_PHASE(space, CP_STEP_PHASE_POST_SOLVE);
+}
+
+//MARK: Step Budget
+
+// Below this fraction of the target there is room to raise the quality, but only to a setting estimated to
+// take less than the high fraction. The headroom keeps timing noise from flipping between two settings.
+#define STEP_BUDGET_LOW 0.75f
+#define STEP_BUDGET_HIGH 0.9f
+
+static inline int
+ClampInt(int value, int min, int max)
+{
+	return (value < min ? min : (value > max ? max : value));
+}
+
+void
+cpSpaceSetStepBudget(cpSpace *space, const cpStepBudget *budget)
+{
+	if(budget){
+		cpAssertHard(budget->clock, "A step budget needs a clock.");
+		cpAssertHard(0 < budget->minIterations && budget->minIterations <= budget->maxIterations, "Invalid iteration range.");
+		cpAssertHard(0 < budget->minSubsteps && budget->minSubsteps <= budget->maxSubsteps, "Invalid substep range.");
+		
+		space->stepBudget = (*budget);
+		space->prevStepTime = CP_NO_STEP_TIME;
+		space->iterations = ClampInt(space->iterations, budget->minIterations, budget->maxIterations);
+		space->substeps = budget->minSubsteps;
+	} else {
+		space->substeps = 1;
+	}
+	
+	space->useStepBudget = (budget != NULL);
+}
+
+int
+cpSpaceGetSubsteps(const cpSpace *space)
+{
+	return space->substeps;
+}
+
+uint64_t
+cpSpaceGetLastStepTime(const cpSpace *space)
+{
+	return space->lastStepTime;
+}
+
+// Scale 'value' down by the ratio, dropping at least one notch.
+static inline int
+ScaleDown(int value, cpFloat ratio, int min)
+{
+	int scaled = (int)(value*ratio);
+	return ClampInt(scaled < value ? scaled : value - 1, min, value);
+}
+
+// Pick the iterations and substeps for the next step from the time the last two steps took at the current settings.
+// Cost is roughly proportional to substeps*iterations. Over budget the quality is cut in proportion, substeps first
+// since each one also repeats collision detection. Under budget it's raised one notch at a time, if the estimated
+// cost of the next notch leaves some headroom. Cutting on the faster of the two steps and raising on the slower one
+// keeps a single slow step (an interrupt, a burst of new contacts) from changing anything.
+static void
+cpSpaceUpdateStepBudget(cpSpace *space, uint64_t time)
+{
+	const cpStepBudget *budget = &space->stepBudget;
+	int iterations = space->iterations, substeps = space->substeps;
+	uint64_t prev = space->prevStepTime;
+	
+	// Wait for a second step at these settings.
+	space->prevStepTime = time;
+	if(prev == CP_NO_STEP_TIME) return;
+	
+	cpFloat target = (cpFloat)budget->target;
+	cpFloat fast = (cpFloat)(time < prev ? time : prev);
+	cpFloat slow = (cpFloat)(time > prev ? time : prev);
+	
+	if(fast > target){
+		cpFloat ratio = target/fast;
+		
+		if(substeps > budget->minSubsteps){
+			space->substeps = ScaleDown(substeps, ratio, budget->minSubsteps);
+		} else {
+			space->iterations = ScaleDown(iterations, ratio, budget->minIterations);
+		}
+	} else if(slow < STEP_BUDGET_LOW*target){
+		cpFloat limit = STEP_BUDGET_HIGH*target;
+		
+		if(iterations < budget->maxIterations){
+			if(slow*(iterations + 1)/iterations < limit) space->iterations = iterations + 1;
+		} else if(substeps < budget->maxSubsteps){
+			if(slow*(substeps + 1)/substeps < limit) space->substeps = substeps + 1;
+		}
+	}
+	
+	// Older times don't say anything about the new settings.
+	if(space->iterations != iterations || space->substeps != substeps) space->prevStepTime = CP_NO_STEP_TIME;
+}
+
+void
+cpSpaceStep(cpSpace *space, cpFloat dt)
+{
+	// don't step if the timestep is 0!
+	if(dt == 0.0f) return;
+	
+#if CP_USE_STEP_PROFILE
+	cpSpaceProfileBegin(space);
+	uint64_t profileStart = space->profileMark;
+#endif
+	
+	if(!space->useStepBudget){
+		cpSpaceSubstep(space, dt);
+	} else {
+		cpStepClockFunc clock = space->stepBudget.clock;
+		uint64_t start = clock();
+		
+		int substeps = space->substeps;
+		for(int i=0; i<substeps; i++) cpSpaceSubstep(space, dt/substeps);
+		
+		space->lastStepTime = clock() - start;
+		cpSpaceUpdateStepBudget(space, space->lastStepTime);
+	}
+	
+#if CP_USE_STEP_PROFILE
+	cpSpaceProfileEnd(space, profileStart);
+#endif
 }
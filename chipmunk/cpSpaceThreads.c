@@ -0,0 +1,327 @@
+#include <stdlib.h>
+
+#include "chipmunk/chipmunk_private.h"
+
+#if CP_USE_THREADS
+
+#include <pthread.h>
+
+// Islands are the groups of arbiters and constraints that belong to the same contact graph component.
+// They share no dynamic bodies, so they can be solved on different threads. Within an island the arbiters and
+// constraints keep their order from the space's arrays, so each body receives exactly the same sequence of
+// impulses as it does in the single threaded solver and the results are bit-identical for any thread count.
+// Static and kinematic bodies are shared between islands, but their zero inverse mass keeps the impulses
+// from changing their velocities.
+
+// Number of jobs handed out per thread, so uneven islands can be balanced between threads.
+#define JOBS_PER_THREAD 4
+
+typedef struct cpIsland {
+	int arbiterStart, arbiterCount;
+	int constraintStart, constraintCount;
+} cpIsland;
+
+typedef void (*cpSolverJobFunc)(cpSolverPool *pool, int job);
+
+struct cpSolverPool {
+	cpSpace *space;
+
+	int workerCount;
+	pthread_t *workers;
+	pthread_mutex_t mutex;
+	pthread_cond_t wake, done;
+	unsigned int generation;
+	int busy;
+	cpBool quit;
+
+	// The batch of jobs being run.
+	cpSolverJobFunc func;
+	int jobCount;
+	int nextJob;
+
+	// Islands for the current step, allocated from the scratch arena.
+	// Job i solves islands jobStarts[i] through jobStarts[i + 1] - 1.
+	cpArbiter **arbiters;
+	cpConstraint **constraints;
+	cpIsland *islands;
+	int *jobStarts;
+
+	cpFloat dt, slop, bias, dt_coef;
+};
+
+//MARK: Worker Pool
+
+static void
+RunJobs(cpSolverPool *pool)
+{
+	for(int job; (job = __atomic_fetch_add(&pool->nextJob, 1, __ATOMIC_RELAXED)) < pool->jobCount;){
+		pool->func(pool, job);
+	}
+}
+
+static void *
+WorkerThread(cpSolverPool *pool)
+{
+	unsigned int generation = 0;
+
+	pthread_mutex_lock(&pool->mutex);
+	for(;;){
+		while(!pool->quit && pool->generation == generation) pthread_cond_wait(&pool->wake, &pool->mutex);
+		if(pool->quit) break;
+
+		generation = pool->generation;
+		pthread_mutex_unlock(&pool->mutex);
+
+		RunJobs(pool);
+
+		pthread_mutex_lock(&pool->mutex);
+		if(--pool->busy == 0) pthread_cond_signal(&pool->done);
+	}
+	pthread_mutex_unlock(&pool->mutex);
+
+	return NULL;
+}
+
+// Run all the jobs using the workers and the calling thread, and wait for them to finish.
+static void
+RunBatch(cpSolverPool *pool, cpSolverJobFunc func)
+{
+	pool->func = func;
+	pool->nextJob = 0;
+
+	// Not worth waking the workers for a single job.
+	if(pool->jobCount <= 1){
+		RunJobs(pool);
+		return;
+	}
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->busy = pool->workerCount;
+	pool->generation++;
+	pthread_cond_broadcast(&pool->wake);
+	pthread_mutex_unlock(&pool->mutex);
+
+	RunJobs(pool);
+
+	pthread_mutex_lock(&pool->mutex);
+	while(pool->busy > 0) pthread_cond_wait(&pool->done, &pool->mutex);
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+static cpSolverPool *
+cpSolverPoolNew(cpSpace *space, int workerCount)
+{
+	cpSolverPool *pool = (cpSolverPool *)cpcalloc(1, sizeof(cpSolverPool));
+	pool->space = space;
+	pool->workerCount = workerCount;
+	pool->workers = (pthread_t *)cpcalloc(workerCount, sizeof(pthread_t));
+
+	pthread_mutex_init(&pool->mutex, NULL);
+	pthread_cond_init(&pool->wake, NULL);
+	pthread_cond_init(&pool->done, NULL);
+
+	for(int i=0; i<workerCount; i++){
+		int err = pthread_create(&pool->workers[i], NULL, (void *(*)(void *))WorkerThread, pool);
+		cpAssertHard(err == 0, "Could not create a solver thread (error %d).", err);
+	}
+
+	return pool;
+}
+
+void
+cpSolverPoolFree(cpSolverPool *pool)
+{
+	if(pool){
+		pthread_mutex_lock(&pool->mutex);
+		pool->quit = cpTrue;
+		pthread_cond_broadcast(&pool->wake);
+		pthread_mutex_unlock(&pool->mutex);
+
+		for(int i=0; i<pool->workerCount; i++) pthread_join(pool->workers[i], NULL);
+
+		pthread_cond_destroy(&pool->done);
+		pthread_cond_destroy(&pool->wake);
+		pthread_mutex_destroy(&pool->mutex);
+
+		cpfree(pool->workers);
+		cpfree(pool);
+	}
+}
+
+void
+cpSpaceSetThreads(cpSpace *space, int threads)
+{
+	cpAssertHard(threads > 0, "A space needs at least one thread to be solved.");
+	cpAssertSpaceUnlocked(space);
+
+	cpSolverPoolFree(space->solverPool);
+	space->solverPool = (threads > 1 ? cpSolverPoolNew(space, threads - 1) : NULL);
+}
+
+int
+cpSpaceGetThreads(const cpSpace *space)
+{
+	return (space->solverPool ? space->solverPool->workerCount + 1 : 1);
+}
+
+//MARK: Islands
+
+typedef struct IslandItem {
+	cpBody *root;
+	int index;
+} IslandItem;
+
+static int
+IslandItemCompare(const IslandItem *a, const IslandItem *b)
+{
+	uintptr_t ra = (uintptr_t)a->root, rb = (uintptr_t)b->root;
+	if(ra != rb) return (ra < rb ? -1 : 1);
+	return a->index - b->index;
+}
+
+// Group the items by component root, keeping their original order within each group.
+static IslandItem *
+SortedItems(cpArena *arena, cpBody **roots, int count)
+{
+	IslandItem *items = (IslandItem *)cpArenaAlloc(arena, count*sizeof(IslandItem));
+	for(int i=0; i<count; i++){
+		items[i].root = roots[i];
+		items[i].index = i;
+	}
+
+	qsort(items, count, sizeof(IslandItem), (int (*)(const void *, const void *))IslandItemCompare);
+	return items;
+}
+
+static void
+BuildIslands(cpSolverPool *pool, cpSpace *space)
+{
+	cpArena *arena = &space->scratchArena;
+	cpArray *arbiters = space->arbiters;
+	cpArray *constraints = space->constraints;
+	int arbiterCount = arbiters->num, constraintCount = constraints->num;
+
+	cpBody **arbiterRoots = (cpBody **)cpArenaAlloc(arena, arbiterCount*sizeof(cpBody *));
+	cpBody **constraintRoots = (cpBody **)cpArenaAlloc(arena, constraintCount*sizeof(cpBody *));
+	cpSpaceComponentRoots(space, arbiterRoots, constraintRoots);
+
+	IslandItem *arbiterItems = SortedItems(arena, arbiterRoots, arbiterCount);
+	IslandItem *constraintItems = SortedItems(arena, constraintRoots, constraintCount);
+
+	pool->arbiters = (cpArbiter **)cpArenaAlloc(arena, arbiterCount*sizeof(cpArbiter *));
+	for(int i=0; i<arbiterCount; i++) pool->arbiters[i] = (cpArbiter *)arbiters->arr[arbiterItems[i].index];
+
+	pool->constraints = (cpConstraint **)cpArenaAlloc(arena, constraintCount*sizeof(cpConstraint *));
+	for(int i=0; i<constraintCount; i++) pool->constraints[i] = (cpConstraint *)constraints->arr[constraintItems[i].index];
+
+	// Merge the runs of arbiters and constraints with the same root into islands.
+	// Islands are cut into jobs of roughly equal work.
+	int maxIslands = arbiterCount + constraintCount;
+	pool->islands = (cpIsland *)cpArenaAlloc(arena, maxIslands*sizeof(cpIsland));
+	pool->jobStarts = (int *)cpArenaAlloc(arena, (maxIslands + 1)*sizeof(int));
+
+	int jobWork = maxIslands/((pool->workerCount + 1)*JOBS_PER_THREAD) + 1;
+	int islandCount = 0, jobCount = 0, work = 0;
+	pool->jobStarts[0] = 0;
+
+	for(int i=0, j=0; i<arbiterCount || j<constraintCount;){
+		cpBody *root;
+		if(j == constraintCount || (i < arbiterCount && IslandItemCompare(arbiterItems + i, constraintItems + j) <= 0)){
+			root = arbiterItems[i].root;
+		} else {
+			root = constraintItems[j].root;
+		}
+
+		cpIsland *island = pool->islands + islandCount++;
+		island->arbiterStart = i;
+		island->constraintStart = j;
+		while(i < arbiterCount && arbiterItems[i].root == root) i++;
+		while(j < constraintCount && constraintItems[j].root == root) j++;
+		island->arbiterCount = i - island->arbiterStart;
+		island->constraintCount = j - island->constraintStart;
+
+		work += island->arbiterCount + island->constraintCount;
+		if(work >= jobWork){
+			pool->jobStarts[++jobCount] = islandCount;
+			work = 0;
+		}
+	}
+
+	if(work > 0) pool->jobStarts[++jobCount] = islandCount;
+	pool->jobCount = jobCount;
+}
+
+//MARK: Solver Jobs
+
+static void
+PreStepJob(cpSolverPool *pool, int job)
+{
+	for(int i=pool->jobStarts[job]; i<pool->jobStarts[job + 1]; i++){
+		cpIsland *island = pool->islands + i;
+		cpArbiter **arbiters = pool->arbiters + island->arbiterStart;
+
+		for(int j=0; j<island->arbiterCount; j++){
+			cpArbiterPreStep(arbiters[j], pool->dt, pool->slop, pool->bias);
+		}
+	}
+}
+
+static void
+SolveJob(cpSolverPool *pool, int job)
+{
+	cpFloat dt = pool->dt;
+	int iterations = pool->space->iterations;
+
+	for(int i=pool->jobStarts[job]; i<pool->jobStarts[job + 1]; i++){
+		cpIsland *island = pool->islands + i;
+		cpArbiter **arbiters = pool->arbiters + island->arbiterStart;
+		cpConstraint **constraints = pool->constraints + island->constraintStart;
+		int arbiterCount = island->arbiterCount, constraintCount = island->constraintCount;
+
+		// Apply cached impulses
+		for(int j=0; j<arbiterCount; j++){
+			cpArbiterApplyCachedImpulse(arbiters[j], pool->dt_coef);
+		}
+
+		for(int j=0; j<constraintCount; j++){
+			cpConstraint *constraint = constraints[j];
+			constraint->klass->applyCachedImpulse(constraint, pool->dt_coef);
+		}
+
+		// Run the impulse solver.
+		for(int k=0; k<iterations; k++){
+			for(int j=0; j<arbiterCount; j++){
+				cpArbiterApplyImpulse(arbiters[j]);
+			}
+
+			for(int j=0; j<constraintCount; j++){
+				cpConstraint *constraint = constraints[j];
+				constraint->klass->applyImpulse(constraint, dt);
+			}
+		}
+	}
+}
+
+void
+cpSpacePreStepIslands(cpSpace *space, cpFloat dt, cpFloat slop, cpFloat bias)
+{
+	cpSolverPool *pool = space->solverPool;
+	BuildIslands(pool, space);
+
+	pool->dt = dt;
+	pool->slop = slop;
+	pool->bias = bias;
+	RunBatch(pool, PreStepJob);
+}
+
+void
+cpSpaceSolveIslands(cpSpace *space, cpFloat dt, cpFloat dt_coef)
+{
+	cpSolverPool *pool = space->solverPool;
+
+	pool->dt = dt;
+	pool->dt_coef = dt_coef;
+	RunBatch(pool, SolveJob);
+}
+
+#endif
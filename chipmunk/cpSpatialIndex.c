@@ -36,6 +36,7 @@ cpSpatialIndexInit(cpSpatialIndex *index, cpSpatialIndexClass *klass, cpSpatialI
 	index->klass = klass;
 	index->bbfunc = bbfunc;
 	index->staticIndex = staticIndex;
+	index->arena = NULL;
 	
 	if(staticIndex){
 		cpAssertHard(!staticIndex->dynamicIndex, "This static index is already associated with a dynamic index.");
@@ -67,3 +68,58 @@ cpSpatialIndexCollideStatic(cpSpatialIndex *dynamicIndex, cpSpatialIndex *static
 	}
 }
 
+
+typedef struct batchQueryContext {
+	int query;
+	cpSpatialIndexBatchQueryFunc func;
+	void *data;
+} batchQueryContext;
+
+static cpCollisionID
+batchQueryIter(batchQueryContext *context, void *obj, cpCollisionID id, void *unused)
+{
+	context->func(context->query, obj, context->data);
+	return id;
+}
+
+void
+cpSpatialIndexQueryBatch(cpSpatialIndex *index, const cpBB *bbs, int count, cpSpatialIndexBatchQueryFunc func, void *data)
+{
+	if(index->klass->queryBatch){
+		index->klass->queryBatch(index, bbs, count, func, data);
+	} else {
+		batchQueryContext context = {0, func, data};
+		for(; context.query<count; context.query++){
+			cpSpatialIndexQuery(index, &context, bbs[context.query], (cpSpatialIndexQueryFunc)batchQueryIter, NULL);
+		}
+	}
+}
+
+typedef struct batchSegmentQueryContext {
+	int query;
+	cpSpatialIndexSegment *segment;
+	cpSpatialIndexBatchSegmentQueryFunc func;
+	void *data;
+} batchSegmentQueryContext;
+
+static cpFloat
+batchSegmentQueryIter(batchSegmentQueryContext *context, void *obj, void *unused)
+{
+	cpFloat t = context->func(context->query, obj, context->data);
+	context->segment->t_exit = cpfmin(context->segment->t_exit, t);
+	return t;
+}
+
+void
+cpSpatialIndexSegmentQueryBatch(cpSpatialIndex *index, cpSpatialIndexSegment *segments, int count, cpSpatialIndexBatchSegmentQueryFunc func, void *data)
+{
+	if(index->klass->segmentQueryBatch){
+		index->klass->segmentQueryBatch(index, segments, count, func, data);
+	} else {
+		batchSegmentQueryContext context = {0, segments, func, data};
+		for(; context.query<count; context.query++, context.segment++){
+			cpSpatialIndexSegment *segment = context.segment;
+			cpSpatialIndexSegmentQuery(index, &context, segment->a, segment->b, segment->t_exit, (cpSpatialIndexSegmentQueryFunc)batchSegmentQueryIter, NULL);
+		}
+	}
+}
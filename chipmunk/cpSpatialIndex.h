@@ -49,6 +49,18 @@ typedef void (*cpSpatialIndexIteratorFunc)(void *obj, void *data);
 typedef cpCollisionID (*cpSpatialIndexQueryFunc)(void *obj1, void *obj2, cpCollisionID id, void *data);
 /// Spatial segment query callback function type.
 typedef cpFloat (*cpSpatialIndexSegmentQueryFunc)(void *obj1, void *obj2, void *data);
+/// Spatial batch query callback function type. @c query is the index of the bounding box in the batch.
+typedef void (*cpSpatialIndexBatchQueryFunc)(int query, void *obj, void *data);
+/// Spatial batch segment query callback function type. @c query is the index of the segment in the batch.
+typedef cpFloat (*cpSpatialIndexBatchSegmentQueryFunc)(int query, void *obj, void *data);
+
+/// Segment for cpSpatialIndexSegmentQueryBatch().
+typedef struct cpSpatialIndexSegment {
+	cpVect a, b;
+	/// Objects past this fraction of the segment are skipped.
+	/// Lowered to the values the query function returns as the query runs.
+	cpFloat t_exit;
+} cpSpatialIndexSegment;
 
 
 typedef struct cpSpatialIndexClass cpSpatialIndexClass;
@@ -61,6 +73,9 @@ struct cpSpatialIndex {
 	cpSpatialIndexBBFunc bbfunc;
 	
 	cpSpatialIndex *staticIndex, *dynamicIndex;
+	
+	// Arena to allocate node pools from. NULL to use cpcalloc().
+	struct cpArena *arena;
 };
 
 
@@ -101,6 +116,27 @@ typedef cpVect (*cpBBTreeVelocityFunc)(void *obj);
 /// Set the velocity function for the bounding box tree to enable temporal coherence.
 CP_EXPORT void cpBBTreeSetVelocityFunc(cpSpatialIndex *index, cpBBTreeVelocityFunc func);
 
+/// Let the tree rebalance itself with tree rotations as it reinserts objects that moved.
+/// At most @c nodes nodes are examined between calls to cpSpatialIndexReindexQuery(), which the space makes once per step.
+/// 0 turns rebalancing off, which is the default.
+CP_EXPORT void cpBBTreeSetRebalanceBudget(cpSpatialIndex *index, int nodes);
+
+/// Shape of a bounding box tree, as measured by cpBBTreeGetQuality().
+typedef struct cpBBTreeQuality {
+	/// Number of leaves in the tree.
+	int leaves;
+	/// Depth of the deepest leaf. A lone leaf at the root has depth 0.
+	int maxDepth;
+	/// Average depth of the leaves.
+	cpFloat averageDepth;
+	/// Surface area heuristic cost: the summed area of the internal nodes divided by the area of the root.
+	/// This is roughly how many internal nodes a small query visits. Lower is better.
+	cpFloat sahCost;
+} cpBBTreeQuality;
+
+/// Measure the depth and the surface area heuristic cost of the tree.
+CP_EXPORT void cpBBTreeGetQuality(cpSpatialIndex *index, cpBBTreeQuality *quality);
+
 //MARK: Single Axis Sweep
 
 typedef struct cpSweep1D cpSweep1D;
@@ -112,6 +148,67 @@ CP_EXPORT cpSpatialIndex* cpSweep1DInit(cpSweep1D *sweep, cpSpatialIndexBBFunc b
 /// Allocate and initialize a 1D sort and sweep broadphase.
 CP_EXPORT cpSpatialIndex* cpSweep1DNew(cpSpatialIndexBBFunc bbfunc, cpSpatialIndex *staticIndex);
 
+/// Sweep along whichever axis the objects are spread out along the most instead of always along x.
+CP_EXPORT void cpSweep1DSetAutoAxis(cpSpatialIndex *index, cpBool autoAxis);
+
+//MARK: Uniform Grid
+
+typedef struct cpGrid cpGrid;
+
+/// Allocate a uniform grid.
+CP_EXPORT cpGrid* cpGridAlloc(void);
+/// Initialize a uniform grid covering @c bounds with square cells of size @c celldim.
+/// Objects outside of the bounds still work, but are lumped into the edge cells.
+CP_EXPORT cpSpatialIndex* cpGridInit(cpGrid *grid, cpBB bounds, cpFloat celldim, cpSpatialIndexBBFunc bbfunc, cpSpatialIndex *staticIndex);
+/// Allocate and initialize a uniform grid.
+CP_EXPORT cpSpatialIndex* cpGridNew(cpBB bounds, cpFloat celldim, cpSpatialIndexBBFunc bbfunc, cpSpatialIndex *staticIndex);
+
+//MARK: Broadphase Comparison
+
+/// Spatial index implementations that can be compared with cpBroadphaseReplay().
+typedef enum cpBroadphaseType {
+	CP_BROADPHASE_BBTREE,
+	CP_BROADPHASE_SPACE_HASH,
+	CP_BROADPHASE_SWEEP_1D,
+	CP_BROADPHASE_GRID,
+	CP_BROADPHASE_TYPE_COUNT,
+} cpBroadphaseType;
+
+/// A recorded population of bounding boxes, one frame per step.
+/// Each frame has @c capacity slots. A slot holding an empty box (l > r) has no object in that frame.
+typedef struct cpBroadphaseRecording {
+	int capacity;
+	int frames, maxFrames;
+	/// Timestep between frames. Used to estimate velocities for the bounding box tree. 0 if unknown.
+	cpFloat dt;
+	/// Caller owned buffer of capacity*maxFrames boxes.
+	cpBB *bbs;
+} cpBroadphaseRecording;
+
+/// Running totals returned by cpBroadphaseReplay(). Times are in the units of the clock function.
+typedef struct cpBroadphaseCost {
+	/// Inserting and removing objects that appear in or disappear from a frame.
+	uint64_t insertTime;
+	/// Updating the index after the objects moved, on its own.
+	uint64_t reindexTime;
+	/// A box query for every object in the frame.
+	uint64_t queryTime;
+	/// Updating the index and finding all overlapping pairs in one call, the way cpSpaceStep() does.
+	/// This is measured in a separate pass, so it's the broadphase cost of a step.
+	uint64_t pairTime;
+	/// Total number of overlapping pairs reported over all frames.
+	unsigned long pairs;
+} cpBroadphaseCost;
+
+/// Clock used to time a replay. Should return a monotonic tick count.
+typedef uint64_t (*cpBroadphaseClockFunc)(void);
+
+/// Initialize a recording that stores its frames in @c bbs.
+CP_EXPORT cpBroadphaseRecording* cpBroadphaseRecordingInit(cpBroadphaseRecording *recording, cpBB *bbs, int capacity, int maxFrames);
+/// Replay a recording through a fresh spatial index of the given type and add the costs to @c cost.
+/// The spatial hash and grid cells are sized from the objects in the first frame. The grid covers every box in the recording.
+CP_EXPORT void cpBroadphaseReplay(const cpBroadphaseRecording *recording, cpBroadphaseType type, cpBroadphaseClockFunc clock, cpBroadphaseCost *cost);
+
 //MARK: Spatial Index Implementation
 
 typedef void (*cpSpatialIndexDestroyImpl)(cpSpatialIndex *index);
@@ -130,6 +227,11 @@ typedef void (*cpSpatialIndexReindexQueryImpl)(cpSpatialIndex *index, cpSpatialI
 typedef void (*cpSpatialIndexQueryImpl)(cpSpatialIndex *index, void *obj, cpBB bb, cpSpatialIndexQueryFunc func, void *data);
 typedef void (*cpSpatialIndexSegmentQueryImpl)(cpSpatialIndex *index, void *obj, cpVect a, cpVect b, cpFloat t_exit, cpSpatialIndexSegmentQueryFunc func, void *data);
 
+typedef void (*cpSpatialIndexQueryBatchImpl)(cpSpatialIndex *index, const cpBB *bbs, int count, cpSpatialIndexBatchQueryFunc func, void *data);
+typedef void (*cpSpatialIndexSegmentQueryBatchImpl)(cpSpatialIndex *index, cpSpatialIndexSegment *segments, int count, cpSpatialIndexBatchSegmentQueryFunc func, void *data);
+
+typedef void (*cpSpatialIndexClearImpl)(cpSpatialIndex *index);
+
 struct cpSpatialIndexClass {
 	cpSpatialIndexDestroyImpl destroy;
 	
@@ -146,6 +248,14 @@ struct cpSpatialIndexClass {
 	
 	cpSpatialIndexQueryImpl query;
 	cpSpatialIndexSegmentQueryImpl segmentQuery;
+	
+	// Optional. When NULL, batches are run one query at a time.
+	cpSpatialIndexQueryBatchImpl queryBatch;
+	cpSpatialIndexSegmentQueryBatchImpl segmentQueryBatch;
+	
+	// Optional. Removes every object and leaves the index exactly as it was when it was created,
+	// so reinserting the same objects in the same order reproduces the same pairs in the same order.
+	cpSpatialIndexClearImpl clear;
 };
 
 /// Destroy and free a spatial index.
@@ -153,6 +263,14 @@ CP_EXPORT void cpSpatialIndexFree(cpSpatialIndex *index);
 /// Collide the objects in @c dynamicIndex against the objects in @c staticIndex using the query callback function.
 CP_EXPORT void cpSpatialIndexCollideStatic(cpSpatialIndex *dynamicIndex, cpSpatialIndex *staticIndex, cpSpatialIndexQueryFunc func, void *data);
 
+/// Perform a rectangle query for each of the @c count bounding boxes, calling @c func for each potential match.
+/// Indexes that support batches traverse their structure once for a group of nearby queries,
+/// so neighbouring entries of @c bbs should be close to each other.
+CP_EXPORT void cpSpatialIndexQueryBatch(cpSpatialIndex *index, const cpBB *bbs, int count, cpSpatialIndexBatchQueryFunc func, void *data);
+/// Perform a segment query for each of the @c count segments, calling @c func for each potential match.
+/// Like cpSpatialIndexQueryBatch(), neighbouring segments should be close to each other.
+CP_EXPORT void cpSpatialIndexSegmentQueryBatch(cpSpatialIndex *index, cpSpatialIndexSegment *segments, int count, cpSpatialIndexBatchSegmentQueryFunc func, void *data);
+
 /// Destroy a spatial index.
 static inline void cpSpatialIndexDestroy(cpSpatialIndex *index)
 {
@@ -19,6 +19,8 @@
  * SOFTWARE.
  */
 
+#include <string.h>
+
 #include "chipmunk/chipmunk_private.h"
 
 static inline cpSpatialIndexClass *Klass(void);
@@ -31,7 +33,8 @@ typedef struct Bounds {
 
 typedef struct TableCell {
 	void *obj;
-	Bounds bounds;
+	// Bounds along the sweep axis and along the other axis.
+	Bounds bounds, other;
 } TableCell;
 
 struct cpSweep1D
@@ -41,6 +44,10 @@ struct cpSweep1D
 	int num;
 	int max;
 	TableCell *table;
+	
+	// Sweep along x (0) or y (1).
+	int axis;
+	cpBool autoAxis;
 };
 
 static inline cpBool
@@ -52,14 +59,32 @@ BoundsOverlap(Bounds a, Bounds b)
 static inline Bounds
 BBToBounds(cpSweep1D *sweep, cpBB bb)
 {
-	Bounds bounds = {bb.l, bb.r};
-	return bounds;
+	if(sweep->axis){
+		Bounds bounds = {bb.b, bb.t};
+		return bounds;
+	} else {
+		Bounds bounds = {bb.l, bb.r};
+		return bounds;
+	}
+}
+
+static inline Bounds
+BBToOtherBounds(cpSweep1D *sweep, cpBB bb)
+{
+	if(sweep->axis){
+		Bounds bounds = {bb.l, bb.r};
+		return bounds;
+	} else {
+		Bounds bounds = {bb.b, bb.t};
+		return bounds;
+	}
 }
 
 static inline TableCell
 MakeTableCell(cpSweep1D *sweep, void *obj)
 {
-	TableCell cell = {obj, BBToBounds(sweep, sweep->spatialIndex.bbfunc(obj))};
+	cpBB bb = sweep->spatialIndex.bbfunc(obj);
+	TableCell cell = {obj, BBToBounds(sweep, bb), BBToOtherBounds(sweep, bb)};
 	return cell;
 }
 
@@ -86,6 +111,9 @@ cpSweep1DInit(cpSweep1D *sweep, cpSpatialIndexBBFunc bbfunc, cpSpatialIndex *sta
 	sweep->num = 0;
 	ResizeTable(sweep, 32);
 	
+	sweep->axis = 0;
+	sweep->autoAxis = cpFalse;
+	
 	return (cpSpatialIndex *)sweep;
 }
 
@@ -95,6 +123,17 @@ cpSweep1DNew(cpSpatialIndexBBFunc bbfunc, cpSpatialIndex *staticIndex)
 	return cpSweep1DInit(cpSweep1DAlloc(), bbfunc, staticIndex);
 }
 
+void
+cpSweep1DSetAutoAxis(cpSpatialIndex *index, cpBool autoAxis)
+{
+	if(index->klass != Klass()){
+		cpAssertWarn(cpFalse, "Ignoring cpSweep1DSetAutoAxis() call to non-sweep spatial index.");
+		return;
+	}
+	
+	((cpSweep1D *)index)->autoAxis = autoAxis;
+}
+
 static void
 cpSweep1DDestroy(cpSweep1D *sweep)
 {
@@ -145,9 +184,9 @@ cpSweep1DRemove(cpSweep1D *sweep, void *obj, cpHashValue hashid)
 	TableCell *table = sweep->table;
 	for(int i=0, count=sweep->num; i<count; i++){
 		if(table[i].obj == obj){
+			// Shift the rest down to keep the table sorted for the next step.
 			int num = --sweep->num;
-			
-			table[i] = table[num];
+			memmove(table + i, table + i + 1, (num - i)*sizeof(TableCell));
 			table[num].obj = NULL;
 			
 			return;
@@ -155,6 +194,13 @@ cpSweep1DRemove(cpSweep1D *sweep, void *obj, cpHashValue hashid)
 	}
 }
 
+static void
+cpSweep1DClear(cpSweep1D *sweep)
+{
+	sweep->num = 0;
+	sweep->axis = 0;
+}
+
 //MARK: Reindexing Functions
 
 static void
@@ -183,7 +229,7 @@ cpSweep1DQuery(cpSweep1D *sweep, void *obj, cpBB bb, cpSpatialIndexQueryFunc fun
 	TableCell *table = sweep->table;
 	for(int i=0, count=sweep->num; i<count; i++){
 		TableCell cell = table[i];
-		if(BoundsOverlap(bounds, cell.bounds) && obj != cell.obj) func(obj, cell.obj, 0, data);
+		if(BoundsOverlap(bounds, cell.bounds) && BoundsOverlap(BBToOtherBounds(sweep, bb), cell.other) && obj != cell.obj) func(obj, cell.obj, 0, data);
 	}
 }
 
@@ -208,6 +254,59 @@ TableSort(TableCell *a, TableCell *b)
 	return (a->bounds.min < b->bounds.min ? -1 : (a->bounds.min > b->bounds.min ? 1 : 0));
 }
 
+// The table stays sorted between steps and objects barely move, so insertion sort is close to linear.
+// If the motion turns out to be incoherent, give up and let qsort() finish the job.
+static void
+SortTable(TableCell *table, int count)
+{
+	int budget = 8*count;
+	
+	for(int i=1; i<count; i++){
+		TableCell cell = table[i];
+		
+		int j = i;
+		while(j > 0 && table[j - 1].bounds.min > cell.bounds.min){
+			table[j] = table[j - 1];
+			j--;
+		}
+		table[j] = cell;
+		
+		budget -= i - j;
+		if(budget < 0){
+			qsort(table, count, sizeof(TableCell), (int (*)(const void *, const void *))TableSort);
+			return;
+		}
+	}
+}
+
+// Sweep along the axis the objects are spread out along the most.
+// Only switch when the other axis is clearly better since it scrambles the sort order.
+static void
+ChooseAxis(cpSweep1D *sweep)
+{
+	TableCell *table = sweep->table;
+	int count = sweep->num;
+	if(count < 2) return;
+	
+	// Variance of the object centers along the current sweep axis and the other axis.
+	cpFloat s = 0.0f, ss = 0.0f, o = 0.0f, oo = 0.0f;
+	for(int i=0; i<count; i++){
+		cpFloat c = table[i].bounds.min + table[i].bounds.max;
+		cpFloat d = table[i].other.min + table[i].other.max;
+		s += c; ss += c*c;
+		o += d; oo += d*d;
+	}
+	
+	if(oo - o*o/count > 1.5f*(ss - s*s/count)){
+		sweep->axis = !sweep->axis;
+		for(int i=0; i<count; i++){
+			Bounds bounds = table[i].bounds;
+			table[i].bounds = table[i].other;
+			table[i].other = bounds;
+		}
+	}
+}
+
 static void
 cpSweep1DReindexQuery(cpSweep1D *sweep, cpSpatialIndexQueryFunc func, void *data)
 {
@@ -216,14 +315,15 @@ cpSweep1DReindexQuery(cpSweep1D *sweep, cpSpatialIndexQueryFunc func, void *data
 	
 	// Update bounds and sort
 	for(int i=0; i<count; i++) table[i] = MakeTableCell(sweep, table[i].obj);
-	qsort(table, count, sizeof(TableCell), (int (*)(const void *, const void *))TableSort); // TODO: use insertion sort instead
+	if(sweep->autoAxis) ChooseAxis(sweep);
+	SortTable(table, count);
 	
 	for(int i=0; i<count; i++){
 		TableCell cell = table[i];
 		cpFloat max = cell.bounds.max;
 		
-		for(int j=i+1; table[j].bounds.min < max && j<count; j++){
-			func(cell.obj, table[j].obj, 0, data);
+		for(int j=i+1; j<count && table[j].bounds.min < max; j++){
+			if(BoundsOverlap(cell.other, table[j].other)) func(cell.obj, table[j].obj, 0, data);
 		}
 	}
 	
@@ -248,6 +348,11 @@ static cpSpatialIndexClass klass = {
 	
 	(cpSpatialIndexQueryImpl)cpSweep1DQuery,
 	(cpSpatialIndexSegmentQueryImpl)cpSweep1DSegmentQuery,
+	
+	NULL,
+	NULL,
+	
+	(cpSpatialIndexClearImpl)cpSweep1DClear,
 };
 
 static inline cpSpatialIndexClass *Klass(){return &klass;}
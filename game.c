@@ -0,0 +1,824 @@
+#include <math.h>
+#include <stdio.h>
+
+#include <chipmunk/chipmunk.h>
+
+#include "game.h"
+#include "platform.h"
+
+ItemType levelProgression[] = {
+    ITEM_CHEESE,
+    ITEM_TAX,
+    ITEM_BEANS,
+    ITEM_BRICK,
+};
+
+static int progressionLength = 4;
+
+bool debug = false;
+
+GameState gameStatus = GAME_STATE_ATTRACT;
+int64_t state_start = 0;
+
+// Set RAY_TRIGGERS=1 to make live rays trigger shapes. They then report touching the item without arbiters, but no
+// longer push fallen rays or shove the item on game over. Journals only replay in a build with the same setting.
+#ifndef RAY_TRIGGERS
+#define RAY_TRIGGERS 0
+#endif
+
+// Time one space step may take. The space trades solver iterations and substeps to stay within it, so a burst of
+// rays costs accuracy instead of frames. Even the most ticks main.c runs per rendered frame fit in one frame.
+#define SIM_STEP_BUDGET_MS 6
+
+#if CP_USE_STEP_PROFILE
+// The last two seconds of space steps, for the debug overlay and tools/host/replay.
+#define STEP_PROFILE_COUNT 64
+static cpStepProfile step_profiles[STEP_PROFILE_COUNT];
+#endif
+
+// Simulated time in microseconds. 64 bits, so it doesn't wrap.
+int64_t curr_time_us = 0;
+
+char title_buffer[50];
+char subtitle_buffer[50];
+
+ItemType currentItemType = ITEM_TAX;
+
+StickStatus stickStatus = STICK_SPRITE_NEUTRAL;
+StickStatus dpadStatus = STICK_SPRITE_NEUTRAL;
+
+cpVect lung_pos;
+cpVect mouth_pos;
+cpVect stick_pos;
+cpVect eyes_pos;
+cpVect dpad_pos;
+cpVect cpad_pos;
+cpVect laughometer_pos;
+
+cpVect item_pos;
+
+cpBody *itemBody;
+
+cpSpace *space;
+
+static cpCollisionType RAY = 1;
+static cpCollisionType PLAYER = 2;
+static cpCollisionType NONE = 3;
+
+float laughometer_level = 1.0f;
+float laughometer_change = 0.0f;
+
+// The current
+int level = 0;
+int sub_level = 0;
+int64_t level_change_time = 0;
+int64_t game_start_time = 0;
+int64_t last_fire_time = 0;
+int64_t fire_time = 0;
+int high_score = 0;
+int score = 0;
+bool item_funny = false;
+
+float lung_scale = 1.0f;
+bool lung_visible = true;
+bool lung_ghost_visible = true;
+
+float base_eye_scale = 0.6f;
+float eye_scale = 1.0f;
+float item_scale = 0.8f;
+float eye_angle = 0.0f;
+
+float lung_target_speed = 1.0f;
+float lung_target_scale = 1.0f;
+float lung_breath_speed = 1.0f;
+
+float target_speed = 1.0f;
+float current_speed = 1.0f;
+
+float mouth_angle = M_PI_4;
+float mouth_target = M_PI / 8;
+float mouth_target_speed = 1.0f;
+bool mouth_ghost_visible = false;
+
+char* title_text = "Make me laugh!";
+char *subtitle_text = "Press start!";
+bool title_visible = true;
+bool subtitle_visible = true;
+
+const cpFloat ray_width = 50.0f;
+const cpFloat ray_height = 20.0f;
+
+// Attention rays are allocated once up front. Dead rays are parked outside of the space
+// and re-armed when fired, so shooting doesn't touch the heap.
+#define RAY_POOL_SIZE 32
+
+typedef struct {
+    cpBody *body;
+    cpShape *shape;
+    bool live;
+    int64_t fire_time;
+    BodyPose prev_pose;
+} Ray;
+
+static Ray ray_pool[RAY_POOL_SIZE];
+static BodyPose item_prev_pose;
+
+// Inputs of the tick being simulated, and the buttons held on the tick before it.
+static JournalTick *input;
+static uint16_t last_buttons = 0;
+
+// Whether the step budget is fed recorded step times instead of the real clock.
+static bool replaying = false;
+static bool replay_step_started = false;
+
+// The game's random numbers. Unlike rand(), the sequence is the same on every platform, so a journal's seed
+// reproduces it.
+static uint32_t rng_state = 1;
+
+static void seed_rand(uint32_t seed) {
+    // Xorshift gets stuck on zero
+    rng_state = seed ? seed : 1;
+}
+
+static int game_rand() {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+
+    return rng_state >> 1;
+}
+
+static bool held(uint16_t button) {
+    return input->buttons & button;
+}
+
+static bool pressed(uint16_t button) {
+    return input->buttons & ~last_buttons & button;
+}
+
+void play_laugh() {
+    Laugh laugh;
+
+    switch (game_rand() % 3) {
+        case 0:
+            laugh = LAUGH_SINISTER;
+            break;
+        default:
+        case 1:
+            laugh = LAUGH_CARTOON;
+            break;
+        case 2:
+            laugh = LAUGH_EVIL;
+            break;
+    }
+
+    platform_play_laugh(laugh, ((game_rand() % 200) + 100.0f) / 200);
+}
+
+void init_rays() {
+    for (int i = 0; i < RAY_POOL_SIZE; i++) {
+        Ray *ray = &ray_pool[i];
+
+        ray->body = cpBodyNewKinematic();
+        cpBodySetUserData(ray->body, ray);
+        // Fast rays at high levels move further than their own width in one step.
+        cpBodySetContinuousCollision(ray->body, cpTrue);
+
+        ray->shape = cpBoxShapeNew(ray->body, ray_width, ray_height, 0);
+        cpShapeSetFriction(ray->shape, 0.0);
+        cpShapeSetElasticity(ray->shape, 0.1f);
+        cpShapeSetMass(ray->shape, 5.0f);
+
+        ray->live = false;
+    }
+}
+
+BodyPose *body_prev_pose(cpBody *body) {
+    if (body == itemBody) {
+        return &item_prev_pose;
+    }
+
+    return &((Ray *)cpBodyGetUserData(body))->prev_pose;
+}
+
+static void save_body_pose(cpBody *body, void *data) {
+    BodyPose *pose = body_prev_pose(body);
+
+    pose->pos = cpBodyGetPosition(body);
+    pose->angle = cpBodyGetAngle(body);
+}
+
+// Take a ray out of the space. Must not be called while the space is locked.
+static void park_ray(Ray *ray) {
+    if (!ray->live) {
+        return;
+    }
+
+    cpSpaceRemoveShape(space, ray->shape);
+
+    // A collision may have turned the ray dynamic. Parked rays are kinematic, so spawn_ray() can fire them as they are.
+    cpBodySetType(ray->body, CP_BODY_TYPE_KINEMATIC);
+    cpSpaceRemoveBody(space, ray->body);
+
+    ray->live = false;
+
+    if (debug) {
+        platform_log("Parked ray %p\n", ray);
+    }
+}
+
+// Find a parked ray, or recycle the oldest live one if the pool is exhausted.
+static Ray *get_ray() {
+    Ray *oldest = &ray_pool[0];
+
+    for (int i = 0; i < RAY_POOL_SIZE; i++) {
+        Ray *ray = &ray_pool[i];
+
+        if (!ray->live) {
+            return ray;
+        }
+
+        if (ray->fire_time < oldest->fire_time) {
+            oldest = ray;
+        }
+    }
+
+    park_ray(oldest);
+
+    return oldest;
+}
+
+void spawn_ray(cpFloat speed) {
+    if (last_fire_time + 1000000 > curr_time_us) {
+        return;
+    }
+
+    last_fire_time = curr_time_us;
+
+    Ray *ray = get_ray();
+    cpBody *rayBody = ray->body;
+
+    cpBodySetPosition(rayBody, cpv(eyes_pos.x, eyes_pos.y));
+    cpBodySetAngle(rayBody, eye_angle);
+
+    // Don't interpolate from where the ray was in its previous life.
+    save_body_pose(rayBody, NULL);
+
+    cpFloat rotSpeed = game_rand() % 2 == 0 ? 1.0f : -1.0f;
+    cpBodySetVelocity(rayBody, cpv(speed * cosf(eye_angle), speed * sinf(eye_angle + M_PI)));
+    cpBodySetAngularVelocity(rayBody, rotSpeed);
+
+    cpShapeSetCollisionType(ray->shape, RAY);
+#if RAY_TRIGGERS
+    // Live rays only need to know when they touch the item, so they skip the narrow phase and arbiters
+    cpShapeSetTrigger(ray->shape, cpTrue);
+#endif
+
+    cpSpaceAddBody(space, rayBody);
+    cpSpaceAddShape(space, ray->shape);
+
+    ray->live = true;
+    ray->fire_time = curr_time_us;
+
+    if (debug) {
+        platform_log("Fired ray %p\n", ray);
+    }
+}
+
+void init() {
+    lung_pos = cpv(100, 175);
+    mouth_pos = cpv(220,175);
+    eyes_pos = cpv(400, 180);
+
+    laughometer_pos = cpv(320, 35);
+
+    stick_pos = cpv(245, 275);
+    dpad_pos = cpv(110, 303);
+    cpad_pos = cpv(550, 290);
+
+    item_pos = cpv(550, 150);
+}
+
+static void changeShapeCollision(cpBody* body, cpShape *shape, void* data) {
+    cpShapeSetCollisionType(shape, NONE);
+
+#if RAY_TRIGGERS
+    // Deflected rays bounce off the item, so they need real collisions again
+    cpShapeSetTrigger(shape, cpFalse);
+#endif
+}
+
+static void postRayCollide(cpSpace *space, cpBody *ray, void *unused)
+{  
+    // A body can have multiple shapes, so we need to iterate through and delete
+    cpBodySetType(ray, CP_BODY_TYPE_DYNAMIC);
+    cpBodySetMass(ray, 5.0f);
+
+    cpBodyEachShape(ray, (cpBodyShapeIteratorFunc)changeShapeCollision, NULL);
+}
+
+static void postStepParkRay(cpSpace *space, cpBody *body, void *unused)
+{
+  park_ray((Ray *)cpBodyGetUserData(body));
+}
+
+static void rayHitItem(cpSpace *space, cpBody *ray) {
+    platform_log("Collide!\n");
+
+    if (item_funny) {
+        cpSpaceAddPostStepCallback(
+            space, (cpPostStepFunc)postStepParkRay, ray, NULL);
+
+    } else {
+        cpSpaceAddPostStepCallback(
+            space, (cpPostStepFunc)postRayCollide, ray, NULL
+        );
+    }
+
+    if (gameStatus == GAME_STATE_PLAYING) {
+        if (item_funny) {
+            laughometer_level += 0.1f;
+        } else {
+            laughometer_level -= 0.1f;
+        }
+    } else {
+        play_laugh();
+    }
+}
+
+#if RAY_TRIGGERS
+static void handlePlayerRayCollision(cpShape *item, cpShape *rayShape, cpSpace *space, void *data){
+    rayHitItem(space, cpShapeGetBody(rayShape));
+}
+#else
+static cpBool handlePlayerRayCollision(cpArbiter *arb, cpSpace *space, void *data){
+    cpBody *a, *b; cpArbiterGetBodies(arb, &a, &b);
+
+    rayHitItem(space, a == itemBody ? b : a);
+
+    return cpTrue;
+}
+#endif
+
+// Clock for the space's step budget. A replay hands back the step time that was recorded instead, so the space picks
+// the same iterations and substeps as it did in the recorded session.
+static uint64_t step_clock(void) {
+    if (replaying) {
+        replay_step_started = !replay_step_started;
+
+        return replay_step_started ? 0 : input->step_ticks;
+    }
+
+    return platform_ticks();
+}
+
+static cpSpace* init_space() {
+    cpSpace *space = cpSpaceNew();
+    cpSpaceSetGravity(space, cpv(0, 100));
+
+    cpSpaceSetStepBudget(space, &(cpStepBudget){
+        .clock = step_clock,
+        .target = PLATFORM_TICKS_FROM_MS(SIM_STEP_BUDGET_MS),
+        .minIterations = 4, .maxIterations = 10,
+        .minSubsteps = 1, .maxSubsteps = 2,
+    });
+
+#if CP_USE_STEP_PROFILE
+    // Always the real clock, even in a replay, since the point is to see where the time goes on this machine.
+    cpSpaceSetStepProfiler(space, platform_ticks, step_profiles, STEP_PROFILE_COUNT);
+#endif
+
+    // Let deflected rays that have come to rest fall asleep so they stop costing solver time
+    cpSpaceSetSleepTimeThreshold(space, 0.5f);
+
+    // The world is bounded by the culling in updateBody, so use a dense grid with ray sized cells
+    cpSpaceUseGrid(space, cpBBNew(-50, -50, 700, 700), 50);
+
+    itemBody = cpBodyNewKinematic();
+    cpSpaceAddBody(space, itemBody);
+
+    cpBodySetPosition(itemBody, item_pos);
+
+    cpShape *itemShape = cpSpaceAddShape(space, cpBoxShapeNew(itemBody, 80, 60, 0));
+    cpShapeSetCollisionType(itemShape, PLAYER);
+    cpShapeSetMass(itemShape, 5.0f);
+
+    cpCollisionHandler *handler = cpSpaceAddCollisionHandler(space, PLAYER, RAY);
+#if RAY_TRIGGERS
+    handler->triggerEnterFunc = handlePlayerRayCollision;
+#else
+    handler->beginFunc = handlePlayerRayCollision;
+#endif
+
+    return space;
+}
+
+void setup_speeds() {
+    mouth_target_speed = 0.8f + level * 0.15f;
+    lung_breath_speed = 0.8f + level * 0.15f;
+}
+
+void update_game_state(GameState new_state) {
+    platform_log("Change state from %i to %i at %lld\n",
+        gameStatus,
+        new_state,
+        (long long)curr_time_us);
+
+    state_start = curr_time_us;
+    gameStatus = new_state;
+}
+
+void start_attract() {
+    update_game_state(GAME_STATE_ATTRACT);
+
+    title_text = "Make Me Laugh!";
+    subtitle_text = "Press start!";
+
+    score = 0;
+
+    lung_ghost_visible = false;
+    mouth_ghost_visible = false;
+
+    lung_target_scale = 1.0f;
+    mouth_target = M_PI / 8;
+
+    currentItemType = ITEM_QUESTION;
+
+    cpBodySetPosition(itemBody, cpv(550, 150));
+    cpBodySetVelocity(itemBody, cpv(0, 0));
+    cpBodySetAngle(itemBody, 0);
+    cpBodySetType(itemBody, CP_BODY_TYPE_KINEMATIC);
+    save_body_pose(itemBody, NULL);
+}
+
+void start_starting() {
+    update_game_state(GAME_STATE_STARTING_LEVEL);
+
+    sprintf(title_buffer, "Starting level %i", level + 1);
+
+    title_text = title_buffer;
+
+    switch (game_rand() % 3) {
+        case 0:
+            subtitle_text = "Is this funny?";
+        break;
+        case 1:
+            subtitle_text = "Does this make you laugh?";
+        break;
+        case 2:
+            subtitle_text = "Is this funny enough for you?";
+        break;
+    }
+
+    subtitle_visible = true;
+
+    laughometer_level = 1.0f;
+    laughometer_change = 0.0f;
+
+    if (level < progressionLength) {
+        currentItemType = levelProgression[level];
+    } else {
+        currentItemType = game_rand() % 4;
+    }
+
+    item_funny = currentItemType == ITEM_CHEESE || currentItemType == ITEM_BEANS;
+
+    item_pos = cpv(550, 220);
+    cpBodySetPosition(itemBody, item_pos);
+    save_body_pose(itemBody, NULL);
+
+    setup_speeds();
+}
+
+void new_game() {
+    level = 0;
+    sub_level = 0;
+    score = 0;
+    game_start_time = curr_time_us;
+
+    start_starting();
+}
+
+void next_level() {
+    level += 1;
+
+    start_starting();
+}
+
+void start_game() {
+    update_game_state(GAME_STATE_PLAYING);
+
+    title_text = "Start!";
+
+    lung_ghost_visible = true;
+    mouth_ghost_visible = true;
+
+    level_change_time = 10 * 1000000 + curr_time_us;
+
+    play_laugh();
+}
+
+void start_game_over() {
+    update_game_state(GAME_STATE_GAME_OVER);
+    
+    platform_log("Gameover with score of %i\n", score);
+
+    title_text = "Game over!";
+
+    if (score > high_score) {
+        high_score = score;
+        sprintf(subtitle_buffer, "You got a new high score of %d seconds!", score);
+    } else {
+        sprintf(subtitle_buffer, "You survived %d seconds", score);
+    }
+
+    cpBodySetType(itemBody, CP_BODY_TYPE_DYNAMIC);
+    cpBodySetMass(itemBody, 10.0f);
+    cpBodySetAngularVelocity(itemBody,10 * ( -1.0f + (game_rand() % 2000) / 1000.0f));
+
+    subtitle_visible = true;
+    subtitle_text = subtitle_buffer;
+}
+
+void update_attract() {
+    laughometer_level = 1.0f + platform_sinf(
+        curr_time_us * 4.0f / (5000000 * lung_breath_speed)
+    );
+
+    laughometer_level = cpfclamp(laughometer_level, 0, 2.0f);
+
+    lung_scale = 0.95f + 0.1f * platform_sinf(curr_time_us / (1000000 * lung_breath_speed));
+    mouth_angle = M_PI / 8 + (M_PI / 10) * (platform_sinf(curr_time_us / (2000000 * 1.0f)));
+
+    eye_scale = 0.9f + (0.2f * platform_sinf(curr_time_us / (3000000.0f)));
+    eye_angle = -M_PI / 8 + (M_PI_4 * platform_sinf(curr_time_us * 5.0f / (6000000.0f)));
+
+    item_pos.y = 180.0f + 80.0f * platform_sinf(curr_time_us / (2000000.0f));
+    cpBodySetPosition(itemBody, item_pos);
+
+    if (fire_time < curr_time_us) {
+        spawn_ray(80.0f);
+
+        fire_time = curr_time_us + cpfmax(500000, 500000 + game_rand() % 2000000);
+    }
+
+    subtitle_visible = curr_time_us % 1000000 > 500000;
+    if (pressed(JOURNAL_BUTTON_START)) {
+        new_game();
+    }
+
+    if (pressed(JOURNAL_BUTTON_A)) {
+        spawn_ray(100.0f);
+    }
+}
+
+void update_starting() {
+    if (curr_time_us - state_start > 5000000) {
+        start_game();
+    }
+}
+
+void update_playing() {
+    mouth_angle = M_PI / 8 + (input->stick_y / 85.0f) * M_PI / 8;
+
+    float mouth_wiggle = cpfmax(0.03f, 0.1f - (sub_level * 0.01f));
+
+    if (mouth_target > mouth_angle + mouth_wiggle) {
+        stickStatus = STICK_SPRITE_UP;
+    } else if (mouth_target < mouth_angle - mouth_wiggle) {
+        stickStatus = STICK_SPRITE_DOWN;
+    }  else {
+        stickStatus = STICK_SPRITE_NEUTRAL;
+    }
+
+    bool mouth_correct = stickStatus == STICK_SPRITE_NEUTRAL;
+
+    mouth_target = M_PI * (1 + 0.75f * platform_sinf(curr_time_us * mouth_target_speed / (1000000))) / 8;
+
+    float lung_wiggle = cpfmax(0.03f, 0.1f - (sub_level * 0.01f));
+    if (lung_target_scale > lung_scale + lung_wiggle) {
+        dpadStatus = STICK_SPRITE_UP;
+    } else if (lung_target_scale < lung_scale - lung_wiggle) {
+        dpadStatus = STICK_SPRITE_DOWN;
+    } else {
+        dpadStatus = STICK_SPRITE_NEUTRAL;
+    }
+
+    bool lung_correct = dpadStatus == STICK_SPRITE_NEUTRAL;
+
+    if (item_funny) {
+        eye_angle = -M_PI / 8 + (M_PI_4 * platform_sinf(curr_time_us * (sub_level + 1) * 2.5f / (6000000.0f)));
+    } else {
+        cpVect dItem = cpvsub(eyes_pos, cpBodyGetPosition(itemBody));
+
+        eye_angle = -cpvtoangle(dItem) + M_PI;
+    }
+
+    if (fire_time < curr_time_us) {
+        spawn_ray(50.0f + sub_level * 10.0f);
+
+        if (item_funny) {
+            fire_time = curr_time_us + 300000 + game_rand() % 2000000;
+        } else {
+            fire_time = curr_time_us + 300000 + game_rand() % 3000000;
+        }
+    }
+
+    laughometer_change += 0.001f + (item_funny ? 0: 0.0001f);
+
+    float punishment = -0.00055 - 0.00001f * sub_level;
+
+    if (!lung_correct) {
+        laughometer_change += punishment;
+    }
+
+    if (!mouth_correct) {
+        laughometer_change += punishment;
+    }
+
+    platform_log("Change: %f, level: %f\n", laughometer_change, laughometer_level);
+
+    if (!lung_correct) {
+        title_text = "Breath harder!";
+    } else if (!mouth_correct) {
+        title_text = "Flap more!";
+    } else {
+        title_text = "";
+    }
+
+    laughometer_change = cpfclamp(laughometer_change, -0.005f, 0.005f);
+
+    laughometer_level += laughometer_change;
+
+    laughometer_level = cpfclamp(laughometer_level, 0, 2.0f);
+
+    platform_log("Change: %f, level: %f\n", laughometer_change, laughometer_level);
+
+    if ((laughometer_level <= 0.0f && !debug) || (debug && pressed(JOURNAL_BUTTON_B))) {
+        score = (curr_time_us - game_start_time) / 1000000;
+        start_game_over();
+
+        play_laugh();
+    }
+
+    if (curr_time_us > level_change_time || (debug && pressed(JOURNAL_BUTTON_A))) {
+        sub_level++;
+        platform_log("Advance to sub level %i\n", sub_level);
+        level_change_time = 8 * 1000000 + curr_time_us;
+
+        setup_speeds();
+
+        play_laugh();
+
+        if (sub_level > 3 * (level + 1)) {
+            next_level();
+        }
+    }
+
+    lung_target_scale = 0.95f + 0.1f * platform_sinf(curr_time_us * lung_target_speed / (1000000));
+
+    float lungSpeed = 0.005f + level * 0.001f;
+    if (held(JOURNAL_BUTTON_D_UP)) {
+        lung_scale += lungSpeed;
+    }
+
+    if (held(JOURNAL_BUTTON_D_DOWN)) {
+        lung_scale -= lungSpeed;
+    }
+
+    lung_scale = cpfclamp(lung_scale, 0.8f, 1.2f);
+    float itemSpeed = 2.0f + sub_level * 0.04f;
+
+    if (held(JOURNAL_BUTTON_C_UP)) {
+        item_pos.y -= itemSpeed;
+    }
+    if (held(JOURNAL_BUTTON_C_DOWN)) {
+        item_pos.y += itemSpeed;
+    }
+    if (held(JOURNAL_BUTTON_C_LEFT)) {
+        item_pos.x -= itemSpeed;
+    }
+    if (held(JOURNAL_BUTTON_C_RIGHT)) {
+        item_pos.x += itemSpeed;
+    }
+
+    cpBodySetPosition(itemBody, item_pos);
+}
+
+void update_game_over() {
+    lung_scale = 0.95f + 0.1f * platform_sinf(curr_time_us / (1000000 * lung_breath_speed));
+    mouth_angle = M_PI / 8 + (M_PI / 10) * (platform_sinf(curr_time_us / (2000000 * 1.0f)));
+
+    eye_scale = 0.9f + (0.2f * platform_sinf(curr_time_us / (3000000.0f)));
+
+    if (pressed(JOURNAL_BUTTON_START)) {
+        start_attract();
+    }
+}
+
+// Remove any bodies that have fallen off the screen
+static void updateBody(cpBody *body, void* data) {
+    cpVect pos = cpBodyGetPosition(body);
+
+    if (pos.y > 700 || pos.x < -50 || pos.x > 700) {
+        if (body == itemBody)
+        {
+            if (cpBodyGetType(body) == CP_BODY_TYPE_DYNAMIC) {
+                cpBodySetPosition(body, cpv(1000, 1000));
+            }
+            return;
+        }
+
+
+        cpSpaceAddPostStepCallback(
+            space, (cpPostStepFunc)postStepParkRay, body, NULL
+        );
+    }
+}
+
+// Advance the game by one simulation tick.
+void update(JournalTick *tick) {
+    input = tick;
+
+    curr_time_us += SIM_TICK_US;
+    cpSpaceEachBody(space, save_body_pose, NULL);
+    cpSpaceStep(space, SIM_DT);
+
+    switch (gameStatus) {
+        case GAME_STATE_ATTRACT:
+            update_attract();
+            break;
+        case GAME_STATE_PLAYING:
+            update_playing();
+            break;
+        case GAME_STATE_STARTING_LEVEL:
+            update_starting();
+            break;
+        case GAME_STATE_GAME_OVER:
+            update_game_over();
+            break;
+    }
+
+    if (!replaying) {
+        tick->step_ticks = cpSpaceGetLastStepTime(space);
+    }
+
+    if (pressed(JOURNAL_BUTTON_R)) {        
+        platform_log("Lung: %f actual %f target, mouth: %f action %f target, eye: %f angle %f\n", lung_scale, lung_target_scale, mouth_angle, mouth_target, eye_scale, eye_angle);
+    }
+
+    if (pressed(JOURNAL_BUTTON_L)) {
+        debug = !debug;
+
+        platform_log("Debug: %i\n", debug);
+        platform_stop_music();
+    }
+
+    cpSpaceEachBody(space, (cpSpaceBodyIteratorFunc)updateBody, NULL);
+
+    last_buttons = tick->buttons;
+}
+
+void game_init(uint32_t seed, bool replay) {
+    replaying = replay;
+    seed_rand(seed);
+
+    init();
+
+    space = init_space();
+    init_rays();
+
+    start_attract();
+}
+
+static void hash_bytes(uint32_t *hash, const void *data, size_t size) {
+    const uint8_t *bytes = data;
+
+    // FNV-1a
+    for (size_t i = 0; i < size; i++) {
+        *hash = (*hash ^ bytes[i]) * 16777619u;
+    }
+}
+
+static void hash_body(cpBody *body, uint32_t *hash) {
+    cpVect pos = cpBodyGetPosition(body);
+    cpFloat angle = cpBodyGetAngle(body);
+
+    hash_bytes(hash, &pos, sizeof(pos));
+    hash_bytes(hash, &angle, sizeof(angle));
+}
+
+uint32_t game_checksum(void) {
+    uint32_t hash = 2166136261u;
+
+    hash_bytes(&hash, &gameStatus, sizeof(gameStatus));
+    hash_bytes(&hash, &level, sizeof(level));
+    hash_bytes(&hash, &sub_level, sizeof(sub_level));
+    hash_bytes(&hash, &score, sizeof(score));
+    hash_bytes(&hash, &laughometer_level, sizeof(laughometer_level));
+    hash_bytes(&hash, &rng_state, sizeof(rng_state));
+
+    cpSpaceEachBody(space, (cpSpaceBodyIteratorFunc)hash_body, &hash);
+
+    return hash;
+}
@@ -0,0 +1,105 @@
+#ifndef GAME_H
+#define GAME_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <chipmunk/chipmunk.h>
+
+#include "journal.h"
+
+// The game simulation: state machine, laughometer, rays and collision handling. It only touches the machine through
+// platform.h, so the same code runs on the N64 and on a PC.
+
+typedef enum {
+    GAME_STATE_ATTRACT = 1,
+    GAME_STATE_STARTING_LEVEL = 2,
+    GAME_STATE_PLAYING = 3,
+    GAME_STATE_GAME_OVER = 4,
+} GameState;
+
+typedef enum {
+    ITEM_BRICK,
+    ITEM_TAX,
+    ITEM_CHEESE,
+    ITEM_BEANS,
+    ITEM_QUESTION = 100,
+} ItemType;
+
+typedef enum {
+    STICK_SPRITE_NEUTRAL = 1,
+    STICK_SPRITE_UP = 2,
+    STICK_SPRITE_DOWN = 3,
+} StickStatus;
+
+// Simulation clock. Game logic and the space advance in fixed ticks of SIM_TICK_US, independent of the render
+// rate. SIM_TICK_US and SIM_DT match the old one step of 0.03 per 30 Hz frame, so the game plays at the same speed.
+#define SIM_TICK_US 33333
+#define SIM_DT 0.03f
+
+// Pose of a body at the start of the latest simulation tick, used to interpolate between ticks when drawing.
+typedef struct {
+    cpVect pos;
+    cpFloat angle;
+} BodyPose;
+
+// Game state read by the renderer, and by bots playing the game on a PC.
+extern GameState gameStatus;
+extern bool debug;
+extern cpSpace *space;
+extern cpBody *itemBody;
+extern ItemType currentItemType;
+extern StickStatus stickStatus;
+extern StickStatus dpadStatus;
+
+extern cpVect lung_pos;
+extern cpVect mouth_pos;
+extern cpVect stick_pos;
+extern cpVect eyes_pos;
+extern cpVect dpad_pos;
+extern cpVect cpad_pos;
+extern cpVect laughometer_pos;
+
+extern int level;
+extern int sub_level;
+extern int score;
+extern int high_score;
+extern float laughometer_level;
+
+extern float lung_scale;
+extern float lung_target_scale;
+extern bool lung_visible;
+extern bool lung_ghost_visible;
+
+extern float mouth_angle;
+extern float mouth_target;
+extern bool mouth_ghost_visible;
+
+extern float base_eye_scale;
+extern float eye_scale;
+extern float eye_angle;
+extern float item_scale;
+
+extern char *title_text;
+extern char *subtitle_text;
+extern bool title_visible;
+extern bool subtitle_visible;
+
+extern const cpFloat ray_width;
+extern const cpFloat ray_height;
+
+// Set up the space and start the attract screen. The game's random numbers all come from @c seed.
+// When @c replaying, the space's step budget is fed the step times recorded in the journal instead of the real clock.
+void game_init(uint32_t seed, bool replaying);
+
+// Advance the game by one simulation tick with the inputs in @c tick. Unless replaying, the time the space step took
+// is stored in tick->step_ticks for the journal.
+void update(JournalTick *tick);
+
+// Hash of the game state and every body's pose, for checking that two runs went the same way.
+uint32_t game_checksum(void);
+
+// Pose of @c body at the start of the latest tick.
+BodyPose *body_prev_pose(cpBody *body);
+
+#endif
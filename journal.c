@@ -0,0 +1,175 @@
+#include "journal.h"
+
+// Which inputs a record holds, in its first byte.
+#define RECORD_BUTTONS 1
+#define RECORD_STICK_X 2
+#define RECORD_STICK_Y 4
+
+// Everything is stored little endian, so journals recorded on the N64 replay on a PC.
+
+static bool write_u16(FILE *file, uint16_t value) {
+    uint8_t bytes[2] = {value & 0xff, value >> 8};
+
+    return fwrite(bytes, 1, sizeof(bytes), file) == sizeof(bytes);
+}
+
+static bool write_u32(FILE *file, uint32_t value) {
+    uint8_t bytes[4] = {value & 0xff, (value >> 8) & 0xff, (value >> 16) & 0xff, value >> 24};
+
+    return fwrite(bytes, 1, sizeof(bytes), file) == sizeof(bytes);
+}
+
+static bool write_varint(FILE *file, uint32_t value) {
+    uint8_t bytes[5];
+    int count = 0;
+
+    while (value >= 0x80) {
+        bytes[count++] = (value & 0x7f) | 0x80;
+        value >>= 7;
+    }
+    bytes[count++] = value;
+
+    return fwrite(bytes, 1, count, file) == (size_t)count;
+}
+
+static bool read_u8(FILE *file, uint8_t *value) {
+    int c = fgetc(file);
+
+    if (c == EOF) {
+        return false;
+    }
+
+    *value = c;
+    return true;
+}
+
+static bool read_u16(FILE *file, uint16_t *value) {
+    uint8_t bytes[2];
+
+    if (fread(bytes, 1, sizeof(bytes), file) != sizeof(bytes)) {
+        return false;
+    }
+
+    *value = bytes[0] | (bytes[1] << 8);
+    return true;
+}
+
+static bool read_u32(FILE *file, uint32_t *value) {
+    uint8_t bytes[4];
+
+    if (fread(bytes, 1, sizeof(bytes), file) != sizeof(bytes)) {
+        return false;
+    }
+
+    *value = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+    return true;
+}
+
+static bool read_varint(FILE *file, uint32_t *value) {
+    uint32_t result = 0;
+
+    for (int shift = 0; shift < 35; shift += 7) {
+        uint8_t byte;
+
+        if (!read_u8(file, &byte)) {
+            return false;
+        }
+
+        result |= (uint32_t)(byte & 0x7f) << shift;
+
+        if (!(byte & 0x80)) {
+            *value = result;
+            return true;
+        }
+    }
+
+    // Too long to be one of ours
+    return false;
+}
+
+bool journal_record(Journal *journal, FILE *file, uint32_t seed) {
+    *journal = (Journal){
+        .file = file,
+        .seed = seed,
+    };
+
+    return write_u32(file, JOURNAL_MAGIC) && write_u16(file, JOURNAL_VERSION) && write_u32(file, seed);
+}
+
+bool journal_write_tick(Journal *journal, const JournalTick *tick) {
+    FILE *file = journal->file;
+    JournalTick *last = &journal->last;
+
+    uint8_t flags = 0;
+    if (tick->buttons != last->buttons) flags |= RECORD_BUTTONS;
+    if (tick->stick_x != last->stick_x) flags |= RECORD_STICK_X;
+    if (tick->stick_y != last->stick_y) flags |= RECORD_STICK_Y;
+
+    bool ok = fputc(flags, file) != EOF;
+    if (flags & RECORD_BUTTONS) ok = ok && write_u16(file, tick->buttons);
+    if (flags & RECORD_STICK_X) ok = ok && fputc((uint8_t)tick->stick_x, file) != EOF;
+    if (flags & RECORD_STICK_Y) ok = ok && fputc((uint8_t)tick->stick_y, file) != EOF;
+    ok = ok && write_varint(file, tick->step_ticks);
+
+    *last = *tick;
+    journal->ticks++;
+
+    if (journal->ticks % JOURNAL_FLUSH_TICKS == 0) {
+        ok = ok && fflush(file) == 0;
+    }
+
+    return ok;
+}
+
+bool journal_replay(Journal *journal, FILE *file) {
+    *journal = (Journal){
+        .file = file,
+    };
+
+    uint32_t magic;
+    uint16_t version;
+
+    return read_u32(file, &magic) && magic == JOURNAL_MAGIC
+        && read_u16(file, &version) && version == JOURNAL_VERSION
+        && read_u32(file, &journal->seed);
+}
+
+bool journal_read_tick(Journal *journal, JournalTick *tick) {
+    FILE *file = journal->file;
+    JournalTick *last = &journal->last;
+
+    uint8_t flags, stick_x, stick_y;
+
+    if (!read_u8(file, &flags) || flags > (RECORD_BUTTONS | RECORD_STICK_X | RECORD_STICK_Y)) {
+        return false;
+    }
+
+    *tick = *last;
+
+    if ((flags & RECORD_BUTTONS) && !read_u16(file, &tick->buttons)) {
+        return false;
+    }
+
+    if (flags & RECORD_STICK_X) {
+        if (!read_u8(file, &stick_x)) {
+            return false;
+        }
+        tick->stick_x = (int8_t)stick_x;
+    }
+
+    if (flags & RECORD_STICK_Y) {
+        if (!read_u8(file, &stick_y)) {
+            return false;
+        }
+        tick->stick_y = (int8_t)stick_y;
+    }
+
+    if (!read_varint(file, &tick->step_ticks)) {
+        return false;
+    }
+
+    *last = *tick;
+    journal->ticks++;
+
+    return true;
+}
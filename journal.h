@@ -0,0 +1,69 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Input journal. Records everything the simulation takes from outside of itself, so a session can be re-executed
+// exactly: the random seed once, then for every simulation tick the controller state and the time the space step
+// took, which is what the step budget picks the next iterations and substeps from.
+//
+// The stream is a header followed by one record per tick. A record is a byte of flags saying which inputs changed
+// since the previous tick, the changed inputs, and the step time as a varint. That's about six bytes a tick.
+
+#define JOURNAL_MAGIC 0x314c4e4a // "JNL1"
+#define JOURNAL_VERSION 1
+
+// Flush the stream this often, so a session cut short by the power switch loses at most a few seconds.
+#define JOURNAL_FLUSH_TICKS 300
+
+// Controller buttons, as bits of JournalTick.buttons.
+enum {
+    JOURNAL_BUTTON_A = 1 << 0,
+    JOURNAL_BUTTON_B = 1 << 1,
+    JOURNAL_BUTTON_Z = 1 << 2,
+    JOURNAL_BUTTON_START = 1 << 3,
+    JOURNAL_BUTTON_D_UP = 1 << 4,
+    JOURNAL_BUTTON_D_DOWN = 1 << 5,
+    JOURNAL_BUTTON_D_LEFT = 1 << 6,
+    JOURNAL_BUTTON_D_RIGHT = 1 << 7,
+    JOURNAL_BUTTON_L = 1 << 8,
+    JOURNAL_BUTTON_R = 1 << 9,
+    JOURNAL_BUTTON_C_UP = 1 << 10,
+    JOURNAL_BUTTON_C_DOWN = 1 << 11,
+    JOURNAL_BUTTON_C_LEFT = 1 << 12,
+    JOURNAL_BUTTON_C_RIGHT = 1 << 13,
+};
+
+// Everything the simulation takes from outside during one tick.
+typedef struct {
+    // Buttons held during the tick. Presses are the buttons held now that weren't on the previous tick.
+    uint16_t buttons;
+    int8_t stick_x;
+    int8_t stick_y;
+    // Clock ticks the space step took.
+    uint32_t step_ticks;
+} JournalTick;
+
+typedef struct {
+    FILE *file;
+    uint32_t seed;
+    // Number of ticks written or read so far.
+    uint32_t ticks;
+    // Previous tick, which records are encoded against.
+    JournalTick last;
+} Journal;
+
+// Start recording to @c file, which must be open for writing. Returns false if the header couldn't be written.
+bool journal_record(Journal *journal, FILE *file, uint32_t seed);
+// Append one tick to a journal being recorded.
+bool journal_write_tick(Journal *journal, const JournalTick *tick);
+
+// Start replaying from @c file, which must be open for reading. Returns false if it doesn't hold a journal.
+// The recorded seed is in journal->seed afterwards.
+bool journal_replay(Journal *journal, FILE *file);
+// Read the next tick of a journal being replayed. Returns false at the end of the journal.
+bool journal_read_tick(Journal *journal, JournalTick *tick);
+
+#endif
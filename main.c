@@ -4,10 +4,21 @@
 #include <GL/gl_integration.h>
 #include <rspq_profile.h>
 #include <math.h>
+#include <stdarg.h>
 #include <unistd.h>
 
 #include <chipmunk/chipmunk.h>
 
+#include "game.h"
+#include "platform.h"
+
+// Set RECORD_JOURNAL=1 to record the input journal of every session to JOURNAL_PATH, for replay with tools/host/replay.
+#ifndef RECORD_JOURNAL
+#define RECORD_JOURNAL 0
+#endif
+
+#define JOURNAL_PATH "sd:/ggj24.jnl"
+
 // Mixer channel allocation
 #define CHANNEL_SFX1    0
 #define CHANNEL_SFX2    1
@@ -18,39 +29,6 @@ enum {
     FONT_IHATCS_SMALL = 2,
 };
 
-typedef enum {
-    GAME_STATE_ATTRACT = 1,
-    GAME_STATE_STARTING_LEVEL = 2,
-    GAME_STATE_PLAYING = 3,
-    GAME_STATE_GAME_OVER = 4,
-} GameState;
-
-typedef enum {
-    ITEM_BRICK,
-    ITEM_TAX,
-    ITEM_CHEESE,
-    ITEM_BEANS,
-    ITEM_QUESTION = 100,
-} ItemType;
-
-typedef enum {
-    STICK_SPRITE_NEUTRAL = 1,
-    STICK_SPRITE_UP = 2,
-    STICK_SPRITE_DOWN = 3,
-} StickStatus;
-
-ItemType levelProgression[] = {
-    ITEM_CHEESE,
-    ITEM_TAX,
-    ITEM_BEANS,
-    ITEM_BRICK,
-};
-
-static int progressionLength = 4;
-
-static int8_t stick_range = 80;
-static bool debug = false;
-
 sprite_t *attention_ray;
 sprite_t *question_mark;
 sprite_t *cheese;
@@ -58,75 +36,14 @@ sprite_t *beans;
 sprite_t *brick;
 sprite_t *tax;
 
-GameState gameStatus = GAME_STATE_ATTRACT;
-int state_start = 0;
-int curr_time_ms = 0;
-
-char title_buffer[50];
-char subtitle_buffer[50];
-
-ItemType currentItemType = ITEM_TAX;
-
-StickStatus stickStatus = STICK_SPRITE_NEUTRAL;
-StickStatus dpadStatus = STICK_SPRITE_NEUTRAL;
-
-cpVect lung_pos;
-cpVect mouth_pos;
-cpVect stick_pos;
-cpVect eyes_pos;
-cpVect dpad_pos;
-cpVect cpad_pos;
-cpVect laughometer_pos;
-
-cpVect item_pos;
-
-cpBody *itemBody;
-
-static cpSpace *space;
+// Real time beyond this many ticks per rendered frame is dropped, so a slow frame can't snowball.
+#define SIM_MAX_TICKS_PER_FRAME 4
+#define RENDER_FPS 30
 
-static cpCollisionType RAY = 1;
-static cpCollisionType PLAYER = 2;
-static cpCollisionType NONE = 3;
-
-float laughometer_level = 1.0f;
-float laughometer_change = 0.0f;
-
-// The current
-int level = 0;
-int sub_level = 0;
-int level_change_time = 0;
-int game_start_time = 0;
-int last_fire_time = 0;
-int fire_time = 0;
-int high_score = 0;
-int score = 0;
-bool item_funny = false;
-
-float lung_scale = 1.0f;
-bool lung_visible = true;
-bool lung_ghost_visible = true;
-
-float base_eye_scale = 0.6f;
-float eye_scale = 1.0f;
-float item_scale = 0.8f;
-float eye_angle = 0.0f;
-
-float lung_target_speed = 1.0f;
-float lung_target_scale = 1.0f;
-float lung_breath_speed = 1.0f;
-
-float target_speed = 1.0f;
-float current_speed = 1.0f;
-
-float mouth_angle = M_PI_4;
-float mouth_target = M_PI / 8;
-float mouth_target_speed = 1.0f;
-bool mouth_ghost_visible = false;
-
-char* title_text = "Make me laugh!";
-char *subtitle_text = "Press start!";
-bool title_visible = true;
-bool subtitle_visible = true;
+// Real time not yet simulated, and the fraction of a tick it represents for interpolation.
+int64_t sim_accumulator_us = 0;
+int64_t sim_last_us = 0;
+float sim_alpha = 0.0f;
 
 xm64player_t xm;
 
@@ -134,535 +51,118 @@ wav64_t sinister_laugh;
 wav64_t cartoon_laugh;
 wav64_t evil_laugh;
 
-static const float FRAME_FACTOR = 1.0f/30;
-static const float GRAVITY = 9.8;
-
-const cpFloat ray_width = 50.0f;
-const cpFloat ray_height = 20.0f;
-
-void play_laugh() {
-    wav64_t *laugh;
-
-    switch (rand() % 3) {
-        case 0:
-            laugh = &sinister_laugh;
-            break;
-        default:
-        case 1:
-            laugh = &cartoon_laugh;
-            break;
-        case 2:
-            laugh = &evil_laugh;
-            break;
-    }
-
-    wav64_play(laugh, CHANNEL_SFX1);
-
-    float freq = laugh->wave.frequency * (((rand() % 200) + 100.0f) / 200);
-
-    debugf("Sample freq original: %f updated: %f\n",laugh->wave.frequency, freq);
-    mixer_ch_set_freq(CHANNEL_SFX1, freq);
-}
-
-void spawn_ray(cpFloat speed) {
-    if (last_fire_time + 1000000 > curr_time_ms) {
-        return;
-    }
-
-    last_fire_time = curr_time_ms;
-
-    cpFloat mass = 1.0f;
-
-    cpBody *rayBody = cpBodyNewKinematic();
-    cpSpaceAddBody(space, rayBody);
-
-    cpBodySetPosition(rayBody, cpv(eyes_pos.x, eyes_pos.y));
-    cpBodySetAngle(rayBody, eye_angle);
-
-    cpFloat rotSpeed = rand() % 2 == 0 ? 1.0f : -1.0f;
-    cpBodySetVelocity(rayBody, cpv(speed * cosf(eye_angle), speed * sinf(eye_angle + M_PI)));
-    cpBodySetAngularVelocity(rayBody, rotSpeed);
+_Static_assert(PLATFORM_TICKS_PER_SECOND == TICKS_PER_SECOND, "platform_ticks() is timer_ticks()");
 
-    cpShape *rayShape = cpSpaceAddShape(space, cpBoxShapeNew(rayBody, ray_width, ray_height, 0));
-    cpShapeSetFriction(rayShape, 0.0);
-    cpShapeSetElasticity(rayShape, 0.1f);
-    cpShapeSetCollisionType(rayShape, RAY);
-    cpShapeSetMass(rayShape, 5.0f);
-
-    if (debug) {
-        debugf("Added shape %p\n", rayShape);
-        debugf("Added body %p\n", rayBody);
-    }
-}
-
-void init() {
-    lung_pos = cpv(100, 175);
-    mouth_pos = cpv(220,175);
-    eyes_pos = cpv(400, 180);
-
-    laughometer_pos = cpv(320, 35);
-
-    stick_pos = cpv(245, 275);
-    dpad_pos = cpv(110, 303);
-    cpad_pos = cpv(550, 290);
-
-    item_pos = cpv(550, 150);
+uint64_t platform_ticks(void) {
+    return timer_ticks();
 }
 
-static void changeShapeCollision(cpBody* body, cpShape *shape, void* data) {
-    cpShapeSetCollisionType(shape, NONE);
+float platform_sinf(float x) {
+    return fm_sinf_approx(x, 5);
 }
 
-static void postRayCollide(cpSpace *space, cpBody *ray, void *unused)
-{  
-    // A body can have multiple shapes, so we need to iterate through and delete
-    cpBodySetType(ray, CP_BODY_TYPE_DYNAMIC);
-    cpBodySetMass(ray, 5.0f);
+void platform_log(const char *format, ...) {
+#ifndef NDEBUG
+    va_list args;
 
-    cpBodyEachShape(ray, (cpBodyShapeIteratorFunc)changeShapeCollision, NULL);
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+#endif
 }
 
-static void removeShape(cpBody* body, cpShape* shape, cpSpace *space) {
-  debugf("Remove shape %p\n", shape);
-  cpSpaceRemoveShape(space, shape);
-  cpShapeFree(shape);
-}
-
-static void postStepRemoveBody(cpSpace *space, cpBody *body, void *unused)
-{  
-  // A body can have multiple shapes, so we need to iterate through and delete
-  cpBodyEachShape(body, (cpBodyShapeIteratorFunc)removeShape, space);
-
-  cpBodySetType(body, CP_BODY_TYPE_KINEMATIC);
-  debugf("Remove body %p\n", body);
-  cpSpaceRemoveBody(space, body);
-
-  cpBodyFree(body);
-}
-
-static cpBool handlePlayerRayCollision(cpArbiter *arb, cpSpace *space, void *data){
-    debugf("Collide!\n");
-
-    cpBody *a, *b; cpArbiterGetBodies(arb, &a, &b);
+void platform_play_laugh(Laugh laugh, float pitch) {
+    wav64_t *sample;
 
-    cpBody *ray = a == itemBody ? b : a;
-
-    if (item_funny) {
-        cpSpaceAddPostStepCallback(
-            space, (cpPostStepFunc)postStepRemoveBody, ray, NULL);
-        
-    } else {
-        cpSpaceAddPostStepCallback(
-            space, (cpPostStepFunc)postRayCollide, ray, NULL
-        );
-    }
-
-    if (gameStatus == GAME_STATE_PLAYING) {
-        if (item_funny) {
-            laughometer_level += 0.1f;
-        } else {
-            laughometer_level -= 0.1f;
-        }
-    } else {
-        play_laugh();
-    }
-
-    return cpTrue;
-}
-
-static cpSpace* init_space() {
-    cpSpace *space = cpSpaceNew();
-    cpSpaceSetGravity(space, cpv(0, 100));
-
-    // This doesn't seem to work, so I've forcible disabled sleep in the cpSpaceStep code
-    cpSpaceSetSleepTimeThreshold(space, INFINITY);
-
-    itemBody = cpBodyNewKinematic();
-    cpSpaceAddBody(space, itemBody);
-
-    cpBodySetPosition(itemBody, item_pos);
-
-    cpShape *itemShape = cpSpaceAddShape(space, cpBoxShapeNew(itemBody, 80, 60, 0));
-    cpShapeSetCollisionType(itemShape, PLAYER);
-    cpShapeSetMass(itemShape, 5.0f);
-
-    cpCollisionHandler *handler = cpSpaceAddCollisionHandler(space, PLAYER, RAY);
-    handler->beginFunc = (cpCollisionBeginFunc)handlePlayerRayCollision;
-
-    return space;
-}
-
-void setup_speeds() {
-    mouth_target_speed = 0.8f + level * 0.15f;
-    lung_breath_speed = 0.8f + level * 0.15f;
-}
-
-void update_game_state(GameState new_state) {
-    debugf("Change state from %i to %i at %i\n",
-        gameStatus,
-        new_state,
-        curr_time_ms);
-
-    state_start = curr_time_ms;
-    gameStatus = new_state;
-}
-
-void start_attract() {
-    update_game_state(GAME_STATE_ATTRACT);
-
-    title_text = "Make Me Laugh!";
-    subtitle_text = "Press start!";
-
-    score = 0;
-
-    lung_ghost_visible = false;
-    mouth_ghost_visible = false;
-
-    lung_target_scale = 1.0f;
-    mouth_target = M_PI / 8;
-
-    currentItemType = ITEM_QUESTION;
-
-    cpBodySetPosition(itemBody, cpv(550, 150));
-    cpBodySetVelocity(itemBody, cpv(0, 0));
-    cpBodySetAngle(itemBody, 0);
-    cpBodySetType(itemBody, CP_BODY_TYPE_KINEMATIC);
-}
-
-void start_starting() {
-    update_game_state(GAME_STATE_STARTING_LEVEL);
-
-    sprintf(title_buffer, "Starting level %i", level + 1);
-
-    title_text = title_buffer;
-
-    switch (rand() % 3) {
-        case 0:
-            subtitle_text = "Is this funny?";
-        break;
-        case 1:
-            subtitle_text = "Does this make you laugh?";
-        break;
-        case 2:
-            subtitle_text = "Is this funny enough for you?";
-        break;
-    }
-
-    subtitle_visible = true;
-
-    laughometer_level = 1.0f;
-    laughometer_change = 0.0f;
-
-    if (level < progressionLength) {
-        currentItemType = levelProgression[level];
-    } else {
-        currentItemType = rand() % 4;
+    switch (laugh) {
+        case LAUGH_SINISTER:
+            sample = &sinister_laugh;
+            break;
+        default:
+        case LAUGH_CARTOON:
+            sample = &cartoon_laugh;
+            break;
+        case LAUGH_EVIL:
+            sample = &evil_laugh;
+            break;
     }
 
-    item_funny = currentItemType == ITEM_CHEESE || currentItemType == ITEM_BEANS;
-
-    item_pos = cpv(550, 220);
-    cpBodySetPosition(itemBody, item_pos);
-
-    setup_speeds();
-}
-
-void new_game() {
-    level = 0;
-    sub_level = 0;
-    score = 0;
-    game_start_time = curr_time_ms;
-
-    start_starting();
-}
-
-void next_level() {
-    level += 1;
-
-    start_starting();
-}
+    wav64_play(sample, CHANNEL_SFX1);
 
-void start_game() {
-    update_game_state(GAME_STATE_PLAYING);
+    float freq = sample->wave.frequency * pitch;
 
-    title_text = "Start!";
-
-    lung_ghost_visible = true;
-    mouth_ghost_visible = true;
-
-    level_change_time = 10 * 1000000 + curr_time_ms;
-
-    play_laugh();
+    debugf("Sample freq original: %f updated: %f\n", sample->wave.frequency, freq);
+    mixer_ch_set_freq(CHANNEL_SFX1, freq);
 }
 
-void start_game_over() {
-    update_game_state(GAME_STATE_GAME_OVER);
-    
-    debugf("Gameover with score of %i\n", score);
-
-    title_text = "Game over!";
-
-    if (score > high_score) {
-        high_score = score;
-        sprintf(subtitle_buffer, "You got a new high score of %d seconds!", score);
-    } else {
-        sprintf(subtitle_buffer, "You survived %d seconds", score);
-    }
-
-    cpBodySetType(itemBody, CP_BODY_TYPE_DYNAMIC);
-    cpBodySetMass(itemBody, 10.0f);
-    cpBodySetAngularVelocity(itemBody,10 * ( -1.0f + (rand() % 2000) / 1000.0f));
-
-    subtitle_visible = true;
-    subtitle_text = subtitle_buffer;
+void platform_stop_music(void) {
+    xm64player_stop(&xm);
 }
 
-void update_attract() {
-    joypad_buttons_t pressed  = joypad_get_buttons_pressed(JOYPAD_PORT_1);
-
-    laughometer_level = 1.0f + fm_sinf_approx(
-        curr_time_ms * 4.0f / (5000000 * lung_breath_speed), 5
-    );
-
-    laughometer_level = cpfclamp(laughometer_level, 0, 2.0f);
-
-    lung_scale = 0.95f + 0.1f * fm_sinf_approx(curr_time_ms / (1000000 * lung_breath_speed), 5);
-    mouth_angle = M_PI / 8 + (M_PI / 10) * (fm_sinf_approx(curr_time_ms / (2000000 * 1.0f), 5));
-
-    eye_scale = 0.9f + (0.2f * fm_sinf_approx(curr_time_ms / (3000000.0f), 5));
-    eye_angle = -M_PI / 8 + (M_PI_4 * fm_sinf_approx(curr_time_ms * 5.0f / (6000000.0f), 5));
+#if RECORD_JOURNAL
+static Journal journal;
+static bool journal_open = false;
+#endif
 
-    item_pos.y = 180.0f + 80.0f * fm_sinf_approx(curr_time_ms / (2000000.0f), 5);
-    cpBodySetPosition(itemBody, item_pos);
-
-    if (fire_time < curr_time_ms) {
-        spawn_ray(80.0f);
-
-        fire_time = curr_time_ms + cpfmax(500000, 500000 + rand() % 2000000);
-    }
-
-    subtitle_visible = curr_time_ms % 1000000 > 500000;
-    if (pressed.start) {
-        new_game();
-    }
-
-    if (pressed.a) {
-        spawn_ray(100.0f);
-    }
-}
-
-void update_starting() {
-    if (curr_time_ms - state_start > 5000000) {
-        start_game();
-    }
-}
+static JournalTick read_joypad() {
+    joypad_poll();
 
-void update_playing() {
+    joypad_buttons_t buttons = joypad_get_buttons_held(JOYPAD_PORT_1);
     joypad_inputs_t inputs = joypad_get_inputs(JOYPAD_PORT_1);
 
-    bool eye_correct = false;
-
-    mouth_angle = M_PI / 8 + (inputs.stick_y / 85.0f) * M_PI / 8;
-
-    float mouth_wiggle = cpfmax(0.03f, 0.1f - (sub_level * 0.01f));
-
-    if (mouth_target > mouth_angle + mouth_wiggle) {
-        stickStatus = STICK_SPRITE_UP;
-    } else if (mouth_target < mouth_angle - mouth_wiggle) {
-        stickStatus = STICK_SPRITE_DOWN;
-    }  else {
-        stickStatus = STICK_SPRITE_NEUTRAL;
-    }
-
-    bool mouth_correct = stickStatus == STICK_SPRITE_NEUTRAL;
-
-    mouth_target = M_PI * (1 + 0.75f * fm_sinf_approx(curr_time_ms * mouth_target_speed / (1000000), 5)) / 8;
-
-    float lung_wiggle = cpfmax(0.03f, 0.1f - (sub_level * 0.01f));
-    if (lung_target_scale > lung_scale + lung_wiggle) {
-        dpadStatus = STICK_SPRITE_UP;
-    } else if (lung_target_scale < lung_scale - lung_wiggle) {
-        dpadStatus = STICK_SPRITE_DOWN;
-    } else {
-        dpadStatus = STICK_SPRITE_NEUTRAL;
-    }
-
-    bool lung_correct = dpadStatus == STICK_SPRITE_NEUTRAL;
-
-    if (item_funny) {
-        eye_angle = -M_PI / 8 + (M_PI_4 * fm_sinf_approx(curr_time_ms * (sub_level + 1) * 2.5f / (6000000.0f), 5));
-    } else {
-        cpVect dItem = cpvsub(eyes_pos, cpBodyGetPosition(itemBody));
-
-        eye_angle = -cpvtoangle(dItem) + M_PI;
-    }
-
-    if (fire_time < curr_time_ms) {
-        spawn_ray(50.0f + sub_level * 10.0f);
-
-        if (item_funny) {
-            fire_time = curr_time_ms + 300000 + rand() % 2000000;
-        } else {
-            fire_time = curr_time_ms + 300000 + rand() % 3000000;
-        }
-    }
-
-    laughometer_change += 0.001f + (item_funny ? 0: 0.0001f);
-
-    float punishment = -0.00055 - 0.00001f * sub_level;
-
-    if (!lung_correct) {
-        laughometer_change += punishment;
-    }
-
-    if (!mouth_correct) {
-        laughometer_change += punishment;
-    }
-
-    debugf("Change: %f, level: %f\n", laughometer_change, laughometer_level);
-
-    if (!lung_correct) {
-        title_text = "Breath harder!";
-    } else if (!mouth_correct) {
-        title_text = "Flap more!";
-    } else {
-        title_text = "";
-    }
-
-    laughometer_change = cpfclamp(laughometer_change, -0.005f, 0.005f);
-
-    laughometer_level += laughometer_change;
-
-    laughometer_level = cpfclamp(laughometer_level, 0, 2.0f);
-
-    debugf("Change: %f, level: %f\n", laughometer_change, laughometer_level);
-
-    joypad_buttons_t pressed  = joypad_get_buttons_pressed(JOYPAD_PORT_1);
-
-    if ((laughometer_level <= 0.0f && !debug) || (debug && pressed.b)) {
-        score = (curr_time_ms - game_start_time) / 1000000;
-        start_game_over();
-
-        play_laugh();
-    }
-
-    if (curr_time_ms > level_change_time || (debug && pressed.a)) {
-        sub_level++;
-        debugf("Advance to sub level %i\n", sub_level);
-        level_change_time = 8 * 1000000 + curr_time_ms;
-
-        setup_speeds();
-
-        play_laugh();
-
-        if (sub_level > 3 * (level + 1)) {
-            next_level();
-        }
-    }
-
-    joypad_buttons_t held = joypad_get_buttons_held(JOYPAD_PORT_1);
-
-    lung_target_scale = 0.95f + 0.1f * fm_sinf_approx(curr_time_ms * lung_target_speed / (1000000), 5);
-
-    float lungSpeed = 0.005f + level * 0.001f;
-    if (held.d_up) {
-        lung_scale += lungSpeed;
-    }
-
-    if (held.d_down) {
-        lung_scale -= lungSpeed;
-    }
-
-    lung_scale = cpfclamp(lung_scale, 0.8f, 1.2f);
-    float itemSpeed = 2.0f + sub_level * 0.04f;
-
-    if (held.c_up) {
-        item_pos.y -= itemSpeed;
-    }
-    if (held.c_down) {
-        item_pos.y += itemSpeed;
-    }
-    if (held.c_left) {
-        item_pos.x -= itemSpeed;
-    }
-    if (held.c_right) {
-        item_pos.x += itemSpeed;
-    }
-
-    cpBodySetPosition(itemBody, item_pos);
+    return (JournalTick){
+        .buttons = (buttons.a ? JOURNAL_BUTTON_A : 0)
+            | (buttons.b ? JOURNAL_BUTTON_B : 0)
+            | (buttons.z ? JOURNAL_BUTTON_Z : 0)
+            | (buttons.start ? JOURNAL_BUTTON_START : 0)
+            | (buttons.d_up ? JOURNAL_BUTTON_D_UP : 0)
+            | (buttons.d_down ? JOURNAL_BUTTON_D_DOWN : 0)
+            | (buttons.d_left ? JOURNAL_BUTTON_D_LEFT : 0)
+            | (buttons.d_right ? JOURNAL_BUTTON_D_RIGHT : 0)
+            | (buttons.l ? JOURNAL_BUTTON_L : 0)
+            | (buttons.r ? JOURNAL_BUTTON_R : 0)
+            | (buttons.c_up ? JOURNAL_BUTTON_C_UP : 0)
+            | (buttons.c_down ? JOURNAL_BUTTON_C_DOWN : 0)
+            | (buttons.c_left ? JOURNAL_BUTTON_C_LEFT : 0)
+            | (buttons.c_right ? JOURNAL_BUTTON_C_RIGHT : 0),
+        .stick_x = inputs.stick_x,
+        .stick_y = inputs.stick_y,
+    };
 }
 
-void update_game_over() {
-    lung_scale = 0.95f + 0.1f * fm_sinf_approx(curr_time_ms / (1000000 * lung_breath_speed), 5);
-    mouth_angle = M_PI / 8 + (M_PI / 10) * (fm_sinf_approx(curr_time_ms / (2000000 * 1.0f), 5));
-
-    eye_scale = 0.9f + (0.2f * fm_sinf_approx(curr_time_ms / (3000000.0f), 5));
+// Run as many simulation ticks as the real time since the last frame calls for.
+void update_clock() {
+    int64_t now = TIMER_MICROS_LL(timer_ticks());
 
-    joypad_buttons_t pressed  = joypad_get_buttons_pressed(JOYPAD_PORT_1);
+    sim_accumulator_us += now - sim_last_us;
+    sim_last_us = now;
 
-    if (pressed.start) {
-        start_attract();
+    if (sim_accumulator_us > SIM_MAX_TICKS_PER_FRAME * SIM_TICK_US) {
+        sim_accumulator_us = SIM_MAX_TICKS_PER_FRAME * SIM_TICK_US;
     }
-}
-
-// Remove any bodies that have fallen off the screen
-static void updateBody(cpBody *body, void* data) {
-    cpVect pos = cpBodyGetPosition(body);
-
-    if (pos.y > 700 || pos.x < -50 || pos.x > 700) {
-        if (body == itemBody && cpBodyGetType(body) == CP_BODY_TYPE_DYNAMIC)
-        {
-            cpBodySetPosition(body, cpv(1000, 1000));
-            return;
-        }
-
-
-        cpSpaceAddPostStepCallback(
-            space, (cpPostStepFunc)postStepRemoveBody, body, NULL
-        );
-    }
-}
 
-void update() {
-    joypad_poll();
+    while (sim_accumulator_us >= SIM_TICK_US) {
+        JournalTick tick = read_joypad();
 
-    curr_time_ms = TIMER_MICROS(timer_ticks());
-    cpSpaceStep(space, 0.03);
+        update(&tick);
+        sim_accumulator_us -= SIM_TICK_US;
 
-    switch (gameStatus) {
-        case GAME_STATE_ATTRACT:
-            update_attract();
-            break;
-        case GAME_STATE_PLAYING:
-            update_playing();
-            break;
-        case GAME_STATE_STARTING_LEVEL:
-            update_starting();
-            break;
-        case GAME_STATE_GAME_OVER:
-            update_game_over();
-            break;
-    }
-
-    joypad_buttons_t pressed  = joypad_get_buttons_pressed(JOYPAD_PORT_1);
-
-    if (pressed.r) {        
-        debugf("Lung: %f actual %f target, mouth: %f action %f target, eye: %f angle %f\n", lung_scale, lung_target_scale, mouth_angle, mouth_target, eye_scale, eye_angle);
-    }
-
-    if (pressed.l) {
-        debug = !debug;
-
-        debugf("Debug: %i\n", debug);
-        xm64player_stop(&xm);
+#if RECORD_JOURNAL
+        if (journal_open && !journal_write_tick(&journal, &tick)) {
+            debugf("Journal write failed, stopped recording\n");
+            journal_open = false;
+        }
+#endif
     }
 
-    cpSpaceEachBody(space, (cpSpaceBodyIteratorFunc)updateBody, NULL);
+    sim_alpha = (float)sim_accumulator_us / SIM_TICK_US;
 }
 
 static void drawBody(cpBody *body, surface_t *disp) {
-    cpVect pos = cpBodyGetPosition(body);
-    cpVect rot = cpBodyGetRotation(body);
+    // Draw between the last two ticks, since the render clock is ahead of the simulation by sim_alpha ticks.
+    BodyPose *prev = body_prev_pose(body);
+    cpVect pos = cpvlerp(prev->pos, cpBodyGetPosition(body), sim_alpha);
+    cpVect rot = cpvforangle(cpflerp(prev->angle, cpBodyGetAngle(body), sim_alpha));
     float theta = atan2f(rot.y, -rot.x);
 
     if (body != itemBody) {
@@ -751,10 +251,18 @@ int main() {
 
     display_init(RESOLUTION_640x480, DEPTH_16_BPP, 2, GAMMA_NONE, FILTERS_DISABLED);
 
+    // The only source of randomness. Everything after it follows from the seed and the inputs in the journal.
     uint32_t seed;
     getentropy(&seed, 4);
-    srand(seed);
-    register_VI_handler((void(*)(void))rand);
+
+#if RECORD_JOURNAL
+    debug_init_sdfs("sd:/", -1);
+
+    FILE *journal_file = fopen(JOURNAL_PATH, "wb");
+    journal_open = journal_file && journal_record(&journal, journal_file, seed);
+
+    debugf("Recording journal to %s: %s\n", JOURNAL_PATH, journal_open ? "yes" : "failed");
+#endif
 
     rdpq_init();
     joypad_init();
@@ -762,7 +270,7 @@ int main() {
     rdpq_debug_start();
     audio_init(44100, 4);
 	mixer_init(16);  // Initialize up to 16 channels
-    throttle_init(30, 0, 1);
+    throttle_init(RENDER_FPS, 0, 1);
 
     rdpq_font_t *ihat_cs_fnt = rdpq_font_load("rom://IHATCS.font64");
     rdpq_font_style(ihat_cs_fnt, 0, &(rdpq_fontstyle_t) {
@@ -813,11 +321,9 @@ int main() {
     xm64player_set_vol(&xm, 0.7f);
     xm64player_play(&xm, CHANNEL_MUSIC);
 
-    init();
-
-    space = init_space();
+    game_init(seed, false);
 
-    start_attract();
+    sim_last_us = TIMER_MICROS_LL(timer_ticks());
 
     while (1)
     {
@@ -1045,6 +551,29 @@ int main() {
         );
       
         if (debug) {
+            rdpq_text_printf(NULL, FONT_IHATCS_SMALL, 10, 470, "Awake: %d Sleeping: %d Iter: %d Sub: %d",
+                cpSpaceGetAwakeBodyCount(space),
+                cpSpaceGetSleepingBodyCount(space),
+                cpSpaceGetIterations(space),
+                cpSpaceGetSubsteps(space));
+
+#if CP_USE_STEP_PROFILE
+            const cpStepProfile *profile = cpSpaceGetStepProfile(space, 0);
+            if (profile) {
+                rdpq_text_printf(NULL, FONT_IHATCS_SMALL, 10, 455,
+                    "Step %dus: broad %d narrow %d graph %d int %d pre %d solve %d post %d",
+                    TIMER_MICROS(profile->total),
+                    TIMER_MICROS(profile->phases[CP_STEP_PHASE_BROADPHASE]),
+                    TIMER_MICROS(profile->phases[CP_STEP_PHASE_NARROWPHASE]),
+                    TIMER_MICROS(profile->phases[CP_STEP_PHASE_COMPONENTS]),
+                    TIMER_MICROS(profile->phases[CP_STEP_PHASE_INTEGRATE]),
+                    TIMER_MICROS(profile->phases[CP_STEP_PHASE_PRESTEP]),
+                    TIMER_MICROS(profile->phases[CP_STEP_PHASE_SOLVER]),
+                    TIMER_MICROS(profile->phases[CP_STEP_PHASE_POST_SOLVE]));
+                rdpq_text_printf(NULL, FONT_IHATCS_SMALL, 10, 440, "Pairs: %d Arbiters: %d Contacts: %d",
+                    profile->pairs, profile->arbiters, profile->contacts);
+            }
+#endif
         }
 
         mixer_try_play();
@@ -1053,7 +582,7 @@ int main() {
         
         display_show(disp);
 
-        update();
+        update_clock();
 
         // Check whether one audio buffer is ready, otherwise wait for next
 		// frame to perform mixing.
@@ -0,0 +1,33 @@
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+#include <stdint.h>
+
+// Everything the game simulation in game.c needs from the machine it runs on. main.c implements it with libdragon
+// for the N64, and tools/host with the C library for running the simulation on a PC.
+
+// Rate of platform_ticks(). Fixed at the N64's timer rate on every platform, so step times in a journal recorded on
+// the console mean the same thing everywhere.
+#define PLATFORM_TICKS_PER_SECOND 46875000
+#define PLATFORM_TICKS_FROM_MS(ms) ((uint64_t)(ms) * (PLATFORM_TICKS_PER_SECOND / 1000))
+
+typedef enum {
+    LAUGH_SINISTER,
+    LAUGH_CARTOON,
+    LAUGH_EVIL,
+} Laugh;
+
+// Monotonic clock in PLATFORM_TICKS_PER_SECOND ticks.
+uint64_t platform_ticks(void);
+
+// Fast sine. Precision is up to the platform.
+float platform_sinf(float x);
+
+// Debug log. printf style.
+void platform_log(const char *format, ...) __attribute__((format(printf, 1, 2)));
+
+// Play a laugh sample with its pitch scaled by @c pitch.
+void platform_play_laugh(Laugh laugh, float pitch);
+void platform_stop_music(void);
+
+#endif
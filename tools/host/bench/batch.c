@@ -0,0 +1,205 @@
+// Batched queries against one query at a time, in the bounding box tree and in a space.
+//
+//   batch [-r rounds]
+//
+// First the tree on its own, with a callback that only counts: a fan of rays around the centre of a tree of random
+// boxes, in angle order, through cpSpatialIndexSegmentQueryBatch() and cpSpatialIndexSegmentQuery(), and boxes at the
+// ends of the rays through cpSpatialIndexQueryBatch() and cpSpatialIndexQuery(). Then a space of shapes with the same
+// rays and points through cpSpaceSegmentQueryFirstBatch() and cpSpacePointQueryNearestBatch() against the single
+// queries, which also run the shape tests. Both ways have to find the same thing. Times are the least over the rounds,
+// in ns per query.
+
+#include <math.h>
+#include <unistd.h>
+
+#include "harness.h"
+#include "scenes.h"
+
+#define MAX_QUERIES 1024
+
+static uint32_t rng = 19;
+
+// Boxes of 4 to 20 units, as dense as 2000 of them in 1000x1000 units.
+static cpBB leaf_bbs[16000];
+
+static cpBB leaf_bb(cpBB *bb) { return *bb; }
+
+static cpFloat field_size(int leaves) { return 1000 * sqrt(leaves / 2000.0); }
+
+static cpSpatialIndex *make_tree(int leaves) {
+    cpSpatialIndex *tree = cpBBTreeNew((cpSpatialIndexBBFunc)leaf_bb, NULL);
+    cpFloat size = field_size(leaves);
+
+    for (int i = 0; i < leaves; i++) {
+        cpVect p = cpv(test_randf(&rng, 0, size), test_randf(&rng, 0, size));
+        leaf_bbs[i] = cpBBNewForExtents(p, test_randf(&rng, 2, 10), test_randf(&rng, 2, 10));
+        cpSpatialIndexInsert(tree, &leaf_bbs[i], i);
+    }
+    cpBBTreeOptimize(tree);
+
+    return tree;
+}
+
+static void make_fan(cpSpatialIndexSegment *segments, cpBB *bbs, int count, cpVect center, cpFloat length) {
+    for (int i = 0; i < count; i++) {
+        cpVect end = cpvadd(center, cpvmult(cpvforangle(2 * CP_PI * i / count), length));
+        segments[i] = (cpSpatialIndexSegment){center, end, 1};
+        bbs[i] = cpBBNewForExtents(end, 10, 10);
+    }
+}
+
+static cpFloat count_segment(void *obj, void *leaf, int *count) {
+    (*count)++;
+    return 1;
+}
+
+static cpFloat count_segment_batch(int query, void *leaf, int *count) {
+    (*count)++;
+    return 1;
+}
+
+static cpCollisionID count_box(void *obj, void *leaf, cpCollisionID id, int *count) {
+    (*count)++;
+    return id;
+}
+
+static void count_box_batch(int query, void *leaf, int *count) { (*count)++; }
+
+static void bench_tree(int leaves, int queries, cpFloat length, int rounds) {
+    static cpSpatialIndexSegment segments[MAX_QUERIES], fan[MAX_QUERIES];
+    static cpBB bbs[MAX_QUERIES];
+
+    cpSpatialIndex *tree = make_tree(leaves);
+    cpFloat size = field_size(leaves);
+    make_fan(fan, bbs, queries, cpv(size / 2, size / 2), length);
+
+    double best[4] = {INFINITY, INFINITY, INFINITY, INFINITY};
+    int found[4] = {0};
+    for (int round = 0; round < rounds; round++) {
+        for (int i = 0; i < queries; i++) {
+            segments[i] = fan[i];
+        }
+
+        found[0] = found[1] = found[2] = found[3] = 0;
+        uint64_t start = now_ns();
+        cpSpatialIndexSegmentQueryBatch(tree, segments, queries,
+            (cpSpatialIndexBatchSegmentQueryFunc)count_segment_batch, &found[0]);
+        uint64_t batched = now_ns();
+        for (int i = 0; i < queries; i++) {
+            cpSpatialIndexSegmentQuery(tree, NULL, fan[i].a, fan[i].b, 1, (cpSpatialIndexSegmentQueryFunc)count_segment,
+                &found[1]);
+        }
+        uint64_t single = now_ns();
+        cpSpatialIndexQueryBatch(tree, bbs, queries, (cpSpatialIndexBatchQueryFunc)count_box_batch, &found[2]);
+        uint64_t boxes_batched = now_ns();
+        for (int i = 0; i < queries; i++) {
+            cpSpatialIndexQuery(tree, NULL, bbs[i], (cpSpatialIndexQueryFunc)count_box, &found[3]);
+        }
+        uint64_t boxes_single = now_ns();
+
+        best[0] = fmin(best[0], (double)(batched - start) / queries);
+        best[1] = fmin(best[1], (double)(single - batched) / queries);
+        best[2] = fmin(best[2], (double)(boxes_batched - single) / queries);
+        best[3] = fmin(best[3], (double)(boxes_single - boxes_batched) / queries);
+    }
+
+    CHECK(found[0] == found[1] && found[2] == found[3], "%d leaves: batches found %d and %d leaves, not %d and %d",
+        leaves, found[0], found[2], found[1], found[3]);
+    printf("  %6d  %7d  %10g  %9.0f / %-6.0f  %6.0f / %.0f\n", leaves, queries, length, best[0], best[1], best[2],
+        best[3]);
+
+    cpSpatialIndexFree(tree);
+}
+
+static cpSpace *make_space(int shapes) {
+    cpSpace *space = cpSpaceNew();
+
+    for (int i = 0; i < shapes; i++) {
+        cpBody *body = cpSpaceAddBody(space, cpBodyNew(1, 1));
+        cpBodySetPosition(body, cpv(test_randf(&rng, 0, 1000), test_randf(&rng, 0, 1000)));
+        cpBodySetAngle(body, test_randf(&rng, 0, 6));
+
+        cpFloat size = test_randf(&rng, 4, 20);
+        cpShape *shape = i % 2 ? cpCircleShapeNew(body, size / 2, cpvzero) : cpBoxShapeNew(body, size, size / 2, 0);
+        cpSpaceAddShape(space, shape);
+    }
+
+    return space;
+}
+
+static void bench_space(int shapes, int queries, cpFloat length, int rounds) {
+    static cpBatchSegmentQuery segments[MAX_QUERIES];
+    static cpBatchPointQuery points[MAX_QUERIES];
+    static cpSegmentQueryInfo segment_infos[MAX_QUERIES];
+    static cpPointQueryInfo point_infos[MAX_QUERIES];
+
+    cpSpace *space = make_space(shapes);
+    for (int i = 0; i < queries; i++) {
+        cpVect end = cpvadd(cpv(500, 500), cpvmult(cpvforangle(2 * CP_PI * i / queries), length));
+        segments[i] = (cpBatchSegmentQuery){cpv(500, 500), end, 0, CP_SHAPE_FILTER_ALL};
+        points[i] = (cpBatchPointQuery){end, 20, CP_SHAPE_FILTER_ALL};
+    }
+
+    double best[4] = {INFINITY, INFINITY, INFINITY, INFINITY};
+    int found[4] = {0};
+    for (int round = 0; round < rounds; round++) {
+        found[1] = found[3] = 0;
+        uint64_t start = now_ns();
+        found[0] = cpSpaceSegmentQueryFirstBatch(space, segments, queries, segment_infos);
+        uint64_t batched = now_ns();
+        for (int i = 0; i < queries; i++) {
+            cpBatchSegmentQuery *q = &segments[i];
+            found[1] += cpSpaceSegmentQueryFirst(space, q->start, q->end, q->radius, q->filter, NULL) != NULL;
+        }
+        uint64_t single = now_ns();
+        found[2] = cpSpacePointQueryNearestBatch(space, points, queries, point_infos);
+        uint64_t points_batched = now_ns();
+        for (int i = 0; i < queries; i++) {
+            cpBatchPointQuery *q = &points[i];
+            found[3] += cpSpacePointQueryNearest(space, q->point, q->maxDistance, q->filter, NULL) != NULL;
+        }
+        uint64_t points_single = now_ns();
+
+        best[0] = fmin(best[0], (double)(batched - start) / queries);
+        best[1] = fmin(best[1], (double)(single - batched) / queries);
+        best[2] = fmin(best[2], (double)(points_batched - single) / queries);
+        best[3] = fmin(best[3], (double)(points_single - points_batched) / queries);
+    }
+
+    CHECK(found[0] == found[1] && found[2] == found[3], "%d shapes: batches hit %d and %d times, not %d and %d",
+        shapes, found[0], found[2], found[1], found[3]);
+    printf("  %6d  %7d  %10g  %9.0f / %-6.0f  %6.0f / %.0f\n", shapes, queries, length, best[0], best[1], best[2],
+        best[3]);
+
+    scene_free_space(space);
+}
+
+int main(int argc, char **argv) {
+    int rounds = 50;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "r:")) != -1) {
+        switch (opt) {
+            case 'r':
+                rounds = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-r rounds]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    printf("tree with a counting callback, ns per query, least over %d rounds\n", rounds);
+    printf("  leaves  queries  ray length  segment batch/single  box batch/single\n");
+    bench_tree(2000, 32, 100, rounds);
+    bench_tree(2000, 256, 100, rounds);
+    bench_tree(2000, 256, 400, rounds);
+    bench_tree(16000, 1024, 200, rounds);
+
+    printf("space, ns per query, least over %d rounds\n", rounds);
+    printf("  shapes  queries  ray length  segment batch/single  point batch/single\n");
+    bench_space(2000, 1000, 200, rounds);
+    bench_space(2000, 1000, 400, rounds);
+
+    return 0;
+}
@@ -0,0 +1,104 @@
+// The broadphases with hundreds of rays in the playfield, through cpBroadphaseReplay().
+//
+//   broadphase [-n rays] [-f frames]
+//
+// The rays are recorded without a space: 50x20 boxes spinning and bouncing off the edges of the screen at the speed
+// they're fired at. game.c takes rays out once they leave the screen, so the grid's bounds stay about the screen's,
+// which a scene piling up rays in a space wouldn't do. Every frame is replayed through a fresh index of every type.
+
+#include <math.h>
+#include <unistd.h>
+
+#include "harness.h"
+#include "scenes.h"
+
+#define WIDTH 640
+#define HEIGHT 470
+#define SPEED 80
+
+static const char *names[CP_BROADPHASE_TYPE_COUNT] = {"tree", "hash", "sweep", "grid"};
+
+typedef struct {
+    cpVect p, v;
+    cpFloat angle, spin;
+} Ray;
+
+// Bounding box of a 50x20 box turned by angle.
+static cpBB ray_bb(const Ray *ray) {
+    cpFloat c = fabs(cos(ray->angle)), s = fabs(sin(ray->angle));
+    return cpBBNewForExtents(ray->p, 25 * c + 10 * s, 25 * s + 10 * c);
+}
+
+static void move_ray(Ray *ray) {
+    ray->p = cpvadd(ray->p, cpvmult(ray->v, SCENE_DT));
+    ray->angle += ray->spin * SCENE_DT;
+
+    if (ray->p.x < 0 || ray->p.x > WIDTH) {
+        ray->v.x = -ray->v.x;
+    }
+    if (ray->p.y < 0 || ray->p.y > HEIGHT) {
+        ray->v.y = -ray->v.y;
+    }
+}
+
+int main(int argc, char **argv) {
+    int rays = 500, frames = 300;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:f:")) != -1) {
+        switch (opt) {
+            case 'n':
+                rays = atoi(optarg);
+                break;
+            case 'f':
+                frames = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-n rays] [-f frames]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    uint32_t rng = 1;
+    Ray *state = calloc(rays, sizeof(Ray));
+    for (int i = 0; i < rays; i++) {
+        cpFloat heading = test_randf(&rng, 0, 2 * M_PI);
+
+        state[i] = (Ray){
+            .p = cpv(test_randf(&rng, 0, WIDTH), test_randf(&rng, 0, HEIGHT)),
+            .v = cpvmult(cpvforangle(heading), SPEED),
+            .angle = test_randf(&rng, 0, 2 * M_PI),
+            .spin = test_rand(&rng) % 2 ? 1 : -1,
+        };
+    }
+
+    cpBroadphaseRecording recording;
+    cpBroadphaseRecordingInit(&recording, calloc((size_t)rays * frames, sizeof(cpBB)), rays, frames);
+    recording.dt = SCENE_DT;
+
+    for (int frame = 0; frame < frames; frame++) {
+        for (int i = 0; i < rays; i++) {
+            recording.bbs[frame * rays + i] = ray_bb(&state[i]);
+            move_ray(&state[i]);
+        }
+    }
+    recording.frames = frames;
+
+    printf("%d rays, %d frames, microseconds per frame\n", rays, frames);
+    printf("  index   insert  reindex    query    pairs  pairs/frame\n");
+
+    for (int type = 0; type < CP_BROADPHASE_TYPE_COUNT; type++) {
+        cpBroadphaseCost cost = {0};
+        cpBroadphaseReplay(&recording, type, now_ns, &cost);
+
+        printf("  %-6s %7.2f  %7.2f  %7.2f  %7.2f  %11lu\n", names[type], cost.insertTime / 1e3 / frames,
+            cost.reindexTime / 1e3 / frames, cost.queryTime / 1e3 / frames, cost.pairTime / 1e3 / frames,
+            cost.pairs / frames);
+    }
+
+    printf("the hash reports a pair once for every cell both objects are in, the tree also pairs its fattened boxes\n");
+
+    free(recording.bbs);
+    free(state);
+    return 0;
+}
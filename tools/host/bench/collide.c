@@ -0,0 +1,155 @@
+// cpCollide() on pairs that take the GJK/EPA path: polygons against circles, segments and other polygons.
+//
+//   collide_double [-f frames]
+//   collide_float [-f frames]
+//
+// Each pair has a polygon moving about and turning a little every frame, so the pairs drift in and out of contact the
+// way bodies do. The collision id of the last frame is passed back in, as the arbiters do, which lets GJK start from
+// last frame's closest edge. Separated pairs usually need just one support point then. Every pair is also timed
+// without the id, starting from scratch each frame. Times are per pair, with the cost of reading the clock taken out.
+
+#include <math.h>
+#include <unistd.h>
+
+#include "chipmunk/chipmunk_private.h"
+
+#include "harness.h"
+
+#define PAIRS 256
+
+typedef struct {
+    double ns;
+    long count;
+} Total;
+
+typedef struct {
+    Total separated, touching;
+} Totals;
+
+static cpBody *bodies1[PAIRS], *bodies2[PAIRS];
+static cpShape *shapes1[PAIRS], *shapes2[PAIRS];
+static cpVect velocities[PAIRS];
+
+static void make_pairs(void) {
+    uint32_t rng = 3;
+
+    for (int i = 0; i < PAIRS; i++) {
+        bodies1[i] = cpBodyNew(1, 1);
+        bodies2[i] = cpBodyNew(1, 1);
+
+        // Irregular polygons of three to eight sides, some rounded.
+        cpVect verts[8];
+        int count = 3 + i % 6;
+        cpFloat size = test_randf(&rng, 5, 30);
+        for (int k = 0; k < count; k++) {
+            cpFloat angle = 2 * CP_PI * k / count + test_randf(&rng, 0, 0.3);
+            verts[k] = cpv(size * cos(angle), size * sin(angle) * test_randf(&rng, 0.5, 1));
+        }
+        shapes1[i] = cpPolyShapeNew(bodies1[i], count, verts, cpTransformIdentity, i % 7 == 0 ? 1 : 0);
+
+        if (i % 4 == 0) {
+            shapes2[i] = cpCircleShapeNew(bodies2[i], test_randf(&rng, 3, 20), cpvzero);
+        } else if (i % 4 == 1) {
+            shapes2[i] = cpSegmentShapeNew(bodies2[i], cpv(-20, 0), cpv(20, 0), test_randf(&rng, 0, 3));
+        } else {
+            count = 3 + (i / 4) % 5;
+            for (int k = 0; k < count; k++) {
+                verts[k] = cpvmult(cpvforangle(2 * CP_PI * k / count), size);
+            }
+            shapes2[i] = cpPolyShapeNew(bodies2[i], count, verts, cpTransformIdentity, 0);
+        }
+
+        cpBodySetPosition(bodies2[i], cpv(test_randf(&rng, -40, 40), test_randf(&rng, -40, 40)));
+        cpBodySetAngle(bodies2[i], test_randf(&rng, 0, 6));
+        velocities[i] = cpv(test_randf(&rng, -1, 1), test_randf(&rng, -1, 1));
+    }
+}
+
+static void place(int i, int frame) {
+    // The polygon bounces back and forth through the middle of the other shape.
+    cpFloat t = fmod(frame * cpvlength(velocities[i]), 160) - 80;
+    cpBodySetPosition(bodies1[i], cpvmult(cpvnormalize(velocities[i]), fabs(t) - 40));
+    cpBodySetAngle(bodies1[i], 0.02 * frame * (i % 3 - 1));
+
+    cpShapeCacheBB(shapes1[i]);
+    cpShapeCacheBB(shapes2[i]);
+}
+
+// Nanoseconds it takes to read the clock twice, the least of many tries.
+static double clock_overhead(void) {
+    double least = INFINITY;
+    for (int i = 0; i < 10000; i++) {
+        uint64_t start = now_ns();
+        least = fmin(least, (double)(now_ns() - start));
+    }
+
+    return least;
+}
+
+static void run(int frames, bool cached, double overhead, Totals *totals) {
+    struct cpContact contacts[CP_MAX_CONTACTS_PER_ARBITER];
+    cpCollisionID ids[PAIRS] = {0};
+
+    *totals = (Totals){0};
+
+    for (int frame = 0; frame < frames; frame++) {
+        for (int i = 0; i < PAIRS; i++) {
+            place(i, frame);
+
+            uint64_t start = now_ns();
+            struct cpCollisionInfo info = cpCollide(shapes1[i], shapes2[i], cached ? ids[i] : 0, contacts);
+            double ns = (double)(now_ns() - start) - overhead;
+
+            Total *total = info.count ? &totals->touching : &totals->separated;
+            total->ns += ns;
+            total->count++;
+            ids[i] = info.id;
+        }
+    }
+}
+
+static double mean(Total total) { return total.count ? total.ns / total.count : 0; }
+
+int main(int argc, char **argv) {
+    int frames = 2000;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "f:")) != -1) {
+        switch (opt) {
+            case 'f':
+                frames = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-f frames]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    make_pairs();
+    double overhead = clock_overhead();
+
+    Totals cached, fresh;
+    run(frames, true, overhead, &cached);
+    run(frames, false, overhead, &fresh);
+
+    CHECK(cached.touching.count == fresh.touching.count, "%ld pairs touched with the cached ids, %ld without",
+        cached.touching.count, fresh.touching.count);
+
+    long pairs = cached.separated.count + cached.touching.count;
+    printf("%s build, %d pairs for %d frames, %.1f%% touching, ns per pair:\n", CP_USE_DOUBLES ? "double" : "float",
+        PAIRS, frames, 100.0 * cached.touching.count / pairs);
+    printf("                separated  touching  all\n");
+    printf("  cached ids    %9.1f  %8.1f  %5.1f\n", mean(cached.separated), mean(cached.touching),
+        (cached.separated.ns + cached.touching.ns) / pairs);
+    printf("  no ids        %9.1f  %8.1f  %5.1f\n", mean(fresh.separated), mean(fresh.touching),
+        (fresh.separated.ns + fresh.touching.ns) / pairs);
+
+    for (int i = 0; i < PAIRS; i++) {
+        cpShapeFree(shapes1[i]);
+        cpShapeFree(shapes2[i]);
+        cpBodyFree(bodies1[i]);
+        cpBodyFree(bodies2[i]);
+    }
+
+    return 0;
+}
@@ -0,0 +1,125 @@
+// Accuracy and speed of the integer kernels in cpFixed.c, which CP_USE_FIXED_KERNELS=1 puts behind cpfsqrt(),
+// cpfsin(), cpfcos() and cpfatan2(), against the C library in double precision.
+//
+//   fixed [-n samples]
+//
+// test/drift.c reports how far the scenes drift with the kernels in place.
+
+#include <math.h>
+#include <unistd.h>
+
+#include <chipmunk/chipmunk.h>
+#include <chipmunk/cpFixed.h>
+
+#include "harness.h"
+
+#define INPUTS 4096
+
+typedef struct {
+    const char *name;
+    const char *range;
+    cpFloat (*kernel)(cpFloat a, cpFloat b);
+    double (*libm)(double a, double b);
+    // Relative error for sqrt, absolute error in radians or units for the others.
+    bool relative;
+    void (*make)(uint32_t *rng, cpFloat *a, cpFloat *b);
+} Function;
+
+static cpFloat kernel_sqrt(cpFloat a, cpFloat b) { return cpFixedKernelSqrt(a); }
+static cpFloat kernel_sin(cpFloat a, cpFloat b) { return cpFixedKernelSin(a); }
+static cpFloat kernel_cos(cpFloat a, cpFloat b) { return cpFixedKernelCos(a); }
+static cpFloat kernel_atan2(cpFloat a, cpFloat b) { return cpFixedKernelAtan2(a, b); }
+
+static double libm_sqrt(double a, double b) { return sqrt(a); }
+static double libm_sin(double a, double b) { return sin(a); }
+static double libm_cos(double a, double b) { return cos(a); }
+static double libm_atan2(double a, double b) { return atan2(a, b); }
+
+// Squared lengths and masses, spread over twelve orders of magnitude.
+static void make_length(uint32_t *rng, cpFloat *a, cpFloat *b) { *a = pow(10, test_randf(rng, -6, 6)); }
+// Body angles, which keep growing while a ray spins.
+static void make_angle(uint32_t *rng, cpFloat *a, cpFloat *b) { *a = test_randf(rng, -200, 200); }
+// Vectors across the playfield.
+static void make_vector(uint32_t *rng, cpFloat *a, cpFloat *b) {
+    *a = test_randf(rng, -700, 700);
+    *b = test_randf(rng, -700, 700);
+}
+
+static const Function functions[] = {
+    {"sqrt", "1e-6..1e6", kernel_sqrt, libm_sqrt, true, make_length},
+    {"sin", "-200..200", kernel_sin, libm_sin, false, make_angle},
+    {"cos", "-200..200", kernel_cos, libm_cos, false, make_angle},
+    {"atan2", "+-700", kernel_atan2, libm_atan2, false, make_vector},
+};
+
+static volatile double sink;
+
+// Nanoseconds per call, the best of five passes over the inputs.
+static double time_calls(const Function *function, bool kernel, const cpFloat *a, const cpFloat *b) {
+    double best = INFINITY;
+
+    for (int pass = 0; pass < 5; pass++) {
+        double sum = 0;
+        uint64_t start = now_ns();
+
+        for (int i = 0; i < INPUTS; i++) {
+            sum += kernel ? function->kernel(a[i], b[i]) : function->libm(a[i], b[i]);
+        }
+
+        best = fmin(best, (double)(now_ns() - start) / INPUTS);
+        sink = sum;
+    }
+
+    return best;
+}
+
+int main(int argc, char **argv) {
+    long samples = 1000000;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:")) != -1) {
+        switch (opt) {
+            case 'n':
+                samples = atol(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-n samples]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    printf("%s build, %ld samples per function\n", CP_USE_DOUBLES ? "double" : "float", samples);
+    printf("  function  inputs        max error  mean error   kernel ns  libm ns\n");
+
+    for (size_t f = 0; f < sizeof(functions) / sizeof(functions[0]); f++) {
+        const Function *function = &functions[f];
+        uint32_t rng = 0x2545f491;
+
+        double max_error = 0, sum_error = 0;
+        for (long i = 0; i < samples; i++) {
+            cpFloat a = 0, b = 0;
+            function->make(&rng, &a, &b);
+
+            double expected = function->libm(a, b);
+            double error = fabs(function->kernel(a, b) - expected);
+            if (function->relative) {
+                error /= expected;
+            }
+
+            max_error = fmax(max_error, error);
+            sum_error += error;
+        }
+
+        cpFloat a[INPUTS] = {0}, b[INPUTS] = {0};
+        for (int i = 0; i < INPUTS; i++) {
+            function->make(&rng, &a[i], &b[i]);
+        }
+
+        printf("  %-8s  %-12s  %9.2e  %9.2e  %9.1f  %7.1f\n", function->name, function->range, max_error,
+            sum_error / samples, time_calls(function, true, a, b), time_calls(function, false, a, b));
+    }
+
+    printf("sqrt errors are relative, the others absolute\n");
+
+    return 0;
+}
@@ -0,0 +1,141 @@
+// cpHashSet used the way the space caches arbiters, from a handful of pairs to tens of thousands.
+//
+//   hashset [-r rounds]
+//
+// Each step looks up 90% of the pairs by their two shapes, inserting any that are missing, then filters out the pairs
+// that haven't been looked up for a few steps, like cpSpaceStep() does with the arbiters. A pair drops out of the
+// lookups one step in ten, so nothing is filtered out and the set keeps its size. Then the set is searched for pairs
+// it doesn't hold. Lookups run in a shuffled order, not the order of the pairs in memory. Times are the least over
+// the rounds, per lookup and per pair in the set.
+
+#include <math.h>
+#include <unistd.h>
+
+#include "chipmunk/chipmunk_private.h"
+
+#include "harness.h"
+
+#define MAX_PAIRS 100000
+// Bytes between shapes, about what a cpPolyShape takes.
+#define SHAPE_STRIDE 128
+
+typedef struct {
+    const void *a, *b;
+    int step;
+} Pair;
+
+static char shapes[MAX_PAIRS * 2 * SHAPE_STRIDE];
+static Pair pairs[MAX_PAIRS];
+static int order[MAX_PAIRS];
+static int current_step;
+
+static cpBool pair_eql(const void **shapes, const Pair *pair) {
+    return (shapes[0] == pair->a && shapes[1] == pair->b) || (shapes[1] == pair->a && shapes[0] == pair->b);
+}
+
+static cpBool pair_is_fresh(Pair *pair, void *unused) { return current_step - pair->step < 3; }
+
+typedef struct {
+    double hit, filter, miss;
+} Times;
+
+static Times run(int count, int steps) {
+    // Shuffle the pairs that are in use.
+    uint32_t rng = 2;
+    for (int i = 0; i < count; i++) {
+        order[i] = i;
+    }
+    for (int i = count - 1; i > 0; i--) {
+        int j = test_rand(&rng) % (i + 1), k = order[i];
+        order[i] = order[j];
+        order[j] = k;
+    }
+
+    for (int i = 0; i < count; i++) {
+        pairs[i] = (Pair){shapes + (2 * i) * SHAPE_STRIDE, shapes + (2 * i + 1) * SHAPE_STRIDE, 0};
+    }
+
+    cpHashSet *set = cpHashSetNew(0, (cpHashSetEqlFunc)pair_eql);
+    Times best = {INFINITY, INFINITY, INFINITY};
+    long found = 0;
+
+    for (current_step = 1; current_step <= steps; current_step++) {
+        uint64_t start = now_ns();
+        int lookups = 0;
+        for (int k = 0; k < count; k++) {
+            int i = order[k];
+            if ((i * 7 + current_step) % 10 == 0) {
+                continue;
+            }
+
+            const void *shape_pair[] = {pairs[i].a, pairs[i].b};
+            cpHashValue hash = CP_HASH_PAIR(shape_pair[0], shape_pair[1]);
+            Pair *pair = (Pair *)cpHashSetInsert(set, hash, shape_pair, NULL, &pairs[i]);
+            pair->step = current_step;
+            lookups++;
+        }
+        uint64_t looked_up = now_ns();
+
+        cpHashSetFilter(set, (cpHashSetFilterFunc)pair_is_fresh, NULL);
+        uint64_t filtered = now_ns();
+
+        // The second shape of one pair with the first of the next.
+        for (int i = 0; i < count; i++) {
+            const void *shape_pair[] = {pairs[i].b, pairs[(i + 1) % count].a};
+            cpHashValue hash = CP_HASH_PAIR(shape_pair[0], shape_pair[1]);
+            found += cpHashSetFind(set, hash, shape_pair) != NULL;
+        }
+        uint64_t missed = now_ns();
+
+        // The first steps fill the set.
+        if (current_step > 3) {
+            best.hit = fmin(best.hit, (double)(looked_up - start) / lookups);
+            best.filter = fmin(best.filter, (double)(filtered - looked_up) / count);
+            best.miss = fmin(best.miss, (double)(missed - filtered) / count);
+        }
+    }
+
+    CHECK(cpHashSetCount(set) == count, "%d pairs in the set, %d expected", cpHashSetCount(set), count);
+    CHECK(found == 0, "found %ld pairs that were never inserted", found);
+
+    cpHashSetFree(set);
+    return best;
+}
+
+int main(int argc, char **argv) {
+    int rounds = 10;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "r:")) != -1) {
+        switch (opt) {
+            case 'r':
+                rounds = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-r rounds]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    static const int counts[] = {16, 50, 100, 300, 1000, 3000, 10000, 30000, 100000};
+
+    printf("arbiter cache pattern, least ns over %d rounds\n", rounds);
+    printf("    pairs  lookup  filter    miss  per step and pair\n");
+
+    for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+        int count = counts[c];
+        Times best = {INFINITY, INFINITY, INFINITY};
+
+        for (int round = 0; round < rounds; round++) {
+            Times times = run(count, 200000 / count + 20);
+            best.hit = fmin(best.hit, times.hit);
+            best.filter = fmin(best.filter, times.filter);
+            best.miss = fmin(best.miss, times.miss);
+        }
+
+        printf("  %7d  %6.1f  %6.1f  %6.1f  %17.1f\n", count, best.hit, best.filter, best.miss,
+            0.9 * best.hit + best.filter);
+    }
+
+    return 0;
+}
@@ -0,0 +1,210 @@
+// Body integration through the per-body function pointers against structure of arrays loops.
+//
+//   integrate [-r rounds]
+//
+// A space's dynamic bodies are integrated the way a step does it, positions then velocities, in three ways:
+//   calls:    body->position_func and body->velocity_func, which is what cpSpaceStep() does.
+//   batched:  gather the state of every body into arrays, integrate them in tight loops and scatter it back, since
+//             the solver, the collision code and the accessors read the cpBody.
+//   resident: the same loops over arrays that already hold the state, with no gather or scatter. This is the most a
+//             store that kept the bodies in arrays for good could save, if nothing else read the cpBody.
+// The batched bodies have to end up bit-identical to the called ones. Times are the least over the rounds, in ns per
+// body for one position and one velocity pass.
+
+#include <math.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "chipmunk/chipmunk_private.h"
+
+#include "harness.h"
+#include "scenes.h"
+
+#define PASSES 20
+
+typedef struct {
+    cpFloat *p_x, *p_y, *a, *v_x, *v_y, *w, *f_x, *f_y, *t, *m_inv, *i_inv, *rot_x, *rot_y;
+} Arrays;
+
+static const cpVect gravity = {0, -100};
+static const cpFloat damping = 0.9, dt = 1 / 60.0;
+
+static cpSpace *make_space(int count) {
+    uint32_t rng = 11;
+    cpSpace *space = cpSpaceNew();
+
+    for (int i = 0; i < count; i++) {
+        cpBody *body = cpSpaceAddBody(space, cpBodyNew(test_randf(&rng, 1, 5), test_randf(&rng, 10, 50)));
+        cpBodySetPosition(body, cpv(test_randf(&rng, 0, 640), test_randf(&rng, 0, 480)));
+        cpBodySetAngle(body, test_randf(&rng, 0, 6));
+        cpBodySetVelocity(body, cpv(test_randf(&rng, -50, 50), test_randf(&rng, -50, 50)));
+        cpBodySetAngularVelocity(body, test_randf(&rng, -2, 2));
+    }
+
+    return space;
+}
+
+static void alloc_arrays(Arrays *arrays, int count) {
+    cpFloat **fields = (cpFloat **)arrays;
+    for (size_t i = 0; i < sizeof(Arrays) / sizeof(cpFloat *); i++) {
+        fields[i] = calloc(count, sizeof(cpFloat));
+    }
+}
+
+static void free_arrays(Arrays *arrays) {
+    cpFloat **fields = (cpFloat **)arrays;
+    for (size_t i = 0; i < sizeof(Arrays) / sizeof(cpFloat *); i++) {
+        free(fields[i]);
+    }
+}
+
+static void integrate_calls(cpArray *bodies) {
+    for (int i = 0; i < bodies->num; i++) {
+        cpBody *body = bodies->arr[i];
+        body->position_func(body, dt);
+    }
+    for (int i = 0; i < bodies->num; i++) {
+        cpBody *body = bodies->arr[i];
+        body->velocity_func(body, gravity, damping, dt);
+    }
+}
+
+// The loops of cpBodyUpdatePosition() and cpBodyUpdateVelocity(), in the same order of operations.
+static void integrate_positions(Arrays *s, int count) {
+    for (int i = 0; i < count; i++) {
+        s->p_x[i] = s->p_x[i] + s->v_x[i] * dt;
+        s->p_y[i] = s->p_y[i] + s->v_y[i] * dt;
+        s->a[i] = s->a[i] + s->w[i] * dt;
+    }
+    for (int i = 0; i < count; i++) {
+        s->rot_x[i] = cpfcos(s->a[i]);
+        s->rot_y[i] = cpfsin(s->a[i]);
+    }
+}
+
+static void integrate_velocities(Arrays *s, int count) {
+    for (int i = 0; i < count; i++) {
+        s->v_x[i] = s->v_x[i] * damping + (gravity.x + s->f_x[i] * s->m_inv[i]) * dt;
+        s->v_y[i] = s->v_y[i] * damping + (gravity.y + s->f_y[i] * s->m_inv[i]) * dt;
+        s->w[i] = s->w[i] * damping + s->t[i] * s->i_inv[i] * dt;
+        s->f_x[i] = s->f_y[i] = s->t[i] = 0;
+    }
+}
+
+static void integrate_batched(cpArray *bodies, Arrays *s) {
+    int count = bodies->num;
+    cpBody **arr = (cpBody **)bodies->arr;
+
+    for (int i = 0; i < count; i++) {
+        cpBody *body = arr[i];
+        s->p_x[i] = body->p.x;
+        s->p_y[i] = body->p.y;
+        s->a[i] = body->a;
+        s->v_x[i] = body->v.x + body->v_bias.x;
+        s->v_y[i] = body->v.y + body->v_bias.y;
+        s->w[i] = body->w + body->w_bias;
+    }
+    integrate_positions(s, count);
+    for (int i = 0; i < count; i++) {
+        cpBody *body = arr[i];
+        cpVect p = body->p = cpv(s->p_x[i], s->p_y[i]), c = body->cog;
+        cpFloat rx = s->rot_x[i], ry = s->rot_y[i];
+        body->a = s->a[i];
+        body->transform = cpTransformNewTranspose(rx, -ry, p.x - (c.x * rx - c.y * ry), ry, rx,
+            p.y - (c.x * ry + c.y * rx));
+        body->v_bias = cpvzero;
+        body->w_bias = 0;
+    }
+
+    for (int i = 0; i < count; i++) {
+        cpBody *body = arr[i];
+        s->v_x[i] = body->v.x;
+        s->v_y[i] = body->v.y;
+        s->w[i] = body->w;
+        s->f_x[i] = body->f.x;
+        s->f_y[i] = body->f.y;
+        s->t[i] = body->t;
+        s->m_inv[i] = body->m_inv;
+        s->i_inv[i] = body->i_inv;
+    }
+    integrate_velocities(s, count);
+    for (int i = 0; i < count; i++) {
+        cpBody *body = arr[i];
+        body->v = cpv(s->v_x[i], s->v_y[i]);
+        body->w = s->w[i];
+        body->f = cpvzero;
+        body->t = 0;
+    }
+}
+
+static void integrate_resident(Arrays *s, int count) {
+    integrate_positions(s, count);
+    integrate_velocities(s, count);
+}
+
+static double time_pass(int mode, cpArray *bodies, Arrays *arrays) {
+    uint64_t start = now_ns();
+    for (int pass = 0; pass < PASSES; pass++) {
+        if (mode == 0) {
+            integrate_calls(bodies);
+        } else if (mode == 1) {
+            integrate_batched(bodies, arrays);
+        } else {
+            integrate_resident(arrays, bodies->num);
+        }
+    }
+    return (double)(now_ns() - start) / PASSES / bodies->num;
+}
+
+int main(int argc, char **argv) {
+    int rounds = 20;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "r:")) != -1) {
+        switch (opt) {
+            case 'r':
+                rounds = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-r rounds]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    static const int counts[] = {100, 1000, 10000};
+
+    printf("ns per body for a position and a velocity pass, least over %d rounds\n", rounds);
+    printf("  bodies   calls  batched  resident\n");
+
+    for (int c = 0; c < 3; c++) {
+        int count = counts[c];
+        cpSpace *called = make_space(count), *batched = make_space(count);
+        cpArray *called_bodies = called->dynamicBodies, *batched_bodies = batched->dynamicBodies;
+
+        Arrays arrays;
+        alloc_arrays(&arrays, count);
+
+        double best[3] = {INFINITY, INFINITY, INFINITY};
+        for (int round = 0; round < rounds; round++) {
+            best[0] = fmin(best[0], time_pass(0, called_bodies, NULL));
+            best[1] = fmin(best[1], time_pass(1, batched_bodies, &arrays));
+            best[2] = fmin(best[2], time_pass(2, batched_bodies, &arrays));
+        }
+
+        // The resident passes only ran on the arrays, so the bodies have had the same passes either way.
+        for (int i = 0; i < count; i++) {
+            cpBody *a = called_bodies->arr[i], *b = batched_bodies->arr[i];
+            CHECK(a->p.x == b->p.x && a->p.y == b->p.y && a->a == b->a && a->v.x == b->v.x && a->v.y == b->v.y &&
+                a->w == b->w && memcmp(&a->transform, &b->transform, sizeof(cpTransform)) == 0,
+                "%d bodies: body %d differs after the batched passes", count, i);
+        }
+
+        printf("  %6d  %6.1f  %7.1f  %8.1f\n", count, best[0], best[1], best[2]);
+
+        free_arrays(&arrays);
+        scene_free_space(called);
+        scene_free_space(batched);
+    }
+
+    return 0;
+}
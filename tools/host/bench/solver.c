@@ -0,0 +1,96 @@
+// Time in the contact solver, with the arbiters in the space's order or packed by CP_USE_PACKED_SOLVER.
+//
+//   solver [-s steps]
+//
+// Built twice, as solver_unpacked and solver_packed, with the step profiler on. Each scene is stepped until its bodies
+// are all in and resting on each other, and then for the given number of steps, which are timed. Prestep and solver
+// are the step profiler's phases, which is where the packed solver packs, solves and unpacks the arbiters. The step is
+// the whole cpSpaceStep(). Times are in us per step, and compare between the two programs.
+
+#include <unistd.h>
+
+#include "harness.h"
+#include "scenes.h"
+
+#define PROFILES 1
+
+typedef struct {
+    uint64_t prestep, solver, step;
+} Times;
+
+static void add_profile(Times *times, cpSpace *space, uint64_t start) {
+    times->step += now_ns() - start;
+
+    const cpStepProfile *profile = cpSpaceGetStepProfile(space, 0);
+    times->prestep += profile->phases[CP_STEP_PHASE_PRESTEP];
+    times->solver += profile->phases[CP_STEP_PHASE_SOLVER];
+}
+
+static void print_times(const char *name, Times *times, int steps) {
+    printf("  %-10s  %7.1f  %7.1f  %7.1f\n", name, times->prestep / 1e3 / steps, times->solver / 1e3 / steps,
+        times->step / 1e3 / steps);
+}
+
+int main(int argc, char **argv) {
+    int steps = 300;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "s:")) != -1) {
+        switch (opt) {
+            case 's':
+                steps = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-s steps]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    cpStepProfile profiles[PROFILES];
+
+    printf("%s solver, us per step over %d steps\n", CP_USE_PACKED_SOLVER ? "packed" : "unpacked", steps);
+    printf("  scene       prestep   solver     step\n");
+
+    static const int pile_counts[] = {100, 300};
+    for (int c = 0; c < 2; c++) {
+        Pile pile;
+        pile_init(&pile, pile_counts[c]);
+        cpSpaceSetStepProfiler(pile.space, now_ns, profiles, PROFILES);
+
+        // A box is dropped every six steps, and the last one gets two seconds to land.
+        while (pile.step < pile.count * 6 + 60) {
+            pile_step(&pile);
+        }
+
+        Times times = {0};
+        for (int i = 0; i < steps; i++) {
+            uint64_t start = now_ns();
+            pile_step(&pile);
+            add_profile(&times, pile.space, start);
+        }
+
+        char name[16];
+        snprintf(name, sizeof(name), "pile %d", pile.count);
+        print_times(name, &times, steps);
+        pile_destroy(&pile);
+    }
+
+    Islands islands;
+    islands_init(&islands, 16);
+    cpSpaceSetStepProfiler(islands.space, now_ns, profiles, PROFILES);
+    for (int i = 0; i < 100; i++) {
+        islands_step(&islands);
+    }
+
+    Times times = {0};
+    for (int i = 0; i < steps; i++) {
+        uint64_t start = now_ns();
+        islands_step(&islands);
+        add_profile(&times, islands.space, start);
+    }
+
+    print_times("islands 16", &times, steps);
+    islands_destroy(&islands);
+
+    return 0;
+}
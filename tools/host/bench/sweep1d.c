@@ -0,0 +1,131 @@
+// cpSweep1D on coherent and incoherent motion, sweeping along x and along the axis it picks.
+//
+//   sweep1d [-n boxes] [-f frames]
+//
+// The boxes are rays, 50x20. In the coherent scenes they stream along rows, horizontally or vertically, a few pixels
+// a frame and wrap around at the edges of the screen. In the incoherent one every box jumps somewhere new each frame,
+// so the sort order is lost and the sweep falls back to qsort(). The pair callback does a bounding box check, like
+// cpSpaceCollideShapes() would, and the time includes it. test/sweep1d.c checks the pairs.
+
+#include <math.h>
+#include <unistd.h>
+
+#include <chipmunk/chipmunk.h>
+
+#include "harness.h"
+
+typedef enum {
+    HORIZONTAL,
+    VERTICAL,
+    INCOHERENT,
+} Motion;
+
+static const char *motion_names[] = {"coherent horizontal", "coherent vertical", "incoherent"};
+
+typedef struct {
+    cpBB bb;
+    cpVect v;
+} Object;
+
+static cpBB object_bb(Object *object) { return object->bb; }
+
+static cpCollisionID count_pair(Object *a, Object *b, cpCollisionID id, unsigned long *pairs) {
+    *pairs += cpBBIntersects(a->bb, b->bb);
+    return id;
+}
+
+static cpBB random_bb(uint32_t *rng) {
+    cpFloat x = test_randf(rng, -50, 700), y = test_randf(rng, -50, 700);
+    return cpBBNew(x, y, x + 50, y + 20);
+}
+
+// Wrap a coordinate that left -50..700 around to the other side.
+static cpFloat wrap(cpFloat min, cpFloat max) {
+    return min > 700 ? -800 : (max < -50 ? 800 : 0);
+}
+
+// Microseconds per frame.
+static double run(Motion motion, bool auto_axis, int count, int frames, unsigned long *pairs) {
+    uint32_t rng = 3;
+    Object *objects = calloc(count, sizeof(Object));
+
+    cpSpatialIndex *sweep = cpSweep1DNew((cpSpatialIndexBBFunc)object_bb, NULL);
+    cpSweep1DSetAutoAxis(sweep, auto_axis);
+
+    for (int i = 0; i < count; i++) {
+        Object *object = &objects[i];
+        object->bb = random_bb(&rng);
+
+        // Six rows 40 pixels apart, alternating direction.
+        cpFloat row = test_randf(&rng, 100, 140) + 40 * (i % 6);
+        cpFloat along = test_randf(&rng, 2, 5) * (i % 2 ? 1 : -1), across = test_randf(&rng, -0.3, 0.3);
+        if (motion == HORIZONTAL) {
+            object->bb = cpBBNew(object->bb.l, row, object->bb.r, row + 20);
+            object->v = cpv(along, across);
+        } else if (motion == VERTICAL) {
+            object->bb = cpBBNew(row, object->bb.b, row + 50, object->bb.t);
+            object->v = cpv(across, along);
+        }
+
+        cpSpatialIndexInsert(sweep, object, i);
+    }
+
+    *pairs = 0;
+    uint64_t start = now_ns();
+
+    for (int frame = 0; frame < frames; frame++) {
+        for (int i = 0; i < count; i++) {
+            Object *object = &objects[i];
+
+            if (motion == INCOHERENT) {
+                object->bb = random_bb(&rng);
+            } else {
+                cpBB bb = cpBBOffset(object->bb, object->v);
+                object->bb = cpBBOffset(bb, cpv(wrap(bb.l, bb.r), wrap(bb.b, bb.t)));
+            }
+        }
+
+        cpSpatialIndexReindexQuery(sweep, (cpSpatialIndexQueryFunc)count_pair, pairs);
+    }
+
+    double us = (now_ns() - start) / 1e3 / frames;
+    *pairs /= frames;
+
+    cpSpatialIndexFree(sweep);
+    free(objects);
+    return us;
+}
+
+int main(int argc, char **argv) {
+    int count = 500, frames = 2000;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:f:")) != -1) {
+        switch (opt) {
+            case 'n':
+                count = atoi(optarg);
+                break;
+            case 'f':
+                frames = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-n boxes] [-f frames]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    printf("%d boxes, %d frames, microseconds per frame\n", count, frames);
+    printf("  motion                 x axis  auto axis  pairs/frame\n");
+
+    for (Motion motion = HORIZONTAL; motion <= INCOHERENT; motion++) {
+        unsigned long pairs, auto_pairs;
+        double x_axis = run(motion, false, count, frames, &pairs);
+        double auto_axis = run(motion, true, count, frames, &auto_pairs);
+
+        CHECK(pairs == auto_pairs, "%s: %lu pairs along x, %lu along the chosen axis", motion_names[motion], pairs,
+            auto_pairs);
+        printf("  %-20s  %7.1f  %9.1f  %11lu\n", motion_names[motion], x_axis, auto_axis, pairs);
+    }
+
+    return 0;
+}
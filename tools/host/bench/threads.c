@@ -0,0 +1,86 @@
+// How the threaded island solver scales, from one thread to as many as the machine has cores.
+//
+//   threads [-j threads] [-p piles] [-s steps]
+//
+// Built with CP_USE_THREADS=1. Steps the islands scene from scenes.h. Every thread count has to end with the bodies in
+// exactly the same state as one thread does, and test/threads.c checks that against the build without threads.
+// Speedups over one thread are only meaningful with that many free cores.
+
+#include <unistd.h>
+
+#include "harness.h"
+#include "scenes.h"
+
+// FNV-1a over the exact bits of every body's position, velocity and angle.
+static void hash_body(cpBody *body, void *data) {
+    uint64_t *hash = data;
+    cpVect p = cpBodyGetPosition(body), v = cpBodyGetVelocity(body);
+    cpFloat state[] = {p.x, p.y, v.x, v.y, cpBodyGetAngle(body)};
+
+    const unsigned char *bytes = (const unsigned char *)state;
+    for (size_t i = 0; i < sizeof(state); i++) {
+        *hash = (*hash ^ bytes[i]) * 0x100000001b3;
+    }
+}
+
+int main(int argc, char **argv) {
+    int max_threads = 0;
+    int piles = 64, steps = 600;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "j:p:s:")) != -1) {
+        switch (opt) {
+            case 'j':
+                max_threads = atoi(optarg);
+                break;
+            case 'p':
+                piles = atoi(optarg);
+                break;
+            case 's':
+                steps = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-j threads] [-p piles] [-s steps]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    // Up to one thread per core, but always a few thread counts, even on a machine with fewer cores.
+    if (max_threads <= 0) {
+        max_threads = sysconf(_SC_NPROCESSORS_ONLN);
+        max_threads = max_threads < 4 ? 4 : max_threads;
+    }
+
+    printf("%d piles, %d steps, %ld cores online\n", piles, steps, sysconf(_SC_NPROCESSORS_ONLN));
+    printf("  threads  ms/step  speedup\n");
+
+    double one_thread = 0;
+    uint64_t expected = 0;
+
+    for (int threads = 1; threads <= max_threads; threads++) {
+        Islands islands;
+        islands_init(&islands, piles);
+        cpSpaceSetThreads(islands.space, threads);
+
+        uint64_t start = now_ns();
+        for (int i = 0; i < steps; i++) {
+            islands_step(&islands);
+        }
+        double ms = (now_ns() - start) / 1e6 / steps;
+
+        uint64_t hash = 0xcbf29ce484222325;
+        cpSpaceEachBody(islands.space, hash_body, &hash);
+
+        if (threads == 1) {
+            one_thread = ms;
+            expected = hash;
+        }
+
+        CHECK(hash == expected, "%d threads ended in a different state than one thread", threads);
+        printf("  %7d  %7.3f  %6.2fx\n", threads, ms, one_thread / ms);
+
+        islands_destroy(&islands);
+    }
+
+    return 0;
+}
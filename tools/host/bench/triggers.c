@@ -0,0 +1,159 @@
+// Trigger shapes against the arbiter path they replace, with hundreds of rays crossing items.
+//
+//   triggers [-s steps]
+//
+// Ray sized kinematic boxes fly through a field of item sized kinematic boxes in a grid, like the game's rays through
+// the item, and wrap around at the edges. Each case runs twice: once with begin and separate callbacks on ordinary
+// shapes, which go through the narrow phase and the arbiters, and once with the rays as triggers and enter and exit
+// callbacks. Every few steps a ray is taken out of the space and put back while it may be touching an item. Both
+// runs have to report the same touches on the same steps. Times are the least and the average over the steps.
+
+#include <math.h>
+#include <unistd.h>
+
+#include <chipmunk/chipmunk.h>
+
+#include "harness.h"
+#include "scenes.h"
+
+#define FIELD 1000
+#define RAY 1
+#define ITEM 2
+
+typedef struct {
+    long enters, exits;
+    uint64_t hash;
+    double least_ms, average_ms;
+} Result;
+
+static int step;
+
+static void count_event(Result *result, cpShape *item, cpShape *ray, int enter) {
+    uintptr_t pair = (uintptr_t)cpShapeGetUserData(item) * 7919 + (uintptr_t)cpShapeGetUserData(ray);
+    *(enter ? &result->enters : &result->exits) += 1;
+    // A sum, since the two paths report the touches of a step in different orders.
+    uint64_t event = ((uint64_t)pair * 31 + step * 2 + enter) * 0x9e3779b97f4a7c15;
+    result->hash += event ^ (event >> 29);
+}
+
+static cpBool begin(cpArbiter *arb, cpSpace *space, Result *result) {
+    CP_ARBITER_GET_SHAPES(arb, item, ray);
+    count_event(result, item, ray, 1);
+    return cpTrue;
+}
+
+static void separate(cpArbiter *arb, cpSpace *space, Result *result) {
+    CP_ARBITER_GET_SHAPES(arb, item, ray);
+    count_event(result, item, ray, 0);
+}
+
+static void enter(cpShape *item, cpShape *ray, cpSpace *space, Result *result) { count_event(result, item, ray, 1); }
+
+static void leave(cpShape *item, cpShape *ray, cpSpace *space, Result *result) { count_event(result, item, ray, 0); }
+
+static Result run(bool triggers, int ray_count, int item_count, int steps) {
+    uint32_t rng = 99;
+    Result result = {.least_ms = INFINITY};
+
+    cpSpace *space = cpSpaceNew();
+    cpSpaceUseGrid(space, cpBBNew(-50, -50, FIELD + 50, FIELD + 50), 50);
+
+    for (int i = 0; i < item_count; i++) {
+        cpBody *body = cpSpaceAddBody(space, cpBodyNewKinematic());
+        cpBodySetPosition(body, cpv(test_randf(&rng, 0, FIELD), test_randf(&rng, 0, FIELD)));
+        cpBodySetVelocity(body, cpv(test_randf(&rng, -20, 20), test_randf(&rng, -20, 20)));
+
+        cpShape *shape = cpSpaceAddShape(space, cpBoxShapeNew(body, 80, 60, 0));
+        cpShapeSetCollisionType(shape, ITEM);
+        cpShapeSetUserData(shape, (void *)(uintptr_t)(i + 1));
+    }
+
+    cpBody **rays = malloc(ray_count * sizeof(cpBody *));
+    cpShape **ray_shapes = malloc(ray_count * sizeof(cpShape *));
+    for (int i = 0; i < ray_count; i++) {
+        cpBody *body = rays[i] = cpSpaceAddBody(space, cpBodyNewKinematic());
+        cpBodySetPosition(body, cpv(test_randf(&rng, 0, FIELD), test_randf(&rng, 0, FIELD)));
+        cpBodySetAngle(body, test_randf(&rng, 0, 6));
+        cpBodySetVelocity(body, cpv(test_randf(&rng, -80, 80), test_randf(&rng, -80, 80)));
+        cpBodySetAngularVelocity(body, test_randf(&rng, -1, 1));
+
+        cpShape *shape = ray_shapes[i] = cpSpaceAddShape(space, cpBoxShapeNew(body, 50, 20, 0));
+        cpShapeSetCollisionType(shape, RAY);
+        cpShapeSetUserData(shape, (void *)(uintptr_t)(i + 1));
+        cpShapeSetTrigger(shape, triggers);
+    }
+
+    cpCollisionHandler *handler = cpSpaceAddCollisionHandler(space, ITEM, RAY);
+    handler->userData = &result;
+    if (triggers) {
+        handler->triggerEnterFunc = (cpTriggerFunc)enter;
+        handler->triggerExitFunc = (cpTriggerFunc)leave;
+    } else {
+        handler->beginFunc = (cpCollisionBeginFunc)begin;
+        handler->separateFunc = (cpCollisionSeparateFunc)separate;
+    }
+
+    double total_ms = 0;
+    for (step = 0; step < steps; step++) {
+        for (int i = 0; i < ray_count; i++) {
+            cpVect p = cpBodyGetPosition(rays[i]);
+            if (p.x < 0 || p.x > FIELD || p.y < 0 || p.y > FIELD) {
+                cpBodySetPosition(rays[i], cpv(fmod(p.x + FIELD, FIELD), fmod(p.y + FIELD, FIELD)));
+            }
+        }
+
+        if (step % 50 == 25) {
+            cpShape *shape = ray_shapes[step % ray_count];
+            cpSpaceRemoveShape(space, shape);
+            cpSpaceAddShape(space, shape);
+        }
+
+        uint64_t start = now_ns();
+        cpSpaceStep(space, 1 / 60.0);
+        double ms = (now_ns() - start) / 1e6;
+
+        result.least_ms = fmin(result.least_ms, ms);
+        total_ms += ms;
+    }
+    result.average_ms = total_ms / steps;
+
+    scene_free_space(space);
+    free(rays);
+    free(ray_shapes);
+    return result;
+}
+
+int main(int argc, char **argv) {
+    int steps = 600;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "s:")) != -1) {
+        switch (opt) {
+            case 's':
+                steps = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-s steps]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    static const int cases[][2] = {{100, 50}, {400, 200}, {800, 300}};
+
+    printf("%d steps, ms per step, least / average\n", steps);
+    printf("  rays  items  touches  arbiters       triggers\n");
+
+    for (int c = 0; c < 3; c++) {
+        int ray_count = cases[c][0], item_count = cases[c][1];
+        Result arbiters = run(false, ray_count, item_count, steps);
+        Result triggers = run(true, ray_count, item_count, steps);
+
+        CHECK(arbiters.enters == triggers.enters && arbiters.exits == triggers.exits && arbiters.hash == triggers.hash,
+            "%d rays: %ld enters, %ld exits with arbiters, %ld and %ld with triggers, or on other steps", ray_count,
+            arbiters.enters, arbiters.exits, triggers.enters, triggers.exits);
+        printf("  %4d  %5d  %7ld  %.3f / %.3f  %.3f / %.3f\n", ray_count, item_count, triggers.enters,
+            arbiters.least_ms, arbiters.average_ms, triggers.least_ms, triggers.average_ms);
+    }
+
+    return 0;
+}
@@ -0,0 +1,44 @@
+#ifndef HARNESS_H
+#define HARNESS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Helpers shared by the tests in test/ and the benchmarks in bench/.
+
+// Monotonic clock in nanoseconds.
+static inline uint64_t now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+// Fail the program with a printf style message unless @c condition holds.
+#define CHECK(condition, ...) do { \
+    if (!(condition)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n    ", __FILE__, __LINE__, #condition); \
+        fprintf(stderr, __VA_ARGS__); \
+        fputc('\n', stderr); \
+        exit(1); \
+    } \
+} while (0)
+
+// xorshift32, so every run makes the same cases whatever the C library.
+static inline uint32_t test_rand(uint32_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+
+    return *state;
+}
+
+// Uniform in [min, max).
+static inline double test_randf(uint32_t *state, double min, double max) {
+    return min + (max - min) * (test_rand(state) >> 8) * (1.0 / 16777216.0);
+}
+
+#endif
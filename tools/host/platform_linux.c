@@ -0,0 +1,41 @@
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "platform_linux.h"
+
+// platform.h for running the simulation on a PC. There's no sound, and the log is off unless asked for, so the
+// simulation runs as fast as it can.
+
+bool platform_log_enabled = false;
+
+uint64_t platform_ticks(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * PLATFORM_TICKS_PER_SECOND
+        + (uint64_t)now.tv_nsec * (PLATFORM_TICKS_PER_SECOND / 1000) / 1000000;
+}
+
+// libdragon's fm_sinf_approx() trades accuracy for speed. This doesn't, so the physics can drift from a session
+// recorded on the console, but runs on a PC always agree with each other.
+float platform_sinf(float x) {
+    return sinf(x);
+}
+
+void platform_log(const char *format, ...) {
+    if (!platform_log_enabled) {
+        return;
+    }
+
+    va_list args;
+
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+}
+
+void platform_play_laugh(Laugh laugh, float pitch) {}
+
+void platform_stop_music(void) {}
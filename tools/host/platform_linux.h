@@ -0,0 +1,11 @@
+#ifndef PLATFORM_LINUX_H
+#define PLATFORM_LINUX_H
+
+#include <stdbool.h>
+
+#include "platform.h"
+
+// Write the game's debug log to stderr. Off by default, since the game logs every tick.
+extern bool platform_log_enabled;
+
+#endif
@@ -0,0 +1,219 @@
+// Headless replay of an input journal. Re-executes the game's update() for every recorded tick as fast as possible,
+// then reports how long the ticks took and which were the slowest.
+//
+//   replay [-v] [-n ticks] [-s spikes] [-k interval] [-j threads] journal
+//
+// -n stops after that many ticks, -s sets how many of the slowest ticks to list, and -k prints the game checksum every
+// that many ticks, to find the first tick where two builds part ways. -v writes the game's debug log to stderr.
+// -j solves the space on that many threads, in a build with CP_USE_THREADS=1. The checksums don't depend on it.
+//
+// Built with CP_USE_STEP_PROFILE=1, the slowest ticks are also broken down by phase of the space step.
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "game.h"
+#include "platform_linux.h"
+
+typedef struct {
+    uint32_t tick;
+    uint64_t ns;
+} TickTime;
+
+static uint64_t now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+#if CP_USE_STEP_PROFILE
+static const char *phase_names[CP_STEP_PHASE_COUNT] = {
+    [CP_STEP_PHASE_BROADPHASE] = "broad",
+    [CP_STEP_PHASE_NARROWPHASE] = "narrow",
+    [CP_STEP_PHASE_COMPONENTS] = "graph",
+    [CP_STEP_PHASE_INTEGRATE] = "integrate",
+    [CP_STEP_PHASE_PRESTEP] = "prestep",
+    [CP_STEP_PHASE_SOLVER] = "solver",
+    [CP_STEP_PHASE_POST_SOLVE] = "post",
+};
+
+static double ticks_to_us(uint64_t ticks) {
+    return ticks * (1e6 / PLATFORM_TICKS_PER_SECOND);
+}
+
+static void print_profile(const cpStepProfile *profile) {
+    printf("           ");
+    for (int phase = 0; phase < CP_STEP_PHASE_COUNT; phase++) {
+        printf(" %s %.1f", phase_names[phase], ticks_to_us(profile->phases[phase]));
+    }
+    printf(" us; %d pairs, %d arbiters, %d contacts, %d substeps, %d iterations\n",
+        profile->pairs, profile->arbiters, profile->contacts, profile->substeps, profile->iterations);
+}
+#endif
+
+static int compare_slowest(const void *a, const void *b) {
+    const TickTime *ta = a, *tb = b;
+
+    if (ta->ns != tb->ns) {
+        return ta->ns < tb->ns ? 1 : -1;
+    }
+
+    return ta->tick < tb->tick ? -1 : 1;
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s [-v] [-n ticks] [-s spikes] [-k interval] [-j threads] journal\n", name);
+    exit(2);
+}
+
+int main(int argc, char **argv) {
+    long max_ticks = -1;
+    int spikes = 10;
+    long checksum_interval = 0;
+    int threads = 1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "vn:s:k:j:")) != -1) {
+        switch (opt) {
+            case 'v':
+                platform_log_enabled = true;
+                break;
+            case 'n':
+                max_ticks = atol(optarg);
+                break;
+            case 's':
+                spikes = atoi(optarg);
+                break;
+            case 'k':
+                checksum_interval = atol(optarg);
+                break;
+            case 'j':
+                threads = atoi(optarg);
+                break;
+            default:
+                usage(argv[0]);
+        }
+    }
+
+    if (optind != argc - 1 || threads < 1) {
+        usage(argv[0]);
+    }
+
+#if !CP_USE_THREADS
+    if (threads > 1) {
+        fprintf(stderr, "%s: -j needs a build with CP_USE_THREADS=1\n", argv[0]);
+        return 2;
+    }
+#endif
+
+    FILE *file = fopen(argv[optind], "rb");
+    if (!file) {
+        perror(argv[optind]);
+        return 1;
+    }
+
+    Journal journal;
+    if (!journal_replay(&journal, file)) {
+        fprintf(stderr, "%s: not a journal, or a different version\n", argv[optind]);
+        return 1;
+    }
+
+    // Read the whole journal up front, so file access doesn't show up in the tick times.
+    size_t count = 0, capacity = 1024;
+    JournalTick *ticks = malloc(capacity * sizeof(*ticks));
+
+    while ((max_ticks < 0 || (long)count < max_ticks) && journal_read_tick(&journal, &ticks[count])) {
+        if (++count == capacity) {
+            capacity *= 2;
+            ticks = realloc(ticks, capacity * sizeof(*ticks));
+        }
+    }
+
+    fclose(file);
+
+    TickTime *times = malloc((count ? count : 1) * sizeof(*times));
+    uint64_t total_ns = 0;
+
+#if CP_USE_STEP_PROFILE
+    // The step of every tick, since the space only keeps the last few.
+    cpStepProfile *profiles = malloc((count ? count : 1) * sizeof(*profiles));
+    cpStepProfile profile_sum = {0};
+#endif
+
+    game_init(journal.seed, true);
+#if CP_USE_THREADS
+    cpSpaceSetThreads(space, threads);
+#endif
+
+    for (size_t i = 0; i < count; i++) {
+        uint64_t start = now_ns();
+        update(&ticks[i]);
+        uint64_t ns = now_ns() - start;
+
+        times[i] = (TickTime){.tick = i, .ns = ns};
+        total_ns += ns;
+
+#if CP_USE_STEP_PROFILE
+        // update() steps the space exactly once per tick.
+        profiles[i] = *cpSpaceGetStepProfile(space, 0);
+
+        profile_sum.total += profiles[i].total;
+        for (int phase = 0; phase < CP_STEP_PHASE_COUNT; phase++) {
+            profile_sum.phases[phase] += profiles[i].phases[phase];
+        }
+#endif
+
+        if (checksum_interval > 0 && (i + 1) % checksum_interval == 0) {
+            printf("tick %zu checksum %08x\n", i + 1, game_checksum());
+        }
+    }
+
+    double seconds = total_ns * 1e-9;
+    double game_seconds = count * (SIM_TICK_US * 1e-6);
+
+    printf("seed %08x, %zu ticks (%.1f s of play) in %.3f s, %.0fx real time\n",
+        journal.seed, count, game_seconds, seconds, seconds > 0 ? game_seconds / seconds : 0.0);
+
+    if (count > 0) {
+        qsort(times, count, sizeof(*times), compare_slowest);
+
+        printf("tick time: mean %.1f us, median %.1f us, 99th percentile %.1f us, max %.1f us\n",
+            total_ns * 1e-3 / count, times[count / 2].ns * 1e-3, times[count / 100].ns * 1e-3, times[0].ns * 1e-3);
+
+#if CP_USE_STEP_PROFILE
+        printf("step time: mean %.1f us;", ticks_to_us(profile_sum.total) / count);
+        for (int phase = 0; phase < CP_STEP_PHASE_COUNT; phase++) {
+            printf(" %s %.1f", phase_names[phase], ticks_to_us(profile_sum.phases[phase]) / count);
+        }
+        printf("\n");
+#endif
+
+        if (spikes > (int)count) {
+            spikes = count;
+        }
+
+        for (int i = 0; i < spikes; i++) {
+            const TickTime *t = &times[i];
+
+            printf("  tick %7u: %8.1f us here, %8.1f us step on the recording\n",
+                t->tick, t->ns * 1e-3, ticks[t->tick].step_ticks * (1e6 / PLATFORM_TICKS_PER_SECOND));
+#if CP_USE_STEP_PROFILE
+            print_profile(&profiles[t->tick]);
+#endif
+        }
+    }
+
+    printf("checksum %08x\n", game_checksum());
+
+#if CP_USE_STEP_PROFILE
+    free(profiles);
+#endif
+    free(times);
+    free(ticks);
+
+    return 0;
+}
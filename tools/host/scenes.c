@@ -0,0 +1,211 @@
+#include <stdlib.h>
+
+#include "scenes.h"
+
+#define RAY 1
+#define ITEM 2
+
+static void add_walls(cpSpace *space) {
+    cpBody *walls = cpSpaceGetStaticBody(space);
+
+    cpSpaceAddShape(space, cpSegmentShapeNew(walls, cpv(0, 470), cpv(640, 470), 0));
+    cpSpaceAddShape(space, cpSegmentShapeNew(walls, cpv(0, -2000), cpv(0, 470), 0));
+    cpSpaceAddShape(space, cpSegmentShapeNew(walls, cpv(640, -2000), cpv(640, 470), 0));
+}
+
+void pile_init(Pile *pile, int count) {
+    *pile = (Pile){
+        .space = cpSpaceNew(),
+        .bodies = calloc(count, sizeof(cpBody *)),
+        .count = count,
+    };
+
+    cpSpaceSetGravity(pile->space, cpv(0, 100));
+    add_walls(pile->space);
+}
+
+void pile_step(Pile *pile) {
+    if (pile->step % 6 == 0 && pile->added < pile->count) {
+        cpBody *body = cpSpaceAddBody(pile->space, cpBodyNew(5, cpMomentForBox(5, 50, 20)));
+        cpBodySetPosition(body, cpv(100 + (pile->step * 37) % 440, 50));
+        cpBodySetAngle(body, (pile->step % 7) * 0.4);
+
+        cpShape *shape = cpSpaceAddShape(pile->space, cpBoxShapeNew(body, 50, 20, 0));
+        cpShapeSetFriction(shape, 0.6);
+
+        pile->bodies[pile->added++] = body;
+    }
+
+    cpSpaceStep(pile->space, SCENE_DT);
+    pile->step++;
+}
+
+void pile_destroy(Pile *pile) {
+    scene_free_space(pile->space);
+    free(pile->bodies);
+}
+
+static void post_ray_collide(cpSpace *space, void *ray, void *data) {
+    cpBodySetType(ray, CP_BODY_TYPE_DYNAMIC);
+    cpBodySetMass(ray, 5);
+}
+
+static cpBool begin_ray_item(cpArbiter *arb, cpSpace *space, void *data) {
+    CP_ARBITER_GET_BODIES(arb, item, ray);
+    cpSpaceAddPostStepCallback(space, post_ray_collide, ray, NULL);
+
+    return cpTrue;
+}
+
+void storm_init(Storm *storm, int count) {
+    *storm = (Storm){
+        .space = cpSpaceNew(),
+        .rays = calloc(count, sizeof(cpBody *)),
+        .count = count,
+    };
+
+    cpSpaceSetGravity(storm->space, cpv(0, 100));
+    add_walls(storm->space);
+
+    storm->item = cpSpaceAddBody(storm->space, cpBodyNewKinematic());
+    cpBodySetPosition(storm->item, cpv(550, 180));
+    cpShapeSetCollisionType(cpSpaceAddShape(storm->space, cpBoxShapeNew(storm->item, 80, 60, 0)), ITEM);
+
+    cpSpaceAddCollisionHandler(storm->space, ITEM, RAY)->beginFunc = begin_ray_item;
+}
+
+void storm_step(Storm *storm) {
+    int step = storm->step;
+
+    if (step % 8 == 0 && storm->fired < storm->count) {
+        cpFloat angle = -0.39 + 0.78 * ((step * 37) % 100) / 100.0;
+
+        cpBody *ray = cpSpaceAddBody(storm->space, cpBodyNewKinematic());
+        cpBodySetPosition(ray, cpv(400, 180));
+        cpBodySetAngle(ray, angle);
+        cpBodySetVelocity(ray, cpv(80 * cpfcos(angle), 80 * cpfsin(angle + CP_PI)));
+        cpBodySetAngularVelocity(ray, (step / 8) % 2 ? 1 : -1);
+
+        cpShape *shape = cpSpaceAddShape(storm->space, cpBoxShapeNew(ray, 50, 20, 0));
+        cpShapeSetElasticity(shape, 0.1);
+        cpShapeSetCollisionType(shape, RAY);
+        cpShapeSetMass(shape, 5);
+
+        storm->rays[storm->fired++] = ray;
+    }
+
+    cpBodySetPosition(storm->item, cpv(550, 180 + 80 * cpfsin(step * 0.015)));
+
+    cpSpaceStep(storm->space, SCENE_DT);
+    storm->step++;
+}
+
+void storm_destroy(Storm *storm) {
+    scene_free_space(storm->space);
+    free(storm->rays);
+}
+
+#define PILE_BOXES 24
+#define CHAIN_LINKS 6
+
+void islands_init(Islands *islands, int piles) {
+    *islands = (Islands){
+        .space = cpSpaceNew(),
+        .bodies = calloc(1 + piles * (PILE_BOXES + CHAIN_LINKS), sizeof(cpBody *)),
+    };
+
+    cpSpace *space = islands->space;
+    cpSpaceSetGravity(space, cpv(0, -100));
+    cpSpaceSetIterations(space, 10);
+
+    cpBody *floor = cpSpaceGetStaticBody(space);
+    cpSpaceAddShape(space, cpSegmentShapeNew(floor, cpv(-100, 0), cpv(piles * 100 + 100, 0), 0));
+
+    cpBody *pusher = islands->bodies[islands->count++] = cpSpaceAddBody(space, cpBodyNewKinematic());
+    cpSpaceAddShape(space, cpBoxShapeNew(pusher, 20, 20, 0));
+    cpBodySetPosition(pusher, cpv(-50, 10));
+    cpBodySetVelocity(pusher, cpv(20, 0));
+
+    for (int p = 0; p < piles; p++) {
+        for (int i = 0; i < PILE_BOXES; i++) {
+            cpBody *body = cpSpaceAddBody(space, cpBodyNew(1, cpMomentForBox(1, 10, 10)));
+            cpBodySetPosition(body, cpv(p * 100 + (i % 3) * 11 + (i / 3) % 2 * 5, 6 + (i / 3) * 11));
+            cpShapeSetFriction(cpSpaceAddShape(space, cpBoxShapeNew(body, 10, 10, 0)), 0.7);
+
+            islands->bodies[islands->count++] = body;
+        }
+
+        cpBody *prev = floor;
+        for (int i = 0; i < CHAIN_LINKS; i++) {
+            cpBody *body = cpSpaceAddBody(space, cpBodyNew(1, cpMomentForCircle(1, 0, 4, cpvzero)));
+            cpBodySetPosition(body, cpv(p * 100 + 60 + i * 8, 200));
+            cpSpaceAddShape(space, cpCircleShapeNew(body, 4, cpvzero));
+            cpSpaceAddConstraint(space, cpPivotJointNew(prev, body, cpv(p * 100 + 56 + i * 8, 200)));
+
+            if (i == 0) {
+                cpSpaceAddConstraint(space, cpSimpleMotorNew(floor, body, 1));
+            } else {
+                cpSpaceAddConstraint(space, cpGearJointNew(prev, body, 0, 1));
+            }
+            if (i == 2) {
+                cpSpaceAddConstraint(space, cpRotaryLimitJointNew(floor, body, -0.5, 0.5));
+            }
+
+            islands->bodies[islands->count++] = prev = body;
+        }
+    }
+}
+
+void islands_step(Islands *islands) { cpSpaceStep(islands->space, SCENE_DT); }
+
+void islands_destroy(Islands *islands) {
+    scene_free_space(islands->space);
+    free(islands->bodies);
+}
+
+typedef struct {
+    void **items;
+    int count, capacity;
+} List;
+
+static void list_push(List *list, void *item) {
+    if (list->count == list->capacity) {
+        list->capacity = list->capacity ? list->capacity * 2 : 64;
+        list->items = realloc(list->items, list->capacity * sizeof(void *));
+    }
+
+    list->items[list->count++] = item;
+}
+
+static void push_shape(cpShape *shape, void *list) { list_push(list, shape); }
+static void push_body(cpBody *body, void *list) { list_push(list, body); }
+static void push_constraint(cpConstraint *constraint, void *list) { list_push(list, constraint); }
+
+void scene_free_space(cpSpace *space) {
+    List shapes = {0}, bodies = {0}, constraints = {0};
+
+    cpSpaceEachShape(space, push_shape, &shapes);
+    cpSpaceEachBody(space, push_body, &bodies);
+    cpSpaceEachConstraint(space, push_constraint, &constraints);
+
+    for (int i = 0; i < shapes.count; i++) {
+        cpSpaceRemoveShape(space, shapes.items[i]);
+        cpShapeFree(shapes.items[i]);
+    }
+
+    for (int i = 0; i < constraints.count; i++) {
+        cpSpaceRemoveConstraint(space, constraints.items[i]);
+        cpConstraintFree(constraints.items[i]);
+    }
+
+    for (int i = 0; i < bodies.count; i++) {
+        cpSpaceRemoveBody(space, bodies.items[i]);
+        cpBodyFree(bodies.items[i]);
+    }
+
+    free(shapes.items);
+    free(bodies.items);
+    free(constraints.items);
+
+    cpSpaceFree(space);
+}
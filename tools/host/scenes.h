@@ -0,0 +1,54 @@
+#ifndef SCENES_H
+#define SCENES_H
+
+#include <chipmunk/chipmunk.h>
+
+// Scenes shared by the tests and benchmarks. They only use the public Chipmunk API, so they build against every
+// variant of the library. Both step by the game's 0.03 s and keep their bodies in the order they were made, so runs in
+// different builds can be compared body by body.
+
+#define SCENE_DT 0.03
+
+// Deflected rays piling up: 50x20 boxes dropped one every six steps between two walls onto a floor.
+typedef struct {
+    cpSpace *space;
+    cpBody **bodies;
+    int count, added;
+    int step;
+} Pile;
+
+void pile_init(Pile *pile, int count);
+void pile_step(Pile *pile);
+void pile_destroy(Pile *pile);
+
+// The attract mode: rays fired every eight steps at the kinematic item as it bobs up and down. A ray that touches the
+// item turns dynamic and falls onto the floor, the way postRayCollide() does it in game.c.
+typedef struct {
+    cpSpace *space;
+    cpBody *item;
+    cpBody **rays;
+    int count, fired;
+    int step;
+} Storm;
+
+void storm_init(Storm *storm, int count);
+void storm_step(Storm *storm);
+void storm_destroy(Storm *storm);
+
+// Independent islands for the threaded solver: piles of 10x10 boxes on a shared floor, and next to each a chain of
+// circles hanging from the static body on pivot joints, with a motor, a rotary limit and gear joints. A kinematic box
+// pushes into the first pile. The bodies are in the order they were made, the pusher first.
+typedef struct {
+    cpSpace *space;
+    cpBody **bodies;
+    int count;
+} Islands;
+
+void islands_init(Islands *islands, int piles);
+void islands_step(Islands *islands);
+void islands_destroy(Islands *islands);
+
+// Free a space with all of its bodies, shapes and constraints.
+void scene_free_space(cpSpace *space);
+
+#endif
@@ -0,0 +1,220 @@
+// Balancing sweep. A bot plays the game on a PC as fast as the simulation runs, and the scores it gets are reported,
+// so changes to the game's tuning can be compared over many games instead of a few by hand.
+//
+//   sweep [-v] [-s seed] [-g games] [-l lag] [-e error] [-t ticks] [-j threads]
+//
+// The bot sees the mouth and lung targets -l ticks late, and gets the stick wrong by up to -e of its range. Games it
+// survives for -t ticks are cut short and counted separately. Every run with the same options plays the same games,
+// whatever the number of threads -j solves the space on in a build with CP_USE_THREADS=1.
+
+#include <getopt.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "game.h"
+#include "platform_linux.h"
+
+#define MAX_LAG 64
+
+// How far the stick can be pushed, which is the range update_playing() maps onto the mouth angle.
+#define STICK_RANGE 85
+
+typedef struct {
+    int lag;
+    float error;
+
+    // Targets seen over the last MAX_LAG ticks
+    float mouth_targets[MAX_LAG];
+    float lung_targets[MAX_LAG];
+    int seen;
+
+    // Separate from the game's random numbers, so the bot's mistakes don't change what the game does.
+    uint32_t rng_state;
+} Bot;
+
+static float bot_rand(Bot *bot) {
+    bot->rng_state ^= bot->rng_state << 13;
+    bot->rng_state ^= bot->rng_state >> 17;
+    bot->rng_state ^= bot->rng_state << 5;
+
+    return (bot->rng_state >> 8) / 16777216.0f;
+}
+
+// Inputs for the next tick: start the game from the attract and game over screens, then follow the targets.
+static JournalTick bot_play(Bot *bot, const JournalTick *last) {
+    JournalTick tick = {0};
+
+    if (gameStatus == GAME_STATE_ATTRACT || gameStatus == GAME_STATE_GAME_OVER) {
+        // Let go in between, or it isn't a press.
+        if (!(last->buttons & JOURNAL_BUTTON_START)) {
+            tick.buttons = JOURNAL_BUTTON_START;
+        }
+
+        bot->seen = 0;
+        return tick;
+    }
+
+    if (gameStatus != GAME_STATE_PLAYING) {
+        return tick;
+    }
+
+    int slot = bot->seen % MAX_LAG;
+    bot->mouth_targets[slot] = mouth_target;
+    bot->lung_targets[slot] = lung_target_scale;
+    bot->seen++;
+
+    int lag = bot->lag < bot->seen ? bot->lag : bot->seen - 1;
+    int seen_slot = (bot->seen - 1 - lag) % MAX_LAG;
+
+    // update_playing() sets the mouth angle to M_PI/8 + stick_y/85 * M_PI/8.
+    float stick = (bot->mouth_targets[seen_slot] - M_PI / 8) / (M_PI / 8) * STICK_RANGE;
+    stick += (bot_rand(bot) * 2 - 1) * bot->error * STICK_RANGE;
+    tick.stick_y = lrintf(fmaxf(-STICK_RANGE, fminf(STICK_RANGE, stick)));
+
+    float lung_target = bot->lung_targets[seen_slot];
+    if (lung_target > lung_scale + 0.02f) {
+        tick.buttons |= JOURNAL_BUTTON_D_UP;
+    } else if (lung_target < lung_scale - 0.02f) {
+        tick.buttons |= JOURNAL_BUTTON_D_DOWN;
+    }
+
+    return tick;
+}
+
+// Press and let go of a button. Returns the ticks it took.
+static int press(uint16_t button) {
+    JournalTick tick = {.buttons = button};
+    update(&tick);
+
+    tick.buttons = 0;
+    update(&tick);
+
+    return 2;
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s [-v] [-s seed] [-g games] [-l lag] [-e error] [-t ticks] [-j threads]\n", name);
+    exit(2);
+}
+
+int main(int argc, char **argv) {
+    uint32_t seed = 1;
+    int games = 100;
+    long max_ticks = 20 * 60 * 30;
+    Bot bot = {.lag = 6, .error = 0.1f};
+    int threads = 1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "vs:g:l:e:t:j:")) != -1) {
+        switch (opt) {
+            case 'v':
+                platform_log_enabled = true;
+                break;
+            case 's':
+                seed = strtoul(optarg, NULL, 0);
+                break;
+            case 'g':
+                games = atoi(optarg);
+                break;
+            case 'l':
+                bot.lag = atoi(optarg);
+                break;
+            case 'e':
+                bot.error = atof(optarg);
+                break;
+            case 't':
+                max_ticks = atol(optarg);
+                break;
+            case 'j':
+                threads = atoi(optarg);
+                break;
+            default:
+                usage(argv[0]);
+        }
+    }
+
+    if (optind != argc || games <= 0 || bot.lag < 0 || bot.lag >= MAX_LAG || max_ticks <= 0 || threads < 1) {
+        usage(argv[0]);
+    }
+
+#if !CP_USE_THREADS
+    if (threads > 1) {
+        fprintf(stderr, "%s: -j needs a build with CP_USE_THREADS=1\n", argv[0]);
+        return 2;
+    }
+#endif
+
+    bot.rng_state = seed ^ 0x9e3779b9;
+    if (!bot.rng_state) {
+        bot.rng_state = 1;
+    }
+
+    // Step times of zero rather than the PC's clock, so the step budget always picks the best quality and every run
+    // plays the same games.
+    game_init(seed, true);
+#if CP_USE_THREADS
+    cpSpaceSetThreads(space, threads);
+#endif
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    long total_ticks = 0;
+    int played = 0, cut_short = 0;
+    int min_score = 0, max_score = 0;
+    double score_sum = 0, level_sum = 0;
+
+    JournalTick tick = {0};
+
+    while (played + cut_short < games) {
+        // Play up to the start of a game
+        while (gameStatus != GAME_STATE_STARTING_LEVEL) {
+            tick = bot_play(&bot, &tick);
+            update(&tick);
+            total_ticks++;
+        }
+
+        long ticks = 0;
+        while (gameStatus != GAME_STATE_GAME_OVER && ticks < max_ticks) {
+            tick = bot_play(&bot, &tick);
+            update(&tick);
+            ticks++;
+        }
+
+        total_ticks += ticks;
+
+        if (gameStatus != GAME_STATE_GAME_OVER) {
+            // Surviving this long, the bot would never lose. Lose on purpose with the debug buttons to start over.
+            cut_short++;
+
+            total_ticks += press(JOURNAL_BUTTON_L) + press(JOURNAL_BUTTON_B) + press(JOURNAL_BUTTON_L);
+            tick = (JournalTick){0};
+
+            continue;
+        }
+
+        if (played == 0 || score < min_score) min_score = score;
+        if (played == 0 || score > max_score) max_score = score;
+        score_sum += score;
+        level_sum += level + 1;
+        played++;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+    double game_seconds = total_ticks * (SIM_TICK_US * 1e-6);
+
+    printf("seed %u, lag %d ticks, error %.2f: %d games lost, %d cut short after %ld ticks\n",
+        seed, bot.lag, bot.error, played, cut_short, max_ticks);
+    if (played > 0) {
+        printf("score: mean %.1f s, min %d s, max %d s; mean level reached %.2f\n",
+            score_sum / played, min_score, max_score, level_sum / played);
+    }
+    printf("%ld ticks (%.0f s of play) in %.3f s, %.0fx real time\n",
+        total_ticks, game_seconds, seconds, seconds > 0 ? game_seconds / seconds : 0.0);
+
+    return 0;
+}
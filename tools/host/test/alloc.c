@@ -0,0 +1,165 @@
+// Chipmunk's heap allocations once a space reaches a steady state.
+//
+//   alloc [-s steps]
+//   alloc_packed [-s steps]
+//
+// Linked against a Chipmunk built with test/alloc_count.h, which counts every cpcalloc() and cprealloc(). The space's
+// arenas get their chunks from an allocator that counts them separately.
+//
+// Some of the boxes in a pile are kicked up into the air every few seconds, so the pile is woken and falls asleep again over
+// and over. Collision handlers queue post-step callbacks during the step, and a callback is also queued between steps.
+// After a warm up, the steps that follow must not allocate at all.
+//
+// Then the space switches to a spatial hash several times. Each switch allocates the new hashes themselves, but once
+// the first indexes have given their pool buffers back, the persistent arena must not grow any more.
+
+#include <unistd.h>
+
+#include "harness.h"
+#include "scenes.h"
+#include "test/alloc_count.h"
+
+#define BOXES 60
+#define KICK_STEPS 300
+#define WARM_UP_STEPS 4000
+#define SWITCHES 10
+
+long counted_allocations;
+
+void *counted_calloc(size_t count, size_t size) {
+    counted_allocations++;
+    return calloc(count, size);
+}
+
+void *counted_realloc(void *ptr, size_t size) {
+    counted_allocations++;
+    return realloc(ptr, size);
+}
+
+static long chunk_allocations;
+
+static void *alloc_chunk(size_t bytes, void *data) {
+    chunk_allocations++;
+    return calloc(1, bytes);
+}
+
+static void free_chunk(void *ptr, void *data) { free(ptr); }
+
+static int callbacks_run;
+
+static void count_callback(cpSpace *space, void *key, void *data) { callbacks_run++; }
+
+static cpBool begin(cpArbiter *arb, cpSpace *space, void *data) {
+    CP_ARBITER_GET_BODIES(arb, a, b);
+    cpSpaceAddPostStepCallback(space, count_callback, a, NULL);
+
+    return cpTrue;
+}
+
+static cpBool pre_solve(cpArbiter *arb, cpSpace *space, void *data) {
+    CP_ARBITER_GET_BODIES(arb, a, b);
+    cpSpaceAddPostStepCallback(space, count_callback, b, NULL);
+
+    return cpTrue;
+}
+
+int main(int argc, char **argv) {
+    int steps = 3000;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "s:")) != -1) {
+        switch (opt) {
+            case 's':
+                steps = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-s steps]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    cpSpace *space = cpSpaceNew();
+
+    cpSpaceAllocator allocator = cpSpaceAllocatorDefault;
+    allocator.alloc = alloc_chunk;
+    allocator.free = free_chunk;
+    cpSpaceSetAllocator(space, &allocator);
+
+    cpSpaceSetGravity(space, cpv(0, 100));
+    cpSpaceSetSleepTimeThreshold(space, 0.5);
+    cpBody *walls = cpSpaceGetStaticBody(space);
+    cpSpaceAddShape(space, cpSegmentShapeNew(walls, cpv(0, 470), cpv(640, 470), 0));
+    cpSpaceAddShape(space, cpSegmentShapeNew(walls, cpv(0, 0), cpv(0, 470), 0));
+    cpSpaceAddShape(space, cpSegmentShapeNew(walls, cpv(640, 0), cpv(640, 470), 0));
+
+    cpCollisionHandler *handler = cpSpaceAddDefaultCollisionHandler(space);
+    handler->beginFunc = begin;
+    handler->preSolveFunc = pre_solve;
+
+    cpBody *boxes[BOXES];
+    for (int i = 0; i < BOXES; i++) {
+        cpBody *body = cpSpaceAddBody(space, cpBodyNew(5, cpMomentForBox(5, 50, 20)));
+        cpBodySetPosition(body, cpv(30 + (i % 10) * 56, 440 - 25 * (i / 10)));
+        cpShapeSetFriction(cpSpaceAddShape(space, cpBoxShapeNew(body, 50, 20, 0)), 0.6);
+
+        boxes[i] = body;
+    }
+
+    long allocations = 0, chunks = 0;
+    int most_sleeping = 0, least_sleeping = BOXES;
+
+    for (int step = 0; step < WARM_UP_STEPS + steps; step++) {
+        if (step == WARM_UP_STEPS) {
+            allocations = counted_allocations;
+            chunks = chunk_allocations;
+        }
+
+        if (step % KICK_STEPS == 0) {
+            for (int i = (step / KICK_STEPS) % 7; i < BOXES; i += 7) {
+                cpBodyApplyImpulseAtLocalPoint(boxes[i], cpv(i % 2 ? 200 : -200, -800), cpv(10, 0));
+            }
+        }
+
+        cpSpaceAddPostStepCallback(space, count_callback, space, NULL);
+        cpSpaceStep(space, SCENE_DT);
+
+        if (step >= WARM_UP_STEPS) {
+            int sleeping = cpSpaceGetSleepingBodyCount(space);
+            most_sleeping = sleeping > most_sleeping ? sleeping : most_sleeping;
+            least_sleeping = sleeping < least_sleeping ? sleeping : least_sleeping;
+        }
+    }
+
+    allocations = counted_allocations - allocations;
+    chunks = chunk_allocations - chunks;
+
+    printf("%s solver, %d steps after a %d step warm up: %ld heap allocations, %ld arena chunks, %d post-step "
+        "callbacks run, %d to %d bodies asleep\n", CP_USE_PACKED_SOLVER ? "packed" : "default", steps, WARM_UP_STEPS,
+        allocations, chunks, callbacks_run, least_sleeping, most_sleeping);
+
+    CHECK(allocations == 0, "the steps allocated %ld times", allocations);
+    CHECK(chunks == 0, "the arenas grew by %ld chunks", chunks);
+    CHECK(least_sleeping == 0 && most_sleeping > 0, "the bodies didn't fall asleep and wake up again");
+
+    // The first switch replaces the trees, the second the first hashes. After that, every hash reuses the pool
+    // buffers of the ones it replaces.
+    long switch_chunks[SWITCHES];
+    for (int i = 0; i < SWITCHES; i++) {
+        long before = chunk_allocations;
+        cpSpaceUseSpatialHash(space, 50, 1000);
+        cpSpaceStep(space, SCENE_DT);
+        switch_chunks[i] = chunk_allocations - before;
+    }
+
+    long later = 0;
+    for (int i = 2; i < SWITCHES; i++) {
+        later += switch_chunks[i];
+    }
+
+    printf("switching to a spatial hash %d times: %ld arena chunks for the first, %ld for the second, %ld for the rest\n",
+        SWITCHES, switch_chunks[0], switch_chunks[1], later);
+    CHECK(later == 0, "the later switches grew the persistent arena by %ld chunks", later);
+
+    scene_free_space(space);
+    return 0;
+}
@@ -0,0 +1,14 @@
+#ifndef ALLOC_COUNT_H
+#define ALLOC_COUNT_H
+
+#include <stddef.h>
+
+// Forced into every Chipmunk file of the counted builds with -include, along with -Dcpcalloc=counted_calloc and
+// -Dcprealloc=counted_realloc, so test/alloc.c can count Chipmunk's heap allocations.
+
+extern long counted_allocations;
+
+void *counted_calloc(size_t count, size_t size);
+void *counted_realloc(void *ptr, size_t size);
+
+#endif
@@ -0,0 +1,226 @@
+// Batched nearest point and first segment queries against the single queries, on every index they go through.
+//
+//   batch_test [-r rounds]
+//
+// A space is filled with random circles, boxes and segments, a quarter of them static, with random filters and a few
+// sensors, and uses the bounding box tree, the grid or the spatial hash. Every round moves the dynamic bodies and
+// reindexes them, then runs batches of random queries through cpSpacePointQueryNearestBatch() and
+// cpSpaceSegmentQueryFirstBatch(). Each result has to be exactly what cpSpacePointQueryNearest() or
+// cpSpaceSegmentQueryFirst() returns for that query, and the returned count has to be the number of hits.
+//
+// The batches are fans of rays around a point, in angle order so the tree runs them as packets, and points along the
+// fans, along with fully scattered ones. Their sizes don't line up with the 32 query packets. The fans are long and
+// cross the space, so hits in the near child of a tree node shorten segments that still have the far child to go.
+
+#include <unistd.h>
+
+#include "harness.h"
+#include "scenes.h"
+
+#define SHAPES 600
+#define FIELD 1000
+#define MAX_QUERIES 300
+
+typedef enum { TREE, GRID, HASH, INDEX_COUNT } Index;
+static const char *index_names[] = {"tree", "grid", "hash"};
+
+static uint32_t rng = 7;
+static cpBody *bodies[SHAPES];
+static int body_count;
+
+static cpShapeFilter random_filter(void) {
+    switch (test_rand(&rng) % 4) {
+        case 0:
+            return CP_SHAPE_FILTER_ALL;
+        case 1:
+            return cpShapeFilterNew(CP_NO_GROUP, 1 << test_rand(&rng) % 4, CP_ALL_CATEGORIES);
+        case 2:
+            return cpShapeFilterNew(CP_NO_GROUP, CP_ALL_CATEGORIES, test_rand(&rng) % 16);
+        default:
+            return cpShapeFilterNew(1 + test_rand(&rng) % 3, 1 << test_rand(&rng) % 4, test_rand(&rng) % 16);
+    }
+}
+
+// What cpShapeFilterReject() in chipmunk_private.h does.
+static bool filter_rejects(cpShapeFilter a, cpShapeFilter b) {
+    return (a.group != 0 && a.group == b.group) || (a.categories & b.mask) == 0 || (b.categories & a.mask) == 0;
+}
+
+static cpVect random_point(void) {
+    return cpv(test_randf(&rng, -50, FIELD + 50), test_randf(&rng, -50, FIELD + 50));
+}
+
+static cpSpace *make_space(Index index) {
+    cpSpace *space = cpSpaceNew();
+    body_count = 0;
+    if (index == GRID) {
+        cpSpaceUseGrid(space, cpBBNew(0, 0, FIELD, FIELD), 50);
+    } else if (index == HASH) {
+        cpSpaceUseSpatialHash(space, 50, 1000);
+    }
+
+    for (int i = 0; i < SHAPES; i++) {
+        cpBody *body = cpSpaceGetStaticBody(space);
+        cpVect p = random_point();
+        cpFloat size = test_randf(&rng, 4, 40);
+
+        if (i % 4 != 0) {
+            body = bodies[body_count++] = cpSpaceAddBody(space, cpBodyNew(1, 1));
+            cpBodySetPosition(body, p);
+            cpBodySetAngle(body, test_randf(&rng, 0, 6));
+            p = cpvzero;
+        }
+
+        cpShape *shape;
+        switch (test_rand(&rng) % 3) {
+            case 0:
+                shape = cpCircleShapeNew(body, size / 2, p);
+                break;
+            case 1: {
+                cpTransform transform = cpTransformTranslate(p);
+                cpVect verts[] = {
+                    {-size / 2, -size / 4}, {-size / 2, size / 4}, {size / 2, size / 4}, {size / 2, -size / 4}};
+                shape = cpPolyShapeNew(body, 4, verts, transform, test_randf(&rng, 0, 3));
+                break;
+            }
+            default:
+                shape = cpSegmentShapeNew(body, cpvsub(p, cpv(size, size / 3)), cpvadd(p, cpv(size, size / 3)),
+                    test_randf(&rng, 0, 3));
+                break;
+        }
+
+        cpShapeSetFilter(shape, random_filter());
+        cpShapeSetSensor(shape, test_rand(&rng) % 20 == 0);
+        cpSpaceAddShape(space, shape);
+    }
+
+    return space;
+}
+
+static void move_bodies(cpSpace *space) {
+    for (int i = 0; i < body_count; i++) {
+        cpBody *body = bodies[i];
+        cpVect move = cpv(test_randf(&rng, -20, 20), test_randf(&rng, -20, 20));
+        cpBodySetPosition(body, cpvadd(cpBodyGetPosition(body), move));
+        cpBodySetAngle(body, cpBodyGetAngle(body) + test_randf(&rng, -1, 1));
+        cpSpaceReindexShapesForBody(space, body);
+    }
+}
+
+// A fan of rays from a random point in angle order, or scattered ones. Points are the ends of the rays.
+static int make_queries(cpBatchSegmentQuery *segments, cpBatchPointQuery *points) {
+    static const int sizes[] = {1, 7, 31, 32, 33, 64, 100, MAX_QUERIES};
+    int count = sizes[test_rand(&rng) % (sizeof(sizes) / sizeof(sizes[0]))];
+
+    bool fan = test_rand(&rng) % 4 != 0;
+    cpVect center = random_point();
+    cpFloat length = test_randf(&rng, 50, FIELD);
+    cpFloat radius = test_rand(&rng) % 3 ? 0 : test_randf(&rng, 0, 5);
+    cpShapeFilter filter = random_filter();
+
+    for (int i = 0; i < count; i++) {
+        cpVect start = fan ? center : random_point();
+        cpVect end = cpvadd(start, cpvmult(cpvforangle(fan ? 2 * CP_PI * i / count : test_randf(&rng, 0, 7)), length));
+
+        // Some queries in a batch have their own filters.
+        cpShapeFilter own = test_rand(&rng) % 4 ? filter : random_filter();
+        segments[i] = (cpBatchSegmentQuery){start, end, radius, own};
+        points[i] = (cpBatchPointQuery){fan ? cpvlerp(start, end, test_randf(&rng, 0, 1)) : end,
+            test_randf(&rng, 0, 100), own};
+    }
+
+    return count;
+}
+
+typedef struct {
+    int point_hits, segment_hits;
+    // Thick segments that found a nearer shape than the single query.
+    int nearer;
+} Counts;
+
+static void check_round(cpSpace *space, Index index, int round, Counts *counts) {
+    static cpBatchSegmentQuery segments[MAX_QUERIES];
+    static cpBatchPointQuery points[MAX_QUERIES];
+    static cpSegmentQueryInfo segment_infos[MAX_QUERIES];
+    static cpPointQueryInfo point_infos[MAX_QUERIES];
+
+    int count = make_queries(segments, points);
+
+    int found = cpSpaceSegmentQueryFirstBatch(space, segments, count, segment_infos), hits = 0;
+    for (int i = 0; i < count; i++) {
+        cpBatchSegmentQuery *q = &segments[i];
+        cpSegmentQueryInfo expected;
+        cpShape *shape = cpSpaceSegmentQueryFirst(space, q->start, q->end, q->radius, q->filter, &expected);
+        hits += shape != NULL;
+
+        cpSegmentQueryInfo *info = &segment_infos[i];
+        if (q->radius > 0 && info->shape) {
+            // The batch checks every shape along the centre line, so it can only find a nearer hit. It has to be the
+            // hit the shape itself reports.
+            cpSegmentQueryInfo own;
+            CHECK(shape && info->alpha <= expected.alpha && !cpShapeGetSensor(info->shape) &&
+                !filter_rejects(cpShapeGetFilter(info->shape), q->filter) &&
+                cpShapeSegmentQuery(info->shape, q->start, q->end, q->radius, &own) && cpveql(own.point, info->point) &&
+                cpveql(own.normal, info->normal) && own.alpha == info->alpha,
+                "%s, round %d: segment %d of %d with radius %g hit %p at %g, %p at %g on its own", index_names[index],
+                round, i, count, q->radius, (void *)info->shape, info->alpha, (void *)shape, expected.alpha);
+            counts->nearer += info->shape != shape;
+        } else {
+            // A miss sets up the rest of the info the same way in both.
+            CHECK(info->shape == expected.shape && cpveql(info->point, expected.point) &&
+                cpveql(info->normal, expected.normal) && info->alpha == expected.alpha,
+                "%s, round %d: segment %d of %d hit %p at %g, not %p at %g", index_names[index], round, i, count,
+                (void *)info->shape, info->alpha, (void *)shape, expected.alpha);
+        }
+    }
+    CHECK(found == hits, "%s, round %d: segment batch returned %d, not %d", index_names[index], round, found, hits);
+    counts->segment_hits += hits;
+
+    found = cpSpacePointQueryNearestBatch(space, points, count, point_infos), hits = 0;
+    for (int i = 0; i < count; i++) {
+        cpBatchPointQuery *q = &points[i];
+        cpPointQueryInfo expected;
+        cpShape *shape = cpSpacePointQueryNearest(space, q->point, q->maxDistance, q->filter, &expected);
+        hits += shape != NULL;
+
+        cpPointQueryInfo *info = &point_infos[i];
+        CHECK(info->shape == expected.shape && cpveql(info->point, expected.point) &&
+            info->distance == expected.distance && cpveql(info->gradient, expected.gradient),
+            "%s, round %d: point %d of %d found %p at %g, not %p at %g", index_names[index], round, i, count,
+            (void *)info->shape, info->distance, (void *)shape, expected.distance);
+    }
+    CHECK(found == hits, "%s, round %d: point batch returned %d, not %d", index_names[index], round, found, hits);
+    counts->point_hits += hits;
+}
+
+int main(int argc, char **argv) {
+    int rounds = 200;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "r:")) != -1) {
+        switch (opt) {
+            case 'r':
+                rounds = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-r rounds]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    for (Index index = 0; index < INDEX_COUNT; index++) {
+        cpSpace *space = make_space(index);
+        Counts counts = {0};
+
+        for (int round = 0; round < rounds; round++) {
+            move_bodies(space);
+            check_round(space, index, round, &counts);
+        }
+
+        printf("%s: %d rounds, %d point and %d segment hits checked against the single queries, %d thick segments hit nearer\n",
+            index_names[index], rounds, counts.point_hits, counts.segment_hits, counts.nearer);
+        scene_free_space(space);
+    }
+
+    return 0;
+}
@@ -0,0 +1,149 @@
+// The separating axis path for box pairs in cpCollide() against GJK/EPA, which it replaces for boxes.
+//
+//   boxes_double [-n pairs]
+//   boxes_float [-n pairs]
+//
+// Random pairs of boxes, some rounded, some axis aligned or turned a quarter, are collided twice: once as boxes, and
+// once with the first shape's box flag cleared, so the pair takes the GJK path. Both have to find the same number of
+// contacts with the same hashes, so arbiters warm start the same either way, and the normals and contact points have to
+// agree to the precision of the build. cpShapesOverlap() has to agree with both. At the end, both paths are timed on the
+// same pairs.
+
+#include <math.h>
+#include <unistd.h>
+
+#include "chipmunk/chipmunk_private.h"
+
+#include "harness.h"
+
+#define SHAPES 64
+
+#if CP_USE_DOUBLES
+    #define NORMAL_LIMIT 1e-9
+    #define POINT_LIMIT 1e-9
+#else
+    #define NORMAL_LIMIT 1e-4
+    #define POINT_LIMIT 1e-3
+#endif
+
+static cpBody *body1, *body2;
+static cpShape *shapes1[SHAPES], *shapes2[SHAPES];
+
+// Place the bodies for pair k and return its shapes.
+static void place(uint32_t *rng, int k, cpShape **a, cpShape **b) {
+    *a = shapes1[k % SHAPES];
+    *b = shapes2[(k * 7) % SHAPES];
+
+    cpBodySetPosition(body1, cpv(test_randf(rng, -5, 5), test_randf(rng, -5, 5)));
+    cpBodySetAngle(body1, k % 3 == 0 ? 0 : test_randf(rng, -4, 4));
+    cpBodySetPosition(body2, cpv(test_randf(rng, -50, 50), test_randf(rng, -50, 50)));
+    cpBodySetAngle(body2, k % 3 == 0 ? (k % 6 == 0 ? 0 : CP_PI / 2) : test_randf(rng, -4, 4));
+
+    cpShapeCacheBB(*a);
+    cpShapeCacheBB(*b);
+}
+
+static struct cpCollisionInfo collide_gjk(cpShape *a, cpShape *b, struct cpContact *contacts) {
+    cpPolyShape *poly = (cpPolyShape *)a;
+    poly->isBox = cpFalse;
+    struct cpCollisionInfo info = cpCollide(a, b, 0, contacts);
+    poly->isBox = cpTrue;
+
+    return info;
+}
+
+// Nanoseconds per pair, including placing the bodies.
+static double time_pairs(int pairs, bool gjk) {
+    struct cpContact contacts[CP_MAX_CONTACTS_PER_ARBITER];
+    uint32_t rng = 1;
+    long total = 0;
+
+    uint64_t start = now_ns();
+    for (int k = 0; k < pairs; k++) {
+        cpShape *a, *b;
+        place(&rng, k, &a, &b);
+        total += (gjk ? collide_gjk(a, b, contacts) : cpCollide(a, b, 0, contacts)).count;
+    }
+    double ns = (double)(now_ns() - start) / pairs;
+
+    CHECK(total > 0, "no pair touched");
+    return ns;
+}
+
+int main(int argc, char **argv) {
+    int pairs = 100000;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:")) != -1) {
+        switch (opt) {
+            case 'n':
+                pairs = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-n pairs]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    uint32_t rng = 1;
+    body1 = cpBodyNew(1, 1);
+    body2 = cpBodyNew(1, 1);
+    for (int i = 0; i < SHAPES; i++) {
+        cpFloat radius1 = i % 8 == 7 ? test_randf(&rng, 0, 2) : 0, radius2 = i % 5 == 4 ? test_randf(&rng, 0, 2) : 0;
+        shapes1[i] = cpBoxShapeNew(body1, test_randf(&rng, 2, 60), test_randf(&rng, 2, 60), radius1);
+        shapes2[i] = cpBoxShapeNew(body2, test_randf(&rng, 2, 60), test_randf(&rng, 2, 60), radius2);
+        CHECK(((cpPolyShape *)shapes1[i])->isBox && ((cpPolyShape *)shapes2[i])->isBox, "box %d isn't flagged", i);
+    }
+
+    // A quadrilateral that isn't a rectangle must not be taken for a box.
+    cpVect kite[] = {{0, -10}, {8, 0}, {0, 20}, {-8, 0}};
+    cpShape *not_box = cpPolyShapeNewRaw(body1, 4, kite, 0);
+    CHECK(!((cpPolyShape *)not_box)->isBox, "a kite was flagged as a box");
+    cpShapeFree(not_box);
+
+    int touching = 0;
+    double normal_error = 0, point_error = 0;
+
+    for (int k = 0; k < pairs; k++) {
+        cpShape *a, *b;
+        place(&rng, k, &a, &b);
+
+        struct cpContact sat[CP_MAX_CONTACTS_PER_ARBITER], gjk[CP_MAX_CONTACTS_PER_ARBITER];
+        struct cpCollisionInfo sat_info = cpCollide(a, b, 0, sat);
+        struct cpCollisionInfo gjk_info = collide_gjk(a, b, gjk);
+
+        CHECK(sat_info.count == gjk_info.count, "pair %d: %d contacts as boxes, %d with GJK", k, sat_info.count,
+            gjk_info.count);
+        CHECK(cpShapesOverlap(a, b) == (sat_info.count > 0), "pair %d: cpShapesOverlap() disagrees with %d contacts",
+            k, sat_info.count);
+
+        if (sat_info.count == 0) {
+            continue;
+        }
+
+        touching++;
+        normal_error = fmax(normal_error, cpvdist(sat_info.n, gjk_info.n));
+
+        for (int i = 0; i < sat_info.count; i++) {
+            CHECK(sat[i].hash == gjk[i].hash, "pair %d: contact %d hash %lx as boxes, %lx with GJK", k, i,
+                (unsigned long)sat[i].hash, (unsigned long)gjk[i].hash);
+            point_error = fmax(point_error, fmax(cpvdist(sat[i].r1, gjk[i].r1), cpvdist(sat[i].r2, gjk[i].r2)));
+        }
+    }
+
+    printf("%s build, %d box pairs, %d touching: largest normal difference %.2g, contact point difference %.2g\n",
+        CP_USE_DOUBLES ? "double" : "float", pairs, touching, normal_error, point_error);
+    CHECK(normal_error < NORMAL_LIMIT, "the normals differ by up to %g", normal_error);
+    CHECK(point_error < POINT_LIMIT, "the contact points differ by up to %g", point_error);
+
+    printf("%.1f ns per pair as boxes, %.1f ns with GJK\n", time_pairs(pairs, false), time_pairs(pairs, true));
+
+    for (int i = 0; i < SHAPES; i++) {
+        cpShapeFree(shapes1[i]);
+        cpShapeFree(shapes2[i]);
+    }
+    cpBodyFree(body1);
+    cpBodyFree(body2);
+
+    return 0;
+}
@@ -0,0 +1,145 @@
+// The step budget controller, with a clock that models what a step costs at the current settings.
+//
+//   budget
+//
+// cpSpaceStep() reads the budget's clock before and after the step. The model clock returns the same time for the first
+// read and moves on by the modelled cost of the step for the second, so the controller sees repeatable times. The cost
+// grows with the awake bodies, substeps and iterations, with a few percent of noise.
+//
+// Boxes are dropped into a pile until there are 240 of them. The controller has to:
+// - drop to the lowest settings when the target can't be met, and stay there,
+// - settle below the target when it can be met, without going back and forth,
+// - raise the quality all the way once the pile falls asleep,
+// - raise it just the same with a clock that says every step took no time, like the replays' clock when nothing was
+//   recorded.
+
+#include <math.h>
+
+#include "harness.h"
+#include "scenes.h"
+
+#define BOXES 240
+#define STEPS 4000
+#define SETTLED_STEPS 1000
+
+static const cpStepBudget limits = {NULL, 0, 3, 10, 1, 3};
+
+static cpSpace *space;
+static uint64_t model_time;
+static bool end_of_step;
+static uint32_t rng = 1;
+
+static uint64_t model_clock(void) {
+    // The first read of a step.
+    if (!end_of_step) {
+        end_of_step = true;
+        return model_time;
+    }
+
+    end_of_step = false;
+
+    double bodies = cpSpaceGetAwakeBodyCount(space) + 1;
+    double cost = 20000 + cpSpaceGetSubsteps(space) * (bodies * 800 + cpSpaceGetIterations(space) * bodies * 1500);
+    model_time += (uint64_t)(cost * test_randf(&rng, 0.95, 1.05));
+
+    return model_time;
+}
+
+static uint64_t zero_clock(void) { return 0; }
+
+typedef struct {
+    // Settings at the end.
+    int iterations, substeps;
+    // Over the last SETTLED_STEPS steps.
+    int changes, over_budget;
+    bool finite;
+} Result;
+
+static void check_finite(cpBody *body, void *finite) {
+    cpVect v = cpBodyGetVelocity(body);
+    *(bool *)finite &= isfinite(v.x) && isfinite(v.y);
+}
+
+static Result run(cpStepClockFunc clock, double target_ms, cpFloat sleep_time) {
+    space = cpSpaceNew();
+    cpSpaceSetGravity(space, cpv(0, 100));
+    cpSpaceSetSleepTimeThreshold(space, sleep_time);
+
+    cpBody *walls = cpSpaceGetStaticBody(space);
+    cpSpaceAddShape(space, cpSegmentShapeNew(walls, cpv(0, 470), cpv(640, 470), 0));
+    cpSpaceAddShape(space, cpSegmentShapeNew(walls, cpv(0, -2000), cpv(0, 470), 0));
+    cpSpaceAddShape(space, cpSegmentShapeNew(walls, cpv(640, -2000), cpv(640, 470), 0));
+
+    cpStepBudget budget = limits;
+    budget.clock = clock;
+    budget.target = (uint64_t)(target_ms * 1e6);
+    cpSpaceSetStepBudget(space, &budget);
+
+    model_time = 0;
+    end_of_step = false;
+
+    Result result = {.finite = true};
+    int iterations = cpSpaceGetIterations(space), substeps = cpSpaceGetSubsteps(space);
+
+    for (int step = 0; step < STEPS; step++) {
+        if (step % 6 == 0 && step < BOXES * 6) {
+            cpBody *body = cpSpaceAddBody(space, cpBodyNew(5, cpMomentForBox(5, 50, 20)));
+            cpBodySetPosition(body, cpv(100 + (step * 37) % 440, 50));
+            cpBodySetAngle(body, (step % 7) * 0.4);
+            cpShapeSetFriction(cpSpaceAddShape(space, cpBoxShapeNew(body, 50, 20, 0)), 0.6);
+        }
+
+        cpSpaceStep(space, SCENE_DT);
+
+        if (step >= STEPS - SETTLED_STEPS) {
+            result.changes += cpSpaceGetIterations(space) != iterations || cpSpaceGetSubsteps(space) != substeps;
+            result.over_budget += cpSpaceGetLastStepTime(space) > budget.target;
+        }
+
+        iterations = cpSpaceGetIterations(space);
+        substeps = cpSpaceGetSubsteps(space);
+        cpSpaceEachBody(space, check_finite, &result.finite);
+    }
+
+    result.iterations = iterations;
+    result.substeps = substeps;
+
+    scene_free_space(space);
+    return result;
+}
+
+static void report(const char *name, Result result) {
+    printf("  %-24s ends at %2d iterations x %d substeps; last %d steps: %d changes, %d over budget\n", name,
+        result.iterations, result.substeps, SETTLED_STEPS, result.changes, result.over_budget);
+    CHECK(result.finite, "%s: a velocity isn't finite", name);
+}
+
+int main(int argc, char **argv) {
+    printf("step budget, %d boxes, %d steps:\n", BOXES, STEPS);
+
+    // The awake pile costs ~1.3 ms at the lowest settings.
+    Result tight = run(model_clock, 0.3, INFINITY);
+    report("0.3 ms, awake", tight);
+    CHECK(tight.iterations == limits.minIterations && tight.substeps == limits.minSubsteps && tight.changes == 0,
+        "the controller didn't stay at the lowest settings");
+
+    // 6 iterations cost up to 2.5 ms. The controller raises the quality while the pile is still small, and a step at 7
+    // iterations would be ~2.8 ms, too close to the target.
+    Result settled = run(model_clock, 2.8, INFINITY);
+    report("2.8 ms, awake", settled);
+    CHECK(settled.iterations == 6 && settled.substeps == 1, "the controller didn't settle at 6 iterations");
+    CHECK(settled.changes == 0 && settled.over_budget == 0, "the controller didn't settle below the target");
+
+    // Once the pile sleeps, a step costs next to nothing.
+    Result asleep = run(model_clock, 0.3, 0.5);
+    report("0.3 ms, falls asleep", asleep);
+    CHECK(asleep.iterations == limits.maxIterations && asleep.substeps == limits.maxSubsteps,
+        "the controller didn't raise the quality once the pile fell asleep");
+
+    Result zero = run(zero_clock, 0.3, INFINITY);
+    report("steps that take no time", zero);
+    CHECK(zero.iterations == limits.maxIterations && zero.substeps == limits.maxSubsteps,
+        "the controller didn't raise the quality on steps that took no time");
+
+    return 0;
+}
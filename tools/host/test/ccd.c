@@ -0,0 +1,174 @@
+// Continuous collision of fast bullets and rays, at speeds that tunnel without it.
+//
+//   ccd [-n bodies]
+//
+// Dynamic bullets fly at a thin wall with a loose crate behind it, and may end a step inside the crate. They
+// have to stop at the wall, and the crate must never move, since nothing reaches it. Then kinematic rays cross a thin
+// kinematic item and a row of loose crates, once as ordinary shapes with a begin callback and once as triggers. Every
+// ray has to report the item, and the rays have to move exactly as their velocities say, since only dynamic bodies
+// are moved back.
+
+#include <math.h>
+#include <unistd.h>
+
+#include <chipmunk/chipmunk.h>
+
+#include "harness.h"
+#include "scenes.h"
+
+#define DT (1 / 30.0)
+#define RAY 1
+#define ITEM 2
+
+static int *hits;
+
+static void count_hit(cpShape *ray) { hits[(uintptr_t)cpShapeGetUserData(ray)]++; }
+
+static cpBool begin(cpArbiter *arb, cpSpace *space, void *unused) {
+    CP_ARBITER_GET_SHAPES(arb, item, ray);
+    count_hit(ray);
+    return cpTrue;
+}
+
+static void enter(cpShape *item, cpShape *ray, cpSpace *space, void *unused) { count_hit(ray); }
+
+static void bullets(int count, cpFloat speed) {
+    uint32_t rng = 7;
+    cpSpace *space = cpSpaceNew();
+    cpSpaceSetIterations(space, 10);
+
+    // A kinematic wall, so its pairs aren't all found before the crate's like a static wall's would be.
+    cpBody *wall = cpSpaceAddBody(space, cpBodyNewKinematic());
+    cpSpaceAddShape(space, cpBoxShapeNew2(wall, cpBBNew(500, -1000, 504, 1000), 0));
+
+    // Every bullet that got past the wall in one step would end it inside the crate.
+    cpFloat reach = speed * DT;
+    cpBody *crate = cpSpaceAddBody(space, cpBodyNew(10, INFINITY));
+    cpBodySetPosition(crate, cpv(510 + reach / 2, 0));
+    cpSpaceAddShape(space, cpBoxShapeNew(crate, reach, 2000, 0));
+
+    cpBody **bodies = malloc(count * sizeof(cpBody *));
+    for (int i = 0; i < count; i++) {
+        cpBody *body = bodies[i] = cpSpaceAddBody(space, cpBodyNew(1, cpMomentForBox(1, 10, 10)));
+        cpBodySetPosition(body, cpv(test_randf(&rng, 0, 300), (i - count / 2) * 4.0));
+        cpBodySetVelocity(body, cpv(speed, test_randf(&rng, -20, 20)));
+        cpBodySetAngularVelocity(body, test_randf(&rng, -3, 3));
+        cpBodySetContinuousCollision(body, cpTrue);
+
+        cpShape *shape = cpSpaceAddShape(space, cpBoxShapeNew(body, 10, 10, 0));
+        cpShapeSetFilter(shape, cpShapeFilterNew(1, CP_ALL_CATEGORIES, CP_ALL_CATEGORIES));
+    }
+
+    int steps = (int)(1000 / reach) + 10;
+    for (int step = 0; step < steps; step++) {
+        cpSpaceStep(space, DT);
+
+        cpFloat crate_speed = cpvlength(cpBodyGetVelocity(crate));
+        CHECK(crate_speed == 0, "speed %.0f, step %d: the crate was pushed to %g", speed, step, crate_speed);
+    }
+
+    int through = 0;
+    for (int i = 0; i < count; i++) {
+        through += cpBodyGetPosition(bodies[i]).x > 504;
+    }
+    CHECK(through == 0, "speed %.0f: %d of %d bullets got through the wall", speed, through, count);
+    printf("speed %5.0f, %3.0f px a step: %d bullets stopped at the wall, the crate stayed put\n", speed, reach, count);
+
+    scene_free_space(space);
+    free(bodies);
+}
+
+static void rays(int count, cpFloat speed, bool triggers) {
+    uint32_t rng = 5;
+    cpSpace *space = cpSpaceNew();
+    hits = calloc(count, sizeof(int));
+
+    cpBody *item = cpSpaceAddBody(space, cpBodyNewKinematic());
+    cpBodySetPosition(item, cpv(500, 300));
+    cpShape *item_shape = cpSpaceAddShape(space, cpBoxShapeNew(item, 8, 200, 0));
+    cpShapeSetCollisionType(item_shape, ITEM);
+
+    for (int i = 0; i < 10; i++) {
+        cpBody *crate = cpSpaceAddBody(space, cpBodyNew(1, cpMomentForBox(1, 30, 30)));
+        cpBodySetPosition(crate, cpv(800, 210 + 20 * i));
+        cpSpaceAddShape(space, cpBoxShapeNew(crate, 30, 30, 0));
+    }
+
+    cpBody **bodies = malloc(count * sizeof(cpBody *));
+    cpVect *expected = malloc(count * sizeof(cpVect));
+    for (int i = 0; i < count; i++) {
+        cpFloat angle = test_randf(&rng, -0.3, 0.3);
+        cpBody *body = bodies[i] = cpSpaceAddBody(space, cpBodyNewKinematic());
+        cpBodySetPosition(body, cpv(test_randf(&rng, 0, 200), 300 + test_randf(&rng, -60, 60) - tan(angle) * 300));
+        cpBodySetAngle(body, test_randf(&rng, 0, 3));
+        cpBodySetAngularVelocity(body, test_randf(&rng, -2, 2));
+        cpBodySetVelocity(body, cpvmult(cpvforangle(angle), speed));
+        cpBodySetContinuousCollision(body, cpTrue);
+        expected[i] = cpBodyGetPosition(body);
+
+        cpShape *shape = cpSpaceAddShape(space, cpBoxShapeNew(body, 50, 20, 0));
+        cpShapeSetCollisionType(shape, RAY);
+        cpShapeSetUserData(shape, (void *)(uintptr_t)i);
+        cpShapeSetTrigger(shape, triggers);
+    }
+
+    cpCollisionHandler *handler = cpSpaceAddCollisionHandler(space, ITEM, RAY);
+    if (triggers) {
+        handler->triggerEnterFunc = enter;
+    } else {
+        handler->beginFunc = begin;
+    }
+
+    int steps = (int)(1200 / (speed * DT)) + 2;
+    for (int step = 0; step < steps; step++) {
+        cpSpaceStep(space, DT);
+
+        for (int i = 0; i < count; i++) {
+            expected[i] = cpvadd(expected[i], cpvmult(cpBodyGetVelocity(bodies[i]), DT));
+            cpFloat error = cpvdist(cpBodyGetPosition(bodies[i]), expected[i]);
+            CHECK(error < 1e-6, "speed %.0f, step %d: ray %d is %g from where it should be", speed, step, i, error);
+        }
+    }
+
+    int missed = 0, repeated = 0;
+    for (int i = 0; i < count; i++) {
+        missed += hits[i] == 0;
+        repeated += hits[i] > 1;
+    }
+    CHECK(missed == 0 && repeated == 0, "speed %.0f%s: %d rays missed the item, %d hit it more than once", speed,
+        triggers ? " as triggers" : "", missed, repeated);
+    printf("speed %5.0f, %3.0f px a step: %d rays hit the item once%s, none were moved back\n", speed, speed * DT, count,
+        triggers ? " as triggers" : "");
+
+    scene_free_space(space);
+    free(bodies);
+    free(expected);
+    free(hits);
+}
+
+int main(int argc, char **argv) {
+    int count = 400;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:")) != -1) {
+        switch (opt) {
+            case 'n':
+                count = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-n bodies]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    static const cpFloat speeds[] = {300, 1000, 3000};
+    for (int i = 0; i < 3; i++) {
+        bullets(count, speeds[i]);
+    }
+    for (int i = 0; i < 3; i++) {
+        rays(count, speeds[i], false);
+        rays(count, speeds[i], true);
+    }
+
+    return 0;
+}
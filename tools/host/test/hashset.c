@@ -0,0 +1,173 @@
+// cpHashSet against a flat table of which keys are in the set.
+//
+//   hashset_test [-n operations]
+//
+// Random inserts, removals and finds on keys 0..4999, with every so often a filter that drops some of the keys and an
+// each pass whose callback removes elements from the set it is iterating. After each pass, every element in the set
+// has to be visited exactly once. The hashes range from the keys themselves to a handful of values shared by
+// thousands of keys, which makes long clusters. Every case runs with and without an arena.
+
+#include <string.h>
+#include <unistd.h>
+
+#include "chipmunk/chipmunk_private.h"
+
+#include "harness.h"
+
+#define KEYS 5000
+
+typedef enum {
+    KEY_HASH,
+    SPREAD_HASH,
+    SHARED_HASH,
+    PAIR_HASH,
+} HashKind;
+
+static const char *hash_names[] = {"key", "key * 16", "key % 7", "shape pair"};
+
+typedef struct {
+    int key;
+    bool in_set;
+} Element;
+
+static Element elements[KEYS];
+static int visits[KEYS];
+
+static HashKind hash_kind;
+static cpHashSet *set;
+static int filter_mod;
+
+static cpHashValue hash(int key) {
+    switch (hash_kind) {
+        case KEY_HASH:
+            return (cpHashValue)key;
+        case SPREAD_HASH:
+            return (cpHashValue)key * 16;
+        case SHARED_HASH:
+            return (cpHashValue)(key % 7);
+        default:
+            return CP_HASH_PAIR(key * 16, key * 32 + 8);
+    }
+}
+
+static cpBool element_eql(const int *key, const Element *element) { return *key == element->key; }
+
+static void *element_trans(const int *key, void *unused) {
+    elements[*key].in_set = true;
+    return &elements[*key];
+}
+
+static cpBool keep_element(Element *element, void *unused) {
+    if (element->key % filter_mod == 0) {
+        element->in_set = false;
+        return cpFalse;
+    }
+
+    return cpTrue;
+}
+
+static void remove_element(Element *element, void *unused) {
+    if (element->key % 3 == 0) {
+        int key = element->key;
+        CHECK(cpHashSetRemove(set, hash(key), &key) == element, "key %d: removal inside each failed", key);
+        element->in_set = false;
+    }
+}
+
+static void visit_element(Element *element, void *unused) { visits[element->key]++; }
+
+static void check_contents(const char *name) {
+    memset(visits, 0, sizeof(visits));
+    cpHashSetEach(set, (cpHashSetIteratorFunc)visit_element, NULL);
+
+    int count = 0;
+    for (int key = 0; key < KEYS; key++) {
+        CHECK(visits[key] == elements[key].in_set, "%s: key %d visited %d times", name, key, visits[key]);
+        count += elements[key].in_set;
+    }
+
+    CHECK(count == cpHashSetCount(set), "%s: %d elements counted, %d in the set", name, cpHashSetCount(set), count);
+}
+
+static int run(HashKind kind, bool use_arena, int operations) {
+    char name[64];
+    snprintf(name, sizeof(name), "%s hashes%s", hash_names[kind], use_arena ? " in an arena" : "");
+
+    uint32_t rng = 1;
+    hash_kind = kind;
+    for (int key = 0; key < KEYS; key++) {
+        elements[key] = (Element){key, false};
+    }
+
+    set = cpHashSetNew(0, (cpHashSetEqlFunc)element_eql);
+
+    cpArena arena;
+    if (use_arena) {
+        cpArenaInit(&arena, &cpSpaceAllocatorDefault, 4096);
+        cpHashSetSetArena(set, &arena);
+    }
+
+    for (int i = 0; i < operations; i++) {
+        int key = test_rand(&rng) % KEYS, op = test_rand(&rng) % 10;
+        Element *element = &elements[key];
+
+        if (op < 5) {
+            const void *found = cpHashSetInsert(set, hash(key), &key, (cpHashSetTransFunc)element_trans, NULL);
+            CHECK(found == element && element->in_set, "%s: inserting key %d failed", name, key);
+        } else if (op < 8) {
+            const void *removed = cpHashSetRemove(set, hash(key), &key);
+            CHECK(removed == (element->in_set ? element : NULL), "%s: removing key %d failed", name, key);
+            element->in_set = false;
+        } else {
+            const void *found = cpHashSetFind(set, hash(key), &key);
+            CHECK(found == (element->in_set ? element : NULL), "%s: finding key %d failed", name, key);
+        }
+
+        if (i % 30000 == 29999) {
+            cpHashSetEach(set, (cpHashSetIteratorFunc)remove_element, NULL);
+            check_contents(name);
+        }
+
+        if (i % 20000 == 19999) {
+            filter_mod = 2 + test_rand(&rng) % 5;
+            cpHashSetFilter(set, (cpHashSetFilterFunc)keep_element, NULL);
+            check_contents(name);
+        }
+
+        if (i % 10000 == 0) {
+            check_contents(name);
+        }
+    }
+
+    int count = cpHashSetCount(set);
+    cpHashSetFree(set);
+    if (use_arena) {
+        cpArenaDestroy(&arena);
+    }
+
+    return count;
+}
+
+int main(int argc, char **argv) {
+    int operations = 200000;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:")) != -1) {
+        switch (opt) {
+            case 'n':
+                operations = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-n operations]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    for (HashKind kind = KEY_HASH; kind <= PAIR_HASH; kind++) {
+        int count = run(kind, false, operations);
+        CHECK(run(kind, true, operations) == count, "%s hashes: the arena changed the outcome", hash_names[kind]);
+        printf("%-10s hashes: %d operations matched, %d elements at the end\n", hash_names[kind], operations, count);
+    }
+
+    return 0;
+}
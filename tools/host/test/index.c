@@ -0,0 +1,240 @@
+// cpGrid against cpBBTree under random inserts, removals and moves.
+//
+//   index [-r rounds]
+//
+// Boxes of mixed sizes, some of them sticking out of the grid bounds, are inserted, removed and moved at random. After
+// every round, both indexes find the overlapping pairs, answer box and segment queries, and are asked which objects
+// they contain. The tree keeps the fattened boxes of objects that moved a little, so its answers are filtered by the
+// objects' real boxes before they're compared with the grid's. The grid must not report a pair or an object twice.
+
+#include <string.h>
+#include <unistd.h>
+
+#include <chipmunk/chipmunk.h>
+
+#include "harness.h"
+
+#define OBJECTS 300
+#define BOUNDS_SIZE 640
+#define CELL_SIZE 50
+#define QUERIES 20
+
+typedef struct {
+    cpBB bb;
+    int id;
+    bool in_index;
+} Object;
+
+static Object objects[OBJECTS];
+static uint32_t rng = 1;
+
+static cpBB object_bb(Object *object) { return object->bb; }
+
+static cpBB random_bb(void) {
+    // Mostly ray sized, some up to a few cells, and a few reaching outside of the bounds.
+    cpFloat size = test_rand(&rng) % 10 ? test_randf(&rng, 5, 60) : test_randf(&rng, 60, 200);
+    cpVect p = cpv(test_randf(&rng, -100, BOUNDS_SIZE + 100), test_randf(&rng, -100, BOUNDS_SIZE + 100));
+
+    return cpBBNewForExtents(p, size / 2, test_randf(&rng, 0.2, 1) * size / 2);
+}
+
+// Every object or pair of objects an index reported, by id.
+typedef struct {
+    bool *seen;
+    int count;
+    // Set when something was reported twice.
+    bool repeated;
+} Found;
+
+static void found_clear(Found *found, int size) {
+    memset(found->seen, 0, size * sizeof(bool));
+    found->count = 0;
+    found->repeated = false;
+}
+
+static void found_add(Found *found, int key) {
+    found->repeated |= found->seen[key];
+    found->count += !found->seen[key];
+    found->seen[key] = true;
+}
+
+static cpCollisionID add_pair(Object *a, Object *b, cpCollisionID id, Found *found) {
+    if (cpBBIntersects(a->bb, b->bb)) {
+        int lo = a->id < b->id ? a->id : b->id, hi = a->id < b->id ? b->id : a->id;
+        found_add(found, lo * OBJECTS + hi);
+    }
+
+    return id;
+}
+
+typedef struct {
+    cpBB bb;
+    Found *found;
+} BoxQuery;
+
+static cpCollisionID add_box_hit(void *unused, Object *object, cpCollisionID id, BoxQuery *query) {
+    if (cpBBIntersects(query->bb, object->bb)) {
+        found_add(query->found, object->id);
+    }
+
+    return id;
+}
+
+typedef struct {
+    cpVect a, b;
+    Found *found;
+} SegmentQuery;
+
+static cpFloat add_segment_hit(void *unused, Object *object, SegmentQuery *query) {
+    if (cpBBSegmentQuery(object->bb, query->a, query->b) < 1) {
+        found_add(query->found, object->id);
+    }
+
+    // Don't shorten the segment, so every object along it is reported.
+    return 1;
+}
+
+static void count_each(Object *object, int *count) { (*count)++; }
+
+static void compare(cpSpatialIndex *grid, cpSpatialIndex *tree, Found *g, Found *t, int round) {
+    found_clear(g, OBJECTS * OBJECTS);
+    found_clear(t, OBJECTS * OBJECTS);
+    cpSpatialIndexReindexQuery(grid, (cpSpatialIndexQueryFunc)add_pair, g);
+    cpSpatialIndexReindexQuery(tree, (cpSpatialIndexQueryFunc)add_pair, t);
+
+    CHECK(!g->repeated, "round %d: the grid reported a pair twice", round);
+    CHECK(g->count == t->count && !memcmp(g->seen, t->seen, OBJECTS * OBJECTS * sizeof(bool)),
+        "round %d: the grid found %d pairs, the tree %d", round, g->count, t->count);
+
+    for (int i = 0; i < QUERIES; i++) {
+        cpBB bb = random_bb();
+        BoxQuery gq = {bb, g}, tq = {bb, t};
+
+        found_clear(g, OBJECTS);
+        found_clear(t, OBJECTS);
+        cpSpatialIndexQuery(grid, NULL, bb, (cpSpatialIndexQueryFunc)add_box_hit, &gq);
+        cpSpatialIndexQuery(tree, NULL, bb, (cpSpatialIndexQueryFunc)add_box_hit, &tq);
+
+        CHECK(!g->repeated, "round %d: the grid reported an object twice in a box query", round);
+        CHECK(g->count == t->count && !memcmp(g->seen, t->seen, OBJECTS * sizeof(bool)),
+            "round %d: a box query found %d objects in the grid, %d in the tree", round, g->count, t->count);
+    }
+
+    for (int i = 0; i < QUERIES; i++) {
+        // Segments start inside or outside of the bounds, and some are axis aligned.
+        cpVect a = cpv(test_randf(&rng, -200, BOUNDS_SIZE + 200), test_randf(&rng, -200, BOUNDS_SIZE + 200));
+        cpVect b = cpv(test_randf(&rng, -200, BOUNDS_SIZE + 200), test_randf(&rng, -200, BOUNDS_SIZE + 200));
+        if (i % 5 == 0) {
+            b.x = a.x;
+        } else if (i % 5 == 1) {
+            b.y = a.y;
+        }
+
+        SegmentQuery gq = {a, b, g}, tq = {a, b, t};
+
+        found_clear(g, OBJECTS);
+        found_clear(t, OBJECTS);
+        cpSpatialIndexSegmentQuery(grid, NULL, a, b, 1, (cpSpatialIndexSegmentQueryFunc)add_segment_hit, &gq);
+        cpSpatialIndexSegmentQuery(tree, NULL, a, b, 1, (cpSpatialIndexSegmentQueryFunc)add_segment_hit, &tq);
+
+        CHECK(!g->repeated, "round %d: the grid reported an object twice in a segment query", round);
+        CHECK(g->count == t->count && !memcmp(g->seen, t->seen, OBJECTS * sizeof(bool)),
+            "round %d: a segment query hit %d objects in the grid, %d in the tree", round, g->count, t->count);
+    }
+
+    int in_index = 0;
+    for (int i = 0; i < OBJECTS; i++) {
+        Object *object = &objects[i];
+        in_index += object->in_index;
+
+        CHECK(cpSpatialIndexContains(grid, object, i) == object->in_index,
+            "round %d: the grid is wrong about containing object %d", round, i);
+    }
+
+    int each = 0;
+    cpSpatialIndexEach(grid, (cpSpatialIndexIteratorFunc)count_each, &each);
+    CHECK(cpSpatialIndexCount(grid) == in_index && each == in_index,
+        "round %d: the grid counts %d objects and iterates over %d, %d were inserted", round,
+        cpSpatialIndexCount(grid), each, in_index);
+}
+
+int main(int argc, char **argv) {
+    int rounds = 2000;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "r:")) != -1) {
+        switch (opt) {
+            case 'r':
+                rounds = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-r rounds]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    cpSpatialIndex *grid = cpGridNew(cpBBNew(0, 0, BOUNDS_SIZE, BOUNDS_SIZE), CELL_SIZE,
+        (cpSpatialIndexBBFunc)object_bb, NULL);
+    cpSpatialIndex *tree = cpBBTreeNew((cpSpatialIndexBBFunc)object_bb, NULL);
+
+    for (int i = 0; i < OBJECTS; i++) {
+        objects[i].id = i;
+    }
+
+    Found g = {calloc(OBJECTS * OBJECTS, sizeof(bool))}, t = {calloc(OBJECTS * OBJECTS, sizeof(bool))};
+    long inserts = 0, removes = 0, moves = 0;
+
+    for (int round = 0; round < rounds; round++) {
+        for (int n = 0; n < 30; n++) {
+            int i = test_rand(&rng) % OBJECTS;
+            Object *object = &objects[i];
+
+            if (!object->in_index) {
+                object->bb = random_bb();
+                cpSpatialIndexInsert(grid, object, i);
+                cpSpatialIndexInsert(tree, object, i);
+                object->in_index = true;
+                inserts++;
+            } else if (test_rand(&rng) % 3 == 0) {
+                cpSpatialIndexRemove(grid, object, i);
+                cpSpatialIndexRemove(tree, object, i);
+                object->in_index = false;
+                removes++;
+            } else {
+                // Small moves like a step's, and the occasional jump across the grid.
+                cpVect d = test_rand(&rng) % 8 ? cpv(test_randf(&rng, -5, 5), test_randf(&rng, -5, 5))
+                                               : cpv(test_randf(&rng, -300, 300), test_randf(&rng, -300, 300));
+                object->bb = cpBBOffset(object->bb, d);
+                moves++;
+
+                // The space reindexes single objects when a shape is moved by hand.
+                if (test_rand(&rng) % 2) {
+                    cpSpatialIndexReindexObject(grid, object, i);
+                    cpSpatialIndexReindexObject(tree, object, i);
+                }
+            }
+        }
+
+        // Clear both now and then, which the space does when it restores a snapshot, to check the grid's handles go
+        // back to its pool. There's no public wrapper for the clear function.
+        if (round % 500 == 499) {
+            grid->klass->clear(grid);
+            tree->klass->clear(tree);
+            for (int i = 0; i < OBJECTS; i++) {
+                objects[i].in_index = false;
+            }
+        }
+
+        compare(grid, tree, &g, &t, round);
+    }
+
+    printf("grid matched the tree over %d rounds: %ld inserts, %ld removes, %ld moves\n", rounds, inserts, removes,
+        moves);
+
+    cpSpatialIndexFree(grid);
+    cpSpatialIndexFree(tree);
+    free(g.seen);
+    free(t.seen);
+
+    return 0;
+}
@@ -0,0 +1,183 @@
+// The packed contact solver against the space's own arbiter order.
+//
+//   packed_off -o samples
+//   packed_on -i samples
+//
+// A pyramid of boxes settles on the floor and a row of boxes slides down a ramp with friction, for many steps. Every
+// SAMPLE_STEPS steps each body's position is taken, and the impulse its contacts applied in the last step, summed with
+// cpArbiterTotalImpulse() over its arbiters. The build with CP_USE_PACKED_SOLVER=0 writes the samples to a file, and
+// the packed build has to stay within the scene's limits of them. The packed solver solves in a different order, so the two
+// can't match exactly, but the impulses only stay close if it copies every accumulated impulse back to the arbiters for
+// warm starting the next step and for the callbacks.
+
+#include <math.h>
+#include <unistd.h>
+
+#include "harness.h"
+#include "scenes.h"
+
+#define STEPS 1000
+#define SAMPLE_STEPS 25
+#define SAMPLES (STEPS / SAMPLE_STEPS)
+
+#define PYRAMID_ROWS 10
+#define SLIDE_BOXES 8
+#define MAX_BODIES (PYRAMID_ROWS * (PYRAMID_ROWS + 1) / 2)
+
+typedef struct {
+    double x, y, jx, jy;
+} Sample;
+
+typedef struct {
+    const char *name;
+    // Largest distance in pixels, and largest impulse difference as a fraction of a box's weight over a step.
+    double position_limit, impulse_limit;
+    cpSpace *space;
+    cpBody *bodies[MAX_BODIES];
+    int count;
+} Scene;
+
+static cpBody *add_box(Scene *scene, cpVect position, cpFloat friction) {
+    cpBody *body = cpSpaceAddBody(scene->space, cpBodyNew(1, cpMomentForBox(1, 20, 20)));
+    cpBodySetPosition(body, position);
+    cpShapeSetFriction(cpSpaceAddShape(scene->space, cpBoxShapeNew(body, 20, 20, 0)), friction);
+
+    return scene->bodies[scene->count++] = body;
+}
+
+static void pyramid_init(Scene *scene) {
+    // The pyramid's arbiters are solved in a different order, which moves it by about 0.6 px and its impulses by 0.2
+    // weights. Leaving the friction impulses out of the write-back takes the impulses to 0.9 weights.
+    *scene = (Scene){.name = "pyramid", .position_limit = 1.5, .impulse_limit = 0.5, .space = cpSpaceNew()};
+    cpSpaceSetGravity(scene->space, cpv(0, 100));
+    cpSpaceSetIterations(scene->space, 10);
+
+    cpShape *floor = cpSegmentShapeNew(cpSpaceGetStaticBody(scene->space), cpv(0, 470), cpv(640, 470), 0);
+    cpShapeSetFriction(cpSpaceAddShape(scene->space, floor), 0.8);
+
+    for (int row = 0; row < PYRAMID_ROWS; row++) {
+        for (int i = 0; i < PYRAMID_ROWS - row; i++) {
+            add_box(scene, cpv(320 + (i - (PYRAMID_ROWS - row - 1) / 2.0) * 21, 460 - row * 20.5), 0.8);
+        }
+    }
+}
+
+static void slide_init(Scene *scene) {
+    // The sliding boxes never touch, so each arbiter is solved on its own and the packed solver has to give the same
+    // results as the unpacked one, give or take rounding.
+    *scene = (Scene){.name = "slide", .position_limit = 1e-6, .impulse_limit = 1e-6, .space = cpSpaceNew()};
+    cpSpaceSetGravity(scene->space, cpv(0, 100));
+    cpSpaceSetIterations(scene->space, 10);
+
+    // A ramp long enough that none of the boxes reach the end of it. Friction is the product of the two shapes', so each
+    // box slides, and the ones further down have less of it and pull away from the ones behind.
+    cpShape *ramp = cpSegmentShapeNew(cpSpaceGetStaticBody(scene->space), cpv(0, 300), cpv(12800, 3700), 0);
+    cpShapeSetFriction(cpSpaceAddShape(scene->space, ramp), 0.4);
+
+    for (int i = 0; i < SLIDE_BOXES; i++) {
+        cpFloat x = 20 + i * 30;
+        cpBody *body = add_box(scene, cpv(x, 300 + x * 170 / 640 - 11), 0.55 - 0.05 * i);
+        cpBodySetAngle(body, atan2(170, 640));
+    }
+}
+
+static void add_impulse(cpBody *body, cpArbiter *arb, cpVect *impulse) {
+    *impulse = cpvadd(*impulse, cpArbiterTotalImpulse(arb));
+}
+
+static void run(Scene *scene, Sample *samples) {
+    for (int step = 1; step <= STEPS; step++) {
+        cpSpaceStep(scene->space, SCENE_DT);
+        if (step % SAMPLE_STEPS != 0) {
+            continue;
+        }
+
+        for (int i = 0; i < scene->count; i++) {
+            cpBody *body = scene->bodies[i];
+            cpVect p = cpBodyGetPosition(body), impulse = cpvzero;
+            cpBodyEachArbiter(body, (cpBodyArbiterIteratorFunc)add_impulse, &impulse);
+            *samples++ = (Sample){p.x, p.y, impulse.x, impulse.y};
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    const char *input = NULL, *output = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "i:o:")) != -1) {
+        switch (opt) {
+            case 'i':
+                input = optarg;
+                break;
+            case 'o':
+                output = optarg;
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-i samples] [-o samples]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    FILE *in = NULL, *out = NULL;
+    if (input) {
+        in = fopen(input, "rb");
+        CHECK(in, "can't open %s", input);
+    }
+    if (output) {
+        out = fopen(output, "wb");
+        CHECK(out, "can't open %s", output);
+    }
+
+    // The weight of a box over one step, which is about what the floor pushes back with.
+    double weight = 100 * SCENE_DT;
+    void (*inits[])(Scene *) = {pyramid_init, slide_init};
+
+    printf("%s solver, %d steps:\n", CP_USE_PACKED_SOLVER ? "packed" : "unpacked", STEPS);
+
+    for (int s = 0; s < 2; s++) {
+        Scene scene;
+        inits[s](&scene);
+
+        Sample *samples = malloc(SAMPLES * scene.count * sizeof(Sample));
+        run(&scene, samples);
+
+        if (out) {
+            CHECK(fwrite(samples, sizeof(Sample), SAMPLES * scene.count, out) == (size_t)(SAMPLES * scene.count),
+                "can't write %s", output);
+        }
+
+        if (!in) {
+            printf("  %-8s %3d bodies\n", scene.name, scene.count);
+        } else {
+            Sample *expected = malloc(SAMPLES * scene.count * sizeof(Sample));
+            CHECK(fread(expected, sizeof(Sample), SAMPLES * scene.count, in) == (size_t)(SAMPLES * scene.count),
+                "%s is too short", input);
+
+            double position = 0, impulse = 0;
+            for (int i = 0; i < SAMPLES * scene.count; i++) {
+                Sample *a = &samples[i], *b = &expected[i];
+                position = fmax(position, hypot(a->x - b->x, a->y - b->y));
+                impulse = fmax(impulse, hypot(a->jx - b->jx, a->jy - b->jy) / weight);
+            }
+
+            CHECK(position < scene.position_limit && impulse < scene.impulse_limit,
+                "%s: bodies %.3g px and contact impulses %.3g weights from %s, over %g and %g", scene.name, position,
+                impulse, input, scene.position_limit, scene.impulse_limit);
+            printf("  %-8s %3d bodies within %.2g px and %.2g weights of %s\n", scene.name, scene.count, position,
+                impulse, input);
+            free(expected);
+        }
+
+        free(samples);
+        scene_free_space(scene.space);
+    }
+
+    if (in) {
+        fclose(in);
+    }
+    if (out) {
+        fclose(out);
+    }
+    return 0;
+}
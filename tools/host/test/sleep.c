@@ -0,0 +1,217 @@
+// Sleeping bodies mixed with the body type changes the game makes.
+//
+//   sleep [-s steps]
+//
+// Rays hit an item and, from a post-step callback, either turn dynamic or are removed the way postStepRemoveBody()
+// removes them: made kinematic first, then taken out of the space. Piles of boxes that start kinematic and are made
+// dynamic settle and fall asleep. Later, sleeping boxes are removed or retyped to kinematic at random. Build Chipmunk
+// without NDEBUG so its assertions run too.
+//
+// After every step, cpSpaceGetAwakeBodyCount() and cpSpaceGetSleepingBodyCount() are checked against a count of the
+// bodies. The awake count is taken before the post-step callbacks run, so the bodies they retype are accounted for. At
+// the end, the settled pile is timed with sleeping off and on.
+
+#include <unistd.h>
+
+#include "harness.h"
+#include "scenes.h"
+
+#define RAY 1
+#define ITEM 2
+
+#define SLEEP_TIME 0.5
+#define PILE_BOXES 40
+
+static cpSpace *space;
+static cpBody *item;
+static uint32_t rng = 1;
+// Change in the number of awake dynamic bodies made by this step's post-step callbacks.
+static int awake_changed;
+
+static int counts_as_awake(cpBody *body) {
+    return cpBodyGetType(body) == CP_BODY_TYPE_DYNAMIC && !cpBodyIsSleeping(body);
+}
+
+static void make_dynamic(cpSpace *space, void *body, void *data) {
+    awake_changed -= counts_as_awake(body);
+    cpBodySetType(body, CP_BODY_TYPE_DYNAMIC);
+    cpBodySetMass(body, 5);
+    awake_changed += counts_as_awake(body);
+}
+
+static void make_kinematic(cpSpace *space, void *body, void *data) {
+    awake_changed -= counts_as_awake(body);
+    cpBodySetType(body, CP_BODY_TYPE_KINEMATIC);
+    cpBodySetVelocity(body, cpv(0, 300));
+}
+
+static void remove_shape(cpBody *body, cpShape *shape, void *space) {
+    cpSpaceRemoveShape(space, shape);
+    cpShapeFree(shape);
+}
+
+// What postStepRemoveBody() in game.c does.
+static void remove_body(cpSpace *space, void *body, void *data) {
+    awake_changed -= counts_as_awake(body);
+    cpBodyEachShape(body, remove_shape, space);
+    cpBodySetType(body, CP_BODY_TYPE_KINEMATIC);
+    cpSpaceRemoveBody(space, body);
+    cpBodyFree(body);
+}
+
+static cpBool begin_ray_item(cpArbiter *arb, cpSpace *space, void *data) {
+    CP_ARBITER_GET_BODIES(arb, a, ray);
+    cpSpaceAddPostStepCallback(space, test_rand(&rng) % 4 ? make_dynamic : remove_body, ray, NULL);
+
+    return cpTrue;
+}
+
+static void remove_lost(cpBody *body, void *data) {
+    cpVect p = cpBodyGetPosition(body);
+    if (body != item && (p.y > 700 || p.x < -50 || p.x > 700)) {
+        cpSpaceAddPostStepCallback(space, remove_body, body, NULL);
+    }
+}
+
+static void disturb_sleeping(cpBody *body, void *data) {
+    if (body != item && cpBodyIsSleeping(body) && test_rand(&rng) % 50 == 0) {
+        cpSpaceAddPostStepCallback(space, test_rand(&rng) % 2 ? remove_body : make_kinematic, body, NULL);
+    }
+}
+
+typedef struct {
+    int awake, sleeping;
+} Count;
+
+static void count_body(cpBody *body, void *data) {
+    Count *count = data;
+
+    if (cpBodyIsSleeping(body)) {
+        count->sleeping++;
+    } else if (cpBodyGetType(body) == CP_BODY_TYPE_DYNAMIC) {
+        count->awake++;
+    }
+}
+
+static void fire_ray(void) {
+    cpFloat angle = test_randf(&rng, -0.39, 0.39);
+
+    cpBody *ray = cpSpaceAddBody(space, cpBodyNewKinematic());
+    cpBodySetPosition(ray, cpv(400, 180));
+    cpBodySetAngle(ray, angle);
+    cpBodySetVelocity(ray, cpv(80 * cpfcos(angle), 80 * cpfsin(angle + CP_PI)));
+    cpBodySetAngularVelocity(ray, test_rand(&rng) % 2 ? 1 : -1);
+
+    cpShape *shape = cpSpaceAddShape(space, cpBoxShapeNew(ray, 50, 20, 0));
+    cpShapeSetElasticity(shape, 0.1);
+    cpShapeSetCollisionType(shape, RAY);
+    cpShapeSetMass(shape, 5);
+}
+
+// Rows of boxes above the floor, added kinematic and made dynamic like a ray that hit the item.
+static void add_pile(cpSpace *space, cpFloat floor) {
+    for (int i = 0; i < PILE_BOXES; i++) {
+        cpBody *body = cpSpaceAddBody(space, cpBodyNewKinematic());
+        cpBodySetPosition(body, cpv(30 + (i % 10) * 56, floor - 30 - 25 * (i / 10)));
+        cpShapeSetMass(cpSpaceAddShape(space, cpBoxShapeNew(body, 50, 20, 0)), 5);
+
+        make_dynamic(space, body, NULL);
+    }
+}
+
+static void stress(int steps) {
+    space = cpSpaceNew();
+    cpSpaceSetGravity(space, cpv(0, 100));
+    cpSpaceSetSleepTimeThreshold(space, SLEEP_TIME);
+    cpSpaceAddShape(space, cpSegmentShapeNew(cpSpaceGetStaticBody(space), cpv(0, 470), cpv(640, 470), 0));
+
+    item = cpSpaceAddBody(space, cpBodyNewKinematic());
+    cpShapeSetCollisionType(cpSpaceAddShape(space, cpBoxShapeNew(item, 80, 60, 0)), ITEM);
+    cpSpaceAddCollisionHandler(space, ITEM, RAY)->beginFunc = begin_ray_item;
+
+    int most_sleeping = 0;
+
+    for (int step = 0; step < steps; step++) {
+        if (step % 8 == 0 && step < steps * 2 / 5) {
+            fire_ray();
+        }
+
+        if (step % 1000 == 0 && step < steps * 2 / 3) {
+            add_pile(space, 470 - (step / 1000) * 110);
+        }
+
+        cpBodySetPosition(item, cpv(550, 180 + 80 * cpfsin(step * 0.015)));
+        awake_changed = 0;
+        cpSpaceStep(space, SCENE_DT);
+
+        Count count = {0};
+        cpSpaceEachBody(space, count_body, &count);
+        CHECK(cpSpaceGetAwakeBodyCount(space) == count.awake - awake_changed,
+            "step %d: %d bodies were awake before the post-step callbacks, the space says %d", step,
+            count.awake - awake_changed, cpSpaceGetAwakeBodyCount(space));
+        CHECK(cpSpaceGetSleepingBodyCount(space) == count.sleeping,
+            "step %d: %d bodies are sleeping, the space says %d", step, count.sleeping,
+            cpSpaceGetSleepingBodyCount(space));
+
+        if (count.sleeping > most_sleeping) {
+            most_sleeping = count.sleeping;
+        }
+
+        cpSpaceEachBody(space, remove_lost, NULL);
+        if (step > steps * 3 / 4) {
+            cpSpaceEachBody(space, disturb_sleeping, NULL);
+        }
+    }
+
+    CHECK(most_sleeping >= PILE_BOXES, "at most %d bodies fell asleep", most_sleeping);
+    printf("stress: %d steps, up to %d bodies asleep at once, the counts always matched\n", steps, most_sleeping);
+
+    scene_free_space(space);
+}
+
+// Milliseconds per step of a settled pile, once it has had time to fall asleep.
+static double time_pile(cpFloat sleep_time) {
+    cpSpace *space = cpSpaceNew();
+    cpSpaceSetGravity(space, cpv(0, 100));
+    cpSpaceSetSleepTimeThreshold(space, sleep_time);
+    cpSpaceAddShape(space, cpSegmentShapeNew(cpSpaceGetStaticBody(space), cpv(0, 470), cpv(640, 470), 0));
+    add_pile(space, 470);
+
+    for (int i = 0; i < 300; i++) {
+        cpSpaceStep(space, SCENE_DT);
+    }
+
+    uint64_t start = now_ns();
+    for (int i = 0; i < 500; i++) {
+        cpSpaceStep(space, SCENE_DT);
+    }
+    double ms = (now_ns() - start) / 500.0 / 1e6;
+
+    CHECK(sleep_time == INFINITY || cpSpaceGetSleepingBodyCount(space) == PILE_BOXES,
+        "only %d of the %d boxes fell asleep", cpSpaceGetSleepingBodyCount(space), PILE_BOXES);
+
+    scene_free_space(space);
+    return ms;
+}
+
+int main(int argc, char **argv) {
+    int steps = 6000;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "s:")) != -1) {
+        switch (opt) {
+            case 's':
+                steps = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-s steps]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    stress(steps);
+    printf("settled %d box pile: %.4f ms/step with sleeping off, %.4f ms/step with it on\n", PILE_BOXES,
+        time_pile(INFINITY), time_pile(SLEEP_TIME));
+
+    return 0;
+}
@@ -0,0 +1,296 @@
+// Snapshots of a space: taking one changes nothing, and restored spaces step bit-identically.
+//
+//   snapshot_double -o file
+//   snapshot_float -i file
+//
+// A scene with every kind of shape and constraint, a trigger, sleeping bodies and a step budget on a fake clock is
+// stepped, snapshotted and stepped further. It has to step exactly like a copy that was never snapshotted. Then the
+// snapshot is restored into the space and into a copy that was stepped differently, which have to step exactly alike,
+// snapshot to the same bytes, and keep the step budget's state, including a previous step time that is still unset.
+//
+// -o writes a snapshot taken early in the scene to a file, and -i restores one written by a build of the other
+// precision. Its bodies have to be where this build has them, to within the rounding of a float.
+
+#include <math.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "chipmunk/chipmunk_private.h"
+
+#include "harness.h"
+#include "scenes.h"
+
+#define BODIES 40
+#define CHAIN 10
+#define EARLY_STEPS 20
+#define STEPS 200
+
+typedef struct {
+    cpSpace *space;
+    cpBody *bodies[BODIES + CHAIN];
+    int count;
+    long events;
+} Scene;
+
+static uint64_t fake_time;
+
+// Every step takes the same time, well under the target, so the budget keeps raising the quality.
+static uint64_t fake_clock(void) { return fake_time += 1000; }
+
+static void count_event(cpShape *a, cpShape *b, cpSpace *space, Scene *scene) { scene->events++; }
+
+static cpBody *add_body(Scene *scene, cpFloat mass, cpFloat moment, cpVect p) {
+    cpBody *body = cpSpaceAddBody(scene->space, cpBodyNew(mass, moment));
+    cpBodySetPosition(body, p);
+    scene->bodies[scene->count++] = body;
+    return body;
+}
+
+static void scene_init(Scene *scene) {
+    uint32_t rng = 3;
+    *scene = (Scene){cpSpaceNew()};
+    cpSpace *space = scene->space;
+    cpSpaceSetIterations(space, 10);
+    cpSpaceSetGravity(space, cpv(0, -300));
+    cpSpaceSetSleepTimeThreshold(space, 0.5);
+    cpSpaceSetIdleSpeedThreshold(space, 5);
+
+    cpBody *static_body = cpSpaceGetStaticBody(space);
+    cpVect walls[][2] = {{{0, 0}, {600, 0}}, {{0, 0}, {0, 600}}, {{600, 0}, {600, 600}}};
+    for (int i = 0; i < 3; i++) {
+        cpShape *wall = cpSpaceAddShape(space, cpSegmentShapeNew(static_body, walls[i][0], walls[i][1], 2));
+        cpShapeSetFriction(wall, 1);
+    }
+
+    static const cpVect pentagon[] = {{-10, -8}, {10, -9}, {12, 5}, {0, 12}, {-11, 4}};
+    for (int i = 0; i < BODIES; i++) {
+        cpVect p = cpv(test_randf(&rng, 20, 300), test_randf(&rng, 10, 200));
+        cpBody *body;
+        cpShape *shape;
+
+        switch (i % 4) {
+            case 0:
+                body = add_body(scene, 1, cpMomentForCircle(1, 0, 10, cpvzero), p);
+                shape = cpCircleShapeNew(body, 10, cpvzero);
+                break;
+            case 1:
+                body = add_body(scene, 1, cpMomentForBox(1, 20, 20), p);
+                shape = cpBoxShapeNew(body, 20, 20, 0);
+                break;
+            case 2:
+                body = add_body(scene, 1, cpMomentForPoly(1, 5, pentagon, cpvzero, 1), p);
+                shape = cpPolyShapeNew(body, 5, pentagon, cpTransformIdentity, 1);
+                break;
+            default:
+                body = add_body(scene, 1, cpMomentForSegment(1, cpv(-15, 0), cpv(15, 0), 3), p);
+                shape = cpSegmentShapeNew(body, cpv(-15, 0), cpv(15, 0), 3);
+                break;
+        }
+
+        cpBodySetAngle(body, test_randf(&rng, 0, 6));
+        cpBodySetContinuousCollision(body, i % 7 == 0);
+        cpSpaceAddShape(space, shape);
+        cpShapeSetFriction(shape, 0.7);
+        cpShapeSetElasticity(shape, 0.1);
+        cpShapeSetCollisionType(shape, 1);
+    }
+
+    // A chain hanging from the static body, with a different kind of constraint at each link.
+    cpBody *links[CHAIN];
+    for (int i = 0; i < CHAIN; i++) {
+        links[i] = add_body(scene, 1, cpMomentForBox(1, 16, 8), cpv(450, 550 - 25 * i));
+        cpSpaceAddShape(space, cpBoxShapeNew(links[i], 16, 8, 0));
+    }
+
+    cpConstraint *constraints[] = {
+        cpPinJointNew(static_body, links[0], cpv(450, 580), cpvzero),
+        cpSlideJointNew(links[0], links[1], cpvzero, cpvzero, 20, 30),
+        cpPivotJointNew(links[1], links[2], cpv(450, 512)),
+        cpGrooveJointNew(links[2], links[3], cpv(0, -5), cpv(0, -30), cpvzero),
+        cpDampedSpringNew(links[3], links[4], cpvzero, cpvzero, 25, 50, 1),
+        cpDampedRotarySpringNew(links[4], links[5], 0.3, 3000, 10),
+        cpRotaryLimitJointNew(links[5], links[6], -0.5, 0.5),
+        cpRatchetJointNew(links[6], links[7], 0, 0.3),
+        cpGearJointNew(links[7], links[8], 0, 2),
+        cpSimpleMotorNew(links[8], links[9], 1),
+        cpPivotJointNew(links[3], links[4], cpv(450, 462)),
+        cpPivotJointNew(links[4], links[5], cpv(450, 437)),
+    };
+    for (size_t i = 0; i < sizeof(constraints) / sizeof(*constraints); i++) {
+        cpSpaceAddConstraint(space, constraints[i]);
+    }
+
+    cpBody *sweeper = cpSpaceAddBody(space, cpBodyNewKinematic());
+    cpBodySetPosition(sweeper, cpv(200, 100));
+    cpBodySetAngularVelocity(sweeper, 1);
+    cpShape *trigger = cpSpaceAddShape(space, cpBoxShapeNew(sweeper, 150, 20, 0));
+    cpShapeSetTrigger(trigger, cpTrue);
+    cpShapeSetCollisionType(trigger, 2);
+
+    cpCollisionHandler *handler = cpSpaceAddCollisionHandler(space, 2, 1);
+    handler->triggerEnterFunc = (cpTriggerFunc)count_event;
+    handler->triggerExitFunc = (cpTriggerFunc)count_event;
+    handler->userData = scene;
+}
+
+static void scene_set_budget(Scene *scene) {
+    cpStepBudget budget = {fake_clock, 50000, 4, 20, 1, 3};
+    cpSpaceSetStepBudget(scene->space, &budget);
+}
+
+// Steps the scene and hashes the poses and velocities of its bodies, the trigger events and the quality after every step.
+static uint64_t scene_run(Scene *scene, int steps) {
+    uint64_t hash = 14695981039346656037u;
+    scene->events = 0;
+
+    for (int i = 0; i < steps; i++) {
+        cpSpaceStep(scene->space, SCENE_DT);
+
+        for (int j = 0; j < scene->count; j++) {
+            cpBody *body = scene->bodies[j];
+            cpFloat values[] = {body->p.x, body->p.y, body->v.x, body->v.y, body->a, body->w};
+
+            const uint8_t *bytes = (const uint8_t *)values;
+            for (size_t k = 0; k < sizeof(values); k++) {
+                hash = (hash ^ bytes[k]) * 1099511628211u;
+            }
+        }
+
+        int quality = cpSpaceGetIterations(scene->space) * 16 + cpSpaceGetSubsteps(scene->space);
+        hash = (hash ^ (uint64_t)scene->events) * 1099511628211u;
+        hash = (hash ^ (uint64_t)quality) * 1099511628211u;
+    }
+
+    return hash;
+}
+
+static void *take_snapshot(cpSpace *space, size_t *size) {
+    *size = cpSpaceSnapshot(space, NULL, 0);
+    void *buffer = malloc(*size);
+    CHECK(cpSpaceSnapshot(space, buffer, *size) == *size, "the snapshot changed size");
+    return buffer;
+}
+
+static void write_snapshot(const char *path) {
+    Scene scene;
+    scene_init(&scene);
+    scene_run(&scene, EARLY_STEPS);
+
+    size_t size;
+    void *snapshot = take_snapshot(scene.space, &size);
+
+    FILE *file = fopen(path, "wb");
+    CHECK(file && fwrite(snapshot, 1, size, file) == size && fclose(file) == 0, "can't write %s", path);
+
+    free(snapshot);
+    scene_free_space(scene.space);
+}
+
+static void read_snapshot(const char *path) {
+    FILE *file = fopen(path, "rb");
+    CHECK(file, "can't open %s", path);
+
+    static uint8_t snapshot[1 << 20];
+    size_t size = fread(snapshot, 1, sizeof(snapshot), file);
+    fclose(file);
+
+    Scene scene, restored;
+    scene_init(&scene);
+    scene_run(&scene, EARLY_STEPS);
+    scene_init(&restored);
+    CHECK(cpSpaceRestore(restored.space, snapshot, size), "the snapshot in %s didn't restore", path);
+
+    double worst = 0;
+    for (int i = 0; i < scene.count; i++) {
+        worst = fmax(worst, cpvdist(cpBodyGetPosition(scene.bodies[i]), cpBodyGetPosition(restored.bodies[i])));
+    }
+    CHECK(worst < 1e-2, "a body restored from %s is %g away from where this build has it", path, worst);
+
+    scene_run(&restored, STEPS);
+    for (int i = 0; i < restored.count; i++) {
+        cpVect p = cpBodyGetPosition(restored.bodies[i]);
+        CHECK(isfinite(p.x) && isfinite(p.y) && fabs(p.x) < 1e4 && fabs(p.y) < 1e4, "body %d went to %g, %g", i, p.x, p.y);
+    }
+
+    printf("%d byte snapshot from %s restored into a %s build, %.2g from this build's poses, and stepped on\n", (int)size,
+        path, sizeof(cpFloat) == 8 ? "double" : "float", worst);
+
+    scene_free_space(scene.space);
+    scene_free_space(restored.space);
+}
+
+int main(int argc, char **argv) {
+    const char *input = NULL, *output = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "i:o:")) != -1) {
+        switch (opt) {
+            case 'i':
+                input = optarg;
+                break;
+            case 'o':
+                output = optarg;
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-i file] [-o file]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    Scene scene, twin, copy, plain;
+    scene_init(&scene);
+    scene_init(&twin);
+    scene_init(&copy);
+    scene_init(&plain);
+    scene_run(&scene, STEPS);
+    scene_run(&twin, STEPS);
+    scene_run(&copy, STEPS / 3);
+    scene_run(&plain, STEPS / 3);
+
+    // The budget is turned on just before the snapshot, so the previous step time is still unset.
+    scene_set_budget(&scene);
+    scene_set_budget(&twin);
+    scene_set_budget(&copy);
+    scene_run(&copy, 5);
+    CHECK(copy.space->prevStepTime != CP_NO_STEP_TIME, "the copy has no previous step time");
+
+    size_t size;
+    void *snapshot = take_snapshot(scene.space, &size);
+    int sleeping = cpSpaceGetSleepingBodyCount(scene.space);
+
+    uint64_t stepped = scene_run(&scene, STEPS);
+    CHECK(stepped == scene_run(&twin, STEPS), "taking a snapshot changed how the space steps");
+
+    CHECK(cpSpaceRestore(scene.space, snapshot, size), "the snapshot didn't restore");
+    CHECK(cpSpaceRestore(copy.space, snapshot, size), "the snapshot didn't restore into the copy");
+    CHECK(copy.space->prevStepTime == CP_NO_STEP_TIME && copy.space->useStepBudget,
+        "the copy's step budget wasn't restored");
+    CHECK(!cpSpaceRestore(plain.space, snapshot, size), "restored a step budget into a space without a clock");
+
+    size_t resize;
+    void *resnapshot = take_snapshot(copy.space, &resize);
+    CHECK(resize == size && !memcmp(snapshot, resnapshot, size), "a snapshot of the restored copy is different");
+
+    uint64_t restored = scene_run(&scene, STEPS);
+    CHECK(restored == scene_run(&copy, STEPS), "the restored space and copy step differently");
+    CHECK(!cpSpaceRestore(scene.space, snapshot, size - 1), "restored a snapshot that was cut short");
+
+    printf("%s build: %d byte snapshot with %d bodies asleep, stepping %d steps matched with and without it, "
+        "and in two restored spaces\n", sizeof(cpFloat) == 8 ? "double" : "float", (int)size, sleeping, STEPS);
+
+    free(snapshot);
+    free(resnapshot);
+    scene_free_space(scene.space);
+    scene_free_space(twin.space);
+    scene_free_space(copy.space);
+    scene_free_space(plain.space);
+
+    if (output) {
+        write_snapshot(output);
+    }
+    if (input) {
+        read_snapshot(input);
+    }
+
+    return 0;
+}
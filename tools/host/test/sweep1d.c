@@ -0,0 +1,112 @@
+// cpSweep1D's pairs against brute force while the table stays sorted across steps.
+//
+//   sweep1d [-r runs]
+//
+// Each run fills a sweep with a random number of boxes and steps it 40 times. Most steps move every box a little, the
+// way bodies move from step to step, so the insertion sort does the work. Every tenth step the boxes jump far enough to
+// scramble the order, which makes the sweep fall back to qsort(). An object is inserted or removed before each step.
+// Runs alternate between sweeping along x and choosing the axis, and some crowd the boxes onto a narrow strip of x so
+// the other axis wins.
+//
+// The pairs have to be exactly the overlapping ones, each reported once.
+
+#include <string.h>
+#include <unistd.h>
+
+#include <chipmunk/chipmunk.h>
+
+#include "harness.h"
+
+#define MAX_OBJECTS 300
+#define STEPS 40
+
+typedef struct {
+    cpBB bb;
+    int id;
+    bool in_index;
+} Object;
+
+static Object objects[MAX_OBJECTS];
+static bool seen[MAX_OBJECTS][MAX_OBJECTS];
+static int repeated;
+
+static cpBB object_bb(Object *object) { return object->bb; }
+
+static cpCollisionID add_pair(Object *a, Object *b, cpCollisionID id, void *data) {
+    int lo = a->id < b->id ? a->id : b->id, hi = a->id < b->id ? b->id : a->id;
+    repeated += seen[lo][hi];
+    seen[lo][hi] = true;
+
+    return id;
+}
+
+int main(int argc, char **argv) {
+    int runs = 60;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "r:")) != -1) {
+        switch (opt) {
+            case 'r':
+                runs = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-r runs]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    long pairs = 0;
+
+    for (int run = 0; run < runs; run++) {
+        uint32_t rng = run + 1;
+        int count = test_rand(&rng) % MAX_OBJECTS;
+        cpFloat width = run % 3 ? 100 : 800;
+
+        cpSpatialIndex *sweep = cpSweep1DNew((cpSpatialIndexBBFunc)object_bb, NULL);
+        cpSweep1DSetAutoAxis(sweep, run % 2);
+
+        for (int i = 0; i < count; i++) {
+            cpFloat x = test_randf(&rng, 0, width), y = test_randf(&rng, 0, 800);
+            objects[i] = (Object){cpBBNew(x, y, x + test_randf(&rng, 0, 40), y + test_randf(&rng, 0, 40)), i, true};
+            cpSpatialIndexInsert(sweep, &objects[i], i);
+        }
+
+        for (int step = 0; step < STEPS; step++) {
+            for (int i = 0; i < count; i++) {
+                cpFloat dx = step % 10 == 9 ? test_randf(&rng, -400, 400) : test_randf(&rng, -3, 3);
+                objects[i].bb = cpBBOffset(objects[i].bb, cpv(dx, test_randf(&rng, -3, 3)));
+            }
+
+            if (count) {
+                Object *object = &objects[test_rand(&rng) % count];
+                if (object->in_index) {
+                    cpSpatialIndexRemove(sweep, object, object->id);
+                } else {
+                    cpSpatialIndexInsert(sweep, object, object->id);
+                }
+                object->in_index = !object->in_index;
+            }
+
+            memset(seen, 0, sizeof(seen));
+            repeated = 0;
+            cpSpatialIndexReindexQuery(sweep, (cpSpatialIndexQueryFunc)add_pair, NULL);
+            CHECK(!repeated, "run %d step %d: %d pairs were reported twice", run, step, repeated);
+
+            for (int i = 0; i < count; i++) {
+                for (int j = i + 1; j < count; j++) {
+                    bool overlap = objects[i].in_index && objects[j].in_index &&
+                        cpBBIntersects(objects[i].bb, objects[j].bb);
+                    CHECK(overlap == seen[i][j], "run %d step %d: objects %d and %d %s", run, step, i, j,
+                        overlap ? "overlap but weren't reported" : "were reported without overlapping");
+                    pairs += overlap;
+                }
+            }
+        }
+
+        cpSpatialIndexFree(sweep);
+    }
+
+    printf("sweep pairs matched brute force over %d runs of %d steps, %ld pairs\n", runs, STEPS, pairs);
+
+    return 0;
+}
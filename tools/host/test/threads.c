@@ -0,0 +1,144 @@
+// The threaded island solver against the build without threads, byte for byte.
+//
+//   threads_serial -o states
+//   threads_test -i states
+//
+// Steps the islands scene from scenes.h, once with sleeping off and once with it on, and takes every body's position,
+// velocity, angle and angular velocity every SAMPLE_STEPS steps. The build without threads writes its states to a
+// file. The threads build steps the same scenes on 1, 2, 4 and 8 threads, and every state has to have the same bytes as
+// the one in the file. With sleeping on, some bodies have to fall asleep, and the pusher wakes them up again.
+
+#include <string.h>
+#include <unistd.h>
+
+#include "harness.h"
+#include "scenes.h"
+
+#define PILES 12
+#define STEPS 600
+#define SAMPLE_STEPS 50
+#define SAMPLES (STEPS / SAMPLE_STEPS)
+
+typedef struct {
+    cpFloat x, y, vx, vy, a, w;
+} State;
+
+// Returns the number of bodies that were asleep at some sample.
+static int run(int threads, bool sleeping, State *states, int count) {
+    Islands islands;
+    islands_init(&islands, PILES);
+    CHECK(islands.count == count, "the scene has %d bodies, not %d", islands.count, count);
+
+#if CP_USE_THREADS
+    cpSpaceSetThreads(islands.space, threads);
+#endif
+    if (sleeping) {
+        cpSpaceSetSleepTimeThreshold(islands.space, 0.5);
+    }
+
+    bool *slept = calloc(count, sizeof(bool));
+    for (int step = 1; step <= STEPS; step++) {
+        islands_step(&islands);
+        if (step % SAMPLE_STEPS != 0) {
+            continue;
+        }
+
+        for (int i = 0; i < count; i++) {
+            cpBody *body = islands.bodies[i];
+            cpVect p = cpBodyGetPosition(body), v = cpBodyGetVelocity(body);
+            *states++ = (State){p.x, p.y, v.x, v.y, cpBodyGetAngle(body), cpBodyGetAngularVelocity(body)};
+            slept[i] |= cpBodyIsSleeping(body);
+        }
+    }
+
+    int slept_count = 0;
+    for (int i = 0; i < count; i++) {
+        slept_count += slept[i];
+    }
+
+    free(slept);
+    islands_destroy(&islands);
+    return slept_count;
+}
+
+int main(int argc, char **argv) {
+    const char *input = NULL, *output = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "i:o:")) != -1) {
+        switch (opt) {
+            case 'i':
+                input = optarg;
+                break;
+            case 'o':
+                output = optarg;
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-i states] [-o states]\n", argv[0]);
+                return 2;
+        }
+    }
+
+#if CP_USE_THREADS
+    static const int thread_counts[] = {1, 2, 4, 8};
+#else
+    static const int thread_counts[] = {1};
+#endif
+
+    Islands counted;
+    islands_init(&counted, PILES);
+    int count = counted.count;
+    islands_destroy(&counted);
+
+    size_t size = (size_t)SAMPLES * count * sizeof(State);
+    State *expected = malloc(size), *states = malloc(size);
+
+    FILE *in = NULL, *out = NULL;
+    if (input) {
+        in = fopen(input, "rb");
+        CHECK(in, "can't open %s", input);
+    }
+    if (output) {
+        out = fopen(output, "wb");
+        CHECK(out, "can't open %s", output);
+    }
+
+    for (int sleeping = 0; sleeping < 2; sleeping++) {
+        if (in) {
+            CHECK(fread(expected, size, 1, in) == 1, "%s is too short", input);
+        }
+
+        for (size_t t = 0; t < sizeof(thread_counts) / sizeof(thread_counts[0]); t++) {
+            int threads = thread_counts[t];
+            int slept = run(threads, sleeping, states, count);
+            CHECK(!sleeping || slept > 0, "%d threads: no body fell asleep", threads);
+
+            if (in) {
+                for (int s = 0; s < SAMPLES; s++) {
+                    for (int i = 0; i < count; i++) {
+                        CHECK(memcmp(&states[s * count + i], &expected[s * count + i], sizeof(State)) == 0,
+                            "%d threads, sleeping %s: body %d differs from %s after %d steps", threads,
+                            sleeping ? "on" : "off", i, input, (s + 1) * SAMPLE_STEPS);
+                    }
+                }
+            }
+            if (out && t == 0) {
+                CHECK(fwrite(states, size, 1, out) == 1, "can't write %s", output);
+            }
+
+            printf("%d thread%s, sleeping %s: %d bodies, %d steps%s, %d bodies slept\n", threads,
+                threads == 1 ? "" : "s", sleeping ? "on" : "off", count, STEPS,
+                in ? " matched the build without threads" : "", slept);
+        }
+    }
+
+    if (in) {
+        fclose(in);
+    }
+    if (out) {
+        fclose(out);
+    }
+    free(expected);
+    free(states);
+    return 0;
+}
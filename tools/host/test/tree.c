@@ -0,0 +1,187 @@
+// The bounding box tree against brute force, with tree rotations off, bounded and unbounded.
+//
+//   tree [-n rounds]
+//
+// A static tree and a dynamic tree that uses it as its static index, like a space's. Every round inserts, removes
+// and moves random boxes, and now and then rebuilds a tree with cpBBTreeOptimize(). Then the reindex query has to
+// report every overlapping pair that isn't two static boxes, each exactly once, and box and segment queries have to
+// find every box they touch. The rebalance budget is set on both trees, so rotations happen in both.
+
+#include <limits.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <chipmunk/chipmunk.h>
+
+#include "harness.h"
+
+#define OBJECTS 1500
+#define STATIC_OBJECTS (OBJECTS / 4)
+
+typedef struct {
+    cpBB bb;
+    int id;
+    bool in_tree, is_static;
+} Object;
+
+static Object objects[OBJECTS];
+static unsigned char pair_counts[OBJECTS * OBJECTS];
+static int hits[OBJECTS];
+static uint32_t rng;
+
+static cpBB object_bb(Object *object) { return object->bb; }
+
+static cpBB random_bb(void) {
+    cpFloat x = test_randf(&rng, 0, 1000), y = test_randf(&rng, 0, 1000);
+    return cpBBNew(x, y, x + test_randf(&rng, 1, 30), y + test_randf(&rng, 1, 30));
+}
+
+static cpCollisionID count_pair(Object *a, Object *b, cpCollisionID id, void *unused) {
+    int i = a->id < b->id ? a->id : b->id, j = a->id < b->id ? b->id : a->id;
+    pair_counts[i * OBJECTS + j]++;
+    return id;
+}
+
+static cpCollisionID count_hit(Object *query, Object *object, cpCollisionID id, void *unused) {
+    hits[object->id]++;
+    return id;
+}
+
+static cpFloat count_segment_hit(Object *query, Object *object, void *unused) {
+    hits[object->id]++;
+    return 1;
+}
+
+static void check_pairs(cpSpatialIndex *dynamic, int budget, int round) {
+    memset(pair_counts, 0, sizeof(pair_counts));
+    cpSpatialIndexReindexQuery(dynamic, (cpSpatialIndexQueryFunc)count_pair, NULL);
+
+    for (int i = 0; i < OBJECTS; i++) {
+        for (int j = i + 1; j < OBJECTS; j++) {
+            Object *a = &objects[i], *b = &objects[j];
+            bool expected = a->in_tree && b->in_tree && !(a->is_static && b->is_static) && cpBBIntersects(a->bb, b->bb);
+            int count = pair_counts[i * OBJECTS + j];
+
+            CHECK(count == expected, "budget %d, round %d: pair %d-%d reported %d times", budget, round, i, j, count);
+        }
+    }
+}
+
+static void check_queries(cpSpatialIndex *dynamic, int budget, int round) {
+    for (int q = 0; q < 20; q++) {
+        cpBB bb = random_bb();
+        bb.r += 50;
+        bb.t += 50;
+
+        memset(hits, 0, sizeof(hits));
+        cpSpatialIndexQuery(dynamic, NULL, bb, (cpSpatialIndexQueryFunc)count_hit, NULL);
+        for (int i = 0; i < OBJECTS; i++) {
+            bool expected = objects[i].in_tree && !objects[i].is_static && cpBBIntersects(objects[i].bb, bb);
+            CHECK(!expected || hits[i], "budget %d, round %d: box query missed object %d", budget, round, i);
+        }
+
+        cpVect a = cpv(test_randf(&rng, 0, 1000), test_randf(&rng, 0, 1000));
+        cpVect b = cpv(test_randf(&rng, 0, 1000), test_randf(&rng, 0, 1000));
+
+        memset(hits, 0, sizeof(hits));
+        cpSpatialIndexSegmentQuery(dynamic, NULL, a, b, 1, (cpSpatialIndexSegmentQueryFunc)count_segment_hit, NULL);
+        for (int i = 0; i < OBJECTS; i++) {
+            bool expected = objects[i].in_tree && !objects[i].is_static && cpBBIntersectsSegment(objects[i].bb, a, b);
+            CHECK(!expected || hits[i], "budget %d, round %d: segment query missed object %d", budget, round, i);
+        }
+    }
+}
+
+static cpBBTreeQuality run(int budget, int rounds) {
+    rng = 12345;
+
+    cpSpatialIndex *statics = cpBBTreeNew((cpSpatialIndexBBFunc)object_bb, NULL);
+    cpSpatialIndex *dynamic = cpBBTreeNew((cpSpatialIndexBBFunc)object_bb, statics);
+    cpBBTreeSetRebalanceBudget(statics, budget);
+    cpBBTreeSetRebalanceBudget(dynamic, budget);
+
+    for (int i = 0; i < OBJECTS; i++) {
+        objects[i] = (Object){.id = i, .is_static = i < STATIC_OBJECTS};
+    }
+
+    for (int round = 0; round < rounds; round++) {
+        for (int k = 0; k < OBJECTS / 5; k++) {
+            Object *object = &objects[test_rand(&rng) % OBJECTS];
+            cpSpatialIndex *index = object->is_static ? statics : dynamic;
+            int op = test_rand(&rng) % 4;
+
+            if (!object->in_tree) {
+                object->bb = random_bb();
+                cpSpatialIndexInsert(index, object, object->id);
+                object->in_tree = true;
+            } else if (op == 0) {
+                cpSpatialIndexRemove(index, object, object->id);
+                object->in_tree = false;
+            } else {
+                // Dynamic boxes are picked up by the reindex query.
+                object->bb = cpBBOffset(object->bb, cpv(test_randf(&rng, -20, 20), test_randf(&rng, -20, 20)));
+                if (object->is_static && op != 1) {
+                    cpSpatialIndexReindexObject(statics, object, object->id);
+                }
+            }
+        }
+
+        if (round % 7 == 0) {
+            cpBBTreeOptimize(dynamic);
+        }
+        if (round % 11 == 0) {
+            cpBBTreeOptimize(statics);
+        }
+
+        // Static boxes that moved without being reindexed.
+        for (int i = 0; i < STATIC_OBJECTS; i++) {
+            if (objects[i].in_tree) {
+                cpSpatialIndexReindexObject(statics, &objects[i], i);
+            }
+        }
+
+        check_pairs(dynamic, budget, round);
+        check_queries(dynamic, budget, round);
+
+        int static_count = 0, dynamic_count = 0;
+        for (int i = 0; i < OBJECTS; i++) {
+            static_count += objects[i].in_tree && objects[i].is_static;
+            dynamic_count += objects[i].in_tree && !objects[i].is_static;
+        }
+        CHECK(cpSpatialIndexCount(statics) == static_count && cpSpatialIndexCount(dynamic) == dynamic_count,
+            "budget %d, round %d: the trees hold %d and %d objects, not %d and %d", budget, round,
+            cpSpatialIndexCount(statics), cpSpatialIndexCount(dynamic), static_count, dynamic_count);
+    }
+
+    cpBBTreeQuality quality;
+    cpBBTreeGetQuality(dynamic, &quality);
+
+    cpSpatialIndexFree(dynamic);
+    cpSpatialIndexFree(statics);
+    return quality;
+}
+
+int main(int argc, char **argv) {
+    int rounds = 60;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:")) != -1) {
+        switch (opt) {
+            case 'n':
+                rounds = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-n rounds]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    static const int budgets[] = {0, 8, INT_MAX};
+    for (int i = 0; i < 3; i++) {
+        cpBBTreeQuality quality = run(budgets[i], rounds);
+        printf("rebalance budget %10d: %d rounds matched brute force, %d leaves, depth %d max %.1f average, SAH %.1f\n",
+            budgets[i], rounds, quality.leaves, quality.maxDepth, quality.averageDepth, quality.sahCost);
+    }
+
+    return 0;
+}